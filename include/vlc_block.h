@@ -257,6 +257,70 @@ VLC_API block_t *block_mmap_Alloc(void *addr, size_t length) VLC_USED VLC_MALLOC
  */
 VLC_API block_t * block_shm_Alloc(void *addr, size_t length) VLC_USED VLC_MALLOC;
 
+/**
+ * Shares the payload of a block.
+ *
+ * Turns a block into a reference to a reference-counted payload, so that
+ * parts of the payload can be referenced with block_Slice() without copying.
+ * Each reference has its own metadata. The original block is released
+ * along with the last reference.
+ *
+ * @note References may be written to, but only within their own payload,
+ * unless they were created with block_Reference() (see block_Unshare()).
+ *
+ * @return the shared block (the same block if it was already shared),
+ * or NULL on error (in that case, the block is left untouched).
+ */
+VLC_API block_t *block_Share(block_t *) VLC_USED;
+
+/**
+ * References part of a shared payload.
+ *
+ * @param offset offset of the slice from the start of the block payload,
+ * possibly negative to start within the block headroom
+ * @param length length (bytes) of the slice
+ * @return a new block with default metadata, or NULL if the block payload
+ * is not shared (see block_Share()), the range is out of the block buffer,
+ * or on error.
+ */
+VLC_API block_t *block_Slice(block_t *, ssize_t offset, size_t length) VLC_USED;
+
+/**
+ * References the whole payload of a shared block.
+ *
+ * This is block_Duplicate() without the copy: the new block has its own
+ * copy of the metadata, but shares the payload of the block. Neither block
+ * may be modified in place anymore, until block_Unshare() is called.
+ * block_Realloc() copies them when needed.
+ *
+ * @return a new block, or NULL if the block payload is not shared
+ * (see block_Share()), or on error.
+ */
+VLC_API block_t *block_Reference(block_t *) VLC_USED;
+
+/**
+ * Makes the payload of a block writable in place.
+ *
+ * If the payload may be in use by other references (see block_Reference()),
+ * the block is replaced with a private copy. Otherwise, it is returned as is.
+ *
+ * @return the writable block, or NULL on error (in that case, the block is
+ * released).
+ */
+VLC_API block_t *block_Unshare(block_t *) VLC_USED;
+
+/**
+ * Joins a chain of contiguous slices.
+ *
+ * If all blocks of the chain reference adjacent parts of the same shared
+ * payload, in order, they are merged into the first one without copying.
+ * The metadata are merged as with block_ChainGather().
+ *
+ * @return the joined block, or NULL if the chain cannot be joined
+ * (in that case, the chain is left untouched).
+ */
+VLC_API block_t *block_ChainJoin(block_t *) VLC_USED;
+
 /**
  * Maps a file handle in memory.
  *
@@ -396,6 +460,10 @@ static inline block_t *block_ChainGather( block_t *p_list )
     if( p_list->p_next == NULL )
         return p_list;  /* Already gathered */
 
+    g = block_ChainJoin( p_list );
+    if( g )
+        return g;  /* Contiguous slices, no copy needed */
+
     block_ChainProperties( p_list, NULL, &i_total, &i_length );
 
     g = block_Alloc( i_total );
@@ -110,13 +110,17 @@ typedef struct httpd_callback_sys_t httpd_callback_sys_t;
 typedef int    (*httpd_callback_t)( httpd_callback_sys_t *, httpd_client_t *, httpd_message_t *answer, const httpd_message_t *query );
 /* register a new url */
 VLC_API httpd_url_t * httpd_UrlNew( httpd_host_t *, const char *psz_url, const char *psz_user, const char *psz_password ) VLC_USED;
-/* register callback on a url */
+/* register callback on a url; an HTTP callback returning VLC_SUCCESS without
+ * setting answer->i_type defers the request, and is called again ~20ms later */
 VLC_API int httpd_UrlCatch( httpd_url_t *, int i_msg, httpd_callback_t, httpd_callback_sys_t * );
 /* delete a url */
 VLC_API void httpd_UrlDelete( httpd_url_t * );
 
 VLC_API char* httpd_ClientIP( const httpd_client_t *cl, char *, int * );
 VLC_API char* httpd_ServerIP( const httpd_client_t *cl, char *, int * );
+/* set the date past which the deferred answer to the current query of a
+ * client is given up, with a 503 error; only the first call counts */
+VLC_API void httpd_ClientSetDeadline( httpd_client_t *cl, mtime_t deadline );
 
 /* High level */
 
@@ -126,6 +130,24 @@ typedef int (*httpd_file_callback_t)( httpd_file_sys_t *, httpd_file_t *, uint8_
 VLC_API httpd_file_t * httpd_FileNew( httpd_host_t *, const char *psz_url, const char *psz_mime, const char *psz_user, const char *psz_password, httpd_file_callback_t pf_fill, httpd_file_sys_t * ) VLC_USED;
 VLC_API httpd_file_sys_t * httpd_FileDelete( httpd_file_t * );
 
+/**
+ * Callback opening the file to serve for a request.
+ *
+ * \param pi_max_age cache lifetime of the file in seconds, which the callback
+ * may set (initially -1, not to be cached)
+ * \return a file descriptor of a regular file, or -1 if not found.
+ * The HTTP server takes ownership of the file descriptor.
+ */
+typedef int (*httpd_file_fd_callback_t)( httpd_file_sys_t *, httpd_file_t *, uint8_t *psz_request, int *pi_max_age );
+/**
+ * Creates a file served from a file descriptor.
+ *
+ * Unlike httpd_FileNew(), the body is not copied through memory buffers:
+ * it is sent with sendfile() where supported (but not over TLS), and
+ * single byte range requests are honored.
+ */
+VLC_API httpd_file_t * httpd_FileNewFd( httpd_host_t *, const char *psz_url, const char *psz_mime, const char *psz_user, const char *psz_password, httpd_file_fd_callback_t pf_open, httpd_file_sys_t * ) VLC_USED;
+
 
 typedef struct httpd_handler_t  httpd_handler_t;
 typedef int (*httpd_handler_callback_t)( void *, httpd_handler_t *, char *psz_url, uint8_t *psz_request, int i_type, uint8_t *p_in, int i_in, char *psz_remote_addr, char *psz_remote_host, uint8_t **pp_data, int *pi_data );
@@ -99,6 +99,10 @@ struct picture_t
 
     /** Next picture in a FIFO a pictures */
     struct picture_t *p_next;
+
+    /** To be encoded as a random access point (last, not to move the other
+     * members for existing plugins) */
+    bool            b_keyframe;
 };
 
 /**
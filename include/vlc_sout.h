@@ -91,8 +91,35 @@ enum access_out_query_e
 {
     ACCESS_OUT_CONTROLS_PACE, /* arg1=bool *, can fail (assume true) */
     ACCESS_OUT_CAN_SEEK, /* arg1=bool *, can fail (assume false) */
+    ACCESS_OUT_INSERT_RANGE, /* arg1=uint64_t offset, arg2=uint64_t length,
+                                arg3=bool *intact, moves the data from offset
+                                up by length, can fail (original data is then
+                                intact unless *intact is false) */
+    ACCESS_OUT_SEGMENT, /* arg1=const sout_segment_t *, announces the data
+                           written until the next announce, can fail */
 };
 
+/**
+ * Segment of the output of a segmenting muxer.
+ *
+ * The muxer announces each segment (or chunk of a segment) with
+ * ACCESS_OUT_SEGMENT, before writing its data. Access outputs may use it to
+ * split their output and to write a manifest.
+ */
+typedef struct sout_segment_t
+{
+    unsigned i_flags; /**< SOUT_SEGMENT_* */
+    uint32_t i_sequence; /**< media segment number, from 1 */
+    mtime_t  i_start; /**< media time of the data, from 0 */
+    mtime_t  i_length; /**< duration of the data */
+} sout_segment_t;
+
+/** Initialization segment, without media data */
+#define SOUT_SEGMENT_INIT  0x1
+/** Start of a media segment, beginning with a random access point.
+ * Without this flag, the data is the next chunk of the current segment. */
+#define SOUT_SEGMENT_START 0x2
+
 VLC_API sout_access_out_t * sout_AccessOutNew( vlc_object_t *, const char *psz_access, const char *psz_name ) VLC_USED;
 #define sout_AccessOutNew( obj, access, name ) \
         sout_AccessOutNew( VLC_OBJECT(obj), access, name )
@@ -154,6 +154,8 @@ enum stream_query_e
     STREAM_GET_CONTENT_TYPE,    /**< arg1= char **         res=can fail */
     STREAM_GET_SIGNAL,      /**< arg1=double *pf_quality, arg2=double *pf_strength   res=can fail */
     STREAM_GET_TAGS,        /**< arg1=const block_t ** res=can fail */
+    STREAM_GET_CACHE_STATS, /**< arg1=stream_cache_stats_t * res=can fail */
+    STREAM_GET_VALIDATOR,   /**< arg1= char ** res=can fail */
 
     STREAM_SET_PAUSE_STATE = 0x200, /**< arg1= bool        res=can fail */
     STREAM_SET_TITLE,       /**< arg1= int          res=can fail */
@@ -167,6 +169,20 @@ enum stream_query_e
     STREAM_GET_PRIVATE_ID_STATE,          /* arg1=int i_private_data arg2=bool *          res=can fail */
 };
 
+/**
+ * Read-ahead cache statistics, as returned by STREAM_GET_CACHE_STATS.
+ */
+typedef struct stream_cache_stats_t
+{
+    uint64_t i_size;        /**< Current cache size (bytes) */
+    uint64_t i_max_size;    /**< Cache size limit (bytes) */
+    uint64_t i_level;       /**< Data buffered ahead of the read offset */
+    uint64_t i_byterate;    /**< Measured upstream throughput (bytes/s) */
+    uint64_t i_consumption; /**< Measured downstream read rate (bytes/s) */
+    mtime_t  i_latency;     /**< Average upstream read latency */
+    unsigned i_underruns;   /**< Times the reader had to wait for data */
+} stream_cache_stats_t;
+
 /**
  * Reads data from a byte stream.
  *
@@ -64,14 +64,60 @@
 #include <vlc_fs.h>
 #include <vlc_url.h>
 #include <vlc_interrupt.h>
+#ifdef HAVE_LIBURING
+# include <liburing.h>
+#endif
+
+#ifdef HAVE_LIBURING
+/* One read of the queue */
+typedef struct
+{
+    void    *p_buf;
+    uint64_t i_pos;
+    int      i_res;  /* bytes read, or -errno */
+    bool     b_done;
+    bool     b_canceled;
+} file_read_t;
+#endif
 
 struct access_sys_t
 {
     int fd;
 
     bool b_pace_control;
+
+    /* Read-ahead hints */
+    uint64_t i_offset;     /* current file offset */
+    uint64_t i_ra_end;     /* end of the requested read-ahead */
+    uint64_t i_drop_end;   /* end of the already dropped cache pages */
+    uint64_t i_sequential; /* bytes read since the last far seek */
+    size_t   i_ra_window;
+    size_t   i_ra_max;
+    unsigned i_far_seeks;  /* far seeks since the last sequential run */
+    bool     b_random;
+    bool     b_drop_cache;
+
+#ifdef HAVE_LIBURING
+    /* Read queue: i_queued reads from i_head, in file order */
+    struct io_uring ring;
+    file_read_t *readv;
+    unsigned i_reads;
+    unsigned i_head;
+    unsigned i_queued;
+    uint64_t i_queue_end;  /* file offset of the next read to queue */
+    bool     b_ring;
+    bool     b_direct;
+#endif
 };
 
+/* Initial read-ahead window, doubled on each sequential read-ahead */
+#define FILE_READAHEAD_MIN (128 * 1024)
+/* Far seeks before read-ahead is disabled */
+#define FILE_RANDOM_SEEKS 3
+/* Size and alignment of the reads of the queue */
+#define FILE_READ_SIZE  (256 * 1024)
+#define FILE_READ_ALIGN 4096
+
 #if !defined (_WIN32) && !defined (__OS2__)
 static bool IsRemote (int fd)
 {
@@ -128,6 +174,355 @@ static bool IsRemote (const char *path)
 # define posix_fadvise(fd, off, len, adv)
 #endif
 
+/**
+ * Asks the operating system to read data ahead of the current offset, so that
+ * several asynchronous reads remain in flight while the demuxer is busy.
+ */
+static void FileReadAhead (stream_t *p_access)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+
+    if (p_sys->i_ra_max == 0)
+        return;
+
+    if (p_sys->b_random)
+    {
+        if (p_sys->i_sequential < p_sys->i_ra_max)
+            return;
+        /* Long sequential run: back to read-ahead */
+        msg_Dbg (p_access, "sequential access pattern");
+        posix_fadvise (p_sys->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        p_sys->b_random = false;
+        p_sys->i_far_seeks = 0;
+    }
+
+    if (p_sys->i_ra_end > p_sys->i_offset + p_sys->i_ra_window / 2)
+        return; /* enough in flight already */
+
+    if (p_sys->i_ra_end < p_sys->i_offset)
+        p_sys->i_ra_end = p_sys->i_offset;
+#ifdef HAVE_LIBURING
+    /* The read queue is the read-ahead */
+    if (!p_sys->b_ring)
+#endif
+    posix_fadvise (p_sys->fd, p_sys->i_ra_end, p_sys->i_ra_window,
+                   POSIX_FADV_WILLNEED);
+    p_sys->i_ra_end += p_sys->i_ra_window;
+
+    if (p_sys->i_ra_window < p_sys->i_ra_max)
+        p_sys->i_ra_window = __MIN(2 * p_sys->i_ra_window, p_sys->i_ra_max);
+
+    /* Release the page cache well behind the read offset */
+    if (p_sys->b_drop_cache
+     && p_sys->i_offset > p_sys->i_drop_end + 2 * p_sys->i_ra_window)
+    {
+        uint64_t end = p_sys->i_offset - p_sys->i_ra_window;
+
+        posix_fadvise (p_sys->fd, p_sys->i_drop_end,
+                       end - p_sys->i_drop_end, POSIX_FADV_DONTNEED);
+        p_sys->i_drop_end = end;
+    }
+}
+
+#ifdef HAVE_LIBURING
+/*
+ * With io_uring, the file is read through a queue of large reads submitted
+ * ahead of the current offset, so that several of them are in flight while
+ * the demuxer works. Optionally, the reads bypass the page cache (O_DIRECT):
+ * the offsets, sizes and buffers of the reads are then aligned, and the
+ * data is copied from the reads to the buffers of the caller.
+ */
+static void RingStop (stream_t *);
+
+static int RingStart (stream_t *p_access)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    unsigned i_reads = var_InheritInteger (p_access, "file-read-queue");
+
+    if (i_reads > p_sys->i_ra_max / FILE_READ_SIZE)
+        i_reads = p_sys->i_ra_max / FILE_READ_SIZE;
+    if (i_reads < 2)
+        i_reads = 2;
+
+    p_sys->readv = calloc (i_reads, sizeof (*p_sys->readv));
+    if (unlikely(p_sys->readv == NULL))
+        return VLC_ENOMEM;
+    p_sys->i_reads = i_reads;
+    p_sys->i_head = 0;
+    p_sys->i_queued = 0;
+    p_sys->i_queue_end = 0;
+
+    for (unsigned i = 0; i < i_reads; i++)
+    {
+        p_sys->readv[i].p_buf = aligned_alloc (FILE_READ_ALIGN, FILE_READ_SIZE);
+        if (unlikely(p_sys->readv[i].p_buf == NULL))
+            goto error;
+    }
+
+    int ret = io_uring_queue_init (i_reads, &p_sys->ring, 0);
+    if (ret < 0)
+    {
+        msg_Dbg (p_access, "io_uring not available: %s",
+                 vlc_strerror_c(-ret));
+        goto error;
+    }
+    p_sys->b_ring = true;
+
+    if (var_InheritBool (p_access, "file-direct"))
+    {
+        int flags = fcntl (p_sys->fd, F_GETFL);
+
+        if (flags != -1 && fcntl (p_sys->fd, F_SETFL, flags | O_DIRECT) == 0)
+            p_sys->b_direct = true;
+        else
+            msg_Warn (p_access, "cannot bypass the page cache: %s",
+                      vlc_strerror_c(errno));
+    }
+
+    msg_Dbg (p_access, "read queue of %u x %u KiB%s", i_reads,
+             FILE_READ_SIZE / 1024, p_sys->b_direct ? ", direct" : "");
+    return VLC_SUCCESS;
+
+error:
+    for (unsigned i = 0; i < i_reads; i++)
+        free (p_sys->readv[i].p_buf);
+    free (p_sys->readv);
+    p_sys->readv = NULL;
+    return VLC_EGENERIC;
+}
+
+/* Waits for a completion, but not past an interruption */
+static int RingWait (access_sys_t *p_sys, struct io_uring_cqe **cqe)
+{
+    struct __kernel_timespec ts = { .tv_sec = 0, .tv_nsec = 100000000 };
+
+    for (;;)
+    {
+        int ret = io_uring_wait_cqe_timeout (&p_sys->ring, cqe, &ts);
+        if (ret != -ETIME && ret != -EINTR)
+            return ret;
+        if (vlc_killed ())
+            return -EINTR;
+    }
+}
+
+/* Collects the completed reads, waiting for the first queued one if asked */
+static int RingReap (access_sys_t *p_sys, bool b_wait)
+{
+    for (;;)
+    {
+        struct io_uring_cqe *cqe;
+        int ret;
+
+        if (b_wait && !p_sys->readv[p_sys->i_head].b_done)
+            ret = RingWait (p_sys, &cqe);
+        else
+            ret = io_uring_peek_cqe (&p_sys->ring, &cqe);
+        if (ret == -EINTR)
+        {
+            errno = EINTR;
+            return -1;
+        }
+        if (ret < 0)
+            break;
+
+        file_read_t *p_read = io_uring_cqe_get_data (cqe);
+        if (p_read != NULL) /* not a cancellation */
+        {
+            p_read->i_res = cqe->res;
+            p_read->b_done = true;
+        }
+        io_uring_cqe_seen (&p_sys->ring, cqe);
+    }
+    return 0;
+}
+
+/* Waits for all the queued reads, before their buffers are reused; the
+ * reads still in flight are canceled first */
+static int RingFlush (access_sys_t *p_sys)
+{
+    bool b_submit = false;
+
+    for (unsigned i = 0; i < p_sys->i_queued; i++)
+    {
+        file_read_t *p_read =
+            &p_sys->readv[(p_sys->i_head + i) % p_sys->i_reads];
+        if (p_read->b_done || p_read->b_canceled)
+            continue;
+
+        struct io_uring_sqe *sqe = io_uring_get_sqe (&p_sys->ring);
+        if (sqe == NULL)
+            break;
+        io_uring_prep_cancel (sqe, p_read, 0);
+        io_uring_sqe_set_data (sqe, NULL);
+        p_read->b_canceled = true;
+        b_submit = true;
+    }
+    if (b_submit)
+        io_uring_submit (&p_sys->ring);
+
+    while (p_sys->i_queued > 0)
+    {
+        if (RingReap (p_sys, true))
+            return -1;
+        p_sys->readv[p_sys->i_head].b_done = false;
+        p_sys->i_head = (p_sys->i_head + 1) % p_sys->i_reads;
+        p_sys->i_queued--;
+    }
+    return 0;
+}
+
+/* Queues the reads following the last queued one; a single one at a time
+ * during random access, as the following ones would be wasted */
+static void RingFill (access_sys_t *p_sys)
+{
+    unsigned i_max = p_sys->b_random ? 1 : p_sys->i_reads;
+    bool b_submit = false;
+
+    while (p_sys->i_queued < i_max)
+    {
+        struct io_uring_sqe *sqe = io_uring_get_sqe (&p_sys->ring);
+        if (sqe == NULL)
+            break;
+
+        unsigned i = (p_sys->i_head + p_sys->i_queued) % p_sys->i_reads;
+        file_read_t *p_read = &p_sys->readv[i];
+
+        p_read->i_pos = p_sys->i_queue_end;
+        p_read->b_done = false;
+        p_read->b_canceled = false;
+        io_uring_prep_read (sqe, p_sys->fd, p_read->p_buf, FILE_READ_SIZE,
+                            p_read->i_pos);
+        io_uring_sqe_set_data (sqe, p_read);
+
+        p_sys->i_queue_end += FILE_READ_SIZE;
+        p_sys->i_queued++;
+        b_submit = true;
+    }
+
+    if (b_submit)
+        io_uring_submit (&p_sys->ring);
+}
+
+/* Reads at the offset without the queue, once it is flushed */
+static ssize_t RingReadSync (access_sys_t *p_sys, void *p_buffer, size_t i_len)
+{
+    if (!p_sys->b_direct)
+    {
+        if (lseek (p_sys->fd, p_sys->i_offset, SEEK_SET) == (off_t)-1)
+            return -1;
+        return vlc_read_i11e (p_sys->fd, p_buffer, i_len);
+    }
+
+    /* Direct reads need aligned offsets and buffers: go through the (free)
+     * buffer of the first read. Should the file system return less than
+     * aligned sizes, EINVAL makes the caller stop direct reads. */
+    file_read_t *p_read = &p_sys->readv[p_sys->i_head];
+    uint64_t i_pos = p_sys->i_offset & ~(uint64_t)(FILE_READ_ALIGN - 1);
+    size_t i_skip = p_sys->i_offset - i_pos, i_got = 0;
+
+    if (lseek (p_sys->fd, i_pos, SEEK_SET) == (off_t)-1)
+        return -1;
+    while (i_got <= i_skip)
+    {
+        ssize_t val = vlc_read_i11e (p_sys->fd, (char *)p_read->p_buf + i_got,
+                                     FILE_READ_SIZE - i_got);
+        if (val <= 0)
+            return val;
+        i_got += val;
+    }
+
+    size_t i_copy = __MIN(i_len, i_got - i_skip);
+    memcpy (p_buffer, (char *)p_read->p_buf + i_skip, i_copy);
+    return i_copy;
+}
+
+static ssize_t RingRead (stream_t *p_access, void *p_buffer, size_t i_len)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    const uint64_t i_pos = p_sys->i_offset;
+
+    /* Skips the reads before the offset, or restarts the queue there */
+    while (p_sys->i_queued > 0)
+    {
+        file_read_t *p_read = &p_sys->readv[p_sys->i_head];
+
+        if (i_pos >= p_read->i_pos && i_pos < p_read->i_pos + FILE_READ_SIZE)
+            break;
+        if (i_pos < p_read->i_pos || i_pos >= p_sys->i_queue_end)
+        {
+            if (RingFlush (p_sys))
+                return -1;
+            break;
+        }
+        if (RingReap (p_sys, true))
+            return -1;
+        p_read->b_done = false;
+        p_sys->i_head = (p_sys->i_head + 1) % p_sys->i_reads;
+        p_sys->i_queued--;
+    }
+    if (p_sys->i_queued == 0)
+        p_sys->i_queue_end = i_pos & ~(uint64_t)(FILE_READ_ALIGN - 1);
+
+    RingFill (p_sys);
+    if (RingReap (p_sys, true))
+        return -1;
+
+    file_read_t *p_read = &p_sys->readv[p_sys->i_head];
+    if (p_read->i_res < 0)
+    {
+        int i_errno = -p_read->i_res;
+
+        RingFlush (p_sys);
+        errno = i_errno;
+        return -1;
+    }
+
+    size_t i_skip = i_pos - p_read->i_pos;
+    if ((size_t)p_read->i_res <= i_skip)
+    {   /* Short read: end of file, or a file system returning less than
+         * asked (network, FUSE, file being written). Do not guess. */
+        if (RingFlush (p_sys))
+            return -1;
+        return RingReadSync (p_sys, p_buffer, i_len);
+    }
+
+    size_t i_copy = __MIN(i_len, p_read->i_res - i_skip);
+    memcpy (p_buffer, (char *)p_read->p_buf + i_skip, i_copy);
+
+    if (i_skip + i_copy == FILE_READ_SIZE)
+    {
+        p_read->b_done = false;
+        p_sys->i_head = (p_sys->i_head + 1) % p_sys->i_reads;
+        p_sys->i_queued--;
+        RingFill (p_sys);
+    }
+    return i_copy;
+}
+
+static void RingStop (stream_t *p_access)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+
+    /* The buffers cannot be freed while the kernel may still write them */
+    while (RingFlush (p_sys))
+        ;
+    io_uring_queue_exit (&p_sys->ring);
+    for (unsigned i = 0; i < p_sys->i_reads; i++)
+        free (p_sys->readv[i].p_buf);
+    free (p_sys->readv);
+    p_sys->readv = NULL;
+    p_sys->b_ring = false;
+
+    if (p_sys->b_direct)
+    {
+        fcntl (p_sys->fd, F_SETFL, fcntl (p_sys->fd, F_GETFL) & ~O_DIRECT);
+        p_sys->b_direct = false;
+    }
+    lseek (p_sys->fd, p_sys->i_offset, SEEK_SET);
+}
+#endif
+
 static ssize_t Read (stream_t *, void *, size_t);
 static int FileSeek (stream_t *, uint64_t);
 static int NoSeek (stream_t *, uint64_t);
@@ -219,6 +614,20 @@ int FileOpen( vlc_object_t *p_this )
     p_access->pf_control = FileControl;
     p_access->p_sys = p_sys;
     p_sys->fd = fd;
+    p_sys->i_offset = 0;
+    p_sys->i_ra_end = 0;
+    p_sys->i_drop_end = 0;
+    p_sys->i_sequential = 0;
+    p_sys->i_ra_window = FILE_READAHEAD_MIN;
+    p_sys->i_ra_max = 0;
+    p_sys->i_far_seeks = 0;
+    p_sys->b_random = false;
+    p_sys->b_drop_cache = false;
+#ifdef HAVE_LIBURING
+    p_sys->readv = NULL;
+    p_sys->b_ring = false;
+    p_sys->b_direct = false;
+#endif
 
     if (S_ISREG (st.st_mode) || S_ISBLK (st.st_mode))
     {
@@ -229,6 +638,19 @@ int FileOpen( vlc_object_t *p_this )
         posix_fadvise (fd, 0, 4096, POSIX_FADV_WILLNEED);
         /* In most cases, we only read the file once. */
         posix_fadvise (fd, 0, 0, POSIX_FADV_NOREUSE);
+#ifdef HAVE_POSIX_FADVISE
+        p_sys->i_ra_max = var_InheritInteger (p_access, "file-readahead") << 10;
+        p_sys->b_drop_cache = var_InheritBool (p_access, "file-drop-cache");
+        if (p_sys->i_ra_max > 0)
+            posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        if (p_sys->i_ra_window > p_sys->i_ra_max)
+            p_sys->i_ra_window = p_sys->i_ra_max;
+#endif
+#ifdef HAVE_LIBURING
+        if (p_sys->i_ra_max > 0
+         && var_InheritInteger (p_access, "file-read-queue") > 0)
+            RingStart (p_access);
+#endif
 #ifdef F_NOCACHE
         fcntl (fd, F_NOCACHE, 0);
 #endif
@@ -267,6 +689,10 @@ void FileClose (vlc_object_t * p_this)
 
     access_sys_t *p_sys = p_access->p_sys;
 
+#ifdef HAVE_LIBURING
+    if (p_sys->b_ring)
+        RingStop (p_access);
+#endif
     vlc_close (p_sys->fd);
 }
 
@@ -275,8 +701,23 @@ static ssize_t Read (stream_t *p_access, void *p_buffer, size_t i_len)
 {
     access_sys_t *p_sys = p_access->p_sys;
     int fd = p_sys->fd;
+    ssize_t val;
 
-    ssize_t val = vlc_read_i11e (fd, p_buffer, i_len);
+#ifdef HAVE_LIBURING
+    if (p_sys->b_ring)
+    {
+        val = RingRead (p_access, p_buffer, i_len);
+        if (val < 0 && p_sys->b_direct && errno == EINVAL)
+        {
+            msg_Warn (p_access, "direct reads not supported, "
+                      "using cached reads");
+            RingStop (p_access);
+            val = vlc_read_i11e (fd, p_buffer, i_len);
+        }
+    }
+    else
+#endif
+        val = vlc_read_i11e (fd, p_buffer, i_len);
     if (val < 0)
     {
         switch (errno)
@@ -293,6 +734,9 @@ static ssize_t Read (stream_t *p_access, void *p_buffer, size_t i_len)
         val = 0;
     }
 
+    p_sys->i_offset += val;
+    p_sys->i_sequential += val;
+    FileReadAhead (p_access);
     return val;
 }
 
@@ -305,6 +749,24 @@ static int FileSeek (stream_t *p_access, uint64_t i_pos)
 
     if (lseek(sys->fd, i_pos, SEEK_SET) == (off_t)-1)
         return VLC_EGENERIC;
+
+    /* Short forward skips do not break the sequential pattern */
+    if (i_pos < sys->i_offset || i_pos > sys->i_offset + sys->i_ra_window)
+    {
+        sys->i_ra_end = i_pos;
+        sys->i_drop_end = i_pos;
+        sys->i_sequential = 0;
+        sys->i_ra_window = __MIN(FILE_READAHEAD_MIN, sys->i_ra_max);
+
+        if (!sys->b_random && sys->i_ra_max > 0
+         && ++sys->i_far_seeks >= FILE_RANDOM_SEEKS)
+        {   /* Kernel read-ahead would only waste I/O bandwidth */
+            msg_Dbg (p_access, "random access pattern");
+            posix_fadvise (sys->fd, 0, 0, POSIX_FADV_RANDOM);
+            sys->b_random = true;
+        }
+    }
+    sys->i_offset = i_pos;
     return VLC_SUCCESS;
 }
 
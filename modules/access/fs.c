@@ -40,6 +40,26 @@ vlc_module_begin ()
     add_shortcut( "file", "fd", "stream" )
     set_callbacks( FileOpen, FileClose )
 
+    add_integer( "file-readahead", 4096, N_("Read-ahead size"),
+                 N_("Maximum amount of data (in KiB) requested in advance "
+                    "from the operating system while reading files "
+                    "sequentially. Zero leaves read-ahead to the operating "
+                    "system."), true )
+        change_integer_range( 0, 1 << 20 )
+    add_bool( "file-drop-cache", false, N_("Drop read data from cache"),
+              N_("Release the operating system cache of the file data "
+                 "already read. This avoids evicting other data from the "
+                 "cache when processing very large files."), true )
+    add_integer( "file-read-queue", 0, N_("Queued reads"),
+                 N_("Number of large asynchronous reads queued ahead while "
+                    "reading files, within the read-ahead size. Zero reads "
+                    "files synchronously. This needs io_uring support."),
+                 true )
+        change_integer_range( 0, 32 )
+    add_bool( "file-direct", false, N_("Direct file reads"),
+              N_("Read files without going through the operating system "
+                 "cache. This needs queued reads."), true )
+
     add_submodule()
     set_section( N_("Directory" ), NULL )
     set_capability( "access", 55 )
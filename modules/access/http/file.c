@@ -193,6 +193,18 @@ uintmax_t vlc_http_file_get_size(struct vlc_http_resource *res)
     return vlc_http_msg_get_size(res->response);
 }
 
+char *vlc_http_file_get_validator(struct vlc_http_resource *res)
+{
+    int status = vlc_http_res_get_status(res);
+    if (status < 200 || status >= 300)
+        return NULL;
+
+    const char *str = vlc_http_msg_get_header(res->response, "ETag");
+    if (str == NULL)
+        str = vlc_http_msg_get_header(res->response, "Last-Modified");
+    return (str != NULL) ? strdup(str) : NULL;
+}
+
 bool vlc_http_file_can_seek(struct vlc_http_resource *res)
 {   /* See IETF RFC7233 */
     int status = vlc_http_res_get_status(res);
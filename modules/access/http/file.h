@@ -55,6 +55,17 @@ struct vlc_http_resource *vlc_http_file_create(struct vlc_http_mgr *mgr,
  */
 uintmax_t vlc_http_file_get_size(struct vlc_http_resource *);
 
+/**
+ * Gets the entity validator.
+ *
+ * Returns the entity tag of the file, or its modification date if the server
+ * did not supply an entity tag. Two equal validators for the same URL identify
+ * the same version of the file.
+ *
+ * @return a heap-allocated string (use free() to release it), or NULL if none
+ */
+char *vlc_http_file_get_validator(struct vlc_http_resource *);
+
 /**
  * Checks seeking support.
  *
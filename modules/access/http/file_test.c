@@ -89,6 +89,9 @@ int main(void)
     str = vlc_http_file_get_type(f);
     assert(str != NULL && !strcmp(str, "video/mpeg"));
     free(str);
+    str = vlc_http_file_get_validator(f);
+    assert(str != NULL && !strcmp(str, "\"foobar42\""));
+    free(str);
 
     /* Seek failure */
     replies[0] = "HTTP/1.1 200 OK\r\nETag: \"foobar42\"\r\n\r\n";
@@ -108,6 +111,9 @@ int main(void)
     assert(f != NULL);
     assert(vlc_http_file_can_seek(f));
     assert(vlc_http_file_get_size(f) == 2345);
+    str = vlc_http_file_get_validator(f);
+    assert(str != NULL && !strcmp(str, "W/\"foobar42\""));
+    free(str);
     assert(vlc_http_file_read(f) == NULL);
 
     /* Seek success */
@@ -40,6 +40,9 @@
 #ifdef __OS2__
 #   include <io.h>      /* setmode() */
 #endif
+#ifdef HAVE_FSTATVFS
+#   include <sys/statvfs.h>
+#endif
 
 #include <vlc_common.h>
 #include <vlc_plugin.h>
@@ -49,6 +52,9 @@
 #include <vlc_network.h>
 #include <vlc_strings.h>
 #include <vlc_dialog.h>
+#ifdef HAVE_COPY_FILE_RANGE
+# include "file_range.h"
+#endif
 
 #ifndef O_LARGEFILE
 #   define O_LARGEFILE 0
@@ -192,6 +198,61 @@ static int Seek( sout_access_out_t *p_access, off_t i_pos )
     return lseek( (intptr_t)p_access->p_sys, i_pos, SEEK_SET );
 }
 
+#if defined(HAVE_FALLOCATE) || defined(HAVE_COPY_FILE_RANGE)
+/*****************************************************************************
+ * InsertRange: move the end of the file up without copying it to user space
+ *****************************************************************************/
+static int InsertRange( sout_access_out_t *p_access, uint64_t i_offset,
+                        uint64_t i_length, bool *pb_intact )
+{
+    int fd = (intptr_t)p_access->p_sys;
+    struct stat st;
+
+    *pb_intact = true;
+    if( fstat( fd, &st ) || !S_ISREG( st.st_mode )
+     || (uint64_t)st.st_size < i_offset )
+        return VLC_EGENERIC;
+
+# if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_INSERT_RANGE)
+    /* Remaps extents: no data is copied, but needs block alignment and
+     * file system support (ext4, XFS) */
+    if( fallocate( fd, FALLOC_FL_INSERT_RANGE, i_offset, i_length ) == 0 )
+        return VLC_SUCCESS;
+    msg_Dbg( p_access, "cannot insert range: %s", vlc_strerror_c(errno) );
+# endif
+# ifdef HAVE_COPY_FILE_RANGE
+#  ifdef HAVE_FSTATVFS
+    /* Do not start moving data that would not fit */
+    struct statvfs stf;
+
+    if( fstatvfs( fd, &stf ) == 0
+     && (uint64_t)stf.f_bavail * stf.f_frsize < i_length )
+    {
+        msg_Dbg( p_access, "not enough space to copy range" );
+        return VLC_EGENERIC;
+    }
+#  endif
+    /* Copy in the kernel, last chunk first */
+    switch( file_ShiftRange( fd, i_offset, st.st_size, i_length,
+                             FILE_RANGE_CHUNK ) )
+    {
+        case 0:
+            return VLC_SUCCESS;
+        case -1:
+            msg_Dbg( p_access, "cannot copy range: %s",
+                     vlc_strerror_c(errno) );
+            break;
+        default:
+            msg_Err( p_access, "cannot copy range back: %s",
+                     vlc_strerror_c(errno) );
+            *pb_intact = false;
+            break;
+    }
+# endif
+    return VLC_EGENERIC;
+}
+#endif
+
 static int Control( sout_access_out_t *p_access, int i_query, va_list args )
 {
     switch( i_query )
@@ -210,6 +271,22 @@ static int Control( sout_access_out_t *p_access, int i_query, va_list args )
             break;
         }
 
+        case ACCESS_OUT_INSERT_RANGE:
+        {
+            uint64_t i_offset = va_arg( args, uint64_t );
+            uint64_t i_length = va_arg( args, uint64_t );
+            bool *pb_intact = va_arg( args, bool * );
+
+            *pb_intact = true;
+#if defined(HAVE_FALLOCATE) || defined(HAVE_COPY_FILE_RANGE)
+            if( p_access->pf_seek != NULL )
+                return InsertRange( p_access, i_offset, i_length, pb_intact );
+#else
+            VLC_UNUSED(i_offset); VLC_UNUSED(i_length);
+#endif
+            return VLC_EGENERIC;
+        }
+
         default:
             return VLC_EGENERIC;
     }
@@ -0,0 +1,96 @@
+/*****************************************************************************
+ * file_range.h: move a range of a file up without copying it to user space
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_ACCESS_OUTPUT_FILE_RANGE_H
+#define VLC_ACCESS_OUTPUT_FILE_RANGE_H
+
+#include <errno.h>
+#include <unistd.h>
+
+#define FILE_RANGE_CHUNK (UINT64_C(1) << 24)
+
+static inline int file_CopyRange( int fd, uint64_t i_from, uint64_t i_to,
+                                  uint64_t i_size )
+{
+    loff_t i_in = i_from, i_out = i_to;
+
+    while( i_size > 0 )
+    {
+        ssize_t val = copy_file_range( fd, &i_in, fd, &i_out, i_size, 0 );
+        if( val <= 0 )
+        {
+            if( val == 0 )
+                errno = EIO;
+            else if( errno == EINTR )
+                continue;
+            return -1;
+        }
+        i_size -= val;
+    }
+    return 0;
+}
+
+/**
+ * Moves the data of a file from i_offset to i_end up by i_length bytes,
+ * last chunk first. Chunks do not overlap their destination.
+ *
+ * If a chunk cannot be copied, the chunks already moved are copied back
+ * down, and the file is truncated to i_end.
+ *
+ * \return 0 on success, -1 if the original data is intact, or -2 if it could
+ * not be restored (errno is set in both error cases)
+ */
+static inline int file_ShiftRange( int fd, uint64_t i_offset, uint64_t i_end,
+                                   uint64_t i_length, uint64_t i_chunk )
+{
+    uint64_t i_done = i_end; /* the data from there is moved */
+    uint64_t i_size;
+
+    if( i_chunk > i_length )
+        i_chunk = i_length;
+
+    while( i_done > i_offset )
+    {
+        i_size = __MIN( i_chunk, i_done - i_offset );
+        if( file_CopyRange( fd, i_done - i_size, i_done - i_size + i_length,
+                            i_size ) )
+            goto undo;
+        i_done -= i_size;
+    }
+    return 0;
+
+undo:;
+    /* The moved chunks are intact at their destination, and a partial copy
+     * only wrote above its own source: copy them back lowest first. */
+    int i_errno = errno;
+
+    for( uint64_t i_pos = i_done; i_pos < i_end; i_pos += i_size )
+    {
+        i_size = __MIN( i_chunk, i_end - i_pos );
+        if( file_CopyRange( fd, i_pos + i_length, i_pos, i_size ) )
+            return -2;
+    }
+    if( ftruncate( fd, i_end ) )
+        return -2;
+    errno = i_errno;
+    return -1;
+}
+
+#endif
@@ -43,6 +43,8 @@
 #include <vlc_fs.h>
 #include <vlc_strings.h>
 #include <vlc_charset.h>
+#include <vlc_httpd.h>
+#include <vlc_memstream.h>
 
 #include <gcrypt.h>
 #include <vlc_gcrypt.h>
@@ -105,6 +107,12 @@ static void Close( vlc_object_t * );
 #define INTITIAL_SEG_TEXT N_("Number of first segment")
 #define INITIAL_SEG_LONGTEXT N_("The number of the first segment generated")
 
+#define HTTPINDEX_TEXT N_("Serve from memory at this HTTP path")
+#define HTTPINDEX_LONGTEXT N_("Keep the segments in memory and serve them "\
+                              "with the built-in HTTP server, publishing the "\
+                              "index at this path. The destination is then the "\
+                              "HTTP path of the segments.")
+
 vlc_module_begin ()
     set_description( N_("HTTP Live streaming output") )
     set_shortname( N_("LiveHTTP" ))
@@ -135,6 +143,8 @@ vlc_module_begin ()
                 KEYFILE_TEXT, KEYFILE_LONGTEXT, true )
     add_loadfile( SOUT_CFG_PREFIX "key-loadfile", NULL,
                 KEYLOADFILE_TEXT, KEYLOADFILE_LONGTEXT, true )
+    add_string( SOUT_CFG_PREFIX "http-index", NULL,
+                HTTPINDEX_TEXT, HTTPINDEX_LONGTEXT, true )
     set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -156,6 +166,7 @@ static const char *const ppsz_sout_options[] = {
     "key-loadfile",
     "generate-iv",
     "initial-segment-number",
+    "http-index",
     NULL
 };
 
@@ -171,6 +182,10 @@ typedef struct output_segment
     float f_seglength;
     uint32_t i_segment_number;
     uint8_t aes_ivs[16];
+    /* in-memory mode */
+    int i_fd; /* memory file of the data */
+    httpd_file_t *p_file;
+    unsigned i_max_age;
 } output_segment_t;
 
 struct sout_access_out_sys_t
@@ -205,13 +220,43 @@ struct sout_access_out_sys_t
     uint8_t stuffing_bytes[16];
     ssize_t stuffing_size;
     vlc_array_t segments_t;
+    bool b_segment_open;
+
+    /* in-memory mode: segments and index served by the built-in httpd */
+    httpd_host_t *p_httpd_host;
+    httpd_url_t *p_index_url;
+    vlc_mutex_t lock; /* protects the fields below, read by the httpd thread */
+    char *psz_playlist;
+    size_t i_playlist;
+    uint32_t i_playlist_last;
+    bool b_playlist_end;
+
+    /* segments announced by the muxer (ACCESS_OUT_SEGMENT) */
+    bool b_segmented;
+    bool b_init_pending; /* the data written is the init segment */
+    block_t *p_init;
+    block_t **pp_init_end;
+    output_segment_t *p_init_segment;
+    mtime_t i_segment_start;
+    mtime_t i_segment_end;
 };
 
 static int LoadCryptFile( sout_access_out_t *p_access);
 static int CryptSetup( sout_access_out_t *p_access, char *keyfile );
 static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer );
+static void CloseSplit( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys );
+static void CloseSegmented( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys );
+static int writeInitSegment( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys );
+static int closeAnnouncedSegment( sout_access_out_t *p_access,
+                                  sout_access_out_sys_t *p_sys,
+                                  mtime_t i_end, bool b_isend );
 static ssize_t writeSegment( sout_access_out_t *p_access );
 static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys );
+static int HttpSetup( sout_access_out_t *p_access, const char *psz_path );
+static void HttpClean( sout_access_out_sys_t *p_sys );
+static int publishData( sout_access_out_t *p_access,
+                        sout_access_out_sys_t *p_sys,
+                        output_segment_t *segment );
 /*****************************************************************************
  * Open: open the file
  *****************************************************************************/
@@ -242,6 +287,8 @@ static int Open( vlc_object_t *p_this )
     p_sys->ongoing_segment = NULL;
     p_sys->ongoing_segment_end = &p_sys->ongoing_segment;
 
+    p_sys->pp_init_end = &p_sys->p_init;
+
     p_sys->i_numsegs = var_GetInteger( p_access, SOUT_CFG_PREFIX "numsegs" );
     p_sys->i_initial_segment = var_GetInteger( p_access, SOUT_CFG_PREFIX "initial-segment-number" );
     p_sys->b_splitanywhere = var_GetBool( p_access, SOUT_CFG_PREFIX "splitanywhere" );
@@ -301,12 +348,227 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_segment = p_sys->i_initial_segment-1;
     p_sys->psz_cursegPath = NULL;
 
+    psz_idx = var_GetNonEmptyString( p_access, SOUT_CFG_PREFIX "http-index" );
+    if( psz_idx )
+    {
+        int i_ret = HttpSetup( p_access, psz_idx );
+        free( psz_idx );
+        if( i_ret != VLC_SUCCESS )
+        {
+            if( p_sys->key_uri )
+            {
+                gcry_cipher_close( p_sys->aes_ctx );
+                free( p_sys->key_uri );
+            }
+            free( p_sys->psz_indexUrl );
+            free( p_sys->psz_indexPath );
+            free( p_sys );
+            return i_ret;
+        }
+    }
+
     p_access->pf_write = Write;
     p_access->pf_control = Control;
 
     return VLC_SUCCESS;
 }
 
+/*****************************************************************************
+ * HTTP in-memory serving
+ *****************************************************************************/
+static int SegmentOpen( httpd_file_sys_t *p_filesys, httpd_file_t *p_file,
+                        uint8_t *psz_request, int *pi_max_age )
+{
+    /* The segment is immutable once published, and it is unpublished
+     * (httpd_FileDelete) before being destroyed. */
+    output_segment_t *segment = (output_segment_t *)p_filesys;
+    VLC_UNUSED(p_file); VLC_UNUSED(psz_request);
+
+    *pi_max_age = segment->i_max_age;
+    /* the HTTP server sends the data straight from the memory file */
+    return vlc_dup( segment->i_fd );
+}
+
+/* Parses the _HLS_msn blocking playlist reload directive */
+static bool GetBlockingSequence( const uint8_t *psz_args, uint32_t *pi_msn )
+{
+    const char *psz = (const char *)psz_args;
+
+    while( psz != NULL && *psz )
+    {
+        if( !strncmp( psz, "_HLS_msn=", 9 ) )
+        {
+            char *psz_end;
+            unsigned long i_msn = strtoul( psz + 9, &psz_end, 10 );
+            if( psz_end == psz + 9 )
+                return false;
+            *pi_msn = i_msn;
+            return true;
+        }
+        psz = strchr( psz, '&' );
+        if( psz != NULL )
+            psz++;
+    }
+    return false;
+}
+
+static int IndexCallback( httpd_callback_sys_t *p_cbsys, httpd_client_t *cl,
+                          httpd_message_t *answer,
+                          const httpd_message_t *query )
+{
+    sout_access_out_sys_t *p_sys = (sout_access_out_sys_t *)p_cbsys;
+    uint32_t i_msn;
+    unsigned i_max_age = 0;
+    size_t i_length;
+
+    if( answer == NULL || query == NULL )
+        return VLC_SUCCESS;
+
+    vlc_mutex_lock( &p_sys->lock );
+    if( p_sys->psz_playlist == NULL )
+    {
+        vlc_mutex_unlock( &p_sys->lock );
+        return VLC_EGENERIC; /* 404 until the first segment is complete */
+    }
+
+    answer->i_proto  = HTTPD_PROTO_HTTP;
+    answer->i_version= 1;
+    answer->i_status = 200;
+
+    if( p_sys->b_playlist_end )
+        i_max_age = p_sys->i_numsegs * p_sys->i_seglen;
+    else if( GetBlockingSequence( query->psz_args, &i_msn ) )
+    {
+        if( i_msn > p_sys->i_playlist_last + 1 )
+            answer->i_status = 400; /* too far in the future */
+        else if( i_msn > p_sys->i_playlist_last )
+        {
+            /* Leave the answer empty: httpd calls back until the requested
+             * segment is listed, or for three target durations at most,
+             * and then gives up as LL-HLS servers should. */
+            httpd_ClientSetDeadline( cl, mdate() +
+                                     3 * (mtime_t)p_sys->i_seglen * CLOCK_FREQ );
+            vlc_mutex_unlock( &p_sys->lock );
+            return VLC_SUCCESS;
+        }
+        /* the URL names a given playlist version: it can be cached */
+        i_max_age = p_sys->i_numsegs * p_sys->i_seglen;
+    }
+    else
+        i_max_age = __MAX( p_sys->i_seglen / 2, 1 );
+
+    answer->i_type = HTTPD_MSG_ANSWER;
+    if( answer->i_status != 200 )
+    {
+        vlc_mutex_unlock( &p_sys->lock );
+        httpd_MsgAdd( answer, "Content-Length", "0" );
+        return VLC_SUCCESS;
+    }
+
+    i_length = p_sys->i_playlist;
+    if( query->i_type != HTTPD_MSG_HEAD )
+    {
+        answer->p_body = malloc( p_sys->i_playlist );
+        if( likely(answer->p_body != NULL) )
+        {
+            memcpy( answer->p_body, p_sys->psz_playlist, p_sys->i_playlist );
+            answer->i_body = p_sys->i_playlist;
+        }
+    }
+    vlc_mutex_unlock( &p_sys->lock );
+
+    httpd_MsgAdd( answer, "Content-Type", "%s",
+                  "application/vnd.apple.mpegurl" );
+    httpd_MsgAdd( answer, "Cache-Control", "max-age=%u", i_max_age );
+    httpd_MsgAdd( answer, "Content-Length", "%zu", i_length );
+    return VLC_SUCCESS;
+}
+
+/************************************************************************
+ * HttpSetup: publish the index on the built-in HTTP server
+ ************************************************************************/
+static int HttpSetup( sout_access_out_t *p_access, const char *psz_path )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    if( psz_path[0] != '/' || p_access->psz_path[0] != '/' )
+    {
+        msg_Err( p_access, "HTTP paths must be absolute (%s, %s)", psz_path,
+                 p_access->psz_path );
+        return VLC_EGENERIC;
+    }
+
+    /* Segments only live in memory: old ones must always be dropped */
+    if( p_sys->i_numsegs == 0 )
+    {
+        msg_Warn( p_access, "keeping the last 3 segments in memory" );
+        p_sys->i_numsegs = 3;
+    }
+    p_sys->b_delsegs = true;
+
+    vlc_mutex_init( &p_sys->lock );
+
+    p_sys->p_httpd_host = vlc_http_HostNew( VLC_OBJECT(p_access) );
+    if( p_sys->p_httpd_host == NULL )
+    {
+        vlc_mutex_destroy( &p_sys->lock );
+        return VLC_EGENERIC;
+    }
+
+    p_sys->p_index_url = httpd_UrlNew( p_sys->p_httpd_host, psz_path,
+                                       NULL, NULL );
+    if( p_sys->p_index_url == NULL )
+    {
+        msg_Err( p_access, "cannot publish index at %s", psz_path );
+        httpd_HostDelete( p_sys->p_httpd_host );
+        p_sys->p_httpd_host = NULL;
+        vlc_mutex_destroy( &p_sys->lock );
+        return VLC_EGENERIC;
+    }
+    httpd_UrlCatch( p_sys->p_index_url, HTTPD_MSG_GET, IndexCallback,
+                    (httpd_callback_sys_t *)p_sys );
+    httpd_UrlCatch( p_sys->p_index_url, HTTPD_MSG_HEAD, IndexCallback,
+                    (httpd_callback_sys_t *)p_sys );
+
+    msg_Dbg( p_access, "serving index at %s", psz_path );
+    return VLC_SUCCESS;
+}
+
+static void HttpClean( sout_access_out_sys_t *p_sys )
+{
+    if( p_sys->p_httpd_host == NULL )
+        return;
+
+    httpd_UrlDelete( p_sys->p_index_url );
+    httpd_HostDelete( p_sys->p_httpd_host );
+    vlc_mutex_destroy( &p_sys->lock );
+    free( p_sys->psz_playlist );
+}
+
+/************************************************************************
+ * publishData: serve the data of a segment with the httpd
+ ************************************************************************/
+static int publishData( sout_access_out_t *p_access,
+                        sout_access_out_sys_t *p_sys,
+                        output_segment_t *segment )
+{
+    /* Segments remain available for at least that long after leaving
+     * the playlist, see isFirstItemRemovable() */
+    segment->i_max_age = p_sys->i_numsegs * p_sys->i_seglen;
+
+    segment->p_file = httpd_FileNewFd( p_sys->p_httpd_host,
+                                       segment->psz_filename, NULL, NULL, NULL,
+                                       SegmentOpen,
+                                       (httpd_file_sys_t *)segment );
+    if( segment->p_file == NULL )
+    {
+        msg_Err( p_access, "cannot publish segment at %s",
+                 segment->psz_filename );
+        return -1;
+    }
+    return 0;
+}
+
 /************************************************************************
  * CryptSetup: Initialize encryption
  ************************************************************************/
@@ -504,8 +766,40 @@ static char *formatSegmentPath( char *psz_path, uint32_t i_seg )
     return psz_result;
 }
 
+/*****************************************************************************
+ * formatInitPath: create init segment path name, in place of the seg #
+ *****************************************************************************/
+static char *formatInitPath( const char *psz_path )
+{
+    char *psz_result;
+    char *psz_newResult;
+    char *psz_firstNumSign;
+    int ret;
+
+    if ( ! ( psz_result = vlc_strftime( psz_path ) ) )
+        return NULL;
+
+    psz_firstNumSign = psz_result + strcspn( psz_result, SEG_NUMBER_PLACEHOLDER );
+    if ( *psz_firstNumSign )
+    {
+        int i_cnt = strspn( psz_firstNumSign, SEG_NUMBER_PLACEHOLDER );
+
+        *psz_firstNumSign = '\0';
+        ret = asprintf( &psz_newResult, "%sinit%s", psz_result, psz_firstNumSign + i_cnt );
+    }
+    else
+        ret = asprintf( &psz_newResult, "%s.init", psz_result );
+
+    free( psz_result );
+    return ret < 0 ? NULL : psz_newResult;
+}
+
 static void destroySegment( output_segment_t *segment )
 {
+    if( segment->p_file )
+        httpd_FileDelete( segment->p_file );
+    if( segment->i_fd != -1 )
+        vlc_close( segment->i_fd );
     free( segment->psz_filename );
     free( segment->psz_duration );
     free( segment->psz_uri );
@@ -555,6 +849,48 @@ static bool isFirstItemRemovable( sout_access_out_sys_t *p_sys, uint32_t i_first
     return duration >= (first->f_seglength + (float)(p_sys->i_numsegs * p_sys->i_seglen));
 }
 
+/************************************************************************
+ * writeIndexFile: Atomically replace the index file
+ ************************************************************************/
+static int writeIndexFile( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys,
+                           const char *psz_index, size_t i_index )
+{
+    int val;
+    FILE *fp;
+    char *psz_idxTmp;
+    if ( asprintf( &psz_idxTmp, "%s.tmp", p_sys->psz_indexPath ) < 0)
+        return -1;
+
+    fp = vlc_fopen( psz_idxTmp, "wt");
+    if ( !fp )
+    {
+        msg_Err( p_access, "cannot open index file `%s'", psz_idxTmp );
+        free( psz_idxTmp );
+        return -1;
+    }
+
+    if ( fwrite( psz_index, 1, i_index, fp ) != i_index )
+    {
+        free( psz_idxTmp );
+        fclose( fp );
+        return -1;
+    }
+    fclose( fp );
+
+    val = vlc_rename ( psz_idxTmp, p_sys->psz_indexPath);
+
+    if ( val < 0 )
+    {
+        vlc_unlink( psz_idxTmp );
+        msg_Err( p_access, "Error moving LiveHttp index file" );
+    }
+    else
+        msg_Dbg( p_access, "LiveHttpIndexComplete: %s" , p_sys->psz_indexPath );
+
+    free( psz_idxTmp );
+    return 0;
+}
+
 /************************************************************************
  * updateIndexAndDel: If necessary, update index file & delete old segments
  ************************************************************************/
@@ -577,35 +913,39 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
     }
 
     // First update index
-    if ( p_sys->psz_indexPath )
+    if ( p_sys->psz_indexPath || p_sys->p_httpd_host )
     {
-        int val;
-        FILE *fp;
-        char *psz_idxTmp;
-        if ( asprintf( &psz_idxTmp, "%s.tmp", p_sys->psz_indexPath ) < 0)
-            return -1;
+        struct vlc_memstream ms;
+        char *psz_current_uri=NULL;
+        size_t i_target = p_sys->i_seglen;
 
-        fp = vlc_fopen( psz_idxTmp, "wt");
-        if ( !fp )
+        /* segments cut by the muxer can be longer than requested */
+        if ( p_sys->b_segmented )
         {
-            msg_Err( p_access, "cannot open index file `%s'", psz_idxTmp );
-            free( psz_idxTmp );
-            return -1;
+            for ( uint32_t i = i_firstseg; i <= p_sys->i_segment; i++ )
+            {
+                output_segment_t *segment = vlc_array_item_at_index( &p_sys->segments_t,
+                                                    i - i_firstseg + i_index_offset );
+                i_target = __MAX( i_target, (size_t)( segment->f_seglength + .5f ) );
+            }
         }
 
-        if ( fprintf( fp, "#EXTM3U\n#EXT-X-TARGETDURATION:%zu\n#EXT-X-VERSION:3\n#EXT-X-ALLOW-CACHE:%s"
-                          "%s\n#EXT-X-MEDIA-SEQUENCE:%"PRIu32"\n%s", p_sys->i_seglen,
+        if ( vlc_memstream_open( &ms ) )
+            return -1;
+
+        vlc_memstream_printf( &ms, "#EXTM3U\n#EXT-X-TARGETDURATION:%zu\n#EXT-X-VERSION:%d\n#EXT-X-ALLOW-CACHE:%s"
+                          "%s\n#EXT-X-MEDIA-SEQUENCE:%"PRIu32"\n%s", i_target,
+                          p_sys->p_init_segment ? 6 : 3,
                           p_sys->b_caching ? "YES" : "NO",
                           p_sys->i_numsegs > 0 ? "" : b_isend ? "\n#EXT-X-PLAYLIST-TYPE:VOD" : "\n#EXT-X-PLAYLIST-TYPE:EVENT",
                           i_firstseg, ((p_sys->i_initial_segment > 1) && (p_sys->i_initial_segment == i_firstseg)) ? "#EXT-X-DISCONTINUITY\n" : ""
-                          ) < 0 )
-        {
-            free( psz_idxTmp );
-            fclose( fp );
-            return -1;
-        }
-        char *psz_current_uri=NULL;
-
+                          );
+        if ( p_sys->p_httpd_host && !b_isend )
+            vlc_memstream_puts( &ms, "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES\n" );
+        /* the init segment is listed before any key: it is not encrypted */
+        if ( p_sys->p_init_segment )
+            vlc_memstream_printf( &ms, "#EXT-X-MAP:URI=\"%s\"\n",
+                                  p_sys->p_init_segment->psz_uri );
 
         for ( uint32_t i = i_firstseg; i <= p_sys->i_segment; i++ )
         {
@@ -617,7 +957,6 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
                 ( !psz_current_uri ||  strcmp( psz_current_uri, segment->psz_key_uri ) )
               )
             {
-                int ret = 0;
                 free( psz_current_uri );
                 psz_current_uri = strdup( segment->psz_key_uri );
                 if( p_sys->b_generate_iv )
@@ -631,55 +970,43 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
                         iv_lo <<= 8;
                         iv_lo |= segment->aes_ivs[8+j] & 0xff;
                     }
-                    ret = fprintf( fp, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\",IV=0X%16.16llx%16.16llx\n",
-                                   segment->psz_key_uri, iv_hi, iv_lo );
+                    vlc_memstream_printf( &ms, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\",IV=0X%16.16llx%16.16llx\n",
+                                          segment->psz_key_uri, iv_hi, iv_lo );
 
                 } else {
-                    ret = fprintf( fp, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"\n", segment->psz_key_uri );
-                }
-                if( ret < 0 )
-                {
-                    free( psz_current_uri );
-                    free( psz_idxTmp );
-                    fclose( fp );
-                    return -1;
+                    vlc_memstream_printf( &ms, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"\n", segment->psz_key_uri );
                 }
             }
 
-            val = fprintf( fp, "#EXTINF:%s,\n%s\n", segment->psz_duration, segment->psz_uri);
-            if ( val < 0 )
-            {
-                free( psz_current_uri );
-                free( psz_idxTmp );
-                fclose( fp );
-                return -1;
-            }
+            vlc_memstream_printf( &ms, "#EXTINF:%s,\n%s\n", segment->psz_duration, segment->psz_uri);
         }
         free( psz_current_uri );
 
         if ( b_isend )
-        {
-            if ( fputs ( STR_ENDLIST, fp ) < 0)
-            {
-                free( psz_idxTmp );
-                fclose( fp ) ;
-                return -1;
-            }
+            vlc_memstream_puts( &ms, STR_ENDLIST );
 
-        }
-        fclose( fp );
+        if ( vlc_memstream_close( &ms ) )
+            return -1;
 
-        val = vlc_rename ( psz_idxTmp, p_sys->psz_indexPath);
+        int val = 0;
+        if ( p_sys->psz_indexPath )
+            val = writeIndexFile( p_access, p_sys, ms.ptr, ms.length );
 
-        if ( val < 0 )
+        if ( p_sys->p_httpd_host )
         {
-            vlc_unlink( psz_idxTmp );
-            msg_Err( p_access, "Error moving LiveHttp index file" );
+            vlc_mutex_lock( &p_sys->lock );
+            free( p_sys->psz_playlist );
+            p_sys->psz_playlist = ms.ptr;
+            p_sys->i_playlist = ms.length;
+            p_sys->i_playlist_last = p_sys->i_segment;
+            p_sys->b_playlist_end = b_isend;
+            vlc_mutex_unlock( &p_sys->lock );
         }
         else
-            msg_Dbg( p_access, "LiveHttpIndexComplete: %s" , p_sys->psz_indexPath );
+            free( ms.ptr );
 
-        free( psz_idxTmp );
+        if ( val < 0 )
+            return -1;
     }
 
     // Then take care of deletion
@@ -692,7 +1019,7 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
          msg_Dbg( p_access, "Removing segment number %d", segment->i_segment_number );
          vlc_array_remove( &p_sys->segments_t, 0 );
 
-         if ( segment->psz_filename )
+         if ( segment->psz_filename && !p_sys->p_httpd_host )
          {
              vlc_unlink( segment->psz_filename );
          }
@@ -710,7 +1037,7 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
  *****************************************************************************/
 static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys, bool b_isend )
 {
-    if ( p_sys->i_handle >= 0 )
+    if ( p_sys->b_segment_open )
     {
         output_segment_t *segment = vlc_array_item_at_index( &p_sys->segments_t, vlc_array_count( &p_sys->segments_t ) - 1 );
 
@@ -732,8 +1059,12 @@ static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sy
         }
 
 
-        vlc_close( p_sys->i_handle );
+        if( p_sys->p_httpd_host )
+            segment->i_fd = p_sys->i_handle; /* served from memory */
+        else
+            vlc_close( p_sys->i_handle );
         p_sys->i_handle = -1;
+        p_sys->b_segment_open = false;
 
         if( ! ( us_asprintf( &segment->psz_duration, "%.2f", p_sys->f_seglen ) ) )
         {
@@ -744,6 +1075,9 @@ static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sy
 
         segment->i_segment_number = p_sys->i_segment;
 
+        if( p_sys->p_httpd_host && publishData( p_access, p_sys, segment ) )
+            msg_Err( p_access, "Couldn't publish segment %"PRIu32, p_sys->i_segment );
+
         if ( p_sys->psz_cursegPath )
         {
             msg_Dbg( p_access, "LiveHttpSegmentComplete: %s (%"PRIu32")" , p_sys->psz_cursegPath, p_sys->i_segment );
@@ -762,6 +1096,50 @@ static void Close( vlc_object_t * p_this )
     sout_access_out_t *p_access = (sout_access_out_t*)p_this;
     sout_access_out_sys_t *p_sys = p_access->p_sys;
 
+    if( p_sys->b_segmented )
+        CloseSegmented( p_access, p_sys );
+    else
+        CloseSplit( p_access, p_sys );
+
+    if( p_sys->key_uri )
+    {
+        gcry_cipher_close( p_sys->aes_ctx );
+        free( p_sys->key_uri );
+    }
+
+    while( vlc_array_count( &p_sys->segments_t ) > 0 )
+    {
+        output_segment_t *segment = vlc_array_item_at_index( &p_sys->segments_t, 0 );
+        vlc_array_remove( &p_sys->segments_t, 0 );
+        if( p_sys->b_delsegs && p_sys->i_numsegs && segment->psz_filename &&
+            !p_sys->p_httpd_host )
+        {
+            msg_Dbg( p_access, "Removing segment number %d name %s", segment->i_segment_number, segment->psz_filename );
+            vlc_unlink( segment->psz_filename );
+        }
+
+        destroySegment( segment );
+    }
+
+    if( p_sys->p_init_segment )
+    {
+        if( p_sys->b_delsegs && p_sys->i_numsegs && !p_sys->p_httpd_host )
+            vlc_unlink( p_sys->p_init_segment->psz_filename );
+        destroySegment( p_sys->p_init_segment );
+    }
+
+    HttpClean( p_sys );
+
+    free( p_sys->psz_indexUrl );
+    free( p_sys->psz_indexPath );
+    free( p_sys );
+
+    msg_Dbg( p_access, "livehttp access output closed" );
+}
+
+/* Flushes the data split by livehttp itself */
+static void CloseSplit( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys )
+{
     if( p_sys->ongoing_segment )
         block_ChainLastAppend( &p_sys->full_segments_end, p_sys->ongoing_segment );
     p_sys->ongoing_segment = NULL;
@@ -797,31 +1175,188 @@ static void Close( vlc_object_t * p_this )
     }
 
     closeCurrentSegment( p_access, p_sys, true );
+}
 
-    if( p_sys->key_uri )
+/* Flushes the segments announced by the muxer */
+static void CloseSegmented( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys )
+{
+    if( p_sys->b_init_pending )
     {
-        gcry_cipher_close( p_sys->aes_ctx );
-        free( p_sys->key_uri );
+        p_sys->b_init_pending = false;
+        writeInitSegment( p_access, p_sys );
     }
 
-    while( vlc_array_count( &p_sys->segments_t ) > 0 )
+    if( closeAnnouncedSegment( p_access, p_sys, p_sys->i_segment_end, true ) < 0 )
     {
-        output_segment_t *segment = vlc_array_item_at_index( &p_sys->segments_t, 0 );
-        vlc_array_remove( &p_sys->segments_t, 0 );
-        if( p_sys->b_delsegs && p_sys->i_numsegs && segment->psz_filename )
+        msg_Err( p_access, "Couldn't write the last segment" );
+        closeCurrentSegment( p_access, p_sys, true );
+    }
+
+    block_ChainRelease( p_sys->full_segments );
+    block_ChainRelease( p_sys->ongoing_segment );
+}
+
+/*****************************************************************************
+ * writeInitSegment: store the initialization segment of the muxer
+ *****************************************************************************/
+static int writeInitSegment( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys )
+{
+    block_t *p_data = block_ChainGather( p_sys->p_init );
+    p_sys->p_init = NULL;
+    p_sys->pp_init_end = &p_sys->p_init;
+    if( p_data == NULL )
+        return -1;
+
+    output_segment_t *segment = calloc( 1, sizeof(*segment) );
+    if( unlikely( segment == NULL ) )
+    {
+        block_Release( p_data );
+        return -1;
+    }
+    segment->i_fd = -1;
+    segment->psz_filename = formatInitPath( p_access->psz_path );
+    segment->psz_uri = formatInitPath( p_sys->psz_indexUrl ? p_sys->psz_indexUrl
+                                                           : p_access->psz_path );
+    if( unlikely( segment->psz_filename == NULL || segment->psz_uri == NULL ) )
+    {
+        block_Release( p_data );
+        destroySegment( segment );
+        return -1;
+    }
+
+    /* a new init segment replaces the previous one */
+    if( p_sys->p_init_segment )
+    {
+        destroySegment( p_sys->p_init_segment );
+        p_sys->p_init_segment = NULL;
+    }
+
+    int fd;
+    if( p_sys->p_httpd_host )
+        fd = vlc_memfd();
+    else
+        fd = vlc_open( segment->psz_filename, O_WRONLY | O_CREAT |
+                       O_LARGEFILE | O_TRUNC, 0666 );
+    if( fd == -1 )
+    {
+        msg_Err( p_access, "cannot open `%s' (%s)", segment->psz_filename,
+                 vlc_strerror_c(errno) );
+        block_Release( p_data );
+        destroySegment( segment );
+        return -1;
+    }
+
+    const uint8_t *p_buf = p_data->p_buffer;
+    size_t i_buf = p_data->i_buffer;
+    while( i_buf > 0 )
+    {
+        ssize_t val = vlc_write( fd, p_buf, i_buf );
+        if( val == -1 )
         {
-            msg_Dbg( p_access, "Removing segment number %d name %s", segment->i_segment_number, segment->psz_filename );
-            vlc_unlink( segment->psz_filename );
+            if( errno == EINTR )
+                continue;
+            msg_Err( p_access, "cannot write `%s' (%s)",
+                     segment->psz_filename, vlc_strerror_c(errno) );
+            break;
         }
+        p_buf += val;
+        i_buf -= val;
+    }
+    block_Release( p_data );
 
+    if( p_sys->p_httpd_host )
+        segment->i_fd = fd; /* served from memory */
+    else
+        vlc_close( fd );
+    if( i_buf > 0
+     || ( p_sys->p_httpd_host && publishData( p_access, p_sys, segment ) ) )
+    {
         destroySegment( segment );
+        return -1;
     }
 
-    free( p_sys->psz_indexUrl );
-    free( p_sys->psz_indexPath );
-    free( p_sys );
+    msg_Dbg( p_access, "LiveHttpInitComplete: %s", segment->psz_filename );
+    p_sys->p_init_segment = segment;
+    return 0;
+}
 
-    msg_Dbg( p_access, "livehttp access output closed" );
+/*****************************************************************************
+ * closeAnnouncedSegment: write and close the current segment
+ *****************************************************************************/
+static int closeAnnouncedSegment( sout_access_out_t *p_access,
+                                  sout_access_out_sys_t *p_sys,
+                                  mtime_t i_end, bool b_isend )
+{
+    if( !p_sys->b_segment_open )
+        return 0;
+
+    if( p_sys->ongoing_segment )
+        block_ChainLastAppend( &p_sys->full_segments_end, p_sys->ongoing_segment );
+    p_sys->ongoing_segment = NULL;
+    p_sys->ongoing_segment_end = &p_sys->ongoing_segment;
+
+    if( writeSegment( p_access ) < 0 )
+        return -1;
+
+    /* the duration comes from the muxer, not from the blocks */
+    p_sys->f_seglen = (float)( i_end - p_sys->i_segment_start ) / CLOCK_FREQ;
+    closeCurrentSegment( p_access, p_sys, b_isend );
+    return 0;
+}
+
+/*****************************************************************************
+ * SegmentAnnounce: follow the segments cut by the muxer
+ *****************************************************************************/
+static int SegmentAnnounce( sout_access_out_t *p_access,
+                            const sout_segment_t *p_segment )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    if( !p_sys->b_segmented )
+    {
+        /* too late, livehttp already splits the data itself */
+        if( p_sys->b_segment_open || p_sys->ongoing_segment )
+            return VLC_EGENERIC;
+        msg_Dbg( p_access, "following the segments of the muxer" );
+        p_sys->b_segmented = true;
+    }
+
+    if( p_sys->b_init_pending )
+    {
+        p_sys->b_init_pending = false;
+        if( writeInitSegment( p_access, p_sys ) )
+            msg_Err( p_access, "Couldn't write the init segment" );
+    }
+
+    if( p_segment->i_flags & SOUT_SEGMENT_INIT )
+    {
+        p_sys->b_init_pending = true;
+        return VLC_SUCCESS;
+    }
+
+    if( p_segment->i_flags & SOUT_SEGMENT_START )
+    {
+        if( closeAnnouncedSegment( p_access, p_sys, p_segment->i_start, false ) < 0 )
+            return VLC_EGENERIC;
+        p_sys->i_segment_start = p_segment->i_start;
+        p_sys->i_segment_end = p_segment->i_start;
+    }
+    else if( p_sys->ongoing_segment )
+    {
+        /* write the previous chunks of the segment right away */
+        block_ChainLastAppend( &p_sys->full_segments_end, p_sys->ongoing_segment );
+        p_sys->ongoing_segment = NULL;
+        p_sys->ongoing_segment_end = &p_sys->ongoing_segment;
+        if( writeSegment( p_access ) < 0 )
+            return VLC_EGENERIC;
+    }
+
+    p_sys->i_segment_end = __MAX( p_sys->i_segment_end,
+                                  p_segment->i_start + p_segment->i_length );
+
+    if( !p_sys->b_segment_open && openNextFile( p_access, p_sys ) < 0 )
+        return VLC_EGENERIC;
+    return VLC_SUCCESS;
 }
 
 static int Control( sout_access_out_t *p_access, int i_query, va_list args )
@@ -838,6 +1373,12 @@ static int Control( sout_access_out_t *p_access, int i_query, va_list args )
             break;
         }
 
+        case ACCESS_OUT_SEGMENT:
+        {
+            const sout_segment_t *p_segment = va_arg( args, const sout_segment_t * );
+            return SegmentAnnounce( p_access, p_segment );
+        }
+
         default:
             return VLC_EGENERIC;
     }
@@ -849,7 +1390,7 @@ static int Control( sout_access_out_t *p_access, int i_query, va_list args )
  *****************************************************************************/
 static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys )
 {
-    int fd;
+    int fd = -1;
 
     uint32_t i_newseg = p_sys->i_segment + 1;
 
@@ -859,6 +1400,7 @@ static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t
         return -1;
 
     segment->i_segment_number = i_newseg;
+    segment->i_fd = -1;
     segment->psz_filename = formatSegmentPath( p_access->psz_path, i_newseg );
     char *psz_idxFormat = p_sys->psz_indexUrl ? p_sys->psz_indexUrl : p_access->psz_path;
     segment->psz_uri = formatSegmentPath( psz_idxFormat , i_newseg );
@@ -870,8 +1412,11 @@ static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t
         return -1;
     }
 
-    fd = vlc_open( segment->psz_filename, O_WRONLY | O_CREAT | O_LARGEFILE |
-                     O_TRUNC, 0666 );
+    if ( p_sys->p_httpd_host )
+        fd = vlc_memfd();
+    else
+        fd = vlc_open( segment->psz_filename, O_WRONLY | O_CREAT |
+                       O_LARGEFILE | O_TRUNC, 0666 );
     if ( fd == -1 )
     {
         msg_Err( p_access, "cannot open `%s' (%s)", segment->psz_filename,
@@ -898,9 +1443,10 @@ static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t
 
     p_sys->psz_cursegPath = strdup(segment->psz_filename);
     p_sys->i_handle = fd;
+    p_sys->b_segment_open = true;
     p_sys->i_segment = i_newseg;
     p_sys->b_segment_has_data = false;
-    return fd;
+    return 0;
 }
 /*****************************************************************************
  * CheckSegmentChange: Check if segment needs to be closed and new opened
@@ -910,7 +1456,7 @@ static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer )
     sout_access_out_sys_t *p_sys = p_access->p_sys;
     ssize_t writevalue = 0;
 
-    if( p_sys->i_handle > 0 && p_sys->b_segment_has_data &&
+    if( p_sys->b_segment_open && p_sys->b_segment_has_data &&
        (( p_buffer->i_length + p_buffer->i_dts - p_sys->i_opendts ) >= p_sys->i_seglenm ) )
     {
         writevalue = writeSegment( p_access );
@@ -923,7 +1469,7 @@ static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer )
         return writevalue;
     }
 
-    if ( unlikely( p_sys->i_handle < 0 ) )
+    if ( unlikely( !p_sys->b_segment_open ) )
     {
         p_sys->i_opendts = p_buffer->i_dts;
 
@@ -969,6 +1515,10 @@ static ssize_t writeSegment( sout_access_out_t *p_access )
                 memcpy( output->p_buffer, p_sys->stuffing_bytes, p_sys->stuffing_size );
                 p_sys->stuffing_size = 0;
             }
+            /* The segment is encrypted in place */
+            output = block_Unshare( output );
+            if( unlikely(!output ) )
+                return VLC_ENOMEM;
             size_t original = output->i_buffer;
             size_t padded = (output->i_buffer + 15 ) & ~15;
             size_t pad = padded - original;
@@ -1026,6 +1576,17 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
 {
     size_t i_write = 0;
     sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    /* the data is kept until the muxer announces the next segment */
+    if( p_sys->b_init_pending || p_sys->b_segmented )
+    {
+        block_ChainProperties( p_buffer, NULL, &i_write, NULL );
+        if( p_sys->b_init_pending )
+            block_ChainLastAppend( &p_sys->pp_init_end, p_buffer );
+        else
+            block_ChainLastAppend( &p_sys->ongoing_segment_end, p_buffer );
+        return i_write;
+    }
     while( p_buffer )
     {
         /* Check if current block is already past segment-length
@@ -393,6 +393,11 @@ static void* ThreadWrite( void *data )
     mtime_t i_to_send = i_group;
     unsigned i_dropped_packets = 0;
 
+    /* Send jitter: how late the datagrams leave after their dates */
+    mtime_t i_jitter_start = VLC_TS_INVALID;
+    mtime_t i_jitter_sum = 0, i_jitter_max = 0;
+    unsigned i_jitter_count = 0;
+
     for (;;)
     {
         block_t *p_pk = block_FifoGet( p_sys->p_fifo );
@@ -421,9 +426,11 @@ static void* ThreadWrite( void *data )
             }
         }
 
-        block_cleanup_push( p_pk );
         i_to_send--;
-        if( !i_to_send || (p_pk->i_flags & BLOCK_FLAG_CLOCK) )
+        bool b_timed = !i_to_send || (p_pk->i_flags & BLOCK_FLAG_CLOCK);
+
+        block_cleanup_push( p_pk );
+        if( b_timed )
         {
             mwait( i_date );
             i_to_send = i_group;
@@ -447,6 +454,29 @@ static void* ThreadWrite( void *data )
         }
 #endif
 
+        if( b_timed )
+        {
+            mtime_t i_jitter = i_sent - i_date;
+
+            if( i_jitter_start == VLC_TS_INVALID )
+                i_jitter_start = i_sent;
+            i_jitter_sum += i_jitter;
+            if( i_jitter > i_jitter_max )
+                i_jitter_max = i_jitter;
+            i_jitter_count++;
+
+            if( i_sent - i_jitter_start >= 10 * CLOCK_FREQ )
+            {
+                msg_Dbg( p_access, "send jitter: %"PRId64" us average, "
+                         "%"PRId64" us max over %u datagrams",
+                         i_jitter_sum / i_jitter_count, i_jitter_max,
+                         i_jitter_count );
+                i_jitter_start = i_sent;
+                i_jitter_sum = i_jitter_max = 0;
+                i_jitter_count = 0;
+            }
+        }
+
         block_FifoPut( p_sys->p_empty_blocks, p_pk );
 
         i_date_last = i_date;
@@ -1113,7 +1113,8 @@ static void check_hurry_up( encoder_sys_t *p_sys, AVFrame *frame, encoder_t *p_e
         }
     }
 
-    if ( current_date + HURRY_UP_GUARD1 > frame->pts )
+    if ( current_date + HURRY_UP_GUARD1 > frame->pts
+      && frame->pict_type != AV_PICTURE_TYPE_I )
     {
         frame->pict_type = AV_PICTURE_TYPE_P;
         /* msg_Dbg( p_enc, "hurry up mode 1 %lld", current_date + HURRY_UP_GUARD1 - frame.pts ); */
@@ -1170,8 +1171,19 @@ static block_t *EncodeVideo( encoder_t *p_enc, picture_t *p_pict )
             p_sys->frame->linesize[i_plane] = p_pict->p[i_plane].i_pitch;
         }
 
-        /* Let libavcodec select the frame type */
+        /* Let libavcodec select the frame type, unless a keyframe is
+         * requested: an I picture type alone is not a random access point
+         * for all encoders (e.g. open GOP), so flag it as key as well */
         frame->pict_type = 0;
+        if( p_pict->b_keyframe )
+        {
+            frame->pict_type = AV_PICTURE_TYPE_I;
+#ifdef AV_FRAME_FLAG_KEY
+            frame->flags |= AV_FRAME_FLAG_KEY;
+#else
+            frame->key_frame = 1;
+#endif
+        }
 
         frame->repeat_pict = p_pict->i_nb_fields - 2;
         frame->interlaced_frame = !p_pict->b_progressive;
@@ -38,6 +38,7 @@
 #include <vlc_input.h>
 
 #include <vlc_dialog.h>
+#include <vlc_interrupt.h>
 
 #include <vlc_meta.h>
 #include <vlc_codecs.h>
@@ -46,6 +47,7 @@
 
 #include "libavi.h"
 #include "../rawdv.h"
+#include "../seekindex.h"
 
 /*****************************************************************************
  * Module descriptor
@@ -58,6 +60,11 @@
     "Recreate a index for the AVI file. Use this if your AVI file is damaged "\
     "or incomplete (not seekable)." )
 
+#define INDEX_BG_TEXT N_("Create index in background")
+#define INDEX_BG_LONGTEXT N_( \
+    "Start playing immediately while the index is recreated in the " \
+    "background. Seeking waits for the index to reach the target." )
+
 #define BI_RAWRGB 0x00
 #define BI_RGBBITFIELDS 0x03
 
@@ -83,6 +90,8 @@ vlc_module_begin ()
     add_integer( "avi-index", 0,
               INDEX_TEXT, INDEX_LONGTEXT, false )
         change_integer_list( pi_index, ppsz_indexes )
+    add_bool( "avi-index-background", true,
+              INDEX_BG_TEXT, INDEX_BG_LONGTEXT, true )
 
     set_callbacks( Open, Close )
 vlc_module_end ()
@@ -137,6 +146,49 @@ typedef struct
     avi_entry_t     *p_entry;
 
 } avi_index_t;
+
+/* entry of the persistent index cache */
+typedef struct
+{
+    uint64_t     i_pos;
+    uint32_t     i_stream;
+    vlc_fourcc_t i_id;
+    uint32_t     i_flags;
+    uint32_t     i_length;
+} avi_seekindex_entry_t;
+
+/* Parameters of a LIST-movi scan */
+typedef struct
+{
+    off_t   i_movi_pos;
+    off_t   i_movi_end;
+    off_t   i_avix_pos;     /* position of the second RIFF, 0 if none */
+
+    /* called regularly with the scan position, returns false to abort */
+    bool  (*pf_progress)( demux_t *, double, void * );
+    void   *p_opaque;
+    vlc_mutex_t *p_lock;    /* held while appending entries, can be NULL */
+} avi_index_scan_t;
+
+/* Index being created by a background thread */
+typedef struct
+{
+    vlc_thread_t     thread;
+    vlc_mutex_t      lock;
+    vlc_cond_t       wait;
+
+    bool             b_started; /* the progress variable exists */
+    bool             b_active;  /* the thread has not been joined yet */
+    bool             b_done;
+    bool             b_complete;
+    bool             b_cancel;
+
+    stream_t         *s;
+    avi_index_scan_t scan;
+    avi_index_t      *p_index;  /* one per track, protected by lock */
+    off_t            i_last_pos;
+} avi_index_bg_t;
+
 static void avi_index_Init( avi_index_t * );
 static void avi_index_Clean( avi_index_t * );
 static void avi_index_Append( avi_index_t *, off_t *, avi_entry_t * );
@@ -198,6 +250,11 @@ struct demux_sys_t
 
     unsigned int       i_attachment;
     input_attachment_t **attachment;
+
+    /* cache of the index created from LIST-movi */
+    seekindex_t *p_seekindex;
+
+    avi_index_bg_t bgindex;
 };
 
 static inline off_t __EVEN( off_t i )
@@ -220,12 +277,18 @@ static int AVI_StreamBytesSet ( demux_t *,
 vlc_fourcc_t AVI_FourccGetCodec( unsigned int i_cat, vlc_fourcc_t );
 static int   AVI_GetKeyFlag    ( vlc_fourcc_t , uint8_t * );
 
-static int AVI_PacketGetHeader( demux_t *, avi_packet_t *p_pk );
-static int AVI_PacketNext     ( demux_t * );
-static int AVI_PacketSearch   ( demux_t * );
+static int AVI_PacketGetHeader( stream_t *, avi_packet_t *p_pk );
+static int AVI_PacketNext     ( stream_t * );
+static int AVI_PacketSearch   ( demux_t *, stream_t * );
 
 static void AVI_IndexLoad    ( demux_t * );
 static void AVI_IndexCreate  ( demux_t * );
+static int  AVI_IndexCreateFromCache( demux_t * );
+static void AVI_IndexStoreToCache( demux_t * );
+static int  AVI_IndexBgStart ( demux_t *, const avi_index_scan_t * );
+static void AVI_IndexBgStop  ( demux_t * );
+static void AVI_IndexBgSync  ( demux_t *, bool b_partial );
+static int  AVI_IndexBgWait  ( demux_t *, mtime_t i_date );
 
 static void AVI_ExtractSubtitle( demux_t *, unsigned int i_stream, avi_chunk_list_t *, avi_chunk_STRING_t * );
 
@@ -302,6 +365,8 @@ static int Open( vlc_object_t * p_this )
     p_sys->track    = NULL;
     p_sys->meta     = NULL;
     TAB_INIT(p_sys->i_attachment, p_sys->attachment);
+    p_sys->p_seekindex = seekindex_New( p_demux, "avi", 1,
+                                        sizeof(avi_seekindex_entry_t) );
 
     vlc_stream_Control( p_demux->s, STREAM_CAN_FASTSEEK,
                         &p_sys->b_fastseekable );
@@ -743,6 +808,12 @@ aviindex:
 
     /* *** movie length in sec *** */
     p_sys->i_length = AVI_MovieGetLength( p_demux );
+    if( p_sys->i_length == 0 && p_sys->bgindex.b_active )
+    {
+        /* trust the header until the index is built */
+        p_sys->i_length = (mtime_t)p_avih->i_totalframes *
+                          (mtime_t)p_avih->i_microsecperframe / CLOCK_FREQ;
+    }
 
     /* Check the index completeness */
     unsigned int i_idx_totalframes = 0;
@@ -854,6 +925,11 @@ aviindex:
     return VLC_SUCCESS;
 
 error:
+    if( p_sys->bgindex.b_active )
+        AVI_IndexBgStop( p_demux );
+    if( p_sys->bgindex.b_started && p_demux->p_input )
+        var_Destroy( p_demux->p_input, "avi-index-progress" );
+
     for( unsigned i = 0; i < p_sys->i_attachment; i++)
         vlc_input_attachment_Delete(p_sys->attachment[i]);
     free(p_sys->attachment);
@@ -861,6 +937,8 @@ error:
     if( p_sys->meta )
         vlc_meta_Delete( p_sys->meta );
 
+    if( p_sys->p_seekindex )
+        seekindex_Delete( p_sys->p_seekindex );
     AVI_ChunkFreeRoot( p_demux->s, &p_sys->ck_root );
     free( p_sys );
     return b_aborted ? VLC_ETIMEOUT : VLC_EGENERIC;
@@ -874,6 +952,11 @@ static void Close ( vlc_object_t * p_this )
     demux_t *    p_demux = (demux_t *)p_this;
     demux_sys_t *p_sys = p_demux->p_sys  ;
 
+    if( p_sys->bgindex.b_active )
+        AVI_IndexBgStop( p_demux );
+    if( p_sys->bgindex.b_started && p_demux->p_input )
+        var_Destroy( p_demux->p_input, "avi-index-progress" );
+
     for( unsigned int i = 0; i < p_sys->i_track; i++ )
     {
         if( p_sys->track[i] )
@@ -892,6 +975,8 @@ static void Close ( vlc_object_t * p_this )
         vlc_input_attachment_Delete(p_sys->attachment[i]);
     free(p_sys->attachment);
 
+    if( p_sys->p_seekindex )
+        seekindex_Delete( p_sys->p_seekindex );
     free( p_sys );
 }
 
@@ -998,6 +1083,8 @@ static int Demux_Seekable( demux_t *p_demux )
     /* cannot be more than 100 stream (dcXX or wbXX) */
     avi_track_toread_t toread[100];
 
+    /* pick up the index once the background scan is over */
+    AVI_IndexBgSync( p_demux, false );
 
     /* detect new selected/unselected streams */
     for( i_track = 0; i_track < p_sys->i_track; i_track++ )
@@ -1136,7 +1223,7 @@ static int Demux_Seekable( demux_t *p_demux )
             if( p_sys->b_seekable && p_sys->i_movi_lastchunk_pos >= p_sys->i_movi_begin + 12 )
             {
                 vlc_stream_Seek( p_demux->s, p_sys->i_movi_lastchunk_pos );
-                if( AVI_PacketNext( p_demux ) )
+                if( AVI_PacketNext( p_demux->s ) )
                 {
                     return( AVI_TrackStopFinishedStreams( p_demux ) ? 0 : 1 );
                 }
@@ -1150,7 +1237,7 @@ static int Demux_Seekable( demux_t *p_demux )
             {
                 avi_packet_t avi_pk;
 
-                if( AVI_PacketGetHeader( p_demux, &avi_pk ) )
+                if( AVI_PacketGetHeader( p_demux->s, &avi_pk ) )
                 {
                     msg_Warn( p_demux,
                              "cannot get packet header, track disabled" );
@@ -1159,7 +1246,7 @@ static int Demux_Seekable( demux_t *p_demux )
                 if( avi_pk.i_stream >= p_sys->i_track ||
                     ( avi_pk.i_cat != AUDIO_ES && avi_pk.i_cat != VIDEO_ES ) )
                 {
-                    if( AVI_PacketNext( p_demux ) )
+                    if( AVI_PacketNext( p_demux->s ) )
                     {
                         msg_Warn( p_demux,
                                   "cannot skip packet, track disabled" );
@@ -1200,7 +1287,7 @@ static int Demux_Seekable( demux_t *p_demux )
                     }
                     else
                     {
-                        if( AVI_PacketNext( p_demux ) )
+                        if( AVI_PacketNext( p_demux->s ) )
                         {
                             msg_Warn( p_demux,
                                       "cannot skip packet, track disabled" );
@@ -1404,7 +1491,7 @@ static int Demux_UnSeekable( demux_t *p_demux )
 
         avi_packet_t    avi_pk;
 
-        if( AVI_PacketGetHeader( p_demux, &avi_pk ) )
+        if( AVI_PacketGetHeader( p_demux->s, &avi_pk ) )
         {
             return VLC_DEMUXER_EOF;
         }
@@ -1421,18 +1508,18 @@ static int Demux_UnSeekable( demux_t *p_demux )
                 case AVIFOURCC_JUNK:
                 case AVIFOURCC_LIST:
                 case AVIFOURCC_RIFF:
-                    return( !AVI_PacketNext( p_demux ) ? 1 : 0 );
+                    return( !AVI_PacketNext( p_demux->s ) ? 1 : 0 );
                 case AVIFOURCC_idx1:
                     if( p_sys->b_odml )
                     {
-                        return( !AVI_PacketNext( p_demux ) ? 1 : 0 );
+                        return( !AVI_PacketNext( p_demux->s ) ? 1 : 0 );
                     }
                     return VLC_DEMUXER_EOF;
                 default:
                     msg_Warn( p_demux,
                               "seems to have lost position @%"PRIu64", resync",
                               vlc_stream_Tell(p_demux->s) );
-                    if( AVI_PacketSearch( p_demux ) )
+                    if( AVI_PacketSearch( p_demux, p_demux->s ) )
                     {
                         msg_Err( p_demux, "resync failed" );
                         return VLC_DEMUXER_EGENERIC;
@@ -1472,7 +1559,7 @@ static int Demux_UnSeekable( demux_t *p_demux )
             }
             else
             {
-                if( AVI_PacketNext( p_demux ) )
+                if( AVI_PacketNext( p_demux->s ) )
                 {
                     return VLC_DEMUXER_EOF;
                 }
@@ -1674,6 +1761,10 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             }
             else
             {
+                /* without length, wait for the index to compute it */
+                if( AVI_IndexBgWait( p_demux, p_sys->i_length > 0 ?
+                                     (mtime_t)(f * CLOCK_FREQ * p_sys->i_length) : -1 ) )
+                    return VLC_EGENERIC;
                 i64 = (mtime_t)(f * CLOCK_FREQ * p_sys->i_length);
                 return Seek( p_demux, i64, (int)(f * 100) );
             }
@@ -1688,7 +1779,8 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             int i_percent = 0;
 
             i64 = va_arg( args, int64_t );
-            if( !p_sys->b_seekable )
+            if( !p_sys->b_seekable ||
+                AVI_IndexBgWait( p_demux, i64 ) )
             {
                 return VLC_EGENERIC;
             }
@@ -1842,7 +1934,7 @@ static int AVI_StreamChunkFind( demux_t *p_demux, unsigned int i_stream )
     if( p_sys->i_movi_lastchunk_pos >= p_sys->i_movi_begin + 12 )
     {
         vlc_stream_Seek( p_demux->s, p_sys->i_movi_lastchunk_pos );
-        if( AVI_PacketNext( p_demux ) )
+        if( AVI_PacketNext( p_demux->s ) )
         {
             return VLC_EGENERIC;
         }
@@ -1854,7 +1946,7 @@ static int AVI_StreamChunkFind( demux_t *p_demux, unsigned int i_stream )
 
     for( ;; )
     {
-        if( AVI_PacketGetHeader( p_demux, &avi_pk ) )
+        if( AVI_PacketGetHeader( p_demux->s, &avi_pk ) )
         {
             msg_Warn( p_demux, "cannot get packet header" );
             return VLC_EGENERIC;
@@ -1862,7 +1954,7 @@ static int AVI_StreamChunkFind( demux_t *p_demux, unsigned int i_stream )
         if( avi_pk.i_stream >= p_sys->i_track ||
             ( avi_pk.i_cat != AUDIO_ES && avi_pk.i_cat != VIDEO_ES ) )
         {
-            if( AVI_PacketNext( p_demux ) )
+            if( AVI_PacketNext( p_demux->s ) )
             {
                 return VLC_EGENERIC;
             }
@@ -1896,7 +1988,7 @@ static int AVI_StreamChunkFind( demux_t *p_demux, unsigned int i_stream )
                 return VLC_SUCCESS;
             }
 
-            if( AVI_PacketNext( p_demux ) )
+            if( AVI_PacketNext( p_demux->s ) )
             {
                 return VLC_EGENERIC;
             }
@@ -2193,17 +2285,17 @@ static void AVI_ParseStreamHeader( vlc_fourcc_t i_id,
 /****************************************************************************
  *
  ****************************************************************************/
-static int AVI_PacketGetHeader( demux_t *p_demux, avi_packet_t *p_pk )
+static int AVI_PacketGetHeader( stream_t *s, avi_packet_t *p_pk )
 {
     const uint8_t *p_peek;
 
-    if( vlc_stream_Peek( p_demux->s, &p_peek, 16 ) < 16 )
+    if( vlc_stream_Peek( s, &p_peek, 16 ) < 16 )
     {
         return VLC_EGENERIC;
     }
     p_pk->i_fourcc  = VLC_FOURCC( p_peek[0], p_peek[1], p_peek[2], p_peek[3] );
     p_pk->i_size    = GetDWLE( p_peek + 4 );
-    p_pk->i_pos     = vlc_stream_Tell( p_demux->s );
+    p_pk->i_pos     = vlc_stream_Tell( s );
     if( p_pk->i_fourcc == AVIFOURCC_LIST || p_pk->i_fourcc == AVIFOURCC_RIFF )
     {
         p_pk->i_type = VLC_FOURCC( p_peek[8],  p_peek[9],
@@ -2220,12 +2312,12 @@ static int AVI_PacketGetHeader( demux_t *p_demux, avi_packet_t *p_pk )
     return VLC_SUCCESS;
 }
 
-static int AVI_PacketNext( demux_t *p_demux )
+static int AVI_PacketNext( stream_t *s )
 {
     avi_packet_t    avi_ck;
     size_t          i_skip = 0;
 
-    if( AVI_PacketGetHeader( p_demux, &avi_ck ) )
+    if( AVI_PacketGetHeader( s, &avi_ck ) )
     {
         return VLC_EGENERIC;
     }
@@ -2250,7 +2342,7 @@ static int AVI_PacketNext( demux_t *p_demux )
     if( i_skip > SSIZE_MAX )
         return VLC_EGENERIC;
 
-    ssize_t i_ret = vlc_stream_Read( p_demux->s, NULL, i_skip );
+    ssize_t i_ret = vlc_stream_Read( s, NULL, i_skip );
     if( i_ret < 0 || (size_t) i_ret != i_skip )
     {
         return VLC_EGENERIC;
@@ -2258,7 +2350,7 @@ static int AVI_PacketNext( demux_t *p_demux )
     return VLC_SUCCESS;
 }
 
-static int AVI_PacketSearch( demux_t *p_demux )
+static int AVI_PacketSearch( demux_t *p_demux, stream_t *s )
 {
     demux_sys_t     *p_sys = p_demux->p_sys;
     avi_packet_t    avi_pk;
@@ -2266,11 +2358,11 @@ static int AVI_PacketSearch( demux_t *p_demux )
 
     for( ;; )
     {
-        if( vlc_stream_Read( p_demux->s, NULL, 1 ) != 1 )
+        if( vlc_stream_Read( s, NULL, 1 ) != 1 )
         {
             return VLC_EGENERIC;
         }
-        AVI_PacketGetHeader( p_demux, &avi_pk );
+        AVI_PacketGetHeader( s, &avi_pk );
         if( avi_pk.i_stream < p_sys->i_track &&
             ( avi_pk.i_cat == AUDIO_ES || avi_pk.i_cat == VIDEO_ES ) )
         {
@@ -2619,18 +2711,13 @@ static void AVI_IndexLoad( demux_t *p_demux )
     }
 }
 
-static void AVI_IndexCreate( demux_t *p_demux )
+static int AVI_IndexScanInit( demux_t *p_demux, avi_index_scan_t *p_scan )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
     avi_chunk_list_t *p_riff;
     avi_chunk_list_t *p_movi;
-
-    unsigned int i_stream;
-    off_t i_movi_end;
-
-    mtime_t i_dialog_update;
-    vlc_dialog_id *p_dialog_id = NULL;
+    avi_chunk_list_t *p_avix;
 
     p_riff = AVI_ChunkFind( &p_sys->ck_root, AVIFOURCC_RIFF, 0);
     p_movi = AVI_ChunkFind( p_riff, AVIFOURCC_movi, 0);
@@ -2638,48 +2725,49 @@ static void AVI_IndexCreate( demux_t *p_demux )
     if( !p_movi )
     {
         msg_Err( p_demux, "cannot find p_movi" );
-        return;
+        return VLC_EGENERIC;
     }
 
-    for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
-        avi_index_Init( &p_sys->track[i_stream]->idx );
-
-    i_movi_end = __MIN( (off_t)(p_movi->i_chunk_pos + p_movi->i_chunk_size),
-                        stream_Size( p_demux->s ) );
-
-    vlc_stream_Seek( p_demux->s, p_movi->i_chunk_pos + 12 );
-    msg_Warn( p_demux, "creating index from LIST-movi, will take time !" );
+    p_avix = AVI_ChunkFind( &p_sys->ck_root, AVIFOURCC_RIFF, 1 );
 
+    p_scan->i_movi_pos = p_movi->i_chunk_pos;
+    p_scan->i_movi_end = __MIN( (off_t)(p_movi->i_chunk_pos + p_movi->i_chunk_size),
+                                stream_Size( p_demux->s ) );
+    p_scan->i_avix_pos = p_avix ? p_avix->i_chunk_pos : 0;
+    p_scan->pf_progress = NULL;
+    p_scan->p_opaque = NULL;
+    p_scan->p_lock = NULL;
+    return VLC_SUCCESS;
+}
 
-    /* Only show dialog if AVI is > 10MB */
-    i_dialog_update = mdate();
-    if( stream_Size( p_demux->s ) > 10000000 )
-    {
-        p_dialog_id =
-            vlc_dialog_display_progress( p_demux, false, 0.0, _("Cancel"),
-                                         _("Broken or missing AVI Index"),
-                                         _("Fixing AVI Index...") );
-    }
+/* Walks LIST-movi from the current position of s, and appends the chunks
+ * found to p_index (one per track).
+ * Only uses the parts of p_sys that do not change once the demuxer is
+ * opened, so that it can run on its own stream from another thread.
+ * Returns VLC_SUCCESS only if the index covers all of LIST-movi: the entries
+ * appended are usable either way, but only a complete index is cached. */
+static int AVI_IndexScan( demux_t *p_demux, stream_t *s, avi_index_t *p_index,
+                          off_t *pi_last_pos, const avi_index_scan_t *p_scan )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    mtime_t i_progress_date = mdate();
+    double f_size = stream_Size( s );
 
     for( ;; )
     {
         avi_packet_t pk;
 
-        /* Don't update/check dialog too often */
-        if( p_dialog_id != NULL && mdate() - i_dialog_update > 100000 )
+        /* Don't update/check progress too often */
+        if( p_scan->pf_progress != NULL && mdate() - i_progress_date > 100000 )
         {
-            if( vlc_dialog_is_cancelled( p_demux, p_dialog_id ) )
-                break;
-
-            double f_current = vlc_stream_Tell( p_demux->s );
-            double f_size    = stream_Size( p_demux->s );
-            double f_pos     = f_current / f_size;
-            vlc_dialog_update_progress( p_demux, p_dialog_id, f_pos );
+            double f_pos = f_size > 0 ? vlc_stream_Tell( s ) / f_size : 0.;
+            if( !p_scan->pf_progress( p_demux, f_pos, p_scan->p_opaque ) )
+                return VLC_EGENERIC;
 
-            i_dialog_update = mdate();
+            i_progress_date = mdate();
         }
 
-        if( AVI_PacketGetHeader( p_demux, &pk ) )
+        if( AVI_PacketGetHeader( s, &pk ) )
             break;
 
         if( pk.i_stream < p_sys->i_track &&
@@ -2693,26 +2781,26 @@ static void AVI_IndexCreate( demux_t *p_demux )
             index.i_pos     = pk.i_pos;
             index.i_length  = pk.i_size;
             index.i_lengthtotal = pk.i_size;
-            avi_index_Append( &tk->idx, &p_sys->i_movi_lastchunk_pos, &index );
+
+            if( p_scan->p_lock )
+                vlc_mutex_lock( p_scan->p_lock );
+            avi_index_Append( &p_index[pk.i_stream], pi_last_pos, &index );
+            if( p_scan->p_lock )
+                vlc_mutex_unlock( p_scan->p_lock );
         }
         else
         {
             switch( pk.i_fourcc )
             {
             case AVIFOURCC_idx1:
-                if( p_sys->b_odml )
+                if( p_sys->b_odml && p_scan->i_avix_pos > 0 )
                 {
-                    avi_chunk_list_t *p_sysx;
-                    p_sysx = AVI_ChunkFind( &p_sys->ck_root,
-                                            AVIFOURCC_RIFF, 1 );
-
                     msg_Dbg( p_demux, "looking for new RIFF chunk" );
-                    if( vlc_stream_Seek( p_demux->s,
-                                         p_sysx->i_chunk_pos + 24 ) )
-                        goto print_stat;
+                    if( vlc_stream_Seek( s, p_scan->i_avix_pos + 24 ) )
+                        return VLC_EGENERIC;
                     break;
                 }
-                goto print_stat;
+                return VLC_SUCCESS;
 
             case AVIFOURCC_RIFF:
                     msg_Dbg( p_demux, "new RIFF chunk found" );
@@ -2724,30 +2812,445 @@ static void AVI_IndexCreate( demux_t *p_demux )
 
             default:
                 msg_Warn( p_demux, "need resync, probably broken avi" );
-                if( AVI_PacketSearch( p_demux ) )
+                if( AVI_PacketSearch( p_demux, s ) )
                 {
-                    msg_Warn( p_demux, "lost sync, abord index creation" );
-                    goto print_stat;
+                    /* the chunks after this point are not indexed */
+                    msg_Warn( p_demux, "lost sync, abort index creation" );
+                    return VLC_EGENERIC;
                 }
             }
         }
 
-        if( ( !p_sys->b_odml && pk.i_pos + pk.i_size >= i_movi_end ) ||
-            AVI_PacketNext( p_demux ) )
-        {
+        if( !p_sys->b_odml && pk.i_pos + pk.i_size >= p_scan->i_movi_end )
+            return VLC_SUCCESS;
+        if( AVI_PacketNext( s ) )
             break;
-        }
     }
 
-print_stat:
+    /* Running out of data before the end of the stream is a read error or
+     * an interruption: the index is not complete */
+    uint64_t i_size;
+    if( vlc_stream_GetSize( s, &i_size ) == VLC_SUCCESS
+     && vlc_stream_Tell( s ) + 16 <= i_size )
+    {
+        msg_Warn( p_demux, "index creation stopped at %"PRIu64" of %"PRIu64,
+                  vlc_stream_Tell( s ), i_size );
+        return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
+static bool AVI_IndexCreateProgress( demux_t *p_demux, double f_pos,
+                                     void *p_opaque )
+{
+    vlc_dialog_id *p_dialog_id = p_opaque;
+
+    if( vlc_dialog_is_cancelled( p_demux, p_dialog_id ) )
+        return false;
+    vlc_dialog_update_progress( p_demux, p_dialog_id, f_pos );
+    return true;
+}
+
+static void AVI_IndexCreate( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    avi_index_scan_t scan;
+    avi_index_t *p_index;
+    unsigned int i_stream;
+    vlc_dialog_id *p_dialog_id = NULL;
+    int i_ret;
+
+    if( AVI_IndexScanInit( p_demux, &scan ) )
+        return;
+
+    for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
+        avi_index_Init( &p_sys->track[i_stream]->idx );
+
+    if( AVI_IndexCreateFromCache( p_demux ) == VLC_SUCCESS )
+        return;
+
+    if( var_InheritBool( p_demux, "avi-index-background" ) &&
+        AVI_IndexBgStart( p_demux, &scan ) == VLC_SUCCESS )
+        return;
+
+    p_index = malloc( p_sys->i_track * sizeof(*p_index) );
+    if( unlikely(p_index == NULL) )
+        return;
+    for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
+        avi_index_Init( &p_index[i_stream] );
+
+    vlc_stream_Seek( p_demux->s, scan.i_movi_pos + 12 );
+    msg_Warn( p_demux, "creating index from LIST-movi, will take time !" );
+
+    /* Only show dialog if AVI is > 10MB */
+    if( stream_Size( p_demux->s ) > 10000000 )
+    {
+        p_dialog_id =
+            vlc_dialog_display_progress( p_demux, false, 0.0, _("Cancel"),
+                                         _("Broken or missing AVI Index"),
+                                         _("Fixing AVI Index...") );
+    }
+    if( p_dialog_id != NULL )
+    {
+        scan.pf_progress = AVI_IndexCreateProgress;
+        scan.p_opaque = p_dialog_id;
+    }
+
+    i_ret = AVI_IndexScan( p_demux, p_demux->s, p_index,
+                           &p_sys->i_movi_lastchunk_pos, &scan );
+
     if( p_dialog_id != NULL )
         vlc_dialog_release( p_demux, p_dialog_id );
 
     for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
     {
+        p_sys->track[i_stream]->idx = p_index[i_stream];
         msg_Dbg( p_demux, "stream[%d] creating %d index entries",
                 i_stream, p_sys->track[i_stream]->idx.i_size );
     }
+    free( p_index );
+
+    if( i_ret == VLC_SUCCESS )
+        AVI_IndexStoreToCache( p_demux );
+}
+
+/*****************************************************************************
+ * Background index creation
+ *****************************************************************************
+ * The scan runs on a second stream while playback starts right away, using
+ * the chunks found along the way. The entries are moved to the tracks once
+ * the scan is over, or copied when a seek needs them earlier.
+ *****************************************************************************/
+static bool AVI_IndexBgProgress( demux_t *p_demux, double f_pos,
+                                 void *p_opaque )
+{
+    avi_index_bg_t *p_bg = p_opaque;
+    bool b_cancel;
+
+    vlc_mutex_lock( &p_bg->lock );
+    b_cancel = p_bg->b_cancel;
+    /* let a pending seek check if it is covered now */
+    vlc_cond_signal( &p_bg->wait );
+    vlc_mutex_unlock( &p_bg->lock );
+
+    if( p_demux->p_input )
+        var_SetFloat( p_demux->p_input, "avi-index-progress", f_pos );
+    return !b_cancel;
+}
+
+static void *AVI_IndexBgThread( void *p_data )
+{
+    demux_t *p_demux = p_data;
+    avi_index_bg_t *p_bg = &p_demux->p_sys->bgindex;
+
+    int i_ret = AVI_IndexScan( p_demux, p_bg->s, p_bg->p_index,
+                               &p_bg->i_last_pos, &p_bg->scan );
+
+    vlc_mutex_lock( &p_bg->lock );
+    p_bg->b_complete = i_ret == VLC_SUCCESS;
+    p_bg->b_done = true;
+    vlc_cond_signal( &p_bg->wait );
+    vlc_mutex_unlock( &p_bg->lock );
+
+    if( i_ret == VLC_SUCCESS && p_demux->p_input )
+        var_SetFloat( p_demux->p_input, "avi-index-progress", 1.0 );
+    return NULL;
+}
+
+static int AVI_IndexBgStart( demux_t *p_demux, const avi_index_scan_t *p_scan )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    avi_index_bg_t *p_bg = &p_sys->bgindex;
+
+    if( p_demux->s->psz_url == NULL )
+        return VLC_EGENERIC;
+
+    p_bg->s = vlc_stream_NewURL( p_demux, p_demux->s->psz_url );
+    if( p_bg->s == NULL )
+        return VLC_EGENERIC;
+
+    p_bg->p_index = malloc( p_sys->i_track * sizeof(*p_bg->p_index) );
+    if( unlikely(p_bg->p_index == NULL) ||
+        vlc_stream_Seek( p_bg->s, p_scan->i_movi_pos + 12 ) )
+    {
+        free( p_bg->p_index );
+        vlc_stream_Delete( p_bg->s );
+        return VLC_EGENERIC;
+    }
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+        avi_index_Init( &p_bg->p_index[i] );
+
+    vlc_mutex_init( &p_bg->lock );
+    vlc_cond_init( &p_bg->wait );
+    p_bg->scan = *p_scan;
+    p_bg->scan.pf_progress = AVI_IndexBgProgress;
+    p_bg->scan.p_opaque = p_bg;
+    p_bg->scan.p_lock = &p_bg->lock;
+    p_bg->i_last_pos = 0;
+    p_bg->b_done = false;
+    p_bg->b_complete = false;
+    p_bg->b_cancel = false;
+
+    if( p_demux->p_input )
+    {
+        var_Create( p_demux->p_input, "avi-index-progress", VLC_VAR_FLOAT );
+        var_SetFloat( p_demux->p_input, "avi-index-progress", 0.0 );
+    }
+
+    if( vlc_clone( &p_bg->thread, AVI_IndexBgThread, p_demux,
+                   VLC_THREAD_PRIORITY_LOW ) )
+    {
+        if( p_demux->p_input )
+            var_Destroy( p_demux->p_input, "avi-index-progress" );
+        vlc_cond_destroy( &p_bg->wait );
+        vlc_mutex_destroy( &p_bg->lock );
+        free( p_bg->p_index );
+        vlc_stream_Delete( p_bg->s );
+        return VLC_EGENERIC;
+    }
+
+    p_bg->b_active = true;
+    p_bg->b_started = true;
+    msg_Dbg( p_demux, "creating index from LIST-movi in the background" );
+    return VLC_SUCCESS;
+}
+
+static void AVI_IndexBgStop( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    avi_index_bg_t *p_bg = &p_sys->bgindex;
+
+    vlc_mutex_lock( &p_bg->lock );
+    p_bg->b_cancel = true;
+    vlc_mutex_unlock( &p_bg->lock );
+    vlc_join( p_bg->thread, NULL );
+
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+        avi_index_Clean( &p_bg->p_index[i] );
+    free( p_bg->p_index );
+    vlc_stream_Delete( p_bg->s );
+    vlc_cond_destroy( &p_bg->wait );
+    vlc_mutex_destroy( &p_bg->lock );
+    p_bg->b_active = false;
+}
+
+/* Must be called with the lock held */
+static bool AVI_IndexBgCovers( demux_t *p_demux, mtime_t i_date )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+    {
+        avi_track_t *tk = p_sys->track[i];
+        const avi_index_t *p_index = &p_sys->bgindex.p_index[i];
+
+        if( !tk->b_activated )
+            continue;
+        if( p_index->i_size == 0 )
+            return false;
+
+        const avi_entry_t *p_last = &p_index->p_entry[p_index->i_size - 1];
+        int64_t i_count = tk->i_samplesize ? p_last->i_lengthtotal + p_last->i_length
+                                           : p_index->i_size;
+        if( AVI_GetDPTS( tk, i_count ) <= i_date )
+            return false;
+    }
+    return true;
+}
+
+/* Index of the first entry at or after i_pos */
+static unsigned int avi_index_Find( const avi_index_t *p_index, off_t i_pos )
+{
+    unsigned int i_low = 0, i_high = p_index->i_size;
+
+    while( i_low < i_high )
+    {
+        unsigned int i_mid = i_low + ( i_high - i_low ) / 2;
+        if( p_index->p_entry[i_mid].i_pos < i_pos )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+    return i_low;
+}
+
+/* Hands the entries found so far to the tracks. The thread is joined once
+ * it is done, otherwise nothing happens unless b_partial is set. */
+static void AVI_IndexBgSync( demux_t *p_demux, bool b_partial )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    avi_index_bg_t *p_bg = &p_sys->bgindex;
+    bool b_done, b_complete;
+
+    if( !p_bg->b_active )
+        return;
+
+    vlc_mutex_lock( &p_bg->lock );
+    b_done = p_bg->b_done;
+    b_complete = p_bg->b_complete;
+    if( !b_done && !b_partial )
+    {
+        vlc_mutex_unlock( &p_bg->lock );
+        return;
+    }
+
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+    {
+        avi_track_t *tk = p_sys->track[i];
+        avi_index_t *p_index = &p_bg->p_index[i];
+        off_t i_pos;
+
+        /* playback may already have gone further than the scan */
+        if( p_index->i_size == 0 || ( tk->idx.i_size > 0 &&
+            tk->idx.p_entry[tk->idx.i_size - 1].i_pos >=
+            p_index->p_entry[p_index->i_size - 1].i_pos ) )
+            continue;
+
+        /* keep the current chunk across the change of index */
+        if( tk->i_idxposc < tk->idx.i_size )
+            i_pos = tk->idx.p_entry[tk->i_idxposc].i_pos;
+        else if( tk->idx.i_size > 0 )
+            i_pos = tk->idx.p_entry[tk->idx.i_size - 1].i_pos + 1;
+        else
+            i_pos = 0;
+
+        if( b_done )
+        {
+            avi_index_Clean( &tk->idx );
+            tk->idx = *p_index;
+            avi_index_Init( p_index );
+        }
+        else
+        {
+            avi_entry_t *p_entry = realloc( tk->idx.p_entry,
+                                            p_index->i_size * sizeof(*p_entry) );
+            if( unlikely(p_entry == NULL) )
+                continue;
+            memcpy( p_entry, p_index->p_entry, p_index->i_size * sizeof(*p_entry) );
+            tk->idx.p_entry = p_entry;
+            tk->idx.i_size = tk->idx.i_max = p_index->i_size;
+        }
+        tk->i_idxposc = avi_index_Find( &tk->idx, i_pos );
+    }
+    if( p_sys->i_movi_lastchunk_pos < p_bg->i_last_pos )
+        p_sys->i_movi_lastchunk_pos = p_bg->i_last_pos;
+    vlc_mutex_unlock( &p_bg->lock );
+
+    if( b_done )
+    {
+        AVI_IndexBgStop( p_demux );
+
+        for( unsigned i = 0; i < p_sys->i_track; i++ )
+            msg_Dbg( p_demux, "stream[%u] created %u index entries in the background",
+                     i, p_sys->track[i]->idx.i_size );
+
+        p_sys->i_length = AVI_MovieGetLength( p_demux );
+        if( b_complete )
+            AVI_IndexStoreToCache( p_demux );
+    }
+}
+
+/* Waits until the background scan has indexed i_date on all the selected
+ * tracks, or until it is done if i_date is negative */
+static int AVI_IndexBgWait( demux_t *p_demux, mtime_t i_date )
+{
+    avi_index_bg_t *p_bg = &p_demux->p_sys->bgindex;
+    int i_ret = VLC_SUCCESS;
+
+    if( !p_bg->b_active )
+        return VLC_SUCCESS;
+
+    vlc_mutex_lock( &p_bg->lock );
+    while( !p_bg->b_done &&
+           ( i_date < 0 || !AVI_IndexBgCovers( p_demux, i_date ) ) )
+    {
+        if( vlc_killed() )
+        {
+            i_ret = VLC_EGENERIC;
+            break;
+        }
+        vlc_cond_timedwait( &p_bg->wait, &p_bg->lock, mdate() + 100000 );
+    }
+    vlc_mutex_unlock( &p_bg->lock );
+
+    if( i_ret == VLC_SUCCESS )
+        AVI_IndexBgSync( p_demux, true );
+    return i_ret;
+}
+
+static int AVI_IndexCreateFromCache( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const avi_seekindex_entry_t *p_entries;
+    size_t i_entries;
+
+    if( p_sys->p_seekindex == NULL )
+        return VLC_EGENERIC;
+    p_entries = seekindex_Get( p_sys->p_seekindex, &i_entries );
+    if( p_entries == NULL )
+        return VLC_EGENERIC;
+
+    for( size_t i = 0; i < i_entries; i++ )
+    {
+        if( p_entries[i].i_stream >= p_sys->i_track )
+        {
+            msg_Warn( p_demux, "invalid cached index, ignoring it" );
+            for( unsigned j = 0; j < p_sys->i_track; j++ )
+            {
+                avi_index_Clean( &p_sys->track[j]->idx );
+                avi_index_Init( &p_sys->track[j]->idx );
+            }
+            return VLC_EGENERIC;
+        }
+
+        avi_entry_t index;
+        index.i_id      = p_entries[i].i_id;
+        index.i_flags   = p_entries[i].i_flags;
+        index.i_pos     = p_entries[i].i_pos;
+        index.i_length  = p_entries[i].i_length;
+        index.i_lengthtotal = p_entries[i].i_length;
+        avi_index_Append( &p_sys->track[p_entries[i].i_stream]->idx,
+                          &p_sys->i_movi_lastchunk_pos, &index );
+    }
+
+    msg_Dbg( p_demux, "index created from %zu cached entries", i_entries );
+    return VLC_SUCCESS;
+}
+
+static void AVI_IndexStoreToCache( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    size_t i_entries = 0;
+
+    if( p_sys->p_seekindex == NULL )
+        return;
+
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+        i_entries += p_sys->track[i]->idx.i_size;
+    if( i_entries == 0 )
+        return;
+
+    avi_seekindex_entry_t *p_entries = malloc( i_entries * sizeof(*p_entries) );
+    if( unlikely(p_entries == NULL) )
+        return;
+
+    avi_seekindex_entry_t *p_entry = p_entries;
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+    {
+        const avi_index_t *p_index = &p_sys->track[i]->idx;
+        for( unsigned j = 0; j < p_index->i_size; j++, p_entry++ )
+        {
+            p_entry->i_pos    = p_index->p_entry[j].i_pos;
+            p_entry->i_stream = i;
+            p_entry->i_id     = p_index->p_entry[j].i_id;
+            p_entry->i_flags  = p_index->p_entry[j].i_flags;
+            p_entry->i_length = p_index->p_entry[j].i_length;
+        }
+    }
+
+    seekindex_Store( p_sys->p_seekindex, p_entries, i_entries );
+    free( p_entries );
 }
 
 /* */
@@ -431,6 +431,9 @@ void *event_thread_t::EventThread(void *data)
 demux_sys_t::~demux_sys_t()
 {
     CleanUi();
+    StoreSeekIndex();
+    if( p_seekindex )
+        seekindex_Delete( p_seekindex );
     size_t i;
     for ( i=0; i<streams.size(); i++ )
         delete streams[i];
@@ -754,6 +757,51 @@ bool demux_sys_t::PreloadLinked()
     return true;
 }
 
+void demux_sys_t::LoadSeekIndex()
+{
+    size_t i_entries;
+    const SegmentSeeker::CacheEntry *p_entries;
+
+    if( p_seekindex == NULL || streams.empty() || streams[0] == NULL )
+        return;
+
+    p_entries = static_cast<const SegmentSeeker::CacheEntry *>(
+                    seekindex_Get( p_seekindex, &i_entries ) );
+    if( p_entries == NULL )
+        return;
+
+    /* stream segments may have been freed, only opened ones are valid */
+    for( size_t i = 0; i < opened_segments.size(); i++ )
+    {
+        if( opened_segments[i] && &opened_segments[i]->es == streams[0]->p_estream )
+            opened_segments[i]->LoadSeekIndex( p_entries, i_entries );
+    }
+}
+
+void demux_sys_t::StoreSeekIndex()
+{
+    SegmentSeeker::cache_entries_t entries;
+    size_t i_cached;
+    const void *p_cached;
+
+    if( p_seekindex == NULL || streams.empty() || streams[0] == NULL )
+        return;
+
+    for( size_t i = 0; i < opened_segments.size(); i++ )
+    {
+        if( opened_segments[i] && &opened_segments[i]->es == streams[0]->p_estream )
+            opened_segments[i]->StoreSeekIndex( entries );
+    }
+
+    /* nothing learnt since the cache was loaded */
+    p_cached = seekindex_Get( p_seekindex, &i_cached );
+    if( entries.empty() || ( i_cached == entries.size() &&
+        !memcmp( p_cached, &entries[0], i_cached * sizeof(entries[0]) ) ) )
+        return;
+
+    seekindex_Store( p_seekindex, &entries[0], entries.size() );
+}
+
 void demux_sys_t::FreeUnused()
 {
     size_t i;
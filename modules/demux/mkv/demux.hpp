@@ -29,6 +29,7 @@
 
 #include "chapter_command.hpp"
 #include "virtual_segment.hpp"
+#include "../seekindex.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #undef ATTRIBUTE_PACKED
@@ -342,6 +343,7 @@ public:
         ,f_duration(-1.0)
         ,p_input(NULL)
         ,p_ev(NULL)
+        ,p_seekindex(NULL)
     {
         vlc_mutex_init( &lock_demuxer );
     }
@@ -380,6 +382,9 @@ public:
                                         virtual_segment_c * & p_vsegment_found );
     virtual_chapter_c *FindChapter( int64_t i_find_uid, virtual_segment_c * & p_vsegment_found );
 
+    void LoadSeekIndex();
+    void StoreSeekIndex();
+
     void PreloadFamily( const matroska_segment_c & of_segment );
     bool PreloadLinked();
     void FreeUnused();
@@ -397,6 +402,9 @@ public:
 
     /* event */
     event_thread_t *p_ev;
+
+    /* persistent cache of the seekpoints of the main file */
+    seekindex_t    *p_seekindex;
 };
 
 
@@ -799,6 +799,16 @@ bool matroska_segment_c::LoadSeekHeadItem( const EbmlCallbacks & ClassInfos, int
     return true;
 }
 
+void matroska_segment_c::LoadSeekIndex( const SegmentSeeker::CacheEntry *p_entries, size_t i_entries )
+{
+    _seeker.load_cache( segment->GetElementPosition(), p_entries, i_entries );
+}
+
+void matroska_segment_c::StoreSeekIndex( SegmentSeeker::cache_entries_t & entries ) const
+{
+    _seeker.save_cache( segment->GetElementPosition(), entries );
+}
+
 bool matroska_segment_c::FastSeek( demux_t &demuxer, mtime_t i_mk_date, mtime_t i_mk_time_offset )
 {
     if( Seek( demuxer, i_mk_date, i_mk_time_offset ) )
@@ -139,6 +139,9 @@ public:
     bool PreloadClusters( uint64 i_cluster_position );
     void InformationCreate();
 
+    void LoadSeekIndex( const SegmentSeeker::CacheEntry *, size_t );
+    void StoreSeekIndex( SegmentSeeker::cache_entries_t & ) const;
+
     bool FastSeek( demux_t &, mtime_t i_mk_date, mtime_t i_mk_time_offset );
     bool Seek( demux_t &, mtime_t i_mk_date, mtime_t i_mk_time_offset );
 
@@ -432,6 +432,52 @@ SegmentSeeker::get_search_areas( fptr_t start, fptr_t end ) const
     return areas_to_search;
 }
 
+void
+SegmentSeeker::load_cache( fptr_t segment_fpos, CacheEntry const* entries, size_t count )
+{
+    for( size_t i = 0; i < count; ++i )
+    {
+        CacheEntry const& entry = entries[i];
+
+        if( entry.segment_fpos != segment_fpos )
+            continue;
+
+        if( entry.trust_level == 0 )
+        {
+            if( entry.fpos <= static_cast<fptr_t>( entry.pts ) )
+                mark_range_as_searched( Range( entry.fpos, entry.pts ) );
+        }
+        else if( entry.trust_level == Seekpoint::TRUSTED ||
+                 entry.trust_level == Seekpoint::QUESTIONABLE )
+        {
+            add_seekpoint( entry.track_id, Seekpoint( entry.fpos, entry.pts,
+                static_cast<Seekpoint::TrustLevel>( entry.trust_level ) ) );
+        }
+    }
+}
+
+void
+SegmentSeeker::save_cache( fptr_t segment_fpos, cache_entries_t& entries ) const
+{
+    for( ranges_t::const_iterator it = _ranges_searched.begin(); it != _ranges_searched.end(); ++it )
+    {
+        CacheEntry entry = { segment_fpos, it->start, static_cast<int64_t>( it->end ), 0, 0 };
+        entries.push_back( entry );
+    }
+
+    for( tracks_seekpoints_t::const_iterator it = _tracks_seekpoints.begin(); it != _tracks_seekpoints.end(); ++it )
+    {
+        for( seekpoints_t::const_iterator sp = it->second.begin(); sp != it->second.end(); ++sp )
+        {
+            if( sp->trust_level == Seekpoint::DISABLED )
+                continue;
+
+            CacheEntry entry = { segment_fpos, sp->fpos, sp->pts, it->first, sp->trust_level };
+            entries.push_back( entry );
+        }
+    }
+}
+
 void
 SegmentSeeker::mkv_jump_to( matroska_segment_c& ms, fptr_t fpos )
 {
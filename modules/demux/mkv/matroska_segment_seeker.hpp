@@ -86,6 +86,15 @@ class SegmentSeeker
             fptr_t  size;
         };
 
+        /* record of the persistent seek index cache */
+        struct CacheEntry {
+            uint64_t segment_fpos;
+            uint64_t fpos;        /* seekpoint position, or start of a searched range */
+            int64_t  pts;         /* seekpoint pts, or end of a searched range */
+            uint32_t track_id;
+            int32_t  trust_level; /* 0 for a searched range */
+        };
+
     public:
         typedef std::vector<track_id_t> track_ids_t;
         typedef std::vector<Range> ranges_t;
@@ -97,6 +106,7 @@ class SegmentSeeker
         typedef std::map<mtime_t, Cluster> cluster_map_t;
 
         typedef std::pair<Seekpoint, Seekpoint> seekpoint_pair_t;
+        typedef std::vector<CacheEntry> cache_entries_t;
 
         void add_seekpoint( track_id_t, Seekpoint );
 
@@ -118,6 +128,9 @@ class SegmentSeeker
         void mark_range_as_searched( Range );
         ranges_t get_search_areas( fptr_t start, fptr_t end ) const;
 
+        void load_cache( fptr_t segment_fpos, CacheEntry const*, size_t );
+        void save_cache( fptr_t segment_fpos, cache_entries_t& ) const;
+
     public:
         ranges_t            _ranges_searched;
         tracks_seekpoints_t _tracks_seekpoints;
@@ -111,6 +111,8 @@ static int Open( vlc_object_t * p_this )
     p_demux->pf_demux   = Demux;
     p_demux->pf_control = Control;
     p_demux->p_sys      = p_sys = new demux_sys_t( *p_demux );
+    p_sys->p_seekindex  = seekindex_New( p_demux, "mkv", 1,
+                                         sizeof(SegmentSeeker::CacheEntry) );
 
     p_io_callback = new vlc_stream_io_callback( p_demux->s, false );
     p_io_stream = new (std::nothrow) EbmlStream( *p_io_callback );
@@ -144,6 +146,8 @@ static int Open( vlc_object_t * p_this )
             b_need_preload = true;
     }
 
+    p_sys->LoadSeekIndex();
+
     p_segment = p_stream->segments[0];
     if( p_segment->cluster == NULL && p_segment->stored_editions.size() == 0 )
     {
@@ -41,6 +41,10 @@ typedef int64_t stime_t;
 #define MAJOR_mp41 VLC_FOURCC( 'm', 'p', '4', '1' )
 #define MAJOR_avc1 VLC_FOURCC( 'a', 'v', 'c', '1' )
 #define MAJOR_M4A  VLC_FOURCC( 'M', '4', 'A', ' ' )
+#define MAJOR_iso6 VLC_FOURCC( 'i', 's', 'o', '6' )
+#define MAJOR_cmfc VLC_FOURCC( 'c', 'm', 'f', 'c' )
+#define MAJOR_cmfs VLC_FOURCC( 'c', 'm', 'f', 's' )
+#define MAJOR_msdh VLC_FOURCC( 'm', 's', 'd', 'h' )
 
 #define ATOM_root VLC_FOURCC( 'r', 'o', 'o', 't' )
 #define ATOM_uuid VLC_FOURCC( 'u', 'u', 'i', 'd' )
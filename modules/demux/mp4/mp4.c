@@ -297,23 +297,26 @@ static inline int64_t MP4_TrackGetDTS( demux_t *p_demux, mp4_track_t *p_track )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
     const mp4_chunk_t *p_chunk = &p_track->chunk[p_track->i_chunk];
+    const MP4_Box_data_stts_t *stts = p_track->p_stts;
 
-    unsigned int i_index = 0;
+    uint32_t i_index = p_chunk->i_stts_index;
+    uint32_t i_skip = p_chunk->i_stts_skip;
     unsigned int i_sample = p_track->i_sample - p_chunk->i_sample_first;
     int64_t i_dts = p_chunk->i_first_dts;
 
-    while( i_sample > 0 && i_index < p_chunk->i_entries_dts )
+    while( i_sample > 0 && i_index < stts->i_entry_count )
     {
-        if( i_sample > p_chunk->p_sample_count_dts[i_index] )
+        uint32_t i_left = stts->pi_sample_count[i_index] - i_skip;
+        if( i_sample > i_left )
         {
-            i_dts += p_chunk->p_sample_count_dts[i_index] *
-                p_chunk->p_sample_delta_dts[i_index];
-            i_sample -= p_chunk->p_sample_count_dts[i_index];
+            i_dts += (int64_t) i_left * stts->pi_sample_delta[i_index];
+            i_sample -= i_left;
+            i_skip = 0;
             i_index++;
         }
         else
         {
-            i_dts += i_sample * p_chunk->p_sample_delta_dts[i_index];
+            i_dts += (int64_t) i_sample * stts->pi_sample_delta[i_index];
             break;
         }
     }
@@ -344,24 +347,25 @@ static inline bool MP4_TrackGetPTSDelta( demux_t *p_demux, mp4_track_t *p_track,
                                          int64_t *pi_delta )
 {
     VLC_UNUSED( p_demux );
-    mp4_chunk_t *ck = &p_track->chunk[p_track->i_chunk];
+    const mp4_chunk_t *ck = &p_track->chunk[p_track->i_chunk];
+    const MP4_Box_data_ctts_t *ctts = p_track->p_ctts;
 
-    unsigned int i_index = 0;
-    unsigned int i_sample = p_track->i_sample - ck->i_sample_first;
-
-    if( ck->p_sample_count_pts == NULL || ck->p_sample_offset_pts == NULL )
+    if( ctts == NULL )
         return false;
 
-    for( i_index = 0; i_index < ck->i_entries_pts ; i_index++ )
+    /* skip the samples of that entry in previous chunks */
+    unsigned int i_sample = p_track->i_sample - ck->i_sample_first + ck->i_ctts_skip;
+
+    for( uint32_t i_index = ck->i_ctts_index; i_index < ctts->i_entry_count; i_index++ )
     {
-        if( i_sample < ck->p_sample_count_pts[i_index] )
+        if( i_sample < ctts->pi_sample_count[i_index] )
         {
-            *pi_delta = MP4_rescale( ck->p_sample_offset_pts[i_index],
+            *pi_delta = MP4_rescale( ctts->pi_sample_offset[i_index] + p_track->i_cts_shift,
                                      p_track->i_timescale, CLOCK_FREQ );
             return true;
         }
 
-        i_sample -= ck->p_sample_count_pts[i_index];
+        i_sample -= ctts->pi_sample_count[i_index];
     }
     return false;
 }
@@ -2325,12 +2329,6 @@ static int TrackCreateChunksIndex( demux_t *p_demux,
         ck->i_offset = BOXDATA(p_co64)->i_chunk_offset[i_chunk];
 
         ck->i_first_dts = 0;
-        ck->i_entries_dts = 0;
-        ck->p_sample_count_dts = NULL;
-        ck->p_sample_delta_dts = NULL;
-        ck->i_entries_pts = 0;
-        ck->p_sample_count_pts = NULL;
-        ck->p_sample_offset_pts = NULL;
     }
 
     /* now we read index for SampleEntry( soun vide mp4a mp4v ...)
@@ -2392,329 +2390,145 @@ static int TrackCreateChunksIndex( demux_t *p_demux,
     return VLC_SUCCESS;
 }
 
-static int xTTS_CountEntries( demux_t *p_demux, uint32_t *pi_entry /* out */,
-                              const uint32_t i_index,
-                              uint32_t i_index_samples_left,
-                              uint32_t i_sample_count,
-                              const uint32_t *pi_index_sample_count,
-                              const uint32_t i_table_count )
+/* Finds where each chunk starts in a run-length (stts/ctts) table */
+static void xTTS_IndexChunks( mp4_track_t *p_track, bool b_ctts,
+                              const uint32_t *pi_sample_count,
+                              const int32_t *pi_sample_value,
+                              uint32_t i_entry_count, mtime_t *pi_next_dts )
 {
-    uint32_t i_array_offset;
-    while( i_sample_count > 0 )
+    uint32_t i_index = 0;
+    uint32_t i_skip = 0;
+
+    for( uint32_t i_chunk = 0; i_chunk < p_track->i_chunk_count; i_chunk++ )
     {
-        if ( likely((UINT32_MAX - i_index) >= *pi_entry) )
-            i_array_offset = i_index + *pi_entry;
-        else
-            return VLC_EGENERIC;
+        mp4_chunk_t *ck = &p_track->chunk[i_chunk];
+        uint32_t i_sample_count = ck->i_sample_count;
 
-        if ( i_array_offset >= i_table_count )
+        if( b_ctts )
+        {
+            ck->i_ctts_index = i_index;
+            ck->i_ctts_skip = i_skip;
+        }
+        else
         {
-            msg_Err( p_demux, "invalid index counting total samples %u %u", i_array_offset,  i_table_count );
-            return VLC_ENOVAR;
+            ck->i_first_dts = *pi_next_dts;
+            ck->i_stts_index = i_index;
+            ck->i_stts_skip = i_skip;
         }
 
-        if ( i_index_samples_left )
+        while( i_sample_count > 0 && i_index < i_entry_count )
         {
-            if ( i_index_samples_left > i_sample_count )
+            uint32_t i_used = __MIN( pi_sample_count[i_index] - i_skip,
+                                     i_sample_count );
+            if( !b_ctts )
+                *pi_next_dts += (mtime_t) i_used * pi_sample_value[i_index];
+            i_sample_count -= i_used;
+            i_skip += i_used;
+            if( i_skip >= pi_sample_count[i_index] )
             {
-                i_index_samples_left -= i_sample_count;
-                i_sample_count = 0;
-                *pi_entry +=1; /* No samples left, go copy */
-                break;
-            }
-            else
-            {
-                i_sample_count -= i_index_samples_left;
-                i_index_samples_left = 0;
-                *pi_entry += 1;
-                continue;
+                i_skip = 0;
+                i_index++;
             }
         }
-        else
-        {
-            i_sample_count -= __MIN( i_sample_count, pi_index_sample_count[i_array_offset] );
-            *pi_entry += 1;
-        }
-    }
 
-    return VLC_SUCCESS;
+        if( !b_ctts )
+            ck->i_duration = *pi_next_dts - ck->i_first_dts;
+    }
 }
 
 static int TrackCreateSamplesIndex( demux_t *p_demux,
                                     mp4_track_t *p_demux_track )
 {
     MP4_Box_t *p_box;
-    MP4_Box_data_stsz_t *stsz;
-    /* TODO use also stss and stsh table for seeking */
+    uint32_t i_sample_size, i_sample_count;
+    const uint32_t *p_entry_size;
     /* FIXME use edit table */
 
-    /* Find stsz
-     *  Gives the sample size for each samples. There is also a stz2 table
-     *  (compressed form) that we need to implement TODO */
-    p_box = MP4_BoxGet( p_demux_track->p_stbl, "stsz" );
-    if( !p_box )
+    /* Find stsz or its compact form stz2
+     *  Gives the sample size for each samples */
+    if( ( p_box = MP4_BoxGet( p_demux_track->p_stbl, "stsz" ) ) && p_box->data.p_stsz )
+    {
+        i_sample_size = p_box->data.p_stsz->i_sample_size;
+        i_sample_count = p_box->data.p_stsz->i_sample_count;
+        p_entry_size = p_box->data.p_stsz->i_entry_size;
+    }
+    else if( ( p_box = MP4_BoxGet( p_demux_track->p_stbl, "stz2" ) ) && p_box->data.p_stz2 )
+    {
+        i_sample_size = 0;
+        i_sample_count = p_box->data.p_stz2->i_sample_count;
+        p_entry_size = p_box->data.p_stz2->i_entry_size;
+    }
+    else
     {
-        /* FIXME and stz2 */
         msg_Warn( p_demux, "cannot find STSZ box" );
         return VLC_EGENERIC;
     }
-    stsz = p_box->data.p_stsz;
 
     /* Use stsz table to create a sample number -> sample size table */
-    if( p_demux_track->i_sample_count != stsz->i_sample_count )
+    if( p_demux_track->i_sample_count != i_sample_count )
     {
         msg_Warn( p_demux, "Incorrect total samples stsc %" PRIu32 " <> stsz %"PRIu32 ", "
                            " expect truncated media playback",
-                           p_demux_track->i_sample_count, stsz->i_sample_count );
-        p_demux_track->i_sample_count = __MIN(p_demux_track->i_sample_count, stsz->i_sample_count);
+                           p_demux_track->i_sample_count, i_sample_count );
+        p_demux_track->i_sample_count = __MIN(p_demux_track->i_sample_count, i_sample_count);
     }
 
-    if( stsz->i_sample_size )
-    {
-        /* 1: all sample have the same size, so no need to construct a table */
-        p_demux_track->i_sample_size = stsz->i_sample_size;
-        p_demux_track->p_sample_size = NULL;
-    }
-    else
-    {
-        /* 2: each sample can have a different size */
-        p_demux_track->i_sample_size = 0;
-        p_demux_track->p_sample_size =
-            calloc( p_demux_track->i_sample_count, sizeof( uint32_t ) );
-        if( p_demux_track->p_sample_size == NULL )
-            return VLC_ENOMEM;
-
-        for( uint32_t i_sample = 0; i_sample < p_demux_track->i_sample_count; i_sample++ )
-        {
-            p_demux_track->p_sample_size[i_sample] =
-                    stsz->i_entry_size[i_sample];
-        }
-    }
+    /* The table is used in place */
+    p_demux_track->i_sample_size = i_sample_size;
+    p_demux_track->p_sample_size = i_sample_size ? NULL : p_entry_size;
 
     if ( p_demux_track->i_chunk_count && p_demux_track->i_sample_size == 0 )
     {
         const mp4_chunk_t *lastchunk = &p_demux_track->chunk[p_demux_track->i_chunk_count - 1];
-        if( (uint64_t)lastchunk->i_sample_count + p_demux_track->i_chunk_count - 1 > stsz->i_sample_count )
+        if( (uint64_t)lastchunk->i_sample_count + p_demux_track->i_chunk_count - 1 > i_sample_count )
         {
             msg_Err( p_demux, "invalid samples table: stsz table is too small" );
             return VLC_EGENERIC;
         }
     }
 
-    /* Use stts table to create a sample number -> dts table.
-     * XXX: if we don't want to waste too much memory, we can't expand
-     *  the box! so each chunk will contain an "extract" of this table
-     *  for fast research (problem with raw stream where a sample is sometime
-     *  just channels*bits_per_sample/8 */
-
-     /* FIXME: refactor STTS & CTTS, STTS having now only few extra lines and
-      *        differing in 2/2 fields and 1 signedness */
-
-    mtime_t i_next_dts = 0;
     /* Find stts
      *  Gives mapping between sample and decoding time
+     * The table is not expanded: each chunk only records where it starts
+     * in the run-length table, and its first dts.
      */
+    mtime_t i_next_dts = 0;
     p_box = MP4_BoxGet( p_demux_track->p_stbl, "stts" );
-    if( !p_box )
+    if( !p_box || !p_box->data.p_stts )
     {
         msg_Warn( p_demux, "cannot find STTS box" );
         return VLC_EGENERIC;
     }
     else
     {
-        MP4_Box_data_stts_t *stts = p_box->data.p_stts;
+        const MP4_Box_data_stts_t *stts = p_box->data.p_stts;
 
         msg_Warn( p_demux, "STTS table of %"PRIu32" entries", stts->i_entry_count );
 
-        /* Create sample -> dts table per chunk */
-        uint32_t i_index = 0;
-        uint32_t i_current_index_samples_left = 0;
-
-        for( uint32_t i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
-        {
-            mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-            uint32_t i_sample_count;
-
-            /* save first dts */
-            ck->i_first_dts = i_next_dts;
-
-            /* count how many entries are needed for this chunk
-             * for p_sample_delta_dts and p_sample_count_dts */
-            ck->i_entries_dts = 0;
-
-            int i_ret = xTTS_CountEntries( p_demux, &ck->i_entries_dts, i_index,
-                                           i_current_index_samples_left,
-                                           ck->i_sample_count,
-                                           stts->pi_sample_count,
-                                           stts->i_entry_count );
-            if ( i_ret == VLC_EGENERIC )
-                return i_ret;
-
-            /* allocate them */
-            ck->p_sample_count_dts = calloc( ck->i_entries_dts, sizeof( uint32_t ) );
-            ck->p_sample_delta_dts = calloc( ck->i_entries_dts, sizeof( uint32_t ) );
-            if( !ck->p_sample_count_dts || !ck->p_sample_delta_dts )
-            {
-                free( ck->p_sample_count_dts );
-                free( ck->p_sample_delta_dts );
-                msg_Err( p_demux, "can't allocate memory for i_entry=%"PRIu32, ck->i_entries_dts );
-                ck->i_entries_dts = 0;
-                return VLC_ENOMEM;
-            }
-
-            /* now copy */
-            i_sample_count = ck->i_sample_count;
-
-            for( uint32_t i = 0; i < ck->i_entries_dts; i++ )
-            {
-                if ( i_current_index_samples_left )
-                {
-                    if ( i_current_index_samples_left > i_sample_count )
-                    {
-                        ck->p_sample_count_dts[i] = i_sample_count;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        if ( i_sample_count ) ck->i_duration = i_next_dts - ck->i_first_dts;
-                        i_current_index_samples_left -= i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_dts - 1 );
-                        break;
-                    }
-                    else
-                    {
-                        ck->p_sample_count_dts[i] = i_current_index_samples_left;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        if ( i_current_index_samples_left ) ck->i_duration = i_next_dts - ck->i_first_dts;
-                        i_sample_count -= i_current_index_samples_left;
-                        i_current_index_samples_left = 0;
-                        i_index++;
-                    }
-                }
-                else
-                {
-                    if ( stts->pi_sample_count[i_index] > i_sample_count )
-                    {
-                        ck->p_sample_count_dts[i] = i_sample_count;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        if ( i_sample_count ) ck->i_duration = i_next_dts - ck->i_first_dts;
-                        i_current_index_samples_left = stts->pi_sample_count[i_index] - i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_dts - 1 );
-                        // keep building from same index
-                    }
-                    else
-                    {
-                        ck->p_sample_count_dts[i] = stts->pi_sample_count[i_index];
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        if ( stts->pi_sample_count[i_index] ) ck->i_duration = i_next_dts - ck->i_first_dts;
-                        i_sample_count -= stts->pi_sample_count[i_index];
-                        i_index++;
-                    }
-                }
-
-            }
-        }
+        p_demux_track->p_stts = stts;
+        xTTS_IndexChunks( p_demux_track, false, stts->pi_sample_count,
+                          stts->pi_sample_delta, stts->i_entry_count,
+                          &i_next_dts );
     }
 
-
     /* Find ctts
      *  Gives the delta between decoding time (dts) and composition table (pts)
      */
     p_box = MP4_BoxGet( p_demux_track->p_stbl, "ctts" );
     if( p_box && p_box->data.p_ctts )
     {
-        MP4_Box_data_ctts_t *ctts = p_box->data.p_ctts;
+        const MP4_Box_data_ctts_t *ctts = p_box->data.p_ctts;
 
         msg_Warn( p_demux, "CTTS table of %"PRIu32" entries", ctts->i_entry_count );
 
-        int64_t i_cts_shift = 0;
+        p_demux_track->i_cts_shift = 0;
         const MP4_Box_t *p_cslg = MP4_BoxGet( p_demux_track->p_stbl, "cslg" );
         if( p_cslg && BOXDATA(p_cslg) )
-            i_cts_shift = BOXDATA(p_cslg)->ct_to_dts_shift;
-
-        /* Create pts-dts table per chunk */
-        uint32_t i_index = 0;
-        uint32_t i_current_index_samples_left = 0;
-
-        for( uint32_t i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
-        {
-            mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-            uint32_t i_sample_count;
-
-            /* count how many entries are needed for this chunk
-             * for p_sample_offset_pts and p_sample_count_pts */
-            ck->i_entries_pts = 0;
-            int i_ret = xTTS_CountEntries( p_demux, &ck->i_entries_pts, i_index,
-                                           i_current_index_samples_left,
-                                           ck->i_sample_count,
-                                           ctts->pi_sample_count,
-                                           ctts->i_entry_count );
-            if ( i_ret == VLC_EGENERIC )
-                return i_ret;
-
-            /* allocate them */
-            ck->p_sample_count_pts = calloc( ck->i_entries_pts, sizeof( uint32_t ) );
-            ck->p_sample_offset_pts = calloc( ck->i_entries_pts, sizeof( int32_t ) );
-            if( !ck->p_sample_count_pts || !ck->p_sample_offset_pts )
-            {
-                free( ck->p_sample_count_pts );
-                free( ck->p_sample_offset_pts );
-                msg_Err( p_demux, "can't allocate memory for i_entry=%"PRIu32, ck->i_entries_pts );
-                ck->i_entries_pts = 0;
-                return VLC_ENOMEM;
-            }
+            p_demux_track->i_cts_shift = BOXDATA(p_cslg)->ct_to_dts_shift;
 
-            /* now copy */
-            i_sample_count = ck->i_sample_count;
-
-            for( uint32_t i = 0; i < ck->i_entries_pts; i++ )
-            {
-                if ( i_current_index_samples_left )
-                {
-                    if ( i_current_index_samples_left > i_sample_count )
-                    {
-                        ck->p_sample_count_pts[i] = i_sample_count;
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index] + i_cts_shift;
-                        i_current_index_samples_left -= i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_pts - 1 );
-                        break;
-                    }
-                    else
-                    {
-                        ck->p_sample_count_pts[i] = i_current_index_samples_left;
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index] + i_cts_shift;
-                        i_sample_count -= i_current_index_samples_left;
-                        i_current_index_samples_left = 0;
-                        i_index++;
-                    }
-                }
-                else
-                {
-                    if ( ctts->pi_sample_count[i_index] > i_sample_count )
-                    {
-                        ck->p_sample_count_pts[i] = i_sample_count;
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index] + i_cts_shift;
-                        i_current_index_samples_left = ctts->pi_sample_count[i_index] - i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_pts - 1 );
-                        // keep building from same index
-                    }
-                    else
-                    {
-                        ck->p_sample_count_pts[i] = ctts->pi_sample_count[i_index];
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index] + i_cts_shift;
-                        i_sample_count -= ctts->pi_sample_count[i_index];
-                        i_index++;
-                    }
-                }
-
-
-            }
-        }
+        p_demux_track->p_ctts = ctts;
+        xTTS_IndexChunks( p_demux_track, true, ctts->pi_sample_count,
+                          ctts->pi_sample_offset, ctts->i_entry_count, NULL );
     }
 
     msg_Dbg( p_demux, "track[Id 0x%x] read %"PRIu32" samples length:%"PRId64"s",
@@ -2895,17 +2709,22 @@ static int TrackGetNearestSeekPoint( demux_t *p_demux, mp4_track_t *p_track,
         const MP4_Box_data_stss_t *p_stss_data = BOXDATA(p_stss);
         msg_Dbg( p_demux, "track[Id 0x%x] using Sync Sample Box (stss)",
                  p_track->i_track_ID );
-        for( unsigned i_index = 0; i_index < p_stss_data->i_entry_count; i_index++ )
+        if( p_stss_data && p_stss_data->i_entry_count > 0 )
         {
-            if( i_index >= p_stss_data->i_entry_count - 1 ||
-                i_sample < p_stss_data->i_sample_number[i_index+1] )
+            /* sorted: last sync sample at or before i_sample, or the first */
+            uint32_t i_low = 0, i_high = p_stss_data->i_entry_count;
+            while( i_high - i_low > 1 )
             {
-                *pi_sync_sample = p_stss_data->i_sample_number[i_index];
-                msg_Dbg( p_demux, "stss gives %d --> %" PRIu32 " (sample number)",
-                         i_sample, *pi_sync_sample );
-                i_ret = VLC_SUCCESS;
-                break;
+                uint32_t i_mid = i_low + ( i_high - i_low ) / 2;
+                if( p_stss_data->i_sample_number[i_mid] <= i_sample )
+                    i_low = i_mid;
+                else
+                    i_high = i_mid;
             }
+            *pi_sync_sample = p_stss_data->i_sample_number[i_low];
+            msg_Dbg( p_demux, "stss gives %d --> %" PRIu32 " (sample number)",
+                     i_sample, *pi_sync_sample );
+            i_ret = VLC_SUCCESS;
         }
     }
 
@@ -2963,7 +2782,7 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
     uint64_t     i_dts;
     unsigned int i_sample;
     unsigned int i_chunk;
-    int          i_index;
+    uint32_t     i_index;
 
     /* FIXME see if it's needed to check p_track->i_chunk_count */
     if( p_track->i_chunk_count == 0 )
@@ -3007,49 +2826,46 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
         i_start = MP4_rescale( i_start, CLOCK_FREQ, p_track->i_timescale );
     }
 
-    /* we start from sample 0/chunk 0, hope it won't take too much time */
-    /* *** find good chunk *** */
-    for( i_chunk = 0; ; i_chunk++ )
+    /* *** find good chunk: last one starting at or before i_start *** */
+    uint32_t i_low = 0, i_high = p_track->i_chunk_count;
+    while( i_high - i_low > 1 )
     {
-        if( i_chunk + 1 >= p_track->i_chunk_count )
-        {
-            /* at the end and can't check if i_start in this chunk,
-               it will be check while searching i_sample */
-            i_chunk = p_track->i_chunk_count - 1;
-            break;
-        }
-
-        if( (uint64_t)i_start >= p_track->chunk[i_chunk].i_first_dts &&
-            (uint64_t)i_start <  p_track->chunk[i_chunk + 1].i_first_dts )
-        {
-            break;
-        }
+        uint32_t i_mid = i_low + ( i_high - i_low ) / 2;
+        if( p_track->chunk[i_mid].i_first_dts <= (uint64_t)i_start )
+            i_low = i_mid;
+        else
+            i_high = i_mid;
     }
+    /* if i_start is beyond the last chunk,
+       it will be check while searching i_sample */
+    i_chunk = i_low;
 
     /* *** find sample in the chunk *** */
-    i_sample = p_track->chunk[i_chunk].i_sample_first;
-    i_dts    = p_track->chunk[i_chunk].i_first_dts;
-    for( i_index = 0; i_sample < p_track->chunk[i_chunk].i_sample_count; )
-    {
-        if( i_dts +
-            p_track->chunk[i_chunk].p_sample_count_dts[i_index] *
-            p_track->chunk[i_chunk].p_sample_delta_dts[i_index] < (uint64_t)i_start )
-        {
-            i_dts    +=
-                p_track->chunk[i_chunk].p_sample_count_dts[i_index] *
-                p_track->chunk[i_chunk].p_sample_delta_dts[i_index];
-
-            i_sample += p_track->chunk[i_chunk].p_sample_count_dts[i_index];
+    const mp4_chunk_t *ck = &p_track->chunk[i_chunk];
+    const MP4_Box_data_stts_t *stts = p_track->p_stts;
+    uint32_t i_skip = ck->i_stts_skip;
+    i_sample = ck->i_sample_first;
+    i_dts    = ck->i_first_dts;
+    for( i_index = ck->i_stts_index;
+         i_sample < ck->i_sample_first + ck->i_sample_count &&
+         i_index < stts->i_entry_count; )
+    {
+        uint32_t i_count = __MIN( stts->pi_sample_count[i_index] - i_skip,
+                                  ck->i_sample_first + ck->i_sample_count - i_sample );
+        if( i_dts + (uint64_t)i_count * stts->pi_sample_delta[i_index] < (uint64_t)i_start )
+        {
+            i_dts    += (uint64_t)i_count * stts->pi_sample_delta[i_index];
+            i_sample += i_count;
+            i_skip = 0;
             i_index++;
         }
         else
         {
-            if( p_track->chunk[i_chunk].p_sample_delta_dts[i_index] <= 0 )
+            if( stts->pi_sample_delta[i_index] <= 0 )
             {
                 break;
             }
-            i_sample += ( i_start - i_dts ) /
-                p_track->chunk[i_chunk].p_sample_delta_dts[i_index];
+            i_sample += ( i_start - i_dts ) / stts->pi_sample_delta[i_index];
             break;
         }
     }
@@ -3479,15 +3295,6 @@ static void MP4_TrackSetup( demux_t *p_demux, mp4_track_t *p_track,
     p_track->b_ok = true;
 }
 
-static void DestroyChunk( mp4_chunk_t *ck )
-{
-    free( ck->p_sample_count_dts );
-    free( ck->p_sample_delta_dts );
-    free( ck->p_sample_count_pts );
-    free( ck->p_sample_offset_pts );
-    free( ck->p_sample_size );
-}
-
 /****************************************************************************
  * MP4_TrackClean:
  ****************************************************************************
@@ -3500,16 +3307,8 @@ static void MP4_TrackClean( es_out_t *out, mp4_track_t *p_track )
     if( p_track->p_es )
         es_out_Del( out, p_track->p_es );
 
-    if( p_track->chunk )
-    {
-        for( unsigned int i_chunk = 0; i_chunk < p_track->i_chunk_count; i_chunk++ )
-            DestroyChunk( &p_track->chunk[i_chunk] );
-    }
     free( p_track->chunk );
 
-    if( !p_track->i_sample_size )
-        free( p_track->p_sample_size );
-
     if ( p_track->asfinfo.p_frame )
         block_ChainRelease( p_track->asfinfo.p_frame );
 
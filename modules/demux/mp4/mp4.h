@@ -40,24 +40,15 @@ typedef struct
     uint32_t     i_sample; /* index of the next sample to read in this chunk */
     uint32_t     i_virtual_run_number; /* chunks interleaving sequence */
 
-    /* now provide way to calculate pts, dts, and offset without too
-        much memory and with fast access */
-
-    /* with this we can calculate dts/pts without waste memory */
     uint64_t     i_first_dts;   /* DTS of the first sample */
     uint64_t     i_duration;    /* total duration of all samples */
 
-    uint32_t     i_entries_dts;
-    uint32_t     *p_sample_count_dts;
-    uint32_t     *p_sample_delta_dts;   /* dts delta */
-
-    uint32_t     i_entries_pts;
-    uint32_t     *p_sample_count_pts;
-    int32_t      *p_sample_offset_pts;  /* pts-dts */
-
-    uint32_t     *p_sample_size;
-    /* TODO if needed add pts
-        but quickly *add* support for edts and seeking */
+    /* position of the first sample in the run-length stts/ctts tables,
+     * timestamps are decoded from there on demand */
+    uint32_t     i_stts_index;  /* stts entry of the first sample */
+    uint32_t     i_stts_skip;   /* samples of that entry in previous chunks */
+    uint32_t     i_ctts_index;
+    uint32_t     i_ctts_skip;
 
 } mp4_chunk_t;
 
@@ -120,8 +111,12 @@ typedef struct
     /* sample size, p_sample_size defined only if i_sample_size == 0
         else i_sample_size is size for all sample */
     uint32_t         i_sample_size;
-    uint32_t         *p_sample_size; /* XXX perhaps add file offset if take
-//                                    too much time to do sumations each time*/
+    const uint32_t   *p_sample_size; /* stsz/stz2 table */
+
+    /* timing tables, stts always defined once indexed */
+    const MP4_Box_data_stts_t *p_stts;
+    const MP4_Box_data_ctts_t *p_ctts;
+    int64_t          i_cts_shift;
 
     uint32_t     i_sample_first; /* i_sample_first value
                                                    of the next chunk */
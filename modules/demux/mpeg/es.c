@@ -39,9 +39,11 @@
 
 #include "../../packetizer/a52.h"
 #include "../../packetizer/dts_header.h"
+#include "../../packetizer/mpegaudio.h"
 #include "../meta_engine/ID3Tag.h"
 #include "../meta_engine/ID3Text.h"
 #include "../meta_engine/ID3Meta.h"
+#include "../seekindex.h"
 
 /*****************************************************************************
  * Module descriptor
@@ -54,6 +56,11 @@ static void Close    ( vlc_object_t * );
 #define FPS_LONGTEXT N_("This is the frame rate used as a fallback when " \
     "playing MPEG video elementary streams.")
 
+#define INDEX_TEXT N_("Frame index")
+#define INDEX_LONGTEXT N_("Index the frame headers of MPEG audio, ADTS AAC, " \
+    "A52 and DTS streams while reading them, for exact seeking and duration " \
+    "of variable bitrate files.")
+
 vlc_module_begin ()
     set_category( CAT_INPUT )
     set_subcategory( SUBCAT_INPUT_DEMUX )
@@ -61,6 +68,7 @@ vlc_module_begin ()
     set_shortname( N_("Audio ES") )
     set_capability( "demux", 155 )
     set_callbacks( OpenAudio, Close )
+    add_bool( "es-frame-index", true, INDEX_TEXT, INDEX_LONGTEXT, true )
 
     add_shortcut( "mpga", "mp3",
                   "m4a", "mp4a", "aac",
@@ -119,6 +127,48 @@ typedef struct
     sync_table_ctx_t current;
 } sync_table_t;
 
+/* Frame header index, see Index*() */
+#define ES_INDEX_INTERVAL   CLOCK_FREQ
+#define ES_INDEX_HEADER_MAX __MAX(VLC_A52_HEADER_SIZE, VLC_DTS_HEADER_SIZE)
+#define ES_INDEX_CHUNK      65536
+#define ES_INDEX_TAIL       16384 /* allowed for trailing tags */
+
+typedef struct
+{
+    mtime_t  i_time;
+    uint64_t i_pos;
+} es_index_entry_t;
+
+typedef struct
+{
+    uint64_t i_pos;     /* of the next frame */
+    mtime_t  i_base;
+    uint64_t i_samples; /* since i_base */
+    unsigned i_rate;
+} es_index_scan_t;
+
+typedef struct
+{
+    int  (*pf_parse)( const uint8_t *, unsigned *pi_samples, unsigned *pi_rate );
+    size_t i_header_size;
+
+    bool b_done;        /* no more frames will be indexed */
+    bool b_complete;    /* the last entry is the end of the stream */
+    bool b_dirty;
+
+    es_index_entry_t *p_entries;
+    size_t i_entries;
+    size_t i_alloc;
+    es_index_scan_t scan;
+
+    /* last bytes of the previous block, for split headers */
+    uint8_t p_carry[ES_INDEX_HEADER_MAX];
+    size_t i_carry;
+    uint64_t i_carry_end;
+
+    seekindex_t *p_cache;
+} es_index_t;
+
 struct demux_sys_t
 {
     codec_t codec;
@@ -161,6 +211,8 @@ struct demux_sys_t
     float rgf_replay_peak[AUDIO_REPLAY_GAIN_MAX];
 
     sync_table_t mllt;
+
+    es_index_t index;
 };
 
 static int MpgaProbe( demux_t *p_demux, int64_t *pi_offset );
@@ -183,6 +235,13 @@ static int MlpInit( demux_t *p_demux );
 static bool Parse( demux_t *p_demux, block_t **pp_output );
 static uint64_t SeekByMlltTable( demux_t *p_demux, mtime_t *pi_time );
 
+static void IndexOpen( demux_t *p_demux );
+static void IndexClose( demux_t *p_demux );
+static void IndexFeed( demux_t *p_demux, const uint8_t *p_buf, size_t i_buf,
+                       uint64_t i_pos );
+static bool IndexTryComplete( demux_t *p_demux );
+static int  IndexSeek( demux_t *p_demux, mtime_t i_time );
+
 static const codec_t p_codecs[] = {
     { VLC_CODEC_MP4A, false, "mp4 audio",  AacProbe,  AacInit },
     { VLC_CODEC_MPGA, false, "mpeg audio", MpgaProbe, MpgaInit },
@@ -237,12 +296,15 @@ static int OpenCommon( demux_t *p_demux,
 
     msg_Dbg( p_demux, "detected format %4.4s", (const char*)&p_sys->codec.i_codec );
 
+    IndexOpen( p_demux );
+
     /* Load the audio packetizer */
     es_format_Init( &fmt, i_cat, p_sys->codec.i_codec );
     fmt.i_original_fourcc = p_sys->i_original;
     p_sys->p_packetizer = demux_PacketizerNew( p_demux, &fmt, p_sys->codec.psz_name );
     if( !p_sys->p_packetizer )
     {
+        IndexClose( p_demux );
         free( p_sys );
         return VLC_EGENERIC;
     }
@@ -375,6 +437,7 @@ static void Close( vlc_object_t * p_this )
         block_ChainRelease( p_sys->p_packetized_data );
     if( p_sys->mllt.p_bits )
         free( p_sys->mllt.p_bits );
+    IndexClose( p_demux );
     demux_PacketizerDestroy( p_sys->p_packetizer );
     free( p_sys );
 }
@@ -403,6 +466,13 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         case DEMUX_GET_LENGTH:
         {
+            if( p_sys->index.b_complete )
+            {
+                pi64 = va_arg( args, int64_t * );
+                *pi64 = p_sys->index.p_entries[p_sys->index.i_entries - 1].i_time;
+                return VLC_SUCCESS;
+            }
+
             va_list ap;
 
             va_copy ( ap, args );
@@ -431,11 +501,35 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             return i_ret;
         }
 
+        case DEMUX_SET_POSITION:
+        {
+            if( !p_sys->index.b_complete )
+                goto helper;
+
+            va_list ap;
+            va_copy( ap, args );
+            double f_pos = va_arg( ap, double );
+            va_end( ap );
+
+            const mtime_t i_length =
+                p_sys->index.p_entries[p_sys->index.i_entries - 1].i_time;
+            if( IndexSeek( p_demux, (mtime_t)(f_pos * i_length) ) == VLC_SUCCESS )
+                return VLC_SUCCESS;
+            goto helper;
+        }
+
         case DEMUX_SET_TIME:
         {
+            va_list ap;
+            va_copy( ap, args );
+            int64_t i_time = va_arg( ap, int64_t );
+            va_end( ap );
+
+            if( IndexSeek( p_demux, i_time ) == VLC_SUCCESS )
+                return VLC_SUCCESS;
+
             if( p_sys->mllt.p_bits )
             {
-                int64_t i_time = va_arg(args, int64_t);
                 uint64_t i_pos = SeekByMlltTable( p_demux, &i_time );
                 int i_ret = vlc_stream_Seek( p_demux->s, p_sys->i_stream_offset + i_pos );
                 if( i_ret != VLC_SUCCESS )
@@ -447,10 +541,10 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
                 p_sys->p_packetized_data = NULL;
                 return VLC_SUCCESS;
             }
-            /* FIXME TODO: implement a high precision seek (with mp3 parsing)
-             * needed for multi-input */
         }
+        /* fall through */
         default:
+        helper:
             i_ret = demux_vaControlHelper( p_demux->s, p_sys->i_stream_offset, -1,
                                             p_sys->i_bitrate_avg, 1, i_query,
                                             args );
@@ -491,6 +585,7 @@ static bool Parse( demux_t *p_demux, block_t **pp_output )
             return true;
     }
 
+    const uint64_t i_block_pos = vlc_stream_Tell( p_demux->s );
     p_block_in = vlc_stream_Block( p_demux->s, p_sys->i_packet_size );
     bool b_eof = p_block_in == NULL;
 
@@ -502,6 +597,9 @@ static bool Parse( demux_t *p_demux, block_t **pp_output )
             swab( p_block_in->p_buffer, p_block_in->p_buffer, p_block_in->i_buffer );
         }
 
+        IndexFeed( p_demux, p_block_in->p_buffer, p_block_in->i_buffer,
+                   i_block_pos );
+
         p_block_in->i_pts = p_block_in->i_dts = p_sys->b_start || p_sys->b_initial_sync_failed ? VLC_TS_0 : VLC_TS_INVALID;
     }
     p_sys->b_initial_sync_failed = p_sys->b_start; /* Only try to resync once */
@@ -547,9 +645,351 @@ static bool Parse( demux_t *p_demux, block_t **pp_output )
         msg_Dbg( p_demux, "did not sync on first block" );
     p_sys->b_start = false;
 
+    if( b_eof && p_sys->index.pf_parse && !p_sys->index.b_done )
+        IndexTryComplete( p_demux );
+
     return b_eof;
 }
 
+/*****************************************************************************
+ * Frame header index
+ *****************************************************************************
+ * Entries map the start of a frame to its time, at ES_INDEX_INTERVAL steps.
+ * The index is built from the frame headers of the blocks read for playback,
+ * and by reading ahead when seeking past its end. Once it reaches the end
+ * of the stream, it gives the exact duration and is stored to the seek index
+ * cache.
+ *****************************************************************************/
+static mtime_t IndexScanTime( const es_index_scan_t *p_scan )
+{
+    if( p_scan->i_rate == 0 )
+        return p_scan->i_base;
+    return p_scan->i_base + p_scan->i_samples * CLOCK_FREQ / p_scan->i_rate;
+}
+
+static int IndexAppend( es_index_t *p_index, uint64_t i_pos, mtime_t i_time )
+{
+    if( p_index->i_entries >= p_index->i_alloc )
+    {
+        size_t i_alloc = p_index->i_alloc ? 2 * p_index->i_alloc : 1024;
+        es_index_entry_t *p_entries =
+            realloc( p_index->p_entries, i_alloc * sizeof(*p_entries) );
+        if( unlikely(p_entries == NULL) )
+            return VLC_ENOMEM;
+        p_index->p_entries = p_entries;
+        p_index->i_alloc = i_alloc;
+    }
+    p_index->p_entries[p_index->i_entries].i_pos = i_pos;
+    p_index->p_entries[p_index->i_entries].i_time = i_time;
+    p_index->i_entries++;
+    return VLC_SUCCESS;
+}
+
+/* Steps over the frame starting at p_scan->i_pos, unless it ends after
+ * i_target. Frames stepped over with the index scan state are indexed.
+ * Returns 1 if the frame was stepped over, 0 if it contains i_target, and
+ * -1 if the header is invalid */
+static int IndexStep( es_index_t *p_index, es_index_scan_t *p_scan,
+                      const uint8_t *p_header, mtime_t i_target )
+{
+    unsigned i_samples, i_rate;
+    int i_size = p_index->pf_parse( p_header, &i_samples, &i_rate );
+    if( i_size < (int)p_index->i_header_size || ( i_samples > 0 && i_rate == 0 ) )
+        return -1;
+
+    if( i_samples > 0 && i_rate != p_scan->i_rate )
+    {
+        p_scan->i_base = IndexScanTime( p_scan );
+        p_scan->i_samples = 0;
+        p_scan->i_rate = i_rate;
+    }
+
+    const mtime_t i_time = IndexScanTime( p_scan );
+    if( i_samples > 0 &&
+        i_time + (mtime_t)i_samples * CLOCK_FREQ / i_rate > i_target )
+        return 0;
+
+    if( p_scan == &p_index->scan &&
+        ( p_index->i_entries == 0 ||
+          i_time >= p_index->p_entries[p_index->i_entries - 1].i_time
+                    + ES_INDEX_INTERVAL ) &&
+        IndexAppend( p_index, p_scan->i_pos, i_time ) )
+        return -1;
+
+    p_scan->i_pos += i_size;
+    p_scan->i_samples += i_samples;
+    return 1;
+}
+
+/* Marks the index complete if it reached the end of the stream, allowing
+ * for trailing tags (ID3v1, APE) */
+static bool IndexTryComplete( demux_t *p_demux )
+{
+    es_index_t *p_index = &p_demux->p_sys->index;
+    uint64_t i_size;
+
+    if( vlc_stream_GetSize( p_demux->s, &i_size ) ||
+        p_index->scan.i_pos + ES_INDEX_TAIL < i_size ||
+        p_index->i_entries == 0 )
+        return false;
+
+    const mtime_t i_length = IndexScanTime( &p_index->scan );
+    if( IndexAppend( p_index, p_index->scan.i_pos, i_length ) )
+    {
+        p_index->b_done = true;
+        return false;
+    }
+    p_index->b_done = true;
+    p_index->b_complete = true;
+    p_index->b_dirty = true;
+    msg_Dbg( p_demux, "frame index complete, %zu entries, length %"PRId64"us",
+             p_index->i_entries, i_length );
+    return true;
+}
+
+/* Stops indexing where the frame sync was lost.
+ * Returns true if that is the end of the stream */
+static bool IndexLostSync( demux_t *p_demux )
+{
+    es_index_t *p_index = &p_demux->p_sys->index;
+
+    if( IndexTryComplete( p_demux ) )
+        return true;
+
+    msg_Dbg( p_demux, "frame index lost sync at %"PRIu64,
+             p_index->scan.i_pos );
+    p_index->b_done = true;
+    return false;
+}
+
+static void IndexFeed( demux_t *p_demux, const uint8_t *p_buf, size_t i_buf,
+                       uint64_t i_pos )
+{
+    es_index_t *p_index = &p_demux->p_sys->index;
+    es_index_scan_t *p_scan = &p_index->scan;
+    const size_t i_header = p_index->i_header_size;
+
+    if( p_index->pf_parse == NULL || p_index->b_done )
+        return;
+
+    /* Header split between the previous block and this one */
+    if( p_scan->i_pos < i_pos && i_pos == p_index->i_carry_end &&
+        p_scan->i_pos + p_index->i_carry >= i_pos &&
+        i_pos - p_scan->i_pos + i_buf >= i_header )
+    {
+        const size_t i_head = i_pos - p_scan->i_pos;
+        uint8_t p_header[ES_INDEX_HEADER_MAX];
+
+        memcpy( p_header, &p_index->p_carry[p_index->i_carry - i_head], i_head );
+        memcpy( &p_header[i_head], p_buf, i_header - i_head );
+        if( IndexStep( p_index, p_scan, p_header, INT64_MAX ) < 0 )
+        {
+            IndexLostSync( p_demux );
+            return;
+        }
+    }
+
+    while( p_scan->i_pos >= i_pos && p_scan->i_pos - i_pos + i_header <= i_buf )
+    {
+        if( IndexStep( p_index, p_scan, &p_buf[p_scan->i_pos - i_pos],
+                       INT64_MAX ) < 0 )
+        {
+            IndexLostSync( p_demux );
+            return;
+        }
+    }
+
+    p_index->i_carry = __MIN( i_buf, i_header - 1 );
+    memcpy( p_index->p_carry, &p_buf[i_buf - p_index->i_carry], p_index->i_carry );
+    p_index->i_carry_end = i_pos + i_buf;
+}
+
+/* Reads the frame headers from p_scan->i_pos up to the frame containing
+ * i_target, or the end of the stream */
+static int IndexWalk( demux_t *p_demux, es_index_scan_t *p_scan, mtime_t i_target )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    es_index_t *p_index = &p_sys->index;
+    const size_t i_header = p_index->i_header_size;
+    const bool b_indexing = p_scan == &p_index->scan;
+
+    uint8_t *p_buf = malloc( ES_INDEX_CHUNK );
+    if( unlikely(p_buf == NULL) )
+        return VLC_ENOMEM;
+
+    int i_ret = VLC_EGENERIC;
+    for( ;; )
+    {
+        if( vlc_stream_Seek( p_demux->s, p_scan->i_pos ) )
+            break;
+
+        const uint64_t i_pos = p_scan->i_pos;
+        ssize_t i_read = vlc_stream_Read( p_demux->s, p_buf, ES_INDEX_CHUNK );
+        if( i_read < (ssize_t)i_header )
+        {
+            /* End of stream */
+            if( !b_indexing || IndexLostSync( p_demux ) )
+                i_ret = VLC_SUCCESS;
+            break;
+        }
+
+        if( p_sys->codec.b_use_word && !p_sys->b_big_endian )
+        {
+            /* swab() may not work in place */
+            for( ssize_t i = 0; i + 1 < i_read; i += 2 )
+            {
+                uint8_t i_tmp = p_buf[i];
+                p_buf[i] = p_buf[i + 1];
+                p_buf[i + 1] = i_tmp;
+            }
+        }
+
+        int i_step = 1;
+        while( i_step > 0 && p_scan->i_pos - i_pos + i_header <= (size_t)i_read )
+            i_step = IndexStep( p_index, p_scan, &p_buf[p_scan->i_pos - i_pos],
+                                i_target );
+        if( i_step == 0 )
+        {
+            i_ret = VLC_SUCCESS;
+            break;
+        }
+        if( i_step < 0 )
+        {
+            if( b_indexing && IndexLostSync( p_demux ) )
+                i_ret = VLC_SUCCESS;
+            break;
+        }
+    }
+    free( p_buf );
+
+    if( b_indexing )
+        p_index->i_carry_end = 0;
+    return i_ret;
+}
+
+static int IndexSeek( demux_t *p_demux, mtime_t i_time )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    es_index_t *p_index = &p_sys->index;
+    es_index_scan_t scan;
+
+    if( p_index->pf_parse == NULL || p_index->i_entries == 0 )
+        return VLC_EGENERIC;
+    if( i_time < 0 )
+        i_time = 0;
+
+    if( !p_index->b_complete && i_time >= IndexScanTime( &p_index->scan ) )
+    {
+        /* Read ahead up to the target, if that is cheap enough */
+        bool b_fastseek;
+        if( p_index->b_done ||
+            vlc_stream_Control( p_demux->s, STREAM_CAN_FASTSEEK, &b_fastseek ) ||
+            !b_fastseek ||
+            IndexWalk( p_demux, &p_index->scan, i_time ) )
+            return VLC_EGENERIC;
+        scan = p_index->scan;
+    }
+    else
+    {
+        /* Last entry before the target */
+        size_t i_lo = 0, i_hi = p_index->i_entries;
+        while( i_hi - i_lo > 1 )
+        {
+            size_t i_mid = ( i_lo + i_hi ) / 2;
+            if( p_index->p_entries[i_mid].i_time <= i_time )
+                i_lo = i_mid;
+            else
+                i_hi = i_mid;
+        }
+
+        scan.i_pos = p_index->p_entries[i_lo].i_pos;
+        scan.i_base = p_index->p_entries[i_lo].i_time;
+        scan.i_samples = 0;
+        scan.i_rate = 0;
+        if( IndexWalk( p_demux, &scan, i_time ) )
+        {
+            scan.i_pos = p_index->p_entries[i_lo].i_pos;
+            scan.i_base = p_index->p_entries[i_lo].i_time;
+            scan.i_samples = 0;
+        }
+    }
+
+    if( vlc_stream_Seek( p_demux->s, scan.i_pos ) )
+        return VLC_EGENERIC;
+
+    p_sys->i_time_offset = IndexScanTime( &scan ) - p_sys->i_pts;
+    /* And reset buffered data */
+    if( p_sys->p_packetized_data )
+        block_ChainRelease( p_sys->p_packetized_data );
+    p_sys->p_packetized_data = NULL;
+    return VLC_SUCCESS;
+}
+
+static void IndexOpen( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    es_index_t *p_index = &p_sys->index;
+    bool b_can_seek;
+
+    if( p_index->pf_parse == NULL ||
+        !var_InheritBool( p_demux, "es-frame-index" ) ||
+        vlc_stream_Control( p_demux->s, STREAM_CAN_SEEK, &b_can_seek ) ||
+        !b_can_seek )
+    {
+        p_index->pf_parse = NULL;
+        return;
+    }
+
+    p_index->scan.i_pos = p_sys->i_stream_offset;
+
+    p_index->p_cache = seekindex_New( p_demux, "es", 1,
+                                      sizeof(es_index_entry_t) );
+    if( p_index->p_cache == NULL )
+        return;
+
+    size_t i_entries;
+    const es_index_entry_t *p_entries =
+        seekindex_Get( p_index->p_cache, &i_entries );
+    if( p_entries == NULL || i_entries < 2 ||
+        p_entries[0].i_pos != (uint64_t)p_sys->i_stream_offset ||
+        p_entries[0].i_time != 0 )
+        return;
+    for( size_t i = 1; i < i_entries; i++ )
+    {
+        if( p_entries[i].i_pos <= p_entries[i-1].i_pos ||
+            p_entries[i].i_time < p_entries[i-1].i_time )
+        {
+            msg_Warn( p_demux, "invalid cached frame index, ignoring it" );
+            return;
+        }
+    }
+
+    p_index->p_entries = malloc( i_entries * sizeof(*p_entries) );
+    if( unlikely(p_index->p_entries == NULL) )
+        return;
+    memcpy( p_index->p_entries, p_entries, i_entries * sizeof(*p_entries) );
+    p_index->i_entries = p_index->i_alloc = i_entries;
+    p_index->scan.i_pos = p_entries[i_entries - 1].i_pos;
+    p_index->scan.i_base = p_entries[i_entries - 1].i_time;
+    p_index->b_done = true;
+    p_index->b_complete = true;
+    msg_Dbg( p_demux, "frame index loaded from %zu cached entries", i_entries );
+}
+
+static void IndexClose( demux_t *p_demux )
+{
+    es_index_t *p_index = &p_demux->p_sys->index;
+
+    if( p_index->p_cache )
+    {
+        if( p_index->b_dirty )
+            seekindex_Store( p_index->p_cache, p_index->p_entries,
+                             p_index->i_entries );
+        seekindex_Delete( p_index->p_cache );
+    }
+    free( p_index->p_entries );
+}
+
 /* Check to apply to WAVE fmt header */
 static int GenericFormatCheck( int i_format, const uint8_t *p_head )
 {
@@ -758,6 +1198,23 @@ static int MpgaGetFrameSamples( uint32_t h )
     }
 }
 
+static int MpgaIndexParse( const uint8_t *p_header, unsigned *pi_samples,
+                           unsigned *pi_rate )
+{
+    unsigned i_channels, i_channels_conf, i_chan_mode, i_bitrate;
+    unsigned i_max_size, i_layer;
+
+    if( !MpgaCheckSync( p_header ) )
+        return -1;
+
+    int i_size = mpga_decode_frameheader( GetDWBE( p_header ), &i_channels,
+                                          &i_channels_conf, &i_chan_mode,
+                                          pi_rate, &i_bitrate, pi_samples,
+                                          &i_max_size, &i_layer );
+    /* Free bitrate frames cannot be walked */
+    return i_bitrate > 0 ? i_size : -1;
+}
+
 static int MpgaProbe( demux_t *p_demux, int64_t *pi_offset )
 {
     const int pi_wav[] = { WAVE_FORMAT_MPEG, WAVE_FORMAT_MPEGLAYER3, WAVE_FORMAT_UNKNOWN };
@@ -801,7 +1258,12 @@ static int MpgaProbe( demux_t *p_demux, int64_t *pi_offset )
                 b_ok = true;
                 break;
             }
-            i_skip++;
+            /* Only a 0xff byte can start a frame */
+            const uint8_t *p_sync = memchr( &p_peek[i_skip + 1], 0xff,
+                                            i_peek - i_skip - 1 );
+            if( p_sync == NULL )
+                break;
+            i_skip = p_sync - p_peek;
         }
         if( !b_ok && !b_forced_demux )
             return VLC_EGENERIC;
@@ -975,6 +1437,8 @@ static int MpgaInit( demux_t *p_demux )
 
     /* */
     p_sys->i_packet_size = 1024;
+    p_sys->index.pf_parse = MpgaIndexParse;
+    p_sys->index.i_header_size = MPGA_HEADER_SIZE;
 
     ID3Parse( p_demux, ID3TAG_Parse_Handler );
 
@@ -1093,12 +1557,32 @@ static int AacProbe( demux_t *p_demux, int64_t *pi_offset )
     *pi_offset = i_offset;
     return VLC_SUCCESS;
 }
+static int AacIndexParse( const uint8_t *p_header, unsigned *pi_samples,
+                          unsigned *pi_rate )
+{
+    static const unsigned pi_sample_rates[16] =
+    {
+        96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050,
+        16000, 12000, 11025, 8000,  7350,  0,     0,     0
+    };
+
+    /* ADTS only, LOAS frames are not indexed */
+    if( p_header[0] != 0xff || (p_header[1] & 0xf6) != 0xf0 )
+        return -1;
+
+    *pi_rate = pi_sample_rates[(p_header[2] >> 2) & 0x0f];
+    *pi_samples = 1024 * ( (p_header[6] & 0x03) + 1 );
+    return ((p_header[3] & 0x03) << 11) | (p_header[4] << 3) | (p_header[5] >> 5);
+}
+
 static int AacInit( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
     p_sys->i_packet_size = 4096;
     p_sys->i_original = VLC_FOURCC('H','E','A','D');
+    p_sys->index.pf_parse = AacIndexParse;
+    p_sys->index.i_header_size = 7;
 
     return VLC_SUCCESS;
 }
@@ -1158,12 +1642,32 @@ static int A52Probe( demux_t *p_demux, int64_t *pi_offset )
                          VLC_A52_HEADER_SIZE, pi_wav, GenericFormatCheck );
 }
 
+static int A52IndexParse( const uint8_t *p_header, unsigned *pi_samples,
+                          unsigned *pi_rate )
+{
+    vlc_a52_header_t header;
+
+    if( vlc_a52_header_Parse( &header, p_header, VLC_A52_HEADER_SIZE ) )
+        return -1;
+
+    /* Only the first independent substream drives the timeline */
+    if( header.b_eac3 && ( header.eac3.strmtyp == EAC3_STRMTYP_DEPENDENT ||
+                           header.eac3.i_substreamid != 0 ) )
+        *pi_samples = 0;
+    else
+        *pi_samples = header.i_samples;
+    *pi_rate = header.i_rate;
+    return header.i_size;
+}
+
 static int A52Init( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
     p_sys->b_big_endian = false;
     p_sys->i_packet_size = 1024;
+    p_sys->index.pf_parse = A52IndexParse;
+    p_sys->index.i_header_size = VLC_A52_HEADER_SIZE;
 
     const uint8_t *p_peek;
 
@@ -1202,11 +1706,28 @@ static int DtsProbe( demux_t *p_demux, int64_t *pi_offset )
     return GenericProbe( p_demux, pi_offset, ppsz_name, DtsCheckSync,
                          VLC_DTS_HEADER_SIZE, pi_wav, NULL );
 }
+static int DtsIndexParse( const uint8_t *p_header, unsigned *pi_samples,
+                          unsigned *pi_rate )
+{
+    vlc_dts_header_t dts;
+
+    if( vlc_dts_header_Parse( &dts, p_header, VLC_DTS_HEADER_SIZE ) != VLC_SUCCESS
+     || dts.i_frame_size == 0 || dts.i_frame_size > 8192 )
+        return -1;
+
+    /* Extension substreams belong to the preceding core frame */
+    *pi_samples = dts.b_substream ? 0 : dts.i_frame_length;
+    *pi_rate = dts.i_rate;
+    return dts.i_frame_size;
+}
+
 static int DtsInit( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
     p_sys->i_packet_size = 16384;
+    p_sys->index.pf_parse = DtsIndexParse;
+    p_sys->index.i_header_size = VLC_DTS_HEADER_SIZE;
 
     return VLC_SUCCESS;
 }
@@ -235,6 +235,9 @@ static int Open( vlc_object_t * p_this )
     vlc_stream_Control( p_demux->s, STREAM_GET_PTS_DELAY,
                         &p_sys->i_access_delay );
 
+    p_sys->p_seekindex = seekindex_New( p_demux, "ogg", 1,
+                                        sizeof(oggseek_cache_entry_t) );
+
     /* Set exported functions */
     p_demux->pf_demux = Demux;
     p_demux->pf_control = Control;
@@ -265,11 +268,14 @@ static void Close( vlc_object_t *p_this )
     /* Cleanup the bitstream parser */
     ogg_sync_clear( &p_sys->oy );
 
+    Oggseek_IndexStore( p_demux );
     Ogg_EndOfStream( p_demux );
 
     if( p_sys->p_old_stream )
         Ogg_LogicalStreamDelete( p_demux, p_sys->p_old_stream );
 
+    if( p_sys->p_seekindex )
+        seekindex_Delete( p_sys->p_seekindex );
     free( p_sys );
 }
 
@@ -311,9 +317,12 @@ static int Demux( demux_t * p_demux )
              * only 1 ES is supported (common case for ogg web radio) */
             if( p_sys->i_streams == 1 )
             {
+                Oggseek_IndexStore( p_demux );
                 p_sys->p_old_stream = p_sys->pp_stream[0];
                 TAB_CLEAN( p_sys->i_streams, p_sys->pp_stream );
             }
+            else
+                Oggseek_IndexStore( p_demux );
 
             Ogg_EndOfStream( p_demux );
             p_sys->b_chained_boundary = true;
@@ -331,6 +340,8 @@ static int Demux( demux_t * p_demux )
 
         msg_Dbg( p_demux, "beginning of a group of logical streams" );
 
+        Oggseek_IndexLoad( p_demux );
+
         if ( !p_sys->b_chained_boundary )
         {
             /* Find the real duration */
@@ -30,6 +30,8 @@
   #include <vorbis/codec.h>
 #endif
 
+#include "seekindex.h"
+
 /*****************************************************************************
  * Definitions of structures and functions used by this plugin
  *****************************************************************************/
@@ -232,6 +234,8 @@ struct demux_sys_t
     /* Length, if available. */
     int64_t i_length;
 
+    /* persistent cache of the seek index entries */
+    seekindex_t *p_seekindex;
 };
 
 
@@ -151,6 +151,87 @@ const demux_index_entry_t *OggSeek_IndexAdd ( logical_stream_t *p_stream,
     return idx;
 }
 
+/* Restore the entries learnt in previous sessions for the current group of
+   logical streams */
+void Oggseek_IndexLoad( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const oggseek_cache_entry_t *p_entries;
+    size_t i_entries;
+
+    if ( p_sys->p_seekindex == NULL ) return;
+    p_entries = seekindex_Get( p_sys->p_seekindex, &i_entries );
+
+    for ( size_t i = 0; i < i_entries; i++ )
+    {
+        for ( int j = 0; j < p_sys->i_streams; j++ )
+        {
+            logical_stream_t *p_stream = p_sys->pp_stream[j];
+            if ( (uint32_t) p_stream->i_serial_no == p_entries[i].i_serial_no )
+            {
+                OggSeek_IndexAdd( p_stream, p_entries[i].i_value,
+                                  p_entries[i].i_pagepos );
+                break;
+            }
+        }
+    }
+}
+
+/* Save the entries of the current group of logical streams, along with the
+   cached entries of the other groups */
+void Oggseek_IndexStore( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const oggseek_cache_entry_t *p_cached;
+    oggseek_cache_entry_t *p_entries = NULL;
+    size_t i_cached, i_entries = 0, i_max = 0;
+
+    if ( p_sys->p_seekindex == NULL ) return;
+    p_cached = seekindex_Get( p_sys->p_seekindex, &i_cached );
+
+    for ( int j = 0; j < p_sys->i_streams; j++ )
+    {
+        for ( demux_index_entry_t *idx = p_sys->pp_stream[j]->idx;
+              idx != NULL; idx = idx->p_next )
+            i_max++;
+    }
+    i_max += i_cached;
+    if ( i_max == 0 ) return;
+
+    p_entries = malloc( i_max * sizeof(*p_entries) );
+    if ( unlikely(p_entries == NULL) ) return;
+
+    for ( size_t i = 0; i < i_cached; i++ )
+    {
+        bool b_current = false;
+        for ( int j = 0; j < p_sys->i_streams && !b_current; j++ )
+            b_current = (uint32_t) p_sys->pp_stream[j]->i_serial_no
+                        == p_cached[i].i_serial_no;
+        if ( !b_current )
+            p_entries[i_entries++] = p_cached[i];
+    }
+
+    for ( int j = 0; j < p_sys->i_streams; j++ )
+    {
+        logical_stream_t *p_stream = p_sys->pp_stream[j];
+        for ( demux_index_entry_t *idx = p_stream->idx;
+              idx != NULL; idx = idx->p_next )
+        {
+            oggseek_cache_entry_t *p_entry = &p_entries[i_entries++];
+            p_entry->i_value = idx->i_value;
+            p_entry->i_pagepos = idx->i_pagepos;
+            p_entry->i_serial_no = p_stream->i_serial_no;
+            p_entry->i_reserved = 0;
+        }
+    }
+
+    /* Entries are only ever added, so the count tells if anything was
+       learnt since the cache was loaded */
+    if ( i_entries != i_cached )
+        seekindex_Store( p_sys->p_seekindex, p_entries, i_entries );
+    free( p_entries );
+}
+
 static bool OggSeekIndexFind ( logical_stream_t *p_stream, int64_t i_timestamp,
                                int64_t *pi_pos_lower, int64_t *pi_pos_upper )
 {
@@ -62,4 +62,16 @@ void    Oggseek_ProbeEnd( demux_t * );
 
 void oggseek_index_entries_free ( demux_index_entry_t * );
 
+/* entry of the persistent index cache */
+typedef struct
+{
+    int64_t  i_value;
+    int64_t  i_pagepos;
+    uint32_t i_serial_no;
+    uint32_t i_reserved;
+} oggseek_cache_entry_t;
+
+void    Oggseek_IndexLoad( demux_t * );
+void    Oggseek_IndexStore( demux_t * );
+
 int64_t oggseek_read_page ( demux_t * );
@@ -0,0 +1,390 @@
+/*****************************************************************************
+ * seekindex.c: persistent seek index cache for demuxers
+ *****************************************************************************
+ * Copyright © 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef _WIN32
+# include <utime.h>
+#endif
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+#include <vlc_configuration.h>
+#include <vlc_fs.h>
+#include <vlc_md5.h>
+
+#include "seekindex.h"
+
+#define SEEKINDEX_MAGIC     "VLCSIDX"
+#define SEEKINDEX_BYTEORDER UINT32_C(0x01020304)
+#define SEEKINDEX_PEEK      4096
+#define SEEKINDEX_MAX_SIZE  (UINT64_C(1) << 28)
+/* Total size of the entries, past which the least recently used go */
+#define SEEKINDEX_CACHE_SIZE (UINT64_C(1) << 28)
+
+typedef struct
+{
+    char     magic[8];
+    uint32_t i_byteorder;
+    uint32_t i_version;
+    uint32_t i_record_size;
+    uint32_t i_reserved;
+    uint64_t i_count;
+    uint8_t  key[16];
+} seekindex_header_t;
+
+struct seekindex_t
+{
+    vlc_object_t      *p_obj;
+    char              *psz_path;
+    seekindex_header_t header;
+    void              *p_records;
+    size_t             i_count;
+};
+
+static void AddString( struct md5_s *p_md5, const char *psz )
+{
+    /* include the terminator so that adjacent fields cannot alias */
+    if( psz == NULL )
+        psz = "";
+    AddMD5( p_md5, psz, strlen( psz ) + 1 );
+}
+
+static void ComputeKey( demux_t *p_demux, const char *psz_demux,
+                        uint32_t i_version, size_t i_record_size,
+                        uint8_t key[16] )
+{
+    struct md5_s md5;
+    InitMD5( &md5 );
+
+    AddString( &md5, psz_demux );
+    AddMD5( &md5, &i_version, sizeof(i_version) );
+    AddMD5( &md5, &i_record_size, sizeof(i_record_size) );
+    AddString( &md5, p_demux->psz_access );
+    AddString( &md5, p_demux->psz_location );
+
+    uint64_t i_size;
+    if( vlc_stream_GetSize( p_demux->s, &i_size ) )
+        i_size = 0;
+    AddMD5( &md5, &i_size, sizeof(i_size) );
+
+    struct stat st;
+    char *psz_validator;
+    if( p_demux->psz_file != NULL && vlc_stat( p_demux->psz_file, &st ) == 0 )
+    {
+        int64_t i_mtime = st.st_mtime;
+        AddMD5( &md5, &i_mtime, sizeof(i_mtime) );
+    }
+    else if( vlc_stream_Control( p_demux->s, STREAM_GET_VALIDATOR,
+                                 &psz_validator ) == VLC_SUCCESS )
+    {
+        AddString( &md5, psz_validator );
+        free( psz_validator );
+    }
+
+    const uint8_t *p_peek;
+    ssize_t i_peek = vlc_stream_Peek( p_demux->s, &p_peek, SEEKINDEX_PEEK );
+    if( i_peek > 0 )
+        AddMD5( &md5, p_peek, i_peek );
+
+    EndMD5( &md5 );
+    memcpy( key, md5.buf, 16 );
+}
+
+static void Load( seekindex_t *p_idx )
+{
+    FILE *p_file = vlc_fopen( p_idx->psz_path, "rb" );
+    if( p_file == NULL )
+        return;
+
+    seekindex_header_t header;
+    if( fread( &header, sizeof(header), 1, p_file ) != 1
+     || memcmp( &header, &p_idx->header,
+                offsetof(seekindex_header_t, i_count) )
+     || memcmp( header.key, p_idx->header.key, sizeof(header.key) )
+     || header.i_count == 0
+     || header.i_count > SEEKINDEX_MAX_SIZE / header.i_record_size )
+    {
+        msg_Dbg( p_idx->p_obj, "ignoring stale seek index %s",
+                 p_idx->psz_path );
+        fclose( p_file );
+        return;
+    }
+
+    void *p_records = malloc( header.i_count * header.i_record_size );
+    if( likely(p_records != NULL)
+     && fread( p_records, header.i_record_size, header.i_count,
+               p_file ) == header.i_count )
+    {
+        p_idx->p_records = p_records;
+        p_idx->i_count = header.i_count;
+        msg_Dbg( p_idx->p_obj, "loaded %zu seek index records from %s",
+                 p_idx->i_count, p_idx->psz_path );
+#ifndef _WIN32
+        /* the modification time orders the entries for eviction */
+        utime( p_idx->psz_path, NULL );
+#endif
+    }
+    else
+        free( p_records );
+
+    fclose( p_file );
+}
+
+typedef struct
+{
+    char    *psz_path;
+    time_t   i_mtime;
+    uint64_t i_size;
+} seekindex_file_t;
+
+static int CompareFiles( const void *a, const void *b )
+{
+    const seekindex_file_t *p_a = a, *p_b = b;
+
+    return ( p_a->i_mtime > p_b->i_mtime ) - ( p_a->i_mtime < p_b->i_mtime );
+}
+
+/* Evicts the least recently used entries, other than that of p_idx, while
+ * the cache directory is over its size limit */
+static void Prune( seekindex_t *p_idx, const char *psz_dir )
+{
+    DIR *p_dir = vlc_opendir( psz_dir );
+    if( p_dir == NULL )
+        return;
+
+    seekindex_file_t *p_files = NULL;
+    size_t i_files = 0, i_max = 0;
+    uint64_t i_total = 0;
+    const char *psz_name;
+
+    while( ( psz_name = vlc_readdir( p_dir ) ) != NULL )
+    {
+        size_t i_len = strlen( psz_name );
+        if( i_len < 4 || strcmp( &psz_name[i_len - 4], ".idx" ) )
+            continue;
+
+        char *psz_path;
+        struct stat st;
+        if( asprintf( &psz_path, "%s"DIR_SEP"%s", psz_dir, psz_name ) == -1 )
+            break;
+        if( vlc_stat( psz_path, &st ) )
+        {
+            free( psz_path );
+            continue;
+        }
+        i_total += st.st_size;
+        if( !strcmp( psz_path, p_idx->psz_path ) )
+        {
+            free( psz_path );
+            continue;
+        }
+
+        if( i_files == i_max )
+        {
+            size_t i_new = i_max ? 2 * i_max : 64;
+            seekindex_file_t *p_new = realloc( p_files,
+                                               i_new * sizeof(*p_new) );
+            if( unlikely(p_new == NULL) )
+            {
+                free( psz_path );
+                break;
+            }
+            p_files = p_new;
+            i_max = i_new;
+        }
+        p_files[i_files].psz_path = psz_path;
+        p_files[i_files].i_mtime = st.st_mtime;
+        p_files[i_files].i_size = st.st_size;
+        i_files++;
+    }
+    closedir( p_dir );
+
+    if( i_total > SEEKINDEX_CACHE_SIZE )
+        qsort( p_files, i_files, sizeof(*p_files), CompareFiles );
+
+    for( size_t i = 0; i < i_files; i++ )
+    {
+        if( i_total > SEEKINDEX_CACHE_SIZE
+         && vlc_unlink( p_files[i].psz_path ) == 0 )
+        {
+            msg_Dbg( p_idx->p_obj, "evicted seek index %s",
+                     p_files[i].psz_path );
+            i_total -= p_files[i].i_size;
+        }
+        free( p_files[i].psz_path );
+    }
+    free( p_files );
+}
+
+seekindex_t *seekindex_New( demux_t *p_demux, const char *psz_demux,
+                            uint32_t i_version, size_t i_record_size )
+{
+    if( !var_InheritBool( p_demux, "seek-index-cache" )
+     || p_demux->s == NULL || p_demux->psz_location == NULL
+     || i_record_size == 0 || i_record_size > UINT32_MAX )
+        return NULL;
+
+    /* Only files whose identity can be checked are worth caching */
+    bool b_can_seek;
+    uint64_t i_size;
+    if( vlc_stream_Control( p_demux->s, STREAM_CAN_SEEK, &b_can_seek )
+     || !b_can_seek || vlc_stream_GetSize( p_demux->s, &i_size ) || i_size == 0 )
+        return NULL;
+
+    seekindex_t *p_idx = calloc( 1, sizeof(*p_idx) );
+    if( unlikely(p_idx == NULL) )
+        return NULL;
+
+    p_idx->p_obj = VLC_OBJECT(p_demux);
+    memcpy( p_idx->header.magic, SEEKINDEX_MAGIC, sizeof(SEEKINDEX_MAGIC) );
+    p_idx->header.i_byteorder = SEEKINDEX_BYTEORDER;
+    p_idx->header.i_version = i_version;
+    p_idx->header.i_record_size = i_record_size;
+    ComputeKey( p_demux, psz_demux, i_version, i_record_size,
+                p_idx->header.key );
+
+    char *psz_cachedir = config_GetUserDir( VLC_CACHE_DIR );
+    if( psz_cachedir == NULL )
+        goto error;
+
+    char psz_name[33];
+    for( int i = 0; i < 16; i++ )
+        sprintf( &psz_name[2*i], "%02"PRIx8, p_idx->header.key[i] );
+
+    if( asprintf( &p_idx->psz_path, "%s"DIR_SEP"seekindex"DIR_SEP"%s.idx",
+                  psz_cachedir, psz_name ) == -1 )
+        p_idx->psz_path = NULL;
+    free( psz_cachedir );
+    if( p_idx->psz_path == NULL )
+        goto error;
+
+    Load( p_idx );
+    return p_idx;
+
+error:
+    free( p_idx );
+    return NULL;
+}
+
+void seekindex_Delete( seekindex_t *p_idx )
+{
+    free( p_idx->p_records );
+    free( p_idx->psz_path );
+    free( p_idx );
+}
+
+const void *seekindex_Get( const seekindex_t *p_idx, size_t *pi_count )
+{
+    *pi_count = p_idx->i_count;
+    return p_idx->p_records;
+}
+
+int seekindex_Store( seekindex_t *p_idx, const void *p_records, size_t i_count )
+{
+    size_t i_record_size = p_idx->header.i_record_size;
+    if( i_count == 0 || i_count > SEEKINDEX_MAX_SIZE / i_record_size )
+        return VLC_EGENERIC;
+
+    /* Create the cache directory on first use */
+    char *psz_dir = strdup( p_idx->psz_path );
+    if( unlikely(psz_dir == NULL) )
+        return VLC_ENOMEM;
+    *strrchr( psz_dir, DIR_SEP_CHAR ) = '\0';
+    char *psz_parent = strrchr( psz_dir, DIR_SEP_CHAR );
+    if( psz_parent != NULL )
+    {
+        *psz_parent = '\0';
+        if( vlc_mkdir( psz_dir, 0700 ) && errno != EEXIST )
+            msg_Dbg( p_idx->p_obj, "cannot create %s: %s", psz_dir,
+                     vlc_strerror_c(errno) );
+        *psz_parent = DIR_SEP_CHAR;
+    }
+    if( vlc_mkdir( psz_dir, 0700 ) && errno != EEXIST )
+    {
+        msg_Warn( p_idx->p_obj, "cannot create %s: %s", psz_dir,
+                  vlc_strerror_c(errno) );
+        free( psz_dir );
+        return VLC_EGENERIC;
+    }
+
+    /* Write aside and rename, so that concurrent readers never see a
+     * partial entry */
+    char *psz_tmp;
+    if( asprintf( &psz_tmp, "%s.%lu.tmp", p_idx->psz_path,
+                  (unsigned long)getpid() ) == -1 )
+    {
+        free( psz_dir );
+        return VLC_ENOMEM;
+    }
+
+    FILE *p_file = vlc_fopen( psz_tmp, "wb" );
+    if( p_file == NULL )
+    {
+        msg_Warn( p_idx->p_obj, "cannot create %s: %s", psz_tmp,
+                  vlc_strerror_c(errno) );
+        free( psz_tmp );
+        free( psz_dir );
+        return VLC_EGENERIC;
+    }
+
+    seekindex_header_t header = p_idx->header;
+    header.i_count = i_count;
+
+    bool b_ok = fwrite( &header, sizeof(header), 1, p_file ) == 1
+             && fwrite( p_records, i_record_size, i_count, p_file ) == i_count;
+    b_ok = ( fclose( p_file ) == 0 ) && b_ok;
+
+    if( b_ok && vlc_rename( psz_tmp, p_idx->psz_path ) == 0 )
+    {
+        msg_Dbg( p_idx->p_obj, "stored %zu seek index records to %s",
+                 i_count, p_idx->psz_path );
+        free( psz_tmp );
+
+        Prune( p_idx, psz_dir );
+        free( psz_dir );
+
+        /* keep seekindex_Get() consistent with the cache entry */
+        void *p_copy = malloc( i_count * i_record_size );
+        if( likely(p_copy != NULL) )
+        {
+            memcpy( p_copy, p_records, i_count * i_record_size );
+            free( p_idx->p_records );
+            p_idx->p_records = p_copy;
+            p_idx->i_count = i_count;
+        }
+        return VLC_SUCCESS;
+    }
+
+    msg_Warn( p_idx->p_obj, "cannot write seek index %s",
+              p_idx->psz_path );
+    vlc_unlink( psz_tmp );
+    free( psz_tmp );
+    free( psz_dir );
+    return VLC_EGENERIC;
+}
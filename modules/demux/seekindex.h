@@ -0,0 +1,71 @@
+/*****************************************************************************
+ * seekindex.h: persistent seek index cache for demuxers
+ *****************************************************************************
+ * Copyright © 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_DEMUX_SEEKINDEX_H
+#define VLC_DEMUX_SEEKINDEX_H
+
+# ifdef __cplusplus
+extern "C" {
+# endif
+
+/**
+ * Seek points learnt by a demuxer (by scanning or bisecting a file without
+ * usable index) are stored in the user cache directory, and reused when the
+ * same file is opened again.
+ *
+ * The cache entry is keyed by the demuxer name and format version, and by
+ * the file identity: location, size, modification time (or HTTP validator)
+ * and a hash of the first bytes. Records have a fixed size and a layout
+ * private to the demuxer, in host byte order.
+ *
+ * The cache is kept under a size limit by evicting the least recently used
+ * entries.
+ */
+typedef struct seekindex_t seekindex_t;
+
+/**
+ * Looks up the cache entry for the stream of a demuxer.
+ * Must be called while the stream is still at its start.
+ *
+ * \return NULL if the cache is disabled ("seek-index-cache") or unusable
+ */
+seekindex_t *seekindex_New( demux_t *, const char *psz_demux,
+                            uint32_t i_version, size_t i_record_size );
+void seekindex_Delete( seekindex_t * );
+
+/**
+ * \return the records loaded from the cache, or NULL if there were none
+ */
+const void *seekindex_Get( const seekindex_t *, size_t *pi_count );
+
+/**
+ * Replaces the cache entry with the given records.
+ * On success, seekindex_Get() returns a copy of the new records.
+ *
+ * The records are reused as they are: a demuxer must not store an index
+ * whose creation was cut short as if it covered the whole file.
+ */
+int seekindex_Store( seekindex_t *, const void *p_records, size_t i_count );
+
+# ifdef __cplusplus
+}
+# endif
+
+#endif
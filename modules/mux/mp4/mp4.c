@@ -53,6 +53,22 @@
     "\"Fast Start\" files are optimized for downloads and allow the user " \
     "to start previewing the file while it is downloading.")
 
+#define MOOVRESERVE_TEXT N_("Space reserved for the index (KiB)")
+#define MOOVRESERVE_LONGTEXT N_(\
+    "Reserve space ahead of the media data for the index of \"Fast Start\" " \
+    "files, so that the data does not need to be moved when the file is " \
+    "closed. About 30 KiB per track and per minute is enough.")
+
+#define SEGMENT_TEXT N_("Segment duration (ms)")
+#define SEGMENT_LONGTEXT N_(\
+    "Target duration of the CMAF segments. Segments start on keyframes, " \
+    "so they can be longer.")
+
+#define CHUNK_TEXT N_("Chunk duration (ms)")
+#define CHUNK_LONGTEXT N_(\
+    "Split the CMAF segments into chunks of this duration, for low latency " \
+    "streaming. 0 writes each segment as a single chunk.")
+
 static int  Open   (vlc_object_t *);
 static void Close  (vlc_object_t *);
 static int  OpenFrag   (vlc_object_t *);
@@ -69,6 +85,9 @@ vlc_module_begin ()
     add_bool(SOUT_CFG_PREFIX "faststart", true,
               FASTSTART_TEXT, FASTSTART_LONGTEXT,
               true)
+    add_integer(SOUT_CFG_PREFIX "moov-reserve", 0,
+                MOOVRESERVE_TEXT, MOOVRESERVE_LONGTEXT, true)
+        change_integer_range(0, 1024 * 1024)
     set_capability("sout mux", 5)
     add_shortcut("mp4", "mov", "3gp")
     set_callbacks(Open, Close)
@@ -78,7 +97,13 @@ add_submodule ()
     set_category(CAT_SOUT)
     set_subcategory(SUBCAT_SOUT_MUX)
     set_shortname("MP4 Frag")
-    add_shortcut("mp4frag", "mp4stream")
+    add_shortcut("mp4frag", "mp4stream", "cmaf")
+    add_integer(SOUT_CFG_PREFIX "segment-duration", 4000,
+                SEGMENT_TEXT, SEGMENT_LONGTEXT, true)
+        change_integer_range(100, 60000)
+    add_integer(SOUT_CFG_PREFIX "chunk-duration", 0,
+                CHUNK_TEXT, CHUNK_LONGTEXT, true)
+        change_integer_range(0, 60000)
     set_capability("sout mux", 0)
     set_callbacks(OpenFrag, CloseFrag)
 
@@ -88,7 +113,11 @@ vlc_module_end ()
  * Exported prototypes
  *****************************************************************************/
 static const char *const ppsz_sout_options[] = {
-    "faststart", NULL
+    "faststart", "moov-reserve", NULL
+};
+
+static const char *const ppsz_frag_options[] = {
+    "segment-duration", "chunk-duration", NULL
 };
 
 static int Control(sout_mux_t *, int, va_list);
@@ -149,6 +178,8 @@ typedef struct
     mp4_fragindex_t *p_indexentries;
     uint32_t         i_indexentriesmax;
     uint32_t         i_indexentries;
+    size_t           i_trun_fixup; /* trun data offset in the moof, or 0 */
+    size_t           i_trun_data;  /* run offset in the mdat payload */
 } mp4_stream_t;
 
 struct sout_mux_sys_t
@@ -158,6 +189,8 @@ struct sout_mux_sys_t
     bool b_64_ext;
     bool b_fast_start;
 
+    block_t *p_header;
+    uint64_t i_moov_start;
     uint64_t i_mdat_pos;
     uint64_t i_pos;
     mtime_t  i_read_duration;
@@ -171,9 +204,19 @@ struct sout_mux_sys_t
     bool           b_header_sent;
     mtime_t        i_written_duration;
     uint32_t       i_mfhd_sequence;
+    mtime_t        i_fragment_length;
+
+    /* cmaf segments */
+    bool           b_segmented;
+    bool           b_segment_new;     /* next fragment starts a segment */
+    mtime_t        i_segment_length;
+    mtime_t        i_segment_start;
+    mtime_t        i_segment_cut;     /* start of the next segment, or 0 */
+    uint32_t       i_segment_sequence;
 };
 
 static void box_send(sout_mux_t *p_mux,  bo_t *box);
+static block_t *FreeBox(size_t i_size);
 static bo_t *BuildMoov(sout_mux_t *p_mux);
 
 static block_t *ConvertSUBT(block_t *);
@@ -203,11 +246,14 @@ static int Open(vlc_object_t *p_this)
     p_sys->i_nb_streams = 0;
     p_sys->pp_streams   = NULL;
     p_sys->i_mdat_pos   = 0;
+    p_sys->i_moov_start = 0;
+    p_sys->p_header     = NULL;
     p_sys->b_mov        = p_mux->psz_mux && !strcmp(p_mux->psz_mux, "mov");
     p_sys->b_3gp        = p_mux->psz_mux && !strcmp(p_mux->psz_mux, "3gp");
     p_sys->i_read_duration   = 0;
     p_sys->i_start_dts = VLC_TS_INVALID;
     p_sys->b_fragmented = false;
+    p_sys->b_segmented  = false;
 
     if (!p_sys->b_mov) {
         /* Now add ftyp header */
@@ -229,10 +275,22 @@ static int Open(vlc_object_t *p_this)
         }
 
         p_sys->i_pos += box->b->i_buffer;
-        p_sys->i_mdat_pos = p_sys->i_pos;
+        p_sys->p_header = block_Duplicate(box->b);
         box_send(p_mux, box);
     }
 
+    /* Reserve room for the moov box, see Close() */
+    p_sys->i_moov_start = p_sys->i_pos;
+    if (var_GetBool(p_this, SOUT_CFG_PREFIX "faststart")) {
+        int64_t i_reserve = var_GetInteger(p_this, SOUT_CFG_PREFIX "moov-reserve");
+        block_t *p_free = i_reserve > 0 ? FreeBox(i_reserve * 1024) : NULL;
+        if (p_free) {
+            p_sys->i_pos += p_free->i_buffer;
+            sout_AccessOutWrite(p_mux->p_access, p_free);
+        }
+    }
+    p_sys->i_mdat_pos = p_sys->i_pos;
+
     /* FIXME FIXME
      * Quicktime actually doesn't like the 64 bits extensions !!! */
     p_sys->b_64_ext = false;
@@ -241,6 +299,8 @@ static int Open(vlc_object_t *p_this)
     box = box_new("mdat");
     if(!box)
     {
+        if (p_sys->p_header)
+            block_Release(p_sys->p_header);
         free(p_sys);
         return VLC_ENOMEM;
     }
@@ -254,6 +314,35 @@ static int Open(vlc_object_t *p_this)
     return VLC_SUCCESS;
 }
 
+/*****************************************************************************
+ * MoveData: move the media data up, through the access output
+ *****************************************************************************/
+static bool MoveData(sout_mux_t *p_mux, uint64_t i_shift)
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    int64_t i_size = p_sys->i_pos - p_sys->i_mdat_pos;
+
+    while (i_size > 0) {
+        int64_t i_chunk = __MIN(32768, i_size);
+        block_t *p_buf = block_Alloc(i_chunk);
+        if (!p_buf)
+            return false;
+        sout_AccessOutSeek(p_mux->p_access,
+                            p_sys->i_mdat_pos + i_size - i_chunk);
+        if (sout_AccessOutRead(p_mux->p_access, p_buf) < i_chunk) {
+            msg_Warn(p_mux, "read() not supported by access output, "
+                      "won't create a fast start file");
+            block_Release(p_buf);
+            return false;
+        }
+        sout_AccessOutSeek(p_mux->p_access, p_sys->i_mdat_pos + i_size +
+                            i_shift - i_chunk);
+        sout_AccessOutWrite(p_mux->p_access, p_buf);
+        i_size -= i_chunk;
+    }
+    return true;
+}
+
 /*****************************************************************************
  * Close:
  *****************************************************************************/
@@ -289,48 +378,58 @@ static void Close(vlc_object_t *p_this)
     bo_t *moov = BuildMoov(p_mux);
 
     /* Check we need to create "fast start" files */
+    uint64_t i_shift = 0, i_free = 0;
     p_sys->b_fast_start = var_GetBool(p_this, SOUT_CFG_PREFIX "faststart");
-    while (p_sys->b_fast_start && moov && moov->b) {
-        /* Move data to the end of the file so we can fit the moov header
-         * at the start */
-        int64_t i_size = p_sys->i_pos - p_sys->i_mdat_pos;
-        int i_moov_size = moov->b->i_buffer;
-
-        while (i_size > 0) {
-            int64_t i_chunk = __MIN(32768, i_size);
-            block_t *p_buf = block_Alloc(i_chunk);
-            sout_AccessOutSeek(p_mux->p_access,
-                                p_sys->i_mdat_pos + i_size - i_chunk);
-            if (sout_AccessOutRead(p_mux->p_access, p_buf) < i_chunk) {
-                msg_Warn(p_this, "read() not supported by access output, "
-                          "won't create a fast start file");
+    if (p_sys->b_fast_start && moov && moov->b) {
+        /* The moov box goes after the file header, in the space reserved
+         * in Open(), followed by a free box for what it does not fill */
+        uint64_t i_avail = p_sys->i_mdat_pos - p_sys->i_moov_start;
+        uint64_t i_moov_size = moov->b->i_buffer;
+
+        if (i_moov_size != i_avail && i_moov_size + 8 > i_avail) {
+            /* Not enough room: move the data up, preferably without
+             * copying it through here. Inserting at the (block aligned)
+             * start of the file also moves the header, rewritten below. */
+            bool b_intact = true;
+
+            i_shift = (i_moov_size + 8 - i_avail + 0xFFFF) & ~UINT64_C(0xFFFF);
+            if (sout_AccessOutControl(p_mux->p_access, ACCESS_OUT_INSERT_RANGE,
+                                      (uint64_t)0, i_shift, &b_intact) == VLC_SUCCESS) {
+                msg_Dbg(p_mux, "inserted %"PRIu64" bytes for the moov box",
+                        i_shift);
+                if (p_sys->p_header) {
+                    sout_AccessOutSeek(p_mux->p_access, 0);
+                    sout_AccessOutWrite(p_mux->p_access,
+                                        block_Duplicate(p_sys->p_header));
+                }
+            } else if (!b_intact) {
+                /* The data is partly moved: do not move it again */
+                msg_Err(p_mux, "media data lost, won't create a fast start file");
                 p_sys->b_fast_start = false;
-                block_Release(p_buf);
-                break;
+            } else {
+                i_shift = (i_moov_size > i_avail) ? i_moov_size - i_avail
+                                                  : i_moov_size + 8 - i_avail;
+                p_sys->b_fast_start = MoveData(p_mux, i_shift);
             }
-            sout_AccessOutSeek(p_mux->p_access, p_sys->i_mdat_pos + i_size +
-                                i_moov_size - i_chunk);
-            sout_AccessOutWrite(p_mux->p_access, p_buf);
-            i_size -= i_chunk;
         }
+    }
 
-        if (!p_sys->b_fast_start)
-            break;
-
+    if (p_sys->b_fast_start && moov && moov->b) {
         /* Update pos pointers */
-        i_moov_pos = p_sys->i_mdat_pos;
-        p_sys->i_mdat_pos += moov->b->i_buffer;
+        i_moov_pos = p_sys->i_moov_start;
+        p_sys->i_mdat_pos += i_shift;
+        i_free = p_sys->i_mdat_pos - i_moov_pos - moov->b->i_buffer;
 
         /* Fix-up samples to chunks table in MOOV header */
-        for (unsigned int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++) {
+        for (unsigned int i_trak = 0; i_shift && i_trak < p_sys->i_nb_streams; i_trak++) {
             mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
             unsigned i_written = 0;
             for (unsigned i = 0; i < p_stream->mux.i_entry_count; ) {
                 mp4mux_entry_t *entry = p_stream->mux.entry;
                 if (b_stco64)
-                    bo_set_64be(moov, p_stream->mux.i_stco_pos + i_written++ * 8, entry[i].i_pos + p_sys->i_mdat_pos - i_moov_pos);
+                    bo_set_64be(moov, p_stream->mux.i_stco_pos + i_written++ * 8, entry[i].i_pos + i_shift);
                 else
-                    bo_set_32be(moov, p_stream->mux.i_stco_pos + i_written++ * 4, entry[i].i_pos + p_sys->i_mdat_pos - i_moov_pos);
+                    bo_set_32be(moov, p_stream->mux.i_stco_pos + i_written++ * 4, entry[i].i_pos + i_shift);
 
                 for (; i < p_stream->mux.i_entry_count; i++)
                     if (i >= p_stream->mux.i_entry_count - 1 ||
@@ -348,6 +447,11 @@ static void Close(vlc_object_t *p_this)
     sout_AccessOutSeek(p_mux->p_access, i_moov_pos);
     if (moov != NULL)
         box_send(p_mux, moov);
+    if (i_free > 0) {
+        block_t *p_free = FreeBox(i_free);
+        if (p_free)
+            sout_AccessOutWrite(p_mux->p_access, p_free);
+    }
 
 cleanup:
     /* Clean-up */
@@ -358,6 +462,8 @@ cleanup:
     }
     if (p_sys->i_nb_streams)
         free(p_sys->pp_streams);
+    if (p_sys->p_header)
+        block_Release(p_sys->p_header);
     free(p_sys);
 }
 
@@ -366,7 +472,6 @@ cleanup:
  *****************************************************************************/
 static int Control(sout_mux_t *p_mux, int i_query, va_list args)
 {
-    VLC_UNUSED(p_mux);
     bool *pb_bool;
 
     switch(i_query)
@@ -381,7 +486,14 @@ static int Control(sout_mux_t *p_mux, int i_query, va_list args)
         *pb_bool = true;
         return VLC_SUCCESS;
 
-    case MUX_GET_MIME:   /* Not needed, as not streamable */
+    case MUX_GET_MIME:
+        if (p_mux->p_sys->b_segmented)
+        {
+            char **ppsz = va_arg(args, char **);
+            *ppsz = strdup("video/mp4");
+            return VLC_SUCCESS;
+        }
+        /* Not needed, as not streamable */
     default:
         return VLC_EGENERIC;
     }
@@ -784,6 +896,18 @@ static void box_send(sout_mux_t *p_mux,  bo_t *box)
     free(box);
 }
 
+static block_t *FreeBox(size_t i_size)
+{
+    assert(i_size >= 8 && i_size <= UINT32_MAX);
+    block_t *p_free = block_Alloc(i_size);
+    if (p_free) {
+        memset(p_free->p_buffer, 0, i_size);
+        SetDWBE(p_free->p_buffer, i_size);
+        memcpy(&p_free->p_buffer[4], "free", 4);
+    }
+    return p_free;
+}
+
 /***************************************************************************
     MP4 Live submodule
 ****************************************************************************/
@@ -877,6 +1001,7 @@ static bo_t *GetMoofBox(sout_mux_t *p_mux, size_t *pi_mdat_total_size,
         mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
 
         /* *** add /moof/traf *** */
+        p_stream->i_trun_fixup = 0;
         bo_t *traf = box_new("traf");
         if(!traf)
             continue;
@@ -917,6 +1042,10 @@ static bo_t *GetMoofBox(sout_mux_t *p_mux, size_t *pi_mdat_total_size,
             i_tfhd_flags |= MP4_TFHD_DURATION_IS_EMPTY;
         }
 
+        /* CMAF fragments are self-contained: each run has its own offset */
+        if (p_sys->b_segmented)
+            i_tfhd_flags |= MP4_TFHD_DEFAULT_BASE_IS_MOOF;
+
         /* *** add /moof/traf/tfhd *** */
         bo_t *tfhd = box_full_new("tfhd", 0, i_tfhd_flags);
         if(!tfhd)
@@ -965,7 +1094,7 @@ static bo_t *GetMoofBox(sout_mux_t *p_mux, size_t *pi_mdat_total_size,
             if (p_stream->mux.b_hasbframes)
                 i_trun_flags |= MP4_TRUN_SAMPLE_TIME_OFFSET;
 
-            if (i_fixupoffset == 0)
+            if (i_fixupoffset == 0 || p_sys->b_segmented)
                 i_trun_flags |= MP4_TRUN_DATA_OFFSET;
 
             bo_t *trun = box_full_new("trun", 0, i_trun_flags);
@@ -992,6 +1121,8 @@ static bo_t *GetMoofBox(sout_mux_t *p_mux, size_t *pi_mdat_total_size,
             if (i_trun_flags & MP4_TRUN_DATA_OFFSET)
             {
                 i_fixupoffset = moof->b->i_buffer + traf->b->i_buffer + trun->b->i_buffer;
+                p_stream->i_trun_fixup = i_fixupoffset;
+                p_stream->i_trun_data = *pi_mdat_total_size;
                 bo_add_32be(trun, 0xdeadbeef); // data offset
             }
 
@@ -1050,10 +1181,13 @@ static bo_t *GetMoofBox(sout_mux_t *p_mux, size_t *pi_mdat_total_size,
     box_fix(moof, moof->b->i_buffer);
 
     /* do tfhd base data offset fixup */
-    if (i_fixupoffset)
+    for (unsigned int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++)
     {
+        const mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
         /* mdat will follow moof */
-        bo_set_32be(moof, i_fixupoffset, moof->b->i_buffer + 8);
+        if (p_stream->i_trun_fixup)
+            bo_set_32be(moof, p_stream->i_trun_fixup,
+                        moof->b->i_buffer + 8 + p_stream->i_trun_data);
     }
 
     /* set iframe flag, so the streaming server always starts from moof */
@@ -1163,7 +1297,14 @@ static void FlushHeader(sout_mux_t *p_mux)
     sout_mux_sys_t *p_sys = (sout_mux_sys_t*) p_mux->p_sys;
 
     /* Now add ftyp header */
-    bo_t *ftyp = mp4mux_GetFtyp(MAJOR_isom, 0, NULL, 0);
+    bo_t *ftyp;
+    if (p_sys->b_segmented)
+    {
+        vlc_fourcc_t extra[] = {MAJOR_cmfc, MAJOR_iso6, MAJOR_isom};
+        ftyp = mp4mux_GetFtyp(MAJOR_cmfc, 0, extra, ARRAY_SIZE(extra));
+    }
+    else
+        ftyp = mp4mux_GetFtyp(MAJOR_isom, 0, NULL, 0);
     if(!ftyp)
         return;
 
@@ -1175,6 +1316,12 @@ static void FlushHeader(sout_mux_t *p_mux)
     /* add header flag for streaming server */
     ftyp->b->i_flags |= BLOCK_FLAG_HEADER;
     p_sys->i_pos += ftyp->b->i_buffer;
+
+    if (p_sys->b_segmented)
+    {
+        const sout_segment_t init = { .i_flags = SOUT_SEGMENT_INIT };
+        sout_AccessOutControl(p_mux->p_access, ACCESS_OUT_SEGMENT, &init);
+    }
     box_send(p_mux, ftyp);
     p_sys->b_header_sent = true;
 }
@@ -1186,6 +1333,8 @@ static int OpenFrag(vlc_object_t *p_this)
     if (!p_sys)
         return VLC_ENOMEM;
 
+    config_ChainParse(p_mux, SOUT_CFG_PREFIX, ppsz_frag_options, p_mux->p_cfg);
+
     p_mux->p_sys = (sout_mux_sys_t *) p_sys;
     p_mux->pf_control   = Control;
     p_mux->pf_addstream = AddStream;
@@ -1209,17 +1358,93 @@ static int OpenFrag(vlc_object_t *p_this)
     p_sys->b_fragmented  = true;
     p_sys->i_start_dts = VLC_TS_INVALID;
     p_sys->i_mfhd_sequence = 1;
+    p_sys->i_fragment_length = FRAGMENT_LENGTH;
+
+    /* CMAF segmenter: an init segment, then segments starting on keyframes,
+     * made of one or more fragments (chunks) */
+    p_sys->b_segmented = p_mux->psz_mux && !strcmp(p_mux->psz_mux, "cmaf");
+    p_sys->b_segment_new = true;
+    p_sys->i_segment_start = 0;
+    p_sys->i_segment_cut = 0;
+    p_sys->i_segment_sequence = 0;
+    p_sys->i_segment_length = 0;
+    if (p_sys->b_segmented)
+    {
+        mtime_t i_chunk = var_GetInteger(p_mux, SOUT_CFG_PREFIX "chunk-duration");
+        p_sys->i_segment_length = CLOCK_FREQ / 1000 *
+                var_GetInteger(p_mux, SOUT_CFG_PREFIX "segment-duration");
+        p_sys->i_fragment_length = i_chunk > 0 ? CLOCK_FREQ / 1000 * i_chunk
+                                               : p_sys->i_segment_length;
+        msg_Dbg(p_mux, "segments of %"PRId64" ms, chunks of %"PRId64" ms",
+                p_sys->i_segment_length * 1000 / CLOCK_FREQ,
+                p_sys->i_fragment_length * 1000 / CLOCK_FREQ);
+    }
 
     return VLC_SUCCESS;
 }
 
+/* Announces the fragment about to be written to the access output */
+static void AnnounceSegment(sout_mux_t *p_mux)
+{
+    sout_mux_sys_t *p_sys = (sout_mux_sys_t*) p_mux->p_sys;
+    sout_segment_t segment = { .i_flags = 0 };
+    mtime_t i_end = 0;
+
+    segment.i_start = INT64_MAX;
+    for (unsigned int i = 0; i < p_sys->i_nb_streams; i++)
+    {
+        const mp4_stream_t *p_stream = p_sys->pp_streams[i];
+        if (!p_stream->towrite.p_first)
+            continue;
+
+        mtime_t i_stream_end = p_stream->i_written_duration;
+        for (const mp4_fragentry_t *p_entry = p_stream->towrite.p_first;
+             p_entry; p_entry = p_entry->p_next)
+            i_stream_end += p_entry->p_block->i_length;
+
+        segment.i_start = __MIN(segment.i_start, p_stream->i_written_duration);
+        i_end = __MAX(i_end, i_stream_end);
+    }
+
+    if (p_sys->b_segment_new)
+    {
+        segment.i_flags |= SOUT_SEGMENT_START;
+        p_sys->i_segment_sequence++;
+    }
+    segment.i_sequence = p_sys->i_segment_sequence;
+    segment.i_length = i_end - segment.i_start;
+
+    sout_AccessOutControl(p_mux->p_access, ACCESS_OUT_SEGMENT, &segment);
+}
+
+static bo_t *GetStypBox(void)
+{
+    bo_t *styp = box_new("styp");
+    if (styp)
+    {
+        vlc_fourcc_t brands[] = {MAJOR_msdh, MAJOR_msdh, MAJOR_cmfs};
+        bo_add_fourcc(styp, &brands[0]);
+        bo_add_32be  (styp, 0);
+        for (size_t i = 1; i < ARRAY_SIZE(brands); i++)
+            bo_add_fourcc(styp, &brands[i]);
+        if (!styp->b)
+        {
+            free(styp);
+            return NULL;
+        }
+        box_fix(styp, styp->b->i_buffer);
+    }
+    return styp;
+}
+
 static void WriteFragments(sout_mux_t *p_mux, bool b_flush)
 {
     sout_mux_sys_t *p_sys = (sout_mux_sys_t*) p_mux->p_sys;
     bo_t *moof = NULL;
-    mtime_t i_barrier_time = p_sys->i_written_duration + FRAGMENT_LENGTH;
+    mtime_t i_barrier_time = p_sys->i_written_duration + p_sys->i_fragment_length;
     size_t i_mdat_size = 0;
     bool b_has_samples = false;
+    bool b_segment_end = false;
 
     if(!p_sys->b_header_sent)
     {
@@ -1239,7 +1464,7 @@ static void WriteFragments(sout_mux_t *p_mux, bool b_flush)
             b_has_samples = true;
 
             /* set a barrier so we try to align to keyframe */
-            if (p_stream->b_hasiframes &&
+            if (!p_sys->b_segmented && p_stream->b_hasiframes &&
                     p_stream->i_last_iframe_time > p_stream->i_written_duration &&
                     (p_stream->mux.fmt.i_cat == VIDEO_ES ||
                      p_stream->mux.fmt.i_cat == AUDIO_ES) )
@@ -1249,6 +1474,23 @@ static void WriteFragments(sout_mux_t *p_mux, bool b_flush)
         }
     }
 
+    /* the previous fragment ended right on the segment boundary */
+    if (p_sys->b_segmented && p_sys->i_segment_cut &&
+        p_sys->i_segment_cut <= p_sys->i_written_duration)
+    {
+        p_sys->b_segment_new = true;
+        p_sys->i_segment_start = p_sys->i_segment_cut;
+        p_sys->i_segment_cut = 0;
+    }
+
+    /* segments end right before their closing keyframe */
+    if (p_sys->b_segmented && p_sys->i_segment_cut > p_sys->i_written_duration &&
+        p_sys->i_segment_cut <= i_barrier_time)
+    {
+        i_barrier_time = p_sys->i_segment_cut;
+        b_segment_end = true;
+    }
+
     if (!p_sys->b_header_sent)
         FlushHeader(p_mux);
 
@@ -1261,15 +1503,42 @@ static void WriteFragments(sout_mux_t *p_mux, bool b_flush)
         FREENULL(moof);
     }
 
+    if (moof && p_sys->b_segmented)
+    {
+        AnnounceSegment(p_mux);
+        if (p_sys->b_segment_new)
+        {
+            /* http clients start from the segment type box */
+            bo_t *styp = GetStypBox();
+            if (styp)
+            {
+                styp->b->i_flags |= BLOCK_FLAG_TYPE_I;
+                p_sys->i_pos += styp->b->i_buffer;
+                box_send(p_mux, styp);
+                moof->b->i_flags &= ~BLOCK_FLAG_TYPE_I;
+            }
+            p_sys->b_segment_new = false;
+        }
+        else /* http clients must start from a segment */
+            moof->b->i_flags &= ~BLOCK_FLAG_TYPE_I;
+    }
+
     if (moof)
     {
         msg_Dbg(p_mux, "writing moof @ %"PRId64, p_sys->i_pos);
         p_sys->i_pos += moof->b->i_buffer;
-        assert(moof->b->i_flags & BLOCK_FLAG_TYPE_I); /* http sout */
+        assert(p_sys->b_segmented || (moof->b->i_flags & BLOCK_FLAG_TYPE_I)); /* http sout */
         box_send(p_mux, moof);
         msg_Dbg(p_mux, "writing mdat @ %"PRId64, p_sys->i_pos);
         WriteFragmentMDAT(p_mux, i_mdat_size);
 
+        if (b_segment_end)
+        {
+            p_sys->b_segment_new = true;
+            p_sys->i_segment_start = p_sys->i_segment_cut;
+            p_sys->i_segment_cut = 0;
+        }
+
         /* update iframe point */
         for (unsigned int i = 0; i < p_sys->i_nb_streams; i++)
         {
@@ -1425,7 +1694,16 @@ static int MuxFrag(sout_mux_t *p_mux)
         ENQUEUE_ENTRY(p_stream->read, p_stream->p_held_entry);
         p_stream->p_held_entry = NULL;
 
-        if (p_stream->b_hasiframes && (p_heldblock->i_flags & BLOCK_FLAG_TYPE_I) &&
+        if (p_sys->b_segmented)
+        {
+            /* the first keyframe after the target duration starts the
+             * next segment */
+            if (p_stream->b_hasiframes && (p_heldblock->i_flags & BLOCK_FLAG_TYPE_I) &&
+                p_sys->i_segment_cut == 0 &&
+                p_stream->mux.i_read_duration >= p_sys->i_segment_start + p_sys->i_segment_length)
+                p_sys->i_segment_cut = p_stream->mux.i_read_duration;
+        }
+        else if (p_stream->b_hasiframes && (p_heldblock->i_flags & BLOCK_FLAG_TYPE_I) &&
             p_stream->mux.i_read_duration - p_sys->i_written_duration < FRAGMENT_LENGTH)
         {
             /* Flag the last iframe time, we'll use it as boundary so it will start
@@ -1474,8 +1752,21 @@ static int MuxFrag(sout_mux_t *p_mux)
     p_sys->i_read_duration = i_min_read_duration;
     p_sys->i_written_duration = i_min_written_duration;
 
+    if (p_sys->b_segmented && p_sys->i_segment_cut == 0)
+    {
+        /* without keyframes, every sample is a random access point */
+        bool b_hasiframes = false;
+        for (unsigned int i=0; i<p_sys->i_nb_streams; i++)
+            b_hasiframes |= p_sys->pp_streams[i]->b_hasiframes;
+        if (!b_hasiframes)
+            p_sys->i_segment_cut = p_sys->i_segment_start + p_sys->i_segment_length;
+    }
+
     /* we have prerolled enough to know all streams, and have enough date to create a fragment */
-    if (p_stream->read.p_first && p_sys->i_read_duration - p_sys->i_written_duration >= FRAGMENT_LENGTH)
+    if (p_stream->read.p_first &&
+        (p_sys->i_read_duration - p_sys->i_written_duration >= p_sys->i_fragment_length ||
+         (p_sys->i_segment_cut > p_sys->i_written_duration &&
+          p_sys->i_read_duration >= p_sys->i_segment_cut)))
         WriteFragments(p_mux, false);
 
     return VLC_SUCCESS;
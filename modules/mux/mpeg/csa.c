@@ -27,9 +27,13 @@
 #endif
 
 #include <vlc_common.h>
+#include <vlc_cpu.h>
 
 #include "csa.h"
 
+/* packets scrambled at once by the batch functions */
+#define CSA_BATCH_SIZE 256
+
 struct csa_t
 {
     /* odd and even keys */
@@ -39,22 +43,38 @@ struct csa_t
     uint8_t o_kk[57];
     uint8_t e_kk[57];
 
-    /* cypher state */
+    bool    use_odd;
+};
+
+/* stream cypher state, private to each packet so that a csa_t can be used
+ * by several threads at once */
+typedef struct
+{
     int     A[11];
     int     B[11];
     int     X, Y, Z;
     int     D, E, F;
     int     p, q, r;
-
-    bool    use_odd;
-};
+} csa_stream_t;
 
 static void csa_ComputeKey( uint8_t kk[57], uint8_t ck[8] );
 
-static void csa_StreamCypher( csa_t *c, int b_init, uint8_t *ck, uint8_t *sb, uint8_t *cb );
+/* a packet payload, for the stream cypher */
+typedef struct
+{
+    uint8_t *p_sb;      /* first block, initializing the stream */
+    uint8_t *p_data;    /* data to xor with the stream */
+    int      i_data;
+} csa_lane_t;
+
+static void csa_StreamCypher( csa_stream_t *c, int b_init, const uint8_t *ck, const uint8_t *sb, uint8_t *cb );
+static void csa_StreamXor( const uint8_t ck[8], const csa_lane_t *p_lane );
+static void csa_StreamBatch( const uint8_t ck[8], const csa_lane_t *p_lanes, size_t i_lanes );
 
 static void csa_BlockDecypher( uint8_t kk[57], uint8_t ib[8], uint8_t bd[8] );
 static void csa_BlockCypher( uint8_t kk[57], uint8_t bd[8], uint8_t ib[8] );
+static void csa_DecryptBlocks8( const uint8_t kk[57], const csa_lane_t *p_lanes, size_t i_lanes );
+static void csa_EncryptBlocks8( const uint8_t kk[57], const csa_lane_t *p_lanes, size_t i_lanes );
 
 /*****************************************************************************
  * csa_New:
@@ -136,32 +156,29 @@ int csa_UseKey( vlc_object_t *p_caller, csa_t *c, bool use_odd )
 }
 
 /*****************************************************************************
- * csa_Decrypt:
+ * csa_DecryptSetup: checks the scrambling control and prepares the stream
+ * cypher, returns the block key or NULL if the packet is not scrambled
  *****************************************************************************/
-void csa_Decrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
+static uint8_t *csa_DecryptSetup( csa_t *c, uint8_t *pkt, int i_pkt_size,
+                                  csa_lane_t *p_lane, uint8_t **pp_ck )
 {
-    uint8_t *ck;
     uint8_t *kk;
-
-    uint8_t  ib[8], stream[8], block[8];
-
-    int     i_hdr, i_residue;
-    int     i, j, n;
+    int     i_hdr;
 
     /* transport scrambling control */
     if( (pkt[3]&0x80) == 0 )
     {
         /* not scrambled */
-        return;
+        return NULL;
     }
     if( pkt[3]&0x40 )
     {
-        ck = c->o_ck;
+        *pp_ck = c->o_ck;
         kk = c->o_kk;
     }
     else
     {
-        ck = c->e_ck;
+        *pp_ck = c->e_ck;
         kk = c->e_kk;
     }
 
@@ -175,67 +192,118 @@ void csa_Decrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
         i_hdr += pkt[4] + 1;
     }
 
-    if( 188 - i_hdr < 8 )
-        return;
+    if( 188 - i_hdr < 8 || i_pkt_size < i_hdr )
+        return NULL;
 
-    /* init csa state */
-    csa_StreamCypher( c, 1, ck, &pkt[i_hdr], ib );
+    /* the stream is initialized with the first block, and then xored with
+     * the following ones, or with the residue if there is no full block */
+    p_lane->p_sb = &pkt[i_hdr];
+    if( i_pkt_size - i_hdr >= 8 )
+    {
+        p_lane->p_data = &pkt[i_hdr + 8];
+        p_lane->i_data = i_pkt_size - i_hdr - 8;
+    }
+    else
+    {
+        p_lane->p_data = &pkt[i_hdr];
+        p_lane->i_data = i_pkt_size - i_hdr;
+    }
+    return kk;
+}
 
-    /* */
-    n = (i_pkt_size - i_hdr) / 8;
-    if( n < 0 )
-        return;
- 
-    i_residue = (i_pkt_size - i_hdr) % 8;
+/*****************************************************************************
+ * csa_DecryptBlocks: runs the block decypher, once the stream is removed
+ *****************************************************************************/
+static void csa_DecryptBlocks( uint8_t kk[57], const csa_lane_t *p_lane )
+{
+    uint8_t *pkt = p_lane->p_sb;
+    uint8_t  ib[8], block[8];
+    int      i, j;
+    int      n = ( p_lane->p_data - p_lane->p_sb + p_lane->i_data ) / 8;
+
+    memcpy( ib, pkt, 8 );
     for( i = 1; i < n + 1; i++ )
     {
         csa_BlockDecypher( kk, ib, block );
         if( i != n )
         {
-            csa_StreamCypher( c, 0, ck, NULL, stream );
-            for( j = 0; j < 8; j++ )
-            {
-                /* xor ib with stream */
-                ib[j] = pkt[i_hdr+8*i+j] ^ stream[j];
-            }
+            memcpy( ib, &pkt[8*i], 8 );
         }
         else
         {
             /* last block */
-            for( j = 0; j < 8; j++ )
-            {
-                ib[j] = 0;
-            }
+            memset( ib, 0, 8 );
         }
         /* xor ib with block */
         for( j = 0; j < 8; j++ )
         {
-            pkt[i_hdr+8*(i-1)+j] = ib[j] ^ block[j];
+            pkt[8*(i-1)+j] = ib[j] ^ block[j];
         }
     }
+}
 
-    if( i_residue > 0 )
+/*****************************************************************************
+ * csa_Decrypt:
+ *****************************************************************************/
+void csa_Decrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
+{
+    csa_lane_t lane;
+    uint8_t   *ck;
+    uint8_t   *kk = csa_DecryptSetup( c, pkt, i_pkt_size, &lane, &ck );
+
+    if( kk == NULL )
+        return;
+
+    csa_StreamXor( ck, &lane );
+    csa_DecryptBlocks( kk, &lane );
+}
+
+/*****************************************************************************
+ * csa_DecryptBatch:
+ *****************************************************************************/
+void csa_DecryptBatch( csa_t *c, uint8_t *const *pp_pkts, size_t i_pkts,
+                       int i_pkt_size )
+{
+    /* lanes using the odd key first, and the even key from the end */
+    csa_lane_t lanes[CSA_BATCH_SIZE];
+
+    while( i_pkts > 0 )
     {
-        csa_StreamCypher( c, 0, ck, NULL, stream );
-        for( j = 0; j < i_residue; j++ )
+        size_t i_batch = __MIN( i_pkts, CSA_BATCH_SIZE );
+        size_t i_odd = 0, i_even = CSA_BATCH_SIZE;
+
+        for( size_t i = 0; i < i_batch; i++ )
         {
-            pkt[i_pkt_size - i_residue + j] ^= stream[j];
+            csa_lane_t lane;
+            uint8_t   *ck;
+
+            if( csa_DecryptSetup( c, pp_pkts[i], i_pkt_size, &lane, &ck ) )
+                lanes[ck == c->o_ck ? i_odd++ : --i_even] = lane;
         }
+
+        csa_StreamBatch( c->o_ck, lanes, i_odd );
+        csa_StreamBatch( c->e_ck, &lanes[i_even], CSA_BATCH_SIZE - i_even );
+
+        for( size_t i = 0; i < i_odd; i += 8 )
+            csa_DecryptBlocks8( c->o_kk, &lanes[i], __MIN( i_odd - i, 8 ) );
+        for( size_t i = i_even; i < CSA_BATCH_SIZE; i += 8 )
+            csa_DecryptBlocks8( c->e_kk, &lanes[i],
+                                __MIN( CSA_BATCH_SIZE - i, 8 ) );
+
+        pp_pkts += i_batch;
+        i_pkts -= i_batch;
     }
 }
 
 /*****************************************************************************
- * csa_Encrypt:
+ * csa_EncryptSetup: sets the scrambling control and prepares the stream
+ * cypher, returns the block key or NULL if the packet is left in clear
  *****************************************************************************/
-void csa_Encrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
+static uint8_t *csa_EncryptSetup( csa_t *c, uint8_t *pkt, int i_pkt_size,
+                                  csa_lane_t *p_lane )
 {
-    uint8_t *ck;
     uint8_t *kk;
-
-    int i, j;
-    int i_hdr = 4; /* hdr len */
-    uint8_t  ib[184/8+2][8], stream[8], block[8];
-    int n, i_residue;
+    int      i_hdr;
 
     /* set transport scrambling control */
     pkt[3] |= 0x80;
@@ -243,12 +311,10 @@ void csa_Encrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
     if( c->use_odd )
     {
         pkt[3] |= 0x40;
-        ck = c->o_ck;
         kk = c->o_kk;
     }
     else
     {
-        ck = c->e_ck;
         kk = c->e_kk;
     }
 
@@ -259,51 +325,82 @@ void csa_Encrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
         /* skip adaption field */
         i_hdr += pkt[4] + 1;
     }
-    n = (i_pkt_size - i_hdr) / 8;
-    i_residue = (i_pkt_size - i_hdr) % 8;
 
-    if( n <= 0 )
+    if( i_pkt_size - i_hdr < 8 )
     {
         pkt[3] &= 0x3f;
-        return;
+        return NULL;
     }
 
-    /* */
-    for( i = 0; i < 8; i++ )
-    {
-        ib[n+1][i] = 0;
-    }
-    for( i = n; i  > 0; i-- )
-    {
-        for( j = 0; j < 8; j++ )
-        {
-            block[j] = pkt[i_hdr+8*(i-1)+j] ^ib[i+1][j];
-        }
-        csa_BlockCypher( kk, block, ib[i] );
-    }
+    /* the stream is initialized with the first scrambled block, and xored
+     * with the following ones */
+    p_lane->p_sb = &pkt[i_hdr];
+    p_lane->p_data = &pkt[i_hdr + 8];
+    p_lane->i_data = i_pkt_size - i_hdr - 8;
+    return kk;
+}
 
-    /* init csa state */
-    csa_StreamCypher( c, 1, ck, ib[1], stream );
+/*****************************************************************************
+ * csa_EncryptBlocks: runs the block cypher, before adding the stream
+ *****************************************************************************/
+static void csa_EncryptBlocks( uint8_t kk[57], const csa_lane_t *p_lane )
+{
+    uint8_t *pkt = p_lane->p_sb;
+    uint8_t  block[8];
+    int      i, j;
+    int      n = ( 8 + p_lane->i_data ) / 8;
 
-    for( i = 0; i < 8; i++ )
-    {
-        pkt[i_hdr+i] = ib[1][i];
-    }
-    for( i = 2; i < n+1; i++ )
+    /* chained from the last block, each ib[i] replaces the block i-1 */
+    for( i = n; i > 0; i-- )
     {
-        csa_StreamCypher( c, 0, ck, NULL, stream );
+        uint8_t *ib = &pkt[8*(i-1)];
         for( j = 0; j < 8; j++ )
         {
-            pkt[i_hdr+8*(i-1)+j] = ib[i][j] ^ stream[j];
+            block[j] = ib[j] ^ ( i != n ? ib[8+j] : 0 );
         }
+        csa_BlockCypher( kk, block, ib );
     }
-    if( i_residue > 0 )
+}
+
+/*****************************************************************************
+ * csa_Encrypt:
+ *****************************************************************************/
+void csa_Encrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
+{
+    csa_lane_t lane;
+    uint8_t   *kk = csa_EncryptSetup( c, pkt, i_pkt_size, &lane );
+
+    if( kk == NULL )
+        return;
+
+    csa_EncryptBlocks( kk, &lane );
+    csa_StreamXor( c->use_odd ? c->o_ck : c->e_ck, &lane );
+}
+
+/*****************************************************************************
+ * csa_EncryptBatch:
+ *****************************************************************************/
+void csa_EncryptBatch( csa_t *c, uint8_t *const *pp_pkts, size_t i_pkts,
+                       int i_pkt_size )
+{
+    csa_lane_t lanes[CSA_BATCH_SIZE];
+    uint8_t   *kk = c->use_odd ? c->o_kk : c->e_kk;
+
+    while( i_pkts > 0 )
     {
-        csa_StreamCypher( c, 0, ck, NULL, stream );
-        for( j = 0; j < i_residue; j++ )
-        {
-            pkt[i_pkt_size - i_residue + j] ^= stream[j];
-        }
+        size_t i_batch = __MIN( i_pkts, CSA_BATCH_SIZE );
+        size_t i_lanes = 0;
+
+        for( size_t i = 0; i < i_batch; i++ )
+            if( csa_EncryptSetup( c, pp_pkts[i], i_pkt_size, &lanes[i_lanes] ) )
+                i_lanes++;
+
+        for( size_t i = 0; i < i_lanes; i += 8 )
+            csa_EncryptBlocks8( kk, &lanes[i], __MIN( i_lanes - i, 8 ) );
+        csa_StreamBatch( c->use_odd ? c->o_ck : c->e_ck, lanes, i_lanes );
+
+        pp_pkts += i_batch;
+        i_pkts -= i_batch;
     }
 }
 
@@ -374,7 +471,7 @@ static const int sbox5[0x20] = {2,0,0,1,3,2,3,2, 0,1,3,3,1,0,2,1, 2,3,2,0,0,3,1,
 static const int sbox6[0x20] = {0,1,2,3,1,2,2,0, 0,1,3,0,2,3,1,3, 2,3,0,2,3,0,1,1, 2,1,1,2,0,3,3,0};
 static const int sbox7[0x20] = {0,3,2,2,3,0,0,1, 3,0,1,3,1,2,2,1, 1,0,3,3,0,1,1,2, 2,3,1,0,2,3,0,2};
 
-static void csa_StreamCypher( csa_t *c, int b_init, uint8_t *ck, uint8_t *sb, uint8_t *cb )
+static void csa_StreamCypher( csa_stream_t *c, int b_init, const uint8_t *ck, const uint8_t *sb, uint8_t *cb )
 {
     int i,j, k;
     int extra_B;
@@ -610,3 +707,268 @@ static void csa_BlockCypher( uint8_t kk[57], uint8_t bd[8], uint8_t ib[8] )
     }
 }
 
+/*****************************************************************************
+ * Block cypher on batches of packets
+ *****************************************************************************/
+/* The blocks of 8 packets are processed at once, byte-sliced: byte k of the
+ * block of lane l is the byte l of R[k+1] */
+#define BYTES(x) ( UINT64_C(0x0101010101010101) * (x) )
+
+static uint64_t csa_BlockSbox8( uint64_t x )
+{
+    uint64_t sbox_out = 0;
+
+    for( unsigned l = 0; l < 64; l += 8 )
+        sbox_out |= (uint64_t)block_sbox[(x >> l) & 0xff] << l;
+    return sbox_out;
+}
+
+/* block_perm of each byte */
+static uint64_t csa_BlockPerm8( uint64_t x )
+{
+    return ( ( x & BYTES(0x29) ) << 1 ) | ( ( x & BYTES(0x02) ) << 6 ) |
+           ( ( x & BYTES(0x04) ) << 3 ) | ( ( x & BYTES(0x10) ) >> 2 ) |
+           ( ( x & BYTES(0x40) ) >> 6 ) | ( ( x & BYTES(0x80) ) >> 4 );
+}
+
+static void csa_BlockDecypher8( const uint8_t kk[57], uint64_t R[9] )
+{
+    uint64_t R1 = R[1], R2 = R[2], R3 = R[3], R4 = R[4];
+    uint64_t R5 = R[5], R6 = R[6], R7 = R[7], R8 = R[8];
+
+    for( int i = 56; i > 0; i-- )
+    {
+        const uint64_t sbox_out = csa_BlockSbox8( R7 ^ BYTES(kk[i]) );
+        const uint64_t perm_out = csa_BlockPerm8( sbox_out );
+        const uint64_t next_R8 = R7;
+
+        R7 = R6 ^ perm_out;
+        R6 = R5;
+        R5 = R4 ^ R8 ^ sbox_out;
+        R4 = R3 ^ R8 ^ sbox_out;
+        R3 = R2 ^ R8 ^ sbox_out;
+        R2 = R1;
+        R1 = R8 ^ sbox_out;
+        R8 = next_R8;
+    }
+
+    R[1] = R1; R[2] = R2; R[3] = R3; R[4] = R4;
+    R[5] = R5; R[6] = R6; R[7] = R7; R[8] = R8;
+}
+
+static void csa_BlockCypher8( const uint8_t kk[57], uint64_t R[9] )
+{
+    uint64_t R1 = R[1], R2 = R[2], R3 = R[3], R4 = R[4];
+    uint64_t R5 = R[5], R6 = R[6], R7 = R[7], R8 = R[8];
+
+    for( int i = 1; i <= 56; i++ )
+    {
+        const uint64_t sbox_out = csa_BlockSbox8( R8 ^ BYTES(kk[i]) );
+        const uint64_t perm_out = csa_BlockPerm8( sbox_out );
+        const uint64_t next_R1 = R2;
+
+        R2 = R3 ^ R1;
+        R3 = R4 ^ R1;
+        R4 = R5 ^ R1;
+        R5 = R6;
+        R6 = R7 ^ perm_out;
+        R7 = R8;
+        R8 = R1 ^ sbox_out;
+        R1 = next_R1;
+    }
+
+    R[1] = R1; R[2] = R2; R[3] = R3; R[4] = R4;
+    R[5] = R5; R[6] = R6; R[7] = R7; R[8] = R8;
+}
+
+#undef BYTES
+
+/* Same as csa_DecryptBlocks() on up to 8 lanes. The blocks do not depend on
+ * each other when decrypting: out[i-1] = decypher(in[i-1]) ^ in[i] */
+static void csa_DecryptBlocks8( const uint8_t kk[57], const csa_lane_t *p_lanes,
+                                size_t i_lanes )
+{
+    int n[8], i_max = 0;
+
+    for( size_t l = 0; l < i_lanes; l++ )
+    {
+        n[l] = ( p_lanes[l].p_data - p_lanes[l].p_sb + p_lanes[l].i_data ) / 8;
+        i_max = __MAX( i_max, n[l] );
+    }
+
+    for( int i = 1; i <= i_max; i++ )
+    {
+        uint64_t R[9] = { 0 };
+
+        for( size_t l = 0; l < i_lanes; l++ )
+            if( i <= n[l] )
+                for( unsigned k = 0; k < 8; k++ )
+                    R[k+1] |= (uint64_t)p_lanes[l].p_sb[8*(i-1)+k] << (8 * l);
+
+        csa_BlockDecypher8( kk, R );
+
+        for( size_t l = 0; l < i_lanes; l++ )
+        {
+            if( i > n[l] )
+                continue;
+            uint8_t *ib = &p_lanes[l].p_sb[8*(i-1)];
+            for( unsigned k = 0; k < 8; k++ )
+                ib[k] = ( R[k+1] >> (8 * l) ) ^ ( i != n[l] ? ib[8+k] : 0 );
+        }
+    }
+}
+
+/* Same as csa_EncryptBlocks() on up to 8 lanes, the lanes being aligned on
+ * their last block */
+static void csa_EncryptBlocks8( const uint8_t kk[57], const csa_lane_t *p_lanes,
+                                size_t i_lanes )
+{
+    int n[8], i_max = 0;
+
+    for( size_t l = 0; l < i_lanes; l++ )
+    {
+        n[l] = ( 8 + p_lanes[l].i_data ) / 8;
+        i_max = __MAX( i_max, n[l] );
+    }
+
+    for( int t = 0; t < i_max; t++ )
+    {
+        uint64_t R[9] = { 0 };
+
+        for( size_t l = 0; l < i_lanes; l++ )
+        {
+            const int i = n[l] - t;
+            if( i < 1 )
+                continue;
+            const uint8_t *ib = &p_lanes[l].p_sb[8*(i-1)];
+            for( unsigned k = 0; k < 8; k++ )
+                R[k+1] |= (uint64_t)( ib[k] ^ ( i != n[l] ? ib[8+k] : 0 ) )
+                          << (8 * l);
+        }
+
+        csa_BlockCypher8( kk, R );
+
+        for( size_t l = 0; l < i_lanes; l++ )
+        {
+            const int i = n[l] - t;
+            if( i < 1 )
+                continue;
+            for( unsigned k = 0; k < 8; k++ )
+                p_lanes[l].p_sb[8*(i-1)+k] = R[k+1] >> (8 * l);
+        }
+    }
+}
+
+/*****************************************************************************
+ * Stream cypher on batches of packets
+ *****************************************************************************/
+static void csa_StreamXor( const uint8_t ck[8], const csa_lane_t *p_lane )
+{
+    csa_stream_t state;
+    uint8_t      stream[8];
+
+    csa_StreamCypher( &state, 1, ck, p_lane->p_sb, stream );
+    for( int i = 0; i < p_lane->i_data; i += 8 )
+    {
+        csa_StreamCypher( &state, 0, ck, NULL, stream );
+        for( int j = 0; j < 8 && i + j < p_lane->i_data; j++ )
+        {
+            p_lane->p_data[i + j] ^= stream[j];
+        }
+    }
+}
+
+/* swaps bit i of m[j] with bit j of m[i] */
+static void csa_Transpose64( uint64_t m[64] )
+{
+    uint64_t mask = UINT64_C(0x00000000ffffffff);
+
+    for( unsigned j = 32; j != 0; j >>= 1, mask ^= mask << j )
+    {
+        for( unsigned k = 0; k < 64; k = ((k | j) + 1) & ~j )
+        {
+            uint64_t t = ( ( m[k] >> j ) ^ m[k | j] ) & mask;
+            m[k] ^= t << j;
+            m[k | j] ^= t;
+        }
+    }
+}
+
+#define CSA_BS_T            uint64_t
+#define CSA_BS_FUNC(name)   name##_64
+#define CSA_BS_TARGET
+#include "csa_bs.h"
+#undef CSA_BS_TARGET
+#undef CSA_BS_FUNC
+#undef CSA_BS_T
+
+#if defined(CAN_COMPILE_SSE2) || defined(HAVE_SSE2_INTRINSICS)
+typedef uint64_t csa_bs_sse2_t __attribute__ ((vector_size (16)));
+# define CSA_BS_T           csa_bs_sse2_t
+# define CSA_BS_FUNC(name)  name##_sse2
+# define CSA_BS_TARGET      __attribute__ ((__target__ ("sse2")))
+# include "csa_bs.h"
+# undef CSA_BS_TARGET
+# undef CSA_BS_FUNC
+# undef CSA_BS_T
+#endif
+
+#ifdef HAVE_AVX2_INTRINSICS
+typedef uint64_t csa_bs_avx2_t __attribute__ ((vector_size (32)));
+# define CSA_BS_T           csa_bs_avx2_t
+# define CSA_BS_FUNC(name)  name##_avx2
+# define CSA_BS_TARGET      __attribute__ ((__target__ ("avx2")))
+# include "csa_bs.h"
+# undef CSA_BS_TARGET
+# undef CSA_BS_FUNC
+# undef CSA_BS_T
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+typedef uint64_t csa_bs_neon_t __attribute__ ((vector_size (16)));
+# define CSA_BS_T           csa_bs_neon_t
+# define CSA_BS_FUNC(name)  name##_neon
+# define CSA_BS_TARGET
+# include "csa_bs.h"
+# undef CSA_BS_TARGET
+# undef CSA_BS_FUNC
+# undef CSA_BS_T
+#endif
+
+/* The cost of a bitsliced pass does not depend much on the word size:
+ * use the narrowest one fitting the lanes, or the widest one */
+static void csa_StreamBatch( const uint8_t ck[8], const csa_lane_t *p_lanes,
+                             size_t i_lanes )
+{
+    /* the bitsliced cypher only pays off with a few lanes */
+    if( i_lanes < 4 )
+    {
+        for( size_t i = 0; i < i_lanes; i++ )
+            csa_StreamXor( ck, &p_lanes[i] );
+        return;
+    }
+
+    while( i_lanes > 0 )
+    {
+        size_t i_done;
+#ifdef HAVE_AVX2_INTRINSICS
+        if( i_lanes > 128 && vlc_CPU_AVX2() )
+            i_done = csa_bs_StreamXor_avx2( ck, p_lanes, i_lanes );
+        else
+#endif
+#if defined(CAN_COMPILE_SSE2) || defined(HAVE_SSE2_INTRINSICS)
+        if( i_lanes > 64 && vlc_CPU_SSE2() )
+            i_done = csa_bs_StreamXor_sse2( ck, p_lanes, i_lanes );
+        else
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+        if( i_lanes > 64 )
+            i_done = csa_bs_StreamXor_neon( ck, p_lanes, i_lanes );
+        else
+#endif
+            i_done = csa_bs_StreamXor_64( ck, p_lanes, i_lanes );
+
+        p_lanes += i_done;
+        i_lanes -= i_done;
+    }
+}
@@ -31,6 +31,8 @@ typedef struct csa_t csa_t;
 #define csa_UseKey  __csa_UseKey
 #define csa_Decrypt __csa_decrypt
 #define csa_Encrypt __csa_encrypt
+#define csa_DecryptBatch __csa_decrypt_batch
+#define csa_EncryptBatch __csa_encrypt_batch
 
 csa_t *csa_New( void );
 void   csa_Delete( csa_t * );
@@ -38,7 +40,16 @@ void   csa_Delete( csa_t * );
 int    csa_SetCW( vlc_object_t *p_caller, csa_t *c, char *psz_ck, bool odd );
 int    csa_UseKey( vlc_object_t *p_caller, csa_t *, bool use_odd );
 
+/* csa_Decrypt and csa_Encrypt can be called concurrently on the same csa_t,
+ * as long as the keys are not changed meanwhile */
 void   csa_Decrypt( csa_t *, uint8_t *pkt, int i_pkt_size );
 void   csa_Encrypt( csa_t *, uint8_t *pkt, int i_pkt_size );
 
+/* Same as csa_Decrypt/csa_Encrypt on each packet, but much faster on large
+ * batches, as the packets are processed in parallel */
+void   csa_DecryptBatch( csa_t *, uint8_t *const *pp_pkts, size_t i_pkts,
+                         int i_pkt_size );
+void   csa_EncryptBatch( csa_t *, uint8_t *const *pp_pkts, size_t i_pkts,
+                         int i_pkt_size );
+
 #endif /* _CSA_H */
@@ -0,0 +1,285 @@
+/*****************************************************************************
+ * csa_bs.h: bitsliced DVB-CSA stream cypher
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* This file is included by csa.c once per lane word type, with:
+ *  - CSA_BS_T: the word type, which must support the C bitwise operators,
+ *  - CSA_BS_FUNC(name): the decorated name of the functions,
+ *  - CSA_BS_TARGET: the attributes of the functions (may be empty).
+ *
+ * Each bit of a word belongs to a different packet (lane), so that every
+ * operation of csa_StreamCypher() is computed for all the lanes at once.
+ * The 4 bits registers are stored as 4 words, least significant bit first. */
+
+#define CSA_BS_LANES (8 * sizeof(CSA_BS_T))
+
+struct CSA_BS_FUNC(csa_bs_state)
+{
+    CSA_BS_T A[11][4];
+    CSA_BS_T B[11][4];
+    CSA_BS_T X[4], Y[4], Z[4];
+    CSA_BS_T D[4], E[4], F[4];
+    CSA_BS_T p, q, r;
+};
+
+CSA_BS_TARGET
+static inline void CSA_BS_FUNC(csa_bs_Round)( struct CSA_BS_FUNC(csa_bs_state) *s,
+                                              const CSA_BS_T *in_a,
+                                              const CSA_BS_T *in_b )
+{
+    CSA_BS_T sbox[7][2];
+    CSA_BS_T next_A1[4], next_B1[4], extra_B[4];
+
+    /* s-boxes in algebraic normal form, a being the most significant bit of
+     * the index in sbox1..sbox7, and e the least significant one */
+    /* s1 */
+    {
+        const CSA_BS_T a = s->A[4][0], b = s->A[1][2], c = s->A[6][1],
+            d = s->A[7][3], e = s->A[9][0];
+        const CSA_BS_T ab = a & b, ac = a & c, ad = a & d, ae = a & e,
+            bc = b & c, bd = b & d, be = b & e, cd = c & d, ce = c & e,
+            de = d & e, abc = ab & c, abd = ab & d, acd = ac & d, ade = ad & e,
+            bcd = bc & d, bce = bc & e, bde = bd & e, abcd = abc & d,
+            abce = abc & e, abde = abd & e;
+        sbox[0][0] = b ^ d ^ ab ^ ae ^ be ^ ce ^ abc ^ abd ^ bde ^ abce;
+        sbox[0][1] = ~( a ^ d ^ e ^ ab ^ ac ^ bc ^ bd ^ be ^ cd ^ ce ^ de ^
+                       abc ^ abd ^ acd ^ ade ^ bcd ^ bce ^ abcd ^ abde );
+    }
+    /* s2 */
+    {
+        const CSA_BS_T a = s->A[2][1], b = s->A[3][2], c = s->A[6][3],
+            d = s->A[7][0], e = s->A[9][1];
+        const CSA_BS_T ab = a & b, ac = a & c, ad = a & d, bc = b & c,
+            bd = b & d, cd = c & d, ce = c & e, abc = ab & c, abd = ab & d,
+            abe = ab & e, acd = ac & d, ade = ad & e, bce = bc & e,
+            bde = bd & e, cde = cd & e, abce = abc & e, abde = abd & e;
+        sbox[1][0] = ~( c ^ d ^ ab ^ ac ^ ce ^ ade ^ bce ^ bde ^ abce ^ abde );
+        sbox[1][1] = ~( b ^ d ^ e ^ cd ^ ce ^ abc ^ abd ^ abe ^ acd ^ cde ^
+                       abde );
+    }
+    /* s3 */
+    {
+        const CSA_BS_T a = s->A[1][3], b = s->A[2][0], c = s->A[5][1],
+            d = s->A[5][3], e = s->A[6][2];
+        const CSA_BS_T ab = a & b, ac = a & c, ad = a & d, bc = b & c,
+            bd = b & d, be = b & e, cd = c & d, ce = c & e, de = d & e,
+            abc = ab & c, abe = ab & e, acd = ac & d, ace = ac & e,
+            ade = ad & e, bcd = bc & d, bde = bd & e, cde = cd & e,
+            abcd = abc & d, acde = acd & e;
+        sbox[2][0] = a ^ b ^ d ^ ce ^ de;
+        sbox[2][1] = ~( a ^ b ^ d ^ e ^ ac ^ ad ^ bc ^ bd ^ be ^ cd ^ ce ^ abc
+                       ^ abe ^ acd ^ ace ^ ade ^ bcd ^ bde ^ cde ^ abcd ^ acde
+                       );
+    }
+    /* s4 */
+    {
+        const CSA_BS_T a = s->A[3][3], b = s->A[1][1], c = s->A[2][3],
+            d = s->A[4][2], e = s->A[8][0];
+        const CSA_BS_T ab = a & b, ac = a & c, ad = a & d, ae = a & e,
+            bc = b & c, bd = b & d, be = b & e, cd = c & d, de = d & e,
+            abc = ab & c, abd = ab & d, abe = ab & e, acd = ac & d,
+            bcd = bc & d, bde = bd & e, cde = cd & e, abcd = abc & d,
+            abde = abd & e, acde = acd & e;
+        sbox[3][0] = ~( c ^ d ^ ab ^ ad ^ ae ^ bc ^ be ^ de ^ abc ^ abe ^ bde
+                       ^ abcd ^ abde ^ acde );
+        sbox[3][1] = ~( a ^ b ^ c ^ e ^ ab ^ ad ^ ae ^ de ^ abc ^ abe ^ bcd ^
+                       cde ^ abcd ^ abde ^ acde );
+    }
+    /* s5 */
+    {
+        const CSA_BS_T a = s->A[5][2], b = s->A[4][3], c = s->A[6][0],
+            d = s->A[8][1], e = s->A[9][2];
+        const CSA_BS_T ab = a & b, ac = a & c, ad = a & d, ae = a & e,
+            bc = b & c, bd = b & d, be = b & e, cd = c & d, ce = c & e,
+            de = d & e, abc = ab & c, abd = ab & d, abe = ab & e, acd = ac & d,
+            ace = ac & e, bcd = bc & d, bce = bc & e, bde = bd & e,
+            cde = cd & e, abcd = abc & d, abce = abc & e, abde = abd & e,
+            acde = acd & e;
+        sbox[4][0] = c ^ ab ^ ac ^ ae ^ bd ^ be ^ ce ^ de ^ abd ^ abe ^ acd ^
+                     ace ^ bce ^ cde ^ abde ^ acde;
+        sbox[4][1] = ~( b ^ d ^ e ^ ac ^ ad ^ ae ^ be ^ cd ^ ce ^ de ^ abd ^
+                       abe ^ acd ^ bcd ^ bce ^ bde ^ cde ^ abcd ^ abce ^ acde
+                       );
+    }
+    /* s6 */
+    {
+        const CSA_BS_T a = s->A[3][1], b = s->A[4][1], c = s->A[5][0],
+            d = s->A[7][2], e = s->A[9][3];
+        const CSA_BS_T ab = a & b, ac = a & c, ad = a & d, bc = b & c,
+            bd = b & d, cd = c & d, ce = c & e, abc = ab & c, abd = ab & d,
+            abe = ab & e, acd = ac & d, ade = ad & e, bcd = bc & d,
+            bce = bc & e, bde = bd & e, cde = cd & e, abcd = abc & d,
+            abde = abd & e, acde = acd & e;
+        sbox[5][0] = c ^ e ^ bc ^ bd ^ cd ^ acd ^ ade ^ bcd ^ cde ^ abcd ^
+                     abde ^ acde;
+        sbox[5][1] = a ^ d ^ bc ^ ce ^ abe ^ ade ^ bce ^ bde;
+    }
+    /* s7 */
+    {
+        const CSA_BS_T a = s->A[2][2], b = s->A[3][0], c = s->A[7][1],
+            d = s->A[8][2], e = s->A[8][3];
+        const CSA_BS_T ab = a & b, ac = a & c, ad = a & d, ae = a & e,
+            bc = b & c, bd = b & d, cd = c & d, de = d & e, abc = ab & c,
+            abd = ab & d, acd = ac & d, ade = ad & e, bde = bd & e,
+            cde = cd & e, abcd = abc & d, abde = abd & e, acde = acd & e;
+        sbox[6][0] = a ^ b ^ c ^ e ^ bc ^ cd ^ de ^ abd ^ cde ^ abde;
+        sbox[6][1] = b ^ c ^ d ^ e ^ ac ^ ae ^ de ^ acd ^ ade ^ bde ^ abcd ^
+                     abde ^ acde;
+    }
+
+    extra_B[3] = s->B[3][0] ^ s->B[6][1] ^ s->B[7][2] ^ s->B[9][3];
+    extra_B[2] = s->B[6][0] ^ s->B[8][1] ^ s->B[3][3] ^ s->B[4][2];
+    extra_B[1] = s->B[5][3] ^ s->B[8][2] ^ s->B[4][0] ^ s->B[5][1];
+    extra_B[0] = s->B[9][2] ^ s->B[6][3] ^ s->B[3][1] ^ s->B[8][0];
+
+    for( unsigned b = 0; b < 4; b++ )
+    {
+        next_A1[b] = s->A[10][b] ^ s->X[b];
+        next_B1[b] = s->B[7][b] ^ s->B[10][b] ^ s->Y[b];
+        if( in_a != NULL )
+        {
+            next_A1[b] ^= s->D[b] ^ in_a[b];
+            next_B1[b] ^= in_b[b];
+        }
+    }
+
+    /* T4: F = Z + E + r when q, with r the carry */
+    CSA_BS_T carry = s->r;
+    for( unsigned b = 0; b < 4; b++ )
+    {
+        const CSA_BS_T half = s->Z[b] ^ s->E[b];
+        const CSA_BS_T sum = half ^ carry;
+        const CSA_BS_T next_E = s->F[b];
+
+        carry = ( s->Z[b] & s->E[b] ) | ( carry & half );
+        s->F[b] = s->E[b] ^ ( s->q & ( sum ^ s->E[b] ) );
+        s->D[b] = half ^ extra_B[b];
+        s->E[b] = next_E;
+    }
+    s->r ^= s->q & ( carry ^ s->r );
+
+    memmove( s->A[2], s->A[1], 9 * sizeof(s->A[1]) );
+    memmove( s->B[2], s->B[1], 9 * sizeof(s->B[1]) );
+    for( unsigned b = 0; b < 4; b++ )
+    {
+        s->A[1][b] = next_A1[b];
+        /* rotate left when p */
+        s->B[1][b] = next_B1[b] ^ ( s->p & ( next_B1[b] ^ next_B1[(b + 3) & 3] ) );
+    }
+
+    s->X[3] = sbox[3][0]; s->X[2] = sbox[2][0];
+    s->X[1] = sbox[1][1]; s->X[0] = sbox[0][1];
+    s->Y[3] = sbox[5][0]; s->Y[2] = sbox[4][0];
+    s->Y[1] = sbox[3][1]; s->Y[0] = sbox[2][1];
+    s->Z[3] = sbox[1][0]; s->Z[2] = sbox[0][0];
+    s->Z[1] = sbox[5][1]; s->Z[0] = sbox[4][1];
+    s->p = sbox[6][1];
+    s->q = sbox[6][0];
+}
+
+/**
+ * Xors the data of up to CSA_BS_LANES lanes with their stream.
+ * \return the number of lanes processed
+ */
+CSA_BS_TARGET
+static size_t CSA_BS_FUNC(csa_bs_StreamXor)( const uint8_t ck[8],
+                                              const csa_lane_t *p_lanes,
+                                              size_t i_lanes )
+{
+    struct CSA_BS_FUNC(csa_bs_state) s;
+    const CSA_BS_T zero = { 0 };
+    CSA_BS_T io[64]; /* bit b of byte i is in io[8*i+b] */
+    uint64_t m[64];
+    int i_data = 0;
+
+    if( i_lanes > CSA_BS_LANES )
+        i_lanes = CSA_BS_LANES;
+
+    for( size_t g = 0; g < CSA_BS_LANES / 64; g++ )
+    {
+        for( size_t l = 0; l < 64; l++ )
+        {
+            const size_t i_lane = 64 * g + l;
+            m[l] = i_lane < i_lanes ? GetQWLE( p_lanes[i_lane].p_sb ) : 0;
+            if( i_lane < i_lanes && p_lanes[i_lane].i_data > i_data )
+                i_data = p_lanes[i_lane].i_data;
+        }
+        csa_Transpose64( m );
+        for( unsigned w = 0; w < 64; w++ )
+            ((uint64_t *)&io[w])[g] = m[w];
+    }
+
+    /* load the key, all other registers are 0 */
+    memset( &s, 0, sizeof(s) );
+    for( unsigned i = 0; i < 4; i++ )
+    {
+        for( unsigned b = 0; b < 4; b++ )
+        {
+            s.A[1+2*i][b] = ( ck[i] >> (4 + b) ) & 1 ? ~zero : zero;
+            s.A[2+2*i][b] = ( ck[i] >> b ) & 1 ? ~zero : zero;
+            s.B[1+2*i][b] = ( ck[4+i] >> (4 + b) ) & 1 ? ~zero : zero;
+            s.B[2+2*i][b] = ( ck[4+i] >> b ) & 1 ? ~zero : zero;
+        }
+    }
+
+    /* initialization with the first block */
+    for( unsigned i = 0; i < 8; i++ )
+    {
+        for( unsigned j = 0; j < 4; j++ )
+        {
+            const CSA_BS_T *in1 = &io[8*i+4], *in2 = &io[8*i];
+            if( j % 2 )
+                CSA_BS_FUNC(csa_bs_Round)( &s, in2, in1 );
+            else
+                CSA_BS_FUNC(csa_bs_Round)( &s, in1, in2 );
+        }
+    }
+
+    for( int i_pos = 0; i_pos < i_data; i_pos += 8 )
+    {
+        /* 2 bits per round, most significant first */
+        for( unsigned i = 0; i < 8; i++ )
+        {
+            for( unsigned j = 0; j < 4; j++ )
+            {
+                CSA_BS_FUNC(csa_bs_Round)( &s, NULL, NULL );
+                io[8*i+7-2*j] = s.D[2] ^ s.D[3];
+                io[8*i+6-2*j] = s.D[0] ^ s.D[1];
+            }
+        }
+
+        for( size_t g = 0; 64 * g < i_lanes; g++ )
+        {
+            for( unsigned w = 0; w < 64; w++ )
+                m[w] = ((const uint64_t *)&io[w])[g];
+            csa_Transpose64( m );
+
+            for( size_t l = 0; l < 64 && 64 * g + l < i_lanes; l++ )
+            {
+                const csa_lane_t *p_lane = &p_lanes[64 * g + l];
+                for( int j = 0; j < 8 && i_pos + j < p_lane->i_data; j++ )
+                    p_lane->p_data[i_pos + j] ^= m[l] >> (8 * j);
+            }
+        }
+    }
+
+    return i_lanes;
+}
+
+#undef CSA_BS_LANES
@@ -40,6 +40,7 @@
 #include <vlc_block.h>
 #include <vlc_rand.h>
 #include <vlc_charset.h>
+#include <vlc_cpu.h>
 
 #include <vlc_iso_lang.h>
 
@@ -148,6 +149,14 @@ static const char *const ts_standards_list_text[] =
   "of the shaping algorithm, since I frames are usually the biggest " \
   "frames in the stream.")
 
+#define MUXRATE_TEXT N_("Constant mux rate (bits/s)")
+#define MUXRATE_LONGTEXT N_("If not 0, the TS is output at this constant " \
+  "bitrate: every packet is sent at its own slot, the unused slots are " \
+  "stuffed with null packets, and the PCRs are stamped with the dates of " \
+  "their slots. The data waiting for their slots are bounded by the " \
+  "shaping duration, past which packets are dropped: the mux rate must be " \
+  "above the peak bitrate of the streams over that duration.")
+
 #define PCR_TEXT N_("PCR interval (ms)")
 #define PCR_LONGTEXT N_("Set at which interval " \
   "PCRs (Program Clock Reference) will be sent (in milliseconds). " \
@@ -182,6 +191,11 @@ static const char *const ts_standards_list_text[] =
 #define CU_LONGTEXT N_("CSA encryption key used. It can be the odd/first/1 " \
   "(default) or the even/second/2 one.")
 
+#define THREADS_TEXT N_("Threads")
+#define THREADS_LONGTEXT N_("Number of threads used to fill and scramble " \
+  "the TS packets. 0 means one per CPU when scrambling, and a single " \
+  "thread otherwise.")
+
 #define CPKT_TEXT N_("Packet size in bytes to encrypt")
 #define CPKT_LONGTEXT N_("Size of the TS packet to encrypt. " \
     "The encryption routines subtract the TS-header from the value before " \
@@ -224,6 +238,7 @@ vlc_module_begin ()
 
     add_integer(SOUT_CFG_PREFIX "shaping", 200, SHAPING_TEXT, SHAPING_LONGTEXT, true)
     add_bool(SOUT_CFG_PREFIX "use-key-frames", false, KEYF_TEXT, KEYF_LONGTEXT, true)
+    add_integer(SOUT_CFG_PREFIX "muxrate", 0, MUXRATE_TEXT, MUXRATE_LONGTEXT, true)
 
     add_integer( SOUT_CFG_PREFIX "pcr", 70, PCR_TEXT, PCR_LONGTEXT, true)
     add_integer( SOUT_CFG_PREFIX "bmin", 0, BMIN_TEXT, BMIN_LONGTEXT, true)
@@ -237,6 +252,8 @@ vlc_module_begin ()
     add_string( SOUT_CFG_PREFIX "csa-use", "1",  CU_TEXT,   CU_LONGTEXT,   true)
     add_integer(SOUT_CFG_PREFIX "csa-pkt", 188,  CPKT_TEXT, CPKT_LONGTEXT, true)
 
+    add_integer(SOUT_CFG_PREFIX "threads", 0, THREADS_TEXT, THREADS_LONGTEXT, true)
+
     set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -247,9 +264,9 @@ static const char *const ppsz_sout_options[] = {
     "standard",
     "pid-video", "pid-audio", "pid-spu", "pid-pmt", "tsid",
     "netid", "sdtdesc",
-    "es-id-pid", "shaping", "pcr", "bmin", "bmax", "use-key-frames",
+    "es-id-pid", "shaping", "pcr", "bmin", "bmax", "use-key-frames", "muxrate",
     "dts-delay", "csa-ck", "csa2-ck", "csa-use", "csa-pkt", "crypt-audio", "crypt-video",
-    "muxpmt", "program-pmt", "alignment",
+    "muxpmt", "program-pmt", "alignment", "threads",
     NULL
 };
 
@@ -340,6 +357,37 @@ typedef struct
     pes_state_t  state;
 } sout_input_sys_t;
 
+/* The TS packet headers are written while interleaving, the payload copy and
+ * the scrambling are deferred, and run on the worker threads */
+typedef struct
+{
+    block_t         *p_ts;
+    const uint8_t   *p_payload;
+    int             i_payload;
+} ts_job_t;
+
+typedef struct
+{
+    /* filled by the muxer thread only */
+    ts_job_t        *p_jobs;
+    size_t          i_jobs;
+    size_t          i_alloc;
+    sout_buffer_chain_t chain_done; /* consumed PES, until the copy is done */
+
+    vlc_thread_t    *p_threads;
+    unsigned        i_threads;
+
+    /* protected by lock */
+    vlc_mutex_t     lock;
+    vlc_cond_t      wait;
+    vlc_cond_t      done;
+    size_t          i_count;  /* jobs in the current run */
+    size_t          i_next;   /* next job to claim */
+    size_t          i_finished;
+    size_t          i_chunk;
+    bool            b_exit;
+} ts_jobs_t;
+
 struct sout_mux_sys_t
 {
     sout_input_t    *p_pcr_input;
@@ -381,10 +429,21 @@ struct sout_mux_sys_t
 
     mtime_t         i_pcr;  /* last PCR emited */
 
+    /* constant bitrate output */
+    int64_t         i_muxrate;          /* bits/s, 0 if disabled */
+    mtime_t         i_cbr_origin;       /* date of the slot 0 */
+    int64_t         i_cbr_slot;         /* next slot from the origin */
+    bool            b_cbr_late;         /* slots behind by the shaping delay */
+    uint64_t        i_cbr_packets;
+    uint64_t        i_cbr_nulls;
+    uint64_t        i_cbr_overflows;    /* packets dropped */
+
     csa_t           *csa;
     int             i_csa_pkt_size;
     bool            b_crypt_audio;
     bool            b_crypt_video;
+
+    ts_jobs_t       jobs;
 };
 
 
@@ -480,8 +539,11 @@ static void TSDate      ( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts,
 static void GetPAT( sout_mux_t *p_mux, sout_buffer_chain_t *c );
 static void GetPMT( sout_mux_t *p_mux, sout_buffer_chain_t *c );
 
-static block_t *TSNew( sout_mux_t *p_mux, sout_input_sys_t *p_stream, bool b_pcr );
+static block_t *TSNew( sout_mux_t *p_mux, sout_input_sys_t *p_stream, bool b_pcr,
+                       bool b_scramble );
+static void TSJobsProcess( sout_mux_t *p_mux );
 static void TSSetPCR( block_t *p_ts, mtime_t i_dts );
+static void TSDateCBR( sout_mux_t *, sout_buffer_chain_t *, mtime_t, mtime_t );
 
 static csa_t *csaSetup( vlc_object_t *p_this )
 {
@@ -535,6 +597,199 @@ static csa_t *csaSetup( vlc_object_t *p_this )
     return csa;
 }
 
+/*****************************************************************************
+ * TS packets workers
+ *****************************************************************************/
+#define TS_JOBS_CSA_BATCH 256
+
+static void TSJobsRun( sout_mux_sys_t *p_sys, const ts_job_t *p_job,
+                       size_t i_count )
+{
+    /* the scrambled packets are gathered, csa is much faster on batches */
+    uint8_t *pp_csa[TS_JOBS_CSA_BATCH];
+    size_t   i_csa = 0;
+
+    for( ; i_count > 0; i_count--, p_job++ )
+    {
+        block_t *p_ts = p_job->p_ts;
+
+        memcpy( &p_ts->p_buffer[188 - p_job->i_payload], p_job->p_payload,
+                p_job->i_payload );
+        if( p_ts->i_flags & BLOCK_FLAG_SCRAMBLED )
+        {
+            pp_csa[i_csa++] = p_ts->p_buffer;
+            if( i_csa == TS_JOBS_CSA_BATCH )
+            {
+                csa_EncryptBatch( p_sys->csa, pp_csa, i_csa,
+                                  p_sys->i_csa_pkt_size );
+                i_csa = 0;
+            }
+        }
+    }
+
+    if( i_csa > 0 )
+        csa_EncryptBatch( p_sys->csa, pp_csa, i_csa, p_sys->i_csa_pkt_size );
+}
+
+/* Claims and runs chunks of the current run, called with the lock held */
+static void TSJobsWork( sout_mux_sys_t *p_sys )
+{
+    ts_jobs_t *p_jobs = &p_sys->jobs;
+
+    while( p_jobs->i_next < p_jobs->i_count )
+    {
+        size_t i_first = p_jobs->i_next;
+        size_t i_count = __MIN( p_jobs->i_chunk, p_jobs->i_count - i_first );
+
+        p_jobs->i_next += i_count;
+        vlc_mutex_unlock( &p_jobs->lock );
+
+        TSJobsRun( p_sys, &p_jobs->p_jobs[i_first], i_count );
+
+        vlc_mutex_lock( &p_jobs->lock );
+        p_jobs->i_finished += i_count;
+    }
+
+    if( p_jobs->i_finished == p_jobs->i_count )
+        vlc_cond_signal( &p_jobs->done );
+}
+
+static void *TSJobsThread( void *data )
+{
+    sout_mux_sys_t *p_sys = data;
+    ts_jobs_t *p_jobs = &p_sys->jobs;
+
+    vlc_mutex_lock( &p_jobs->lock );
+    while( !p_jobs->b_exit )
+    {
+        if( p_jobs->i_next < p_jobs->i_count )
+            TSJobsWork( p_sys );
+        else
+            vlc_cond_wait( &p_jobs->wait, &p_jobs->lock );
+    }
+    vlc_mutex_unlock( &p_jobs->lock );
+
+    return NULL;
+}
+
+static void TSJobsStart( sout_mux_t *p_mux )
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    ts_jobs_t *p_jobs = &p_sys->jobs;
+
+    BufferChainInit( &p_jobs->chain_done );
+    vlc_mutex_init( &p_jobs->lock );
+    vlc_cond_init( &p_jobs->wait );
+    vlc_cond_init( &p_jobs->done );
+
+    /* Copying alone is cheap: only split big runs. Scrambling chunks are
+     * sized for the csa batches */
+    p_jobs->i_chunk = p_sys->csa != NULL ? TS_JOBS_CSA_BATCH : 512;
+
+    int64_t i_threads = var_GetInteger( p_mux, SOUT_CFG_PREFIX "threads" );
+    if( i_threads <= 0 )
+        i_threads = p_sys->csa != NULL ? vlc_GetCPUCount() : 1;
+    i_threads = __MIN( i_threads, 64 );
+
+    /* the muxer thread takes part in each run */
+    if( i_threads <= 1 )
+        return;
+    p_jobs->p_threads = malloc( ( i_threads - 1 ) * sizeof(vlc_thread_t) );
+    if( unlikely(p_jobs->p_threads == NULL) )
+        return;
+
+    while( p_jobs->i_threads < i_threads - 1 )
+    {
+        if( vlc_clone( &p_jobs->p_threads[p_jobs->i_threads], TSJobsThread,
+                       p_sys, VLC_THREAD_PRIORITY_OUTPUT ) )
+            break;
+        p_jobs->i_threads++;
+    }
+    msg_Dbg( p_mux, "using %u worker threads", p_jobs->i_threads );
+}
+
+static void TSJobsStop( ts_jobs_t *p_jobs )
+{
+    vlc_mutex_lock( &p_jobs->lock );
+    p_jobs->b_exit = true;
+    vlc_cond_broadcast( &p_jobs->wait );
+    vlc_mutex_unlock( &p_jobs->lock );
+
+    for( unsigned i = 0; i < p_jobs->i_threads; i++ )
+        vlc_join( p_jobs->p_threads[i], NULL );
+    free( p_jobs->p_threads );
+
+    free( p_jobs->p_jobs );
+    BufferChainClean( &p_jobs->chain_done );
+    vlc_cond_destroy( &p_jobs->done );
+    vlc_cond_destroy( &p_jobs->wait );
+    vlc_mutex_destroy( &p_jobs->lock );
+}
+
+static void TSJobsQueue( sout_mux_t *p_mux, block_t *p_ts,
+                         const uint8_t *p_payload, int i_payload )
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    ts_jobs_t *p_jobs = &p_sys->jobs;
+    ts_job_t job = { p_ts, p_payload, i_payload };
+
+    if( p_jobs->i_jobs == p_jobs->i_alloc )
+    {
+        size_t i_alloc = p_jobs->i_alloc ? p_jobs->i_alloc * 2 : 256;
+        ts_job_t *p_realloc = realloc( p_jobs->p_jobs,
+                                       i_alloc * sizeof(*p_realloc) );
+        if( unlikely(p_realloc == NULL) )
+        {
+            /* do it now */
+            if( p_sys->csa != NULL )
+                vlc_mutex_lock( &p_sys->csa_lock );
+            TSJobsRun( p_sys, &job, 1 );
+            if( p_sys->csa != NULL )
+                vlc_mutex_unlock( &p_sys->csa_lock );
+            return;
+        }
+        p_jobs->p_jobs = p_realloc;
+        p_jobs->i_alloc = i_alloc;
+    }
+    p_jobs->p_jobs[p_jobs->i_jobs++] = job;
+}
+
+/* Completes all the queued TS packets */
+static void TSJobsProcess( sout_mux_t *p_mux )
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    ts_jobs_t *p_jobs = &p_sys->jobs;
+
+    /* the keys must not change in the middle of a run */
+    if( p_sys->csa != NULL )
+        vlc_mutex_lock( &p_sys->csa_lock );
+
+    if( p_jobs->i_threads > 0 && p_jobs->i_jobs > p_jobs->i_chunk )
+    {
+        vlc_mutex_lock( &p_jobs->lock );
+        p_jobs->i_count = p_jobs->i_jobs;
+        p_jobs->i_next = 0;
+        p_jobs->i_finished = 0;
+        vlc_cond_broadcast( &p_jobs->wait );
+
+        TSJobsWork( p_sys );
+        while( p_jobs->i_finished < p_jobs->i_count )
+            vlc_cond_wait( &p_jobs->done, &p_jobs->lock );
+
+        p_jobs->i_count = 0;
+        p_jobs->i_next = 0;
+        vlc_mutex_unlock( &p_jobs->lock );
+    }
+    else
+        TSJobsRun( p_sys, p_jobs->p_jobs, p_jobs->i_jobs );
+
+    if( p_sys->csa != NULL )
+        vlc_mutex_unlock( &p_sys->csa_lock );
+
+    p_jobs->i_jobs = 0;
+    BufferChainClean( &p_jobs->chain_done );
+}
+
 /*****************************************************************************
  * Open:
  *****************************************************************************/
@@ -735,9 +990,22 @@ static int Open( vlc_object_t *p_this )
 
     p_sys->b_use_key_frames = var_GetBool( p_mux, SOUT_CFG_PREFIX "use-key-frames" );
 
+    p_sys->i_muxrate = var_GetInteger( p_mux, SOUT_CFG_PREFIX "muxrate" );
+    if( p_sys->i_muxrate < 0 )
+        p_sys->i_muxrate = 0;
+    if( p_sys->i_muxrate > 0 )
+        msg_Dbg( p_mux, "constant mux rate %"PRId64" bits/s", p_sys->i_muxrate );
+    p_sys->i_cbr_origin = VLC_TS_INVALID;
+    p_sys->i_cbr_slot = 0;
+    p_sys->b_cbr_late = false;
+    p_sys->i_cbr_packets = 0;
+    p_sys->i_cbr_nulls = 0;
+    p_sys->i_cbr_overflows = 0;
+
     p_mux->p_sys        = p_sys;
 
     p_sys->csa = csaSetup(p_this);
+    TSJobsStart( p_mux );
 
     p_mux->pf_control   = Control;
     p_mux->pf_addstream = AddStream;
@@ -758,6 +1026,14 @@ static void Close( vlc_object_t * p_this )
     if( p_sys->p_dvbpsi )
         dvbpsi_delete( p_sys->p_dvbpsi );
 
+    TSJobsStop( &p_sys->jobs );
+
+    if( p_sys->i_muxrate > 0 )
+        msg_Dbg( p_mux, "constant mux rate: %"PRIu64" packets, %"PRIu64
+                 " null packets, %"PRIu64" dropped packets",
+                 p_sys->i_cbr_packets,
+                 p_sys->i_cbr_nulls, p_sys->i_cbr_overflows );
+
     if( p_sys->csa )
     {
         var_DelCallback( p_mux, SOUT_CFG_PREFIX "csa-ck", ChangeKeyCallback, NULL );
@@ -1155,6 +1431,10 @@ static block_t *Encap_J2K( block_t *p_data, const es_format_t *p_fmt )
     }
     else
     {
+        /* the boxes header is written over the payload */
+        p_data = block_Unshare( p_data );
+        if( unlikely(!p_data) )
+            return NULL;
         p_data->p_buffer += (i_offset - 38);
         p_data->i_buffer -= (i_offset - 38);
     }
@@ -1525,13 +1805,10 @@ static bool MuxStreams(sout_mux_t *p_mux )
         }
 
         /* Build the TS packet */
-        block_t *p_ts = TSNew( p_mux, p_stream, b_pcr );
-        if( p_sys->csa != NULL &&
+        bool b_scramble = p_sys->csa != NULL &&
              (p_input->p_fmt->i_cat != AUDIO_ES || p_sys->b_crypt_audio) &&
-             (p_input->p_fmt->i_cat != VIDEO_ES || p_sys->b_crypt_video) )
-        {
-            p_ts->i_flags |= BLOCK_FLAG_SCRAMBLED;
-        }
+             (p_input->p_fmt->i_cat != VIDEO_ES || p_sys->b_crypt_video);
+        block_t *p_ts = TSNew( p_mux, p_stream, b_pcr, b_scramble );
         i_packet_pos++;
 
         /* Write PAT/PMT before every keyframe if use-key-frames is enabled,
@@ -1558,7 +1835,8 @@ static bool MuxStreams(sout_mux_t *p_mux )
         BufferChainAppend( &chain_ts, p_ts );
     }
 
-    /* 4: date and send */
+    /* 4: fill and scramble the payloads, date and send */
+    TSJobsProcess( p_mux );
     TSSchedule( p_mux, &chain_ts, i_pcr_length, i_pcr_dts );
     return false;
 }
@@ -1753,6 +2031,12 @@ static void TSDate( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts,
     sout_mux_sys_t  *p_sys = p_mux->p_sys;
     int i_packet_count = p_chain_ts->i_depth;
 
+    if( p_sys->i_muxrate > 0 )
+    {
+        TSDateCBR( p_mux, p_chain_ts, i_pcr_length, i_pcr_dts );
+        return;
+    }
+
     if ( i_pcr_length / 1000 > 0 )
     {
         int i_bitrate = ((uint64_t)i_packet_count * 188 * 8000)
@@ -1784,14 +2068,9 @@ static void TSDate( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts,
         if( p_ts->i_flags & BLOCK_FLAG_CLOCK )
         {
             /* msg_Dbg( p_mux, "pcr=%lld ms", p_ts->i_dts / 1000 ); */
+            /* the adaptation field is never scrambled */
             TSSetPCR( p_ts, p_ts->i_dts - p_sys->first_dts );
         }
-        if( p_ts->i_flags & BLOCK_FLAG_SCRAMBLED )
-        {
-            vlc_mutex_lock( &p_sys->csa_lock );
-            csa_Encrypt( p_sys->csa, p_ts->p_buffer, p_sys->i_csa_pkt_size );
-            vlc_mutex_unlock( &p_sys->csa_lock );
-        }
 
         /* latency */
         p_ts->i_dts += p_sys->i_shaping_delay * 3 / 2;
@@ -1800,10 +2079,109 @@ static void TSDate( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts,
     }
 }
 
+/* Date of the given slot of the constant bitrate output */
+static mtime_t CBRSlotDate( const sout_mux_sys_t *p_sys, int64_t i_slot )
+{
+    /* split not to overflow after a few days */
+    lldiv_t d = lldiv( i_slot, p_sys->i_muxrate );
+    return p_sys->i_cbr_origin + d.quot * 188 * 8 * CLOCK_FREQ
+         + d.rem * 188 * 8 * CLOCK_FREQ / p_sys->i_muxrate;
+}
+
+static void CBRWrite( sout_mux_t *p_mux, block_t *p_ts, mtime_t i_date )
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+
+    p_ts->i_dts    = i_date;
+    p_ts->i_length = CBRSlotDate( p_sys, p_sys->i_cbr_slot + 1 ) - i_date;
+    p_sys->i_cbr_slot++;
+    p_sys->i_cbr_packets++;
+
+    if( p_ts->i_flags & BLOCK_FLAG_CLOCK )
+        TSSetPCR( p_ts, p_ts->i_dts - p_sys->first_dts );
+
+    /* latency */
+    p_ts->i_dts += p_sys->i_shaping_delay * 3 / 2;
+
+    sout_AccessOutWrite( p_mux->p_access, p_ts );
+}
+
+/* Sends the packets at the slots of the constant bitrate, each one at its
+ * date or at the first free slot after it. The slots left free are filled
+ * with null packets. The delay of the packets behind their dates, the
+ * occupancy of a buffer emptied at the mux rate, is bounded by the shaping
+ * duration: past it, the mux rate is too low, and the packets but the PCR
+ * ones are dropped until the delay is back within the bound. The slots are
+ * never dated back, so that the PCR never goes backwards. */
+static void TSDateCBR( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts,
+                       mtime_t i_pcr_length, mtime_t i_pcr_dts )
+{
+    sout_mux_sys_t  *p_sys = p_mux->p_sys;
+    int i_packet_count = p_chain_ts->i_depth;
+
+    for (int i = 0; i < i_packet_count; i++ )
+    {
+        block_t *p_ts = BufferChainGet( p_chain_ts );
+        mtime_t i_new_dts = i_pcr_dts + i_pcr_length * i / i_packet_count;
+        mtime_t i_slot_dts = CBRSlotDate( p_sys, p_sys->i_cbr_slot );
+
+        /* Starts on the first packet. Holes longer than a second are not
+         * stuffed: the slots restart forward, at the date of the packet. The
+         * time base does not change, so no discontinuity is flagged. */
+        if( p_sys->i_cbr_origin == VLC_TS_INVALID ||
+            i_new_dts - i_slot_dts > CLOCK_FREQ )
+        {
+            if( p_sys->i_cbr_origin != VLC_TS_INVALID )
+                msg_Warn( p_mux, "%"PRId64" ms hole in the input, restarting "
+                          "the mux rate", ( i_new_dts - i_slot_dts ) / 1000 );
+            p_sys->i_cbr_origin = i_new_dts;
+            p_sys->i_cbr_slot = 0;
+            i_slot_dts = i_new_dts;
+        }
+
+        while( i_slot_dts < i_new_dts )
+        {
+            block_t *p_null = block_Alloc( 188 );
+            if( unlikely(p_null == NULL) )
+                break;
+            p_null->p_buffer[0] = 0x47;
+            p_null->p_buffer[1] = 0x1f; /* PID 0x1fff */
+            p_null->p_buffer[2] = 0xff;
+            p_null->p_buffer[3] = 0x10; /* payload only */
+            memset( &p_null->p_buffer[4], 0xff, 184 );
+
+            CBRWrite( p_mux, p_null, i_slot_dts );
+            p_sys->i_cbr_nulls++;
+            i_slot_dts = CBRSlotDate( p_sys, p_sys->i_cbr_slot );
+        }
+
+        if( i_slot_dts - i_new_dts > p_sys->i_shaping_delay )
+        {
+            if( !p_sys->b_cbr_late )
+            {
+                msg_Warn( p_mux, "mux rate too low, %"PRId64" ms of data "
+                          "waiting for their slots, dropping packets",
+                          ( i_slot_dts - i_new_dts ) / 1000 );
+                p_sys->b_cbr_late = true;
+            }
+            if( !( p_ts->i_flags & BLOCK_FLAG_CLOCK ) )
+            {
+                block_Release( p_ts );
+                p_sys->i_cbr_overflows++;
+                continue;
+            }
+        }
+        else
+            p_sys->b_cbr_late = false;
+
+        CBRWrite( p_mux, p_ts, i_slot_dts );
+    }
+}
+
 static block_t *TSNew( sout_mux_t *p_mux, sout_input_sys_t *p_stream,
-                       bool b_pcr )
+                       bool b_pcr, bool b_scramble )
 {
-    VLC_UNUSED(p_mux);
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
     block_t *p_pes = p_stream->state.chain_pes.p_first;
 
     bool b_new_pes = false;
@@ -1830,6 +2208,9 @@ static block_t *TSNew( sout_mux_t *p_mux, sout_input_sys_t *p_stream,
         p_ts->i_flags |= BLOCK_FLAG_TYPE_I;
     }
 
+    if( b_scramble )
+        p_ts->i_flags |= BLOCK_FLAG_SCRAMBLED;
+
     p_ts->i_dts = p_pes->i_dts;
 
     p_ts->p_buffer[0] = 0x47;
@@ -1869,9 +2250,9 @@ static block_t *TSNew( sout_mux_t *p_mux, sout_input_sys_t *p_stream,
         }
     }
 
-    /* copy payload */
-    memcpy( &p_ts->p_buffer[188 - i_payload],
-            &p_pes->p_buffer[p_stream->state.i_pes_used], i_payload );
+    /* copy payload, see TSJobsProcess() */
+    TSJobsQueue( p_mux, p_ts, &p_pes->p_buffer[p_stream->state.i_pes_used],
+                 i_payload );
 
     p_stream->state.i_pes_used += i_payload;
     p_stream->state.i_pes_dts = p_pes->i_dts + p_pes->i_length *
@@ -1880,7 +2261,9 @@ static block_t *TSNew( sout_mux_t *p_mux, sout_input_sys_t *p_stream,
 
     if( p_stream->state.i_pes_used >= (int)p_pes->i_buffer )
     {
-        block_Release(BufferChainGet( &p_stream->state.chain_pes ));
+        /* released once its payload is copied */
+        BufferChainAppend( &p_sys->jobs.chain_done,
+                           BufferChainGet( &p_stream->state.chain_pes ) );
 
         p_pes = p_stream->state.chain_pes.p_first;
         p_stream->state.i_pes_length = 0;
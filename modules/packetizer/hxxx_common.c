@@ -126,6 +126,15 @@ block_t *PacketizeXXC1( decoder_t *p_dec, uint8_t i_nal_length_size,
     p_block = *pp_block;
     *pp_block = NULL;
 
+    /* 4 bytes NAL sizes can be turned into startcodes in place,
+     * so that NALs are referenced instead of copied */
+    if( i_nal_length_size == 4 )
+    {
+        block_t *p_shared = block_Share( p_block );
+        if( p_shared )
+            p_block = p_shared;
+    }
+
     for( p = p_block->p_buffer; p < &p_block->p_buffer[p_block->i_buffer]; )
     {
         bool b_dummy;
@@ -160,13 +169,22 @@ block_t *PacketizeXXC1( decoder_t *p_dec, uint8_t i_nal_length_size,
         }
         else
         {
-            p_nal = block_Alloc( 4 + i_size );
+            p_nal = NULL;
+            if( i_nal_length_size == 4 )
+                p_nal = block_Slice( p_block, p - 4 - p_block->p_buffer, 4 + i_size );
+            if( !p_nal )
+            {
+                p_nal = block_Alloc( 4 + i_size );
+                if( p_nal )
+                {
+                    /* Copy nalu */
+                    memcpy( &p_nal->p_buffer[4], p, i_size );
+                }
+            }
             if( p_nal )
             {
                 p_nal->i_dts = p_block->i_dts;
                 p_nal->i_pts = p_block->i_pts;
-                /* Copy nalu */
-                memcpy( &p_nal->p_buffer[4], p, i_size );
             }
             p += i_size;
         }
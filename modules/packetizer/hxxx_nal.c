@@ -41,6 +41,16 @@ static inline void hxxx_WritePrefix( uint8_t i_nal_length_size, uint8_t *p_dest,
         *p_dest = i_payload;
 }
 
+/* startcode_FindAnnexB() ignores a startcode ending the buffer */
+static const uint8_t * hxxx_FindAnnexB( const uint8_t *p, const uint8_t *p_end )
+{
+    const uint8_t *p_startcode = startcode_FindAnnexB( p, p_end );
+    if( !p_startcode && p_end - p >= 3 &&
+        p_end[-3] == 0 && p_end[-2] == 0 && p_end[-1] == 1 )
+        p_startcode = &p_end[-3];
+    return p_startcode;
+}
+
 block_t *hxxx_AnnexB_to_xVC( block_t *p_block, uint8_t i_nal_length_size )
 {
     unsigned i_nalcount = 0;
@@ -55,47 +65,44 @@ block_t *hxxx_AnnexB_to_xVC( block_t *p_block, uint8_t i_nal_length_size )
     if(!p_block->i_buffer || p_block->p_buffer[0])
         goto error;
 
+    /* prefixes are rewritten in place, and the NAL list below points into
+     * the payload: take a private copy of it first if it is referenced */
+    p_block = block_Unshare( p_block );
+    if( unlikely(!p_block) )
+        return NULL;
+
     if(! (p_list = malloc( sizeof(*p_list) * i_list )) )
         goto error;
 
     /* Search all startcode of size 3 */
     const uint8_t *p_buf = p_block->p_buffer;
     const uint8_t *p_end = &p_block->p_buffer[p_block->i_buffer];
-    unsigned i_bitflow = 0;
     off_t i_move = 0;
-    while( p_buf != p_end )
+    while( (p_buf = hxxx_FindAnnexB( p_buf, p_end )) )
     {
-        i_bitflow <<= 1;
-        if( !*p_buf )
+        if( p_buf > p_block->p_buffer && p_buf[-1] == 0 ) /* three zero prefixed 1 */
         {
-            i_bitflow |= 1;
+            p_list[i_nalcount].p = &p_buf[-1];
+            p_list[i_nalcount].prefix = 4;
         }
-        else if( *p_buf == 0x01 && (i_bitflow & 0x06) == 0x06 ) /* >= two zero prefixed 1 */
+        else /* two zero prefixed 1 */
         {
-            if( i_bitflow & 0x08 ) /* three zero prefixed 1 */
-            {
-                p_list[i_nalcount].p = &p_buf[-3];
-                p_list[i_nalcount].prefix = 4;
-            }
-            else /* two zero prefixed 1 */
-            {
-                p_list[i_nalcount].p = &p_buf[-2];
-                p_list[i_nalcount].prefix = 3;
-            }
-            i_move += (off_t) i_nal_length_size - p_list[i_nalcount].prefix;
-            p_list[i_nalcount++].move = i_move;
-
-            /* Check and realloc our list */
-            if(i_nalcount == i_list)
-            {
-                i_list += 16;
-                struct nalmoves_e *p_new = realloc( p_list, sizeof(*p_new) * i_list );
-                if(unlikely(!p_new))
-                    goto error;
-                p_list = p_new;
-            }
+            p_list[i_nalcount].p = p_buf;
+            p_list[i_nalcount].prefix = 3;
+        }
+        i_move += (off_t) i_nal_length_size - p_list[i_nalcount].prefix;
+        p_list[i_nalcount++].move = i_move;
+
+        /* Check and realloc our list */
+        if(i_nalcount == i_list)
+        {
+            i_list += 16;
+            struct nalmoves_e *p_new = realloc( p_list, sizeof(*p_new) * i_list );
+            if(unlikely(!p_new))
+                goto error;
+            p_list = p_new;
         }
-        p_buf++;
+        p_buf += 3;
     }
 
     if( !i_nalcount )
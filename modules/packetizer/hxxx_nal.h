@@ -228,29 +228,37 @@ static inline uint8_t *hxxx_bsfw_ep3b_to_rbsp( uint8_t *p, uint8_t *end, void *p
     return p;
 }
 
-#if 0
-/* Discards emulation prevention three bytes */
+/* Discards emulation prevention three bytes.
+ * Unlike the bs_t callback, whole runs of payload are copied between
+ * the escapes located by the startcode helpers, which is what matters
+ * for large NALs (SEI, slice data). */
 static inline uint8_t * hxxx_ep3b_to_rbsp(const uint8_t *p_src, size_t i_src, size_t *pi_ret)
 {
     uint8_t *p_dst;
-    if(!p_src || !(p_dst = malloc(i_src)))
+    if(!p_src || !(p_dst = malloc(i_src ? i_src : 1)))
         return NULL;
 
+    const uint8_t *p_end = &p_src[i_src];
     size_t j = 0;
-    for (size_t i = 0; i < i_src; i++) {
-        if (i < i_src - 3 &&
-            p_src[i] == 0 && p_src[i+1] == 0 && p_src[i+2] == 3) {
-            p_dst[j++] = 0;
-            p_dst[j++] = 0;
-            i += 2;
-            continue;
+    while( p_src < p_end )
+    {
+        /* Never escape sequence if no next byte, which is also what
+         * the startcode helpers only return */
+        const uint8_t *p_ep3b = startcode_FindEP3B( p_src, p_end );
+        if( p_ep3b == NULL )
+        {
+            memcpy( &p_dst[j], p_src, p_end - p_src );
+            j += p_end - p_src;
+            break;
         }
-        p_dst[j++] = p_src[i];
+        /* keep the 2 zeros, drop the 0x03 */
+        memcpy( &p_dst[j], p_src, p_ep3b + 2 - p_src );
+        j += p_ep3b + 2 - p_src;
+        p_src = p_ep3b + 3;
     }
     *pi_ret = j;
     return p_dst;
 }
-#endif
 
 /* Declarations */
 
@@ -39,15 +39,19 @@ void HxxxParseSEI(const uint8_t *p_buf, size_t i_buf,
                   uint8_t i_header, pf_hxxx_sei_callback pf_callback, void *cbdata)
 {
     bs_t s;
-    unsigned i_bitflow = 0;
     bool b_continue = true;
 
     if( i_buf <= i_header )
         return;
 
-    bs_init( &s, &p_buf[i_header], i_buf - i_header ); /* skip nal unit header */
-    s.p_fwpriv = &i_bitflow;
-    s.pf_forward = hxxx_bsfw_ep3b_to_rbsp;  /* Does the emulated 3bytes conversion to rbsp */
+    /* Does the emulated 3bytes conversion to rbsp once for the whole NAL,
+     * so that payloads can be read in place */
+    size_t i_rbsp;
+    uint8_t *p_rbsp = hxxx_ep3b_to_rbsp( &p_buf[i_header], i_buf - i_header, &i_rbsp );
+    if( !p_rbsp )
+        return;
+
+    bs_init( &s, p_rbsp, i_rbsp ); /* skip nal unit header */
 
     while( bs_remain( &s ) >= 8 && bs_aligned( &s ) && b_continue )
     {
@@ -92,13 +96,9 @@ void HxxxParseSEI(const uint8_t *p_buf, size_t i_buf,
             /* Look for user_data_registered_itu_t_t35 */
             case HXXX_SEI_USER_DATA_REGISTERED_ITU_T_T35:
             {
-                size_t i_t35;
-                uint8_t *p_t35 = malloc( i_size );
-                if( !p_t35 )
-                    break;
-
-                for( i_t35 = 0; i_t35<i_size && bs_remain( &s ) >= 8; i_t35++ )
-                    p_t35[i_t35] = bs_read( &s, 8 );
+                /* payload starts byte aligned */
+                const uint8_t *p_t35 = &p_rbsp[i_start_bit_pos / 8];
+                size_t i_t35 = __MIN( i_size, bs_remain( &s ) / 8 );
 
                 /* TS 101 154 Auxiliary Data and H264/AVC video */
                 if( i_t35 > 4 && p_t35[0] == 0xb5 /* United States */ )
@@ -132,7 +132,6 @@ void HxxxParseSEI(const uint8_t *p_buf, size_t i_buf,
                     }
                 }
 
-                free( p_t35 );
             } break;
 
             case HXXX_SEI_FRAME_PACKING_ARRANGEMENT:
@@ -199,4 +198,6 @@ void HxxxParseSEI(const uint8_t *p_buf, size_t i_buf,
             break;
         bs_skip( &s, i_size * 8 - ( i_end_bit_pos - i_start_bit_pos ) );
     }
+
+    free( p_rbsp );
 }
@@ -102,6 +102,28 @@ static inline void packetizer_Flush( packetizer_t *p_pack )
     p_pack->pf_reset( p_pack->p_private, true );
 }
 
+/* References the next fragment in the current block instead of copying it,
+ * when it does not span blocks and the AU prepend is already in place */
+static inline block_t *packetizer_Slice( packetizer_t *p_pack )
+{
+    block_t *p_block = p_pack->bytestream.p_block;
+    const size_t i_block_offset = p_pack->bytestream.i_block_offset;
+    const ssize_t i_start = i_block_offset - p_pack->i_au_prepend;
+
+    /* The prepend can be found in the already consumed data, which remains
+     * in the block headroom */
+    if( p_block->i_buffer - i_block_offset < p_pack->i_offset ||
+        (size_t)p_pack->i_au_prepend > (size_t)(p_block->p_buffer - p_block->p_start) + i_block_offset ||
+        memcmp( &p_block->p_buffer[i_start], p_pack->p_au_prepend, p_pack->i_au_prepend ) )
+        return NULL;
+
+    block_t *p_pic = block_Slice( p_block, i_start,
+                                  p_pack->i_offset + p_pack->i_au_prepend );
+    if( p_pic )
+        block_SkipBytes( &p_pack->bytestream, p_pack->i_offset );
+    return p_pic;
+}
+
 static inline block_t *packetizer_Packetize( packetizer_t *p_pack, block_t **pp_block )
 {
     block_t *p_block = ( pp_block ) ? *pp_block : NULL;
@@ -128,7 +150,13 @@ static inline block_t *packetizer_Packetize( packetizer_t *p_pack, block_t **pp_
     }
 
     if( p_block )
+    {
+        /* Share the payload so that fragments can be sliced out of it */
+        block_t *p_shared = block_Share( p_block );
+        if( p_shared )
+            p_block = p_shared;
         block_BytestreamPush( &p_pack->bytestream, p_block );
+    }
 
     for( ;; )
     {
@@ -180,15 +208,18 @@ static inline block_t *packetizer_Packetize( packetizer_t *p_pack, block_t **pp_
             /* Get the new fragment and set the pts/dts */
             block_t *p_block_bytestream = p_pack->bytestream.p_block;
 
-            p_pic = block_Alloc( p_pack->i_offset + p_pack->i_au_prepend );
+            p_pic = packetizer_Slice( p_pack );
+            if( p_pic == NULL )
+            {
+                p_pic = block_Alloc( p_pack->i_offset + p_pack->i_au_prepend );
+                block_GetBytes( &p_pack->bytestream, &p_pic->p_buffer[p_pack->i_au_prepend],
+                                p_pic->i_buffer - p_pack->i_au_prepend );
+                if( p_pack->i_au_prepend > 0 )
+                    memcpy( p_pic->p_buffer, p_pack->p_au_prepend, p_pack->i_au_prepend );
+            }
             p_pic->i_pts = p_block_bytestream->i_pts;
             p_pic->i_dts = p_block_bytestream->i_dts;
 
-            block_GetBytes( &p_pack->bytestream, &p_pic->p_buffer[p_pack->i_au_prepend],
-                            p_pic->i_buffer - p_pack->i_au_prepend );
-            if( p_pack->i_au_prepend > 0 )
-                memcpy( p_pic->p_buffer, p_pack->p_au_prepend, p_pack->i_au_prepend );
-
             p_pack->i_offset = 0;
 
             /* Parse the NAL */
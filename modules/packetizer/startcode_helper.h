@@ -25,21 +25,31 @@
 #if !defined(CAN_COMPILE_SSE2) && defined(HAVE_SSE2_INTRINSICS)
    #include <emmintrin.h>
 #endif
+#ifdef HAVE_AVX2_INTRINSICS
+   #include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+   #include <arm_neon.h>
+   #define STARTCODE_NEON
+#endif
 
-/* Looks up efficiently for an AnnexB startcode 0x00 0x00 0x01
- * by using a 4 times faster trick than single byte lookup. */
+/* Looks up efficiently for a 0x00 0x00 c sequence, c being 0x01 for an
+ * AnnexB startcode or 0x03 for an emulation prevention three byte,
+ * by using a 4 times faster trick than single byte lookup.
+ * The SIMD variants only locate the zero bytes, and the candidates are
+ * checked 4 bytes at a time with TRY_MATCH. */
 
-#define TRY_MATCH(p,a) {\
+#define TRY_MATCH(p,a,c) {\
      if (p[a+1] == 0) {\
-            if (p[a+0] == 0 && p[a+2] == 1)\
+            if (p[a+0] == 0 && p[a+2] == c)\
                 return a+p;\
-            if (p[a+2] == 0 && p[a+3] == 1)\
+            if (p[a+2] == 0 && p[a+3] == c)\
                 return a+p+1;\
         }\
         if (p[a+3] == 0) {\
-            if (p[a+2] == 0 && p[a+4] == 1)\
+            if (p[a+2] == 0 && p[a+4] == c)\
                 return a+p+2;\
-            if (p[a+4] == 0 && p[a+5] == 1)\
+            if (p[a+4] == 0 && p[a+5] == c)\
                 return a+p+3;\
         }\
     }
@@ -47,13 +57,14 @@
 #if defined(CAN_COMPILE_SSE2) || defined(HAVE_SSE2_INTRINSICS)
 
 __attribute__ ((__target__ ("sse2")))
-static inline const uint8_t * startcode_FindAnnexB_SSE2( const uint8_t *p, const uint8_t *end )
+static inline const uint8_t * startcode_Find_SSE2( const uint8_t *p, const uint8_t *end,
+                                                   const uint8_t c )
 {
     /* First align to 16 */
     /* Skipping this step and doing unaligned loads isn't faster */
     const uint8_t *alignedend = p + 16 - ((intptr_t)p & 15);
     for (end -= 3; p < alignedend && p < end; p++) {
-        if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+        if (p[0] == 0 && p[1] == 0 && p[2] == c)
             return p;
     }
 
@@ -89,18 +100,89 @@ static inline const uint8_t * startcode_FindAnnexB_SSE2( const uint8_t *p, const
             match = _mm_movemask_epi8( res ); /* mask will be in reversed match order */
 #endif
             if( match & 0x000F )
-                TRY_MATCH(p, 0);
+                TRY_MATCH(p, 0, c);
             if( match & 0x00F0 )
-                TRY_MATCH(p, 4);
+                TRY_MATCH(p, 4, c);
             if( match & 0x0F00 )
-                TRY_MATCH(p, 8);
+                TRY_MATCH(p, 8, c);
             if( match & 0xF000 )
-                TRY_MATCH(p, 12);
+                TRY_MATCH(p, 12, c);
         }
     }
 
     for (; p < end; p++) {
-        if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+        if (p[0] == 0 && p[1] == 0 && p[2] == c)
+            return p;
+    }
+
+    return NULL;
+}
+
+#endif
+
+#ifdef HAVE_AVX2_INTRINSICS
+
+__attribute__ ((__target__ ("avx2")))
+static inline const uint8_t * startcode_Find_AVX2( const uint8_t *p, const uint8_t *end,
+                                                   const uint8_t c )
+{
+    /* Unaligned loads are as fast as aligned ones on AVX2 capable CPUs */
+    end -= 3;
+    if( p < end )
+    {
+        const __m256i zeros = _mm256_setzero_si256();
+        for( ; end - p >= 32; p += 32 )
+        {
+            __m256i v = _mm256_loadu_si256( (const __m256i *)p );
+            uint32_t match = _mm256_movemask_epi8( _mm256_cmpeq_epi8( zeros, v ) );
+            if( match == 0 )
+                continue;
+            for( unsigned a = 0; a < 32; a += 4 )
+            {
+                if( match & (UINT32_C(0xF) << a) )
+                    TRY_MATCH(p, a, c);
+            }
+        }
+    }
+
+    for (; p < end; p++) {
+        if (p[0] == 0 && p[1] == 0 && p[2] == c)
+            return p;
+    }
+
+    return NULL;
+}
+
+#endif
+
+#ifdef STARTCODE_NEON
+
+static inline const uint8_t * startcode_Find_NEON( const uint8_t *p, const uint8_t *end,
+                                                   const uint8_t c )
+{
+    end -= 3;
+    if( p < end )
+    {
+        const uint8x16_t zeros = vdupq_n_u8( 0x00 );
+        for( ; end - p >= 16; p += 16 )
+        {
+            uint8x16_t res = vceqq_u8( vld1q_u8( p ), zeros );
+            /* There is no movemask: narrow each byte of the result to a
+             * nibble, so that bytes i..i+3 end up in bits 4i..4i+15 */
+            uint64_t match = vget_lane_u64( vreinterpret_u64_u8(
+                                vshrn_n_u16( vreinterpretq_u16_u8( res ), 4 ) ), 0 );
+            if( match == 0 )
+                continue;
+            for( unsigned a = 0; a < 16; a += 4 )
+            {
+                if( match & (UINT64_C(0xFFFF) << (4 * a)) )
+                    TRY_MATCH(p, a, c);
+            }
+        }
+    }
+
+    for (; p < end; p++) {
+        if (p[0] == 0 && p[1] == 0 && p[2] == c)
             return p;
     }
 
@@ -113,16 +195,24 @@ static inline const uint8_t * startcode_FindAnnexB_SSE2( const uint8_t *p, const
  * and i believe the trick originated from
  * https://graphics.stanford.edu/~seander/bithacks.html#ZeroInWord
  */
-static inline const uint8_t * startcode_FindAnnexB( const uint8_t *p, const uint8_t *end )
+static inline const uint8_t * startcode_Find( const uint8_t *p, const uint8_t *end,
+                                              const uint8_t c )
 {
+#ifdef HAVE_AVX2_INTRINSICS
+    if (vlc_CPU_AVX2())
+        return startcode_Find_AVX2(p, end, c);
+#endif
 #if defined(CAN_COMPILE_SSE2) || defined(HAVE_SSE2_INTRINSICS)
     if (vlc_CPU_SSE2())
-        return startcode_FindAnnexB_SSE2(p, end);
+        return startcode_Find_SSE2(p, end, c);
 #endif
+#ifdef STARTCODE_NEON
+    return startcode_Find_NEON(p, end, c);
+#else
     const uint8_t *a = p + 4 - ((intptr_t)p & 3);
 
     for (end -= 3; p < a && p < end; p++) {
-        if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+        if (p[0] == 0 && p[1] == 0 && p[2] == c)
             return p;
     }
 
@@ -131,16 +221,29 @@ static inline const uint8_t * startcode_FindAnnexB( const uint8_t *p, const uint
         if ((x - 0x01010101) & (~x) & 0x80808080)
         {
             /* matching DW isn't faster */
-            TRY_MATCH(p, 0);
+            TRY_MATCH(p, 0, c);
         }
     }
 
     for (end += 3; p < end; p++) {
-        if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+        if (p[0] == 0 && p[1] == 0 && p[2] == c)
             return p;
     }
 
     return NULL;
+#endif
+}
+
+/* Returns the first 0x00 0x00 0x01 startcode */
+static inline const uint8_t * startcode_FindAnnexB( const uint8_t *p, const uint8_t *end )
+{
+    return startcode_Find( p, end, 0x01 );
+}
+
+/* Returns the first 0x00 0x00 0x03 emulation prevention sequence */
+static inline const uint8_t * startcode_FindEP3B( const uint8_t *p, const uint8_t *end )
+{
+    return startcode_Find( p, end, 0x03 );
 }
 
 /* Special variation to return on prefix only and no data */
@@ -151,7 +254,7 @@ static inline const uint8_t * startcode_FindAnyAnnexB( const uint8_t *p, const u
     {
         if( i_size == 4 )
         {
-            TRY_MATCH(p, 0);
+            TRY_MATCH(p, 0, 0x01);
         }
         else  if ( i_size == 3 && p[0] == 0 && p[1] == 0 && p[2] == 1 )
              return p;
@@ -161,5 +264,6 @@ static inline const uint8_t * startcode_FindAnyAnnexB( const uint8_t *p, const u
 }
 
 #undef TRY_MATCH
+#undef STARTCODE_NEON
 
 #endif
@@ -42,6 +42,16 @@
 
 #define BLANK_DELAY INT64_C(1000000)
 
+/* Picture of a bridge to show, taken under the mosaic mutex */
+typedef struct
+{
+    picture_t *p_picture;
+    video_format_t fmt; /* as shown */
+    int i_real_index;
+    int i_x, i_y;
+    int i_alpha;
+} mosaic_tile_t;
+
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
@@ -519,45 +529,53 @@ static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
     row_inner_height = ( ( p_sys->i_height - ( p_sys->i_rows - 1 )
                        * p_sys->i_borderh ) / p_sys->i_rows );
 
+    /* Take the pictures to show under the lock: the conversions, if the
+     * bridges did not do them, are done without it */
+    mosaic_tile_t *p_tiles = malloc( p_bridge->i_es_num * sizeof( *p_tiles ) );
+    int i_tiles = 0;
+    if( p_tiles == NULL )
+    {
+        vlc_global_unlock( VLC_MOSAIC_MUTEX );
+        vlc_mutex_unlock( &p_sys->lock );
+        return p_spu;
+    }
+
     i_real_index = 0;
 
     for( int i_index = 0; i_index < p_bridge->i_es_num; i_index++ )
     {
         bridged_es_t *p_es = p_bridge->pp_es[i_index];
-        video_format_t fmt_in, fmt_out;
-        picture_t *p_converted;
+        mosaic_tile_t *p_tile = &p_tiles[i_tiles];
+        picture_t *p_picture;
 
         if ( p_es->b_empty )
             continue;
 
-        while ( p_es->p_picture != NULL
-                 && p_es->p_picture->date + p_sys->i_delay < date )
+        while ( ( p_picture = bridged_es_Peek( p_es, 0 ) ) != NULL
+                 && p_picture->date + p_sys->i_delay < date )
         {
-            if ( p_es->p_picture->p_next != NULL )
+            if ( bridged_es_Peek( p_es, 1 ) != NULL )
             {
-                picture_t *p_next = p_es->p_picture->p_next;
-                picture_Release( p_es->p_picture );
-                p_es->p_picture = p_next;
+                bridged_es_Pop( p_es );
             }
-            else if ( p_es->p_picture->date + p_sys->i_delay + BLANK_DELAY <
+            else if ( p_picture->date + p_sys->i_delay + BLANK_DELAY <
                         date )
             {
                 /* Display blank */
-                picture_Release( p_es->p_picture );
-                p_es->p_picture = NULL;
-                p_es->pp_last = &p_es->p_picture;
+                bridged_es_Pop( p_es );
+                p_picture = NULL;
                 break;
             }
             else
             {
                 msg_Dbg( p_filter, "too late picture for %s (%"PRId64 ")",
                          p_es->psz_id,
-                         date - p_es->p_picture->date - p_sys->i_delay );
+                         date - p_picture->date - p_sys->i_delay );
                 break;
             }
         }
 
-        if ( p_es->p_picture == NULL )
+        if ( p_picture == NULL )
             continue;
 
         if ( p_sys->i_order_length == 0 )
@@ -579,88 +597,117 @@ static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
             if ( i == p_sys->i_order_length )
                 i_real_index = ++i_greatest_real_index_used;
         }
-        i_row = ( i_real_index / p_sys->i_cols ) % p_sys->i_rows;
-        i_col = i_real_index % p_sys->i_cols ;
 
-        video_format_Init( &fmt_in, 0 );
-        video_format_Init( &fmt_out, 0 );
+        video_format_Init( &p_tile->fmt, 0 );
 
         if ( !p_sys->b_keep )
         {
-            /* Convert the images */
-            fmt_in.i_chroma = p_es->p_picture->format.i_chroma;
-            fmt_in.i_height = p_es->p_picture->format.i_height;
-            fmt_in.i_width = p_es->p_picture->format.i_width;
-
-            if( fmt_in.i_chroma == VLC_CODEC_YUVA ||
-                fmt_in.i_chroma == VLC_CODEC_RGBA )
-                fmt_out.i_chroma = VLC_CODEC_YUVA;
+            const video_format_t *p_fmt_in = &p_picture->format;
+
+            if( p_fmt_in->i_chroma == VLC_CODEC_YUVA ||
+                p_fmt_in->i_chroma == VLC_CODEC_RGBA )
+                p_tile->fmt.i_chroma = VLC_CODEC_YUVA;
             else
-                fmt_out.i_chroma = VLC_CODEC_I420;
-            fmt_out.i_width = col_inner_width;
-            fmt_out.i_height = row_inner_height;
+                p_tile->fmt.i_chroma = VLC_CODEC_I420;
+            p_tile->fmt.i_width = col_inner_width;
+            p_tile->fmt.i_height = row_inner_height;
 
             if( p_sys->b_ar ) /* keep aspect ratio */
             {
-                if( (float)fmt_out.i_width / (float)fmt_out.i_height
-                      > (float)fmt_in.i_width / (float)fmt_in.i_height )
+                if( (float)p_tile->fmt.i_width / (float)p_tile->fmt.i_height
+                      > (float)p_fmt_in->i_width / (float)p_fmt_in->i_height )
                 {
-                    fmt_out.i_width = ( fmt_out.i_height * fmt_in.i_width )
-                                         / fmt_in.i_height;
+                    p_tile->fmt.i_width = ( p_tile->fmt.i_height * p_fmt_in->i_width )
+                                         / p_fmt_in->i_height;
                 }
                 else
                 {
-                    fmt_out.i_height = ( fmt_out.i_width * fmt_in.i_height )
-                                        / fmt_in.i_width;
+                    p_tile->fmt.i_height = ( p_tile->fmt.i_width * p_fmt_in->i_height )
+                                        / p_fmt_in->i_width;
                 }
              }
 
-            fmt_out.i_visible_width = fmt_out.i_width;
-            fmt_out.i_visible_height = fmt_out.i_height;
+            /* for the next pictures of this bridge */
+            atomic_store( &p_es->i_tile_width, p_tile->fmt.i_width );
+            atomic_store( &p_es->i_tile_height, p_tile->fmt.i_height );
+            atomic_store( &p_es->i_tile_chroma, p_tile->fmt.i_chroma );
+        }
+        else
+        {
+            p_tile->fmt.i_width = p_picture->format.i_width;
+            p_tile->fmt.i_height = p_picture->format.i_height;
+            p_tile->fmt.i_chroma = p_picture->format.i_chroma;
+
+            /* keep-picture may have been set since: stop the bridge scaling */
+            atomic_store( &p_es->i_tile_width, 0 );
+            atomic_store( &p_es->i_tile_height, 0 );
+        }
+        p_tile->fmt.i_visible_width = p_tile->fmt.i_width;
+        p_tile->fmt.i_visible_height = p_tile->fmt.i_height;
+
+        p_tile->p_picture = picture_Hold( p_picture );
+        p_tile->i_real_index = i_real_index;
+        p_tile->i_x = p_es->i_x;
+        p_tile->i_y = p_es->i_y;
+        p_tile->i_alpha = p_es->i_alpha;
+        i_tiles++;
+    }
+
+    vlc_global_unlock( VLC_MOSAIC_MUTEX );
 
-            p_converted = image_Convert( p_sys->p_image, p_es->p_picture,
-                                         &fmt_in, &fmt_out );
+    for( int i_tile = 0; i_tile < i_tiles; i_tile++ )
+    {
+        mosaic_tile_t *p_tile = &p_tiles[i_tile];
+        video_format_t *p_fmt_out = &p_tile->fmt;
+        picture_t *p_converted = p_tile->p_picture;
+
+        i_real_index = p_tile->i_real_index;
+        i_row = ( i_real_index / p_sys->i_cols ) % p_sys->i_rows;
+        i_col = i_real_index % p_sys->i_cols ;
+
+        /* Convert the images, unless the bridge already did */
+        if ( !p_sys->b_keep
+          && ( p_converted->format.i_chroma != p_fmt_out->i_chroma
+            || p_converted->format.i_width != p_fmt_out->i_width
+            || p_converted->format.i_height != p_fmt_out->i_height ) )
+        {
+            video_format_t fmt_in;
+
+            video_format_Init( &fmt_in, p_converted->format.i_chroma );
+            fmt_in.i_width = p_converted->format.i_width;
+            fmt_in.i_height = p_converted->format.i_height;
+
+            p_converted = image_Convert( p_sys->p_image, p_tile->p_picture,
+                                         &fmt_in, p_fmt_out );
+            video_format_Clean( &fmt_in );
             if( !p_converted )
             {
                 msg_Warn( p_filter,
                            "image resizing and chroma conversion failed" );
-                video_format_Clean( &fmt_in );
-                video_format_Clean( &fmt_out );
                 continue;
             }
         }
         else
-        {
-            p_converted = p_es->p_picture;
-            fmt_in.i_width = fmt_out.i_width = p_converted->format.i_width;
-            fmt_in.i_height = fmt_out.i_height = p_converted->format.i_height;
-            fmt_in.i_chroma = fmt_out.i_chroma = p_converted->format.i_chroma;
-            fmt_out.i_visible_width = fmt_out.i_width;
-            fmt_out.i_visible_height = fmt_out.i_height;
-        }
+            picture_Hold( p_converted );
 
-        p_region = subpicture_region_New( &fmt_out );
+        p_region = subpicture_region_New( p_fmt_out );
         /* FIXME the copy is probably not needed anymore */
         if( p_region )
             picture_Copy( p_region->p_picture, p_converted );
-        if( !p_sys->b_keep )
-            picture_Release( p_converted );
+        picture_Release( p_converted );
 
         if( !p_region )
         {
-            video_format_Clean( &fmt_in );
-            video_format_Clean( &fmt_out );
             msg_Err( p_filter, "cannot allocate SPU region" );
             subpicture_Delete( p_spu );
-            vlc_global_unlock( VLC_MOSAIC_MUTEX );
-            vlc_mutex_unlock( &p_sys->lock );
-            return NULL;
+            p_spu = NULL;
+            break;
         }
 
-        if( p_es->i_x >= 0 && p_es->i_y >= 0 )
+        if( p_tile->i_x >= 0 && p_tile->i_y >= 0 )
         {
-            p_region->i_x = p_es->i_x;
-            p_region->i_y = p_es->i_y;
+            p_region->i_x = p_tile->i_x;
+            p_region->i_y = p_tile->i_y;
         }
         else if( p_sys->i_position == position_offsets )
         {
@@ -669,7 +716,7 @@ static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
         }
         else
         {
-            if( fmt_out.i_width > col_inner_width ||
+            if( p_fmt_out->i_width > col_inner_width ||
                 p_sys->b_ar || p_sys->b_keep )
             {
                 /* we don't have to center the video since it takes the
@@ -684,10 +731,10 @@ static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
                 p_region->i_x = p_sys->i_xoffset
                         + i_col * ( p_sys->i_width / p_sys->i_cols )
                         + ( i_col * p_sys->i_borderw ) / p_sys->i_cols
-                        + ( col_inner_width - fmt_out.i_width ) / 2;
+                        + ( col_inner_width - p_fmt_out->i_width ) / 2;
             }
 
-            if( fmt_out.i_height > row_inner_height
+            if( p_fmt_out->i_height > row_inner_height
                 || p_sys->b_ar || p_sys->b_keep )
             {
                 /* we don't have to center the video since it takes the
@@ -702,11 +749,11 @@ static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
                 p_region->i_y = p_sys->i_yoffset
                         + i_row * ( p_sys->i_height / p_sys->i_rows )
                         + ( i_row * p_sys->i_borderh ) / p_sys->i_rows
-                        + ( row_inner_height - fmt_out.i_height ) / 2;
+                        + ( row_inner_height - p_fmt_out->i_height ) / 2;
             }
         }
         p_region->i_align = p_sys->i_align;
-        p_region->i_alpha = p_es->i_alpha;
+        p_region->i_alpha = p_tile->i_alpha;
 
         if( p_region_prev == NULL )
         {
@@ -717,13 +764,16 @@ static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
             p_region_prev->p_next = p_region;
         }
 
-        video_format_Clean( &fmt_in );
-        video_format_Clean( &fmt_out );
-
         p_region_prev = p_region;
     }
 
-    vlc_global_unlock( VLC_MOSAIC_MUTEX );
+    for( int i_tile = 0; i_tile < i_tiles; i_tile++ )
+    {
+        picture_Release( p_tiles[i_tile].p_picture );
+        video_format_Clean( &p_tiles[i_tile].fmt );
+    }
+    free( p_tiles );
+
     vlc_mutex_unlock( &p_sys->lock );
 
     return p_spu;
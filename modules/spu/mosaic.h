@@ -22,19 +22,95 @@
  * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
  *****************************************************************************/
 
+#include <vlc_atomic.h>
+
+/* Pictures queued by a bridge, enough for the mosaic delay at usual frame
+ * rates: beyond, the oldest ones are dropped */
+#define BRIDGE_QUEUE_SIZE 16
+
 typedef struct bridged_es_t
 {
     es_format_t fmt;
-    picture_t *p_picture;
-    picture_t **pp_last;
+    /* Ring of pictures, oldest first, with a single producer (the bridge,
+     * without lock) and a single consumer (the mosaic, under the mosaic
+     * mutex). The mosaic leaves the picture it shows at the head. */
+    picture_t *pp_queue[BRIDGE_QUEUE_SIZE];
+    atomic_uint i_read;
+    atomic_uint i_write;
     bool b_empty;
     char *psz_id;
 
+    /* Size and chroma the mosaic shows the pictures with (0 if unknown),
+     * for the bridge to convert them to on its own thread */
+    atomic_uint i_tile_width;
+    atomic_uint i_tile_height;
+    atomic_uint i_tile_chroma;
+
     int i_alpha;
     int i_x;
     int i_y;
 } bridged_es_t;
 
+static inline void bridged_es_Init( bridged_es_t *p_es )
+{
+    atomic_init( &p_es->i_read, 0 );
+    atomic_init( &p_es->i_write, 0 );
+    atomic_init( &p_es->i_tile_width, 0 );
+    atomic_init( &p_es->i_tile_height, 0 );
+    atomic_init( &p_es->i_tile_chroma, 0 );
+}
+
+/* Releases the oldest picture (mosaic side, or bridge side with the mosaic
+ * mutex) */
+static inline void bridged_es_Pop( bridged_es_t *p_es )
+{
+    unsigned i_read = atomic_load_explicit( &p_es->i_read,
+                                            memory_order_relaxed );
+
+    picture_Release( p_es->pp_queue[i_read % BRIDGE_QUEUE_SIZE] );
+    atomic_store_explicit( &p_es->i_read, i_read + 1, memory_order_release );
+}
+
+/* Queues a picture (bridge side). If the ring is full, the oldest picture
+ * is dropped, so that the mosaic skips ahead rather than falls behind: the
+ * mosaic mutex is only taken then. Returns false if a picture was dropped. */
+static inline bool bridged_es_Push( bridged_es_t *p_es, picture_t *p_pic )
+{
+    unsigned i_write = atomic_load_explicit( &p_es->i_write,
+                                             memory_order_relaxed );
+    unsigned i_read = atomic_load_explicit( &p_es->i_read,
+                                            memory_order_acquire );
+    bool b_dropped = false;
+
+    if( i_write - i_read >= BRIDGE_QUEUE_SIZE )
+    {
+        vlc_global_lock( VLC_MOSAIC_MUTEX );
+        i_read = atomic_load_explicit( &p_es->i_read, memory_order_relaxed );
+        if( i_write - i_read >= BRIDGE_QUEUE_SIZE )
+        {
+            bridged_es_Pop( p_es );
+            b_dropped = true;
+        }
+        vlc_global_unlock( VLC_MOSAIC_MUTEX );
+    }
+    p_es->pp_queue[i_write % BRIDGE_QUEUE_SIZE] = p_pic;
+    atomic_store_explicit( &p_es->i_write, i_write + 1, memory_order_release );
+    return !b_dropped;
+}
+
+/* Returns the i-th oldest picture, or NULL (mosaic side) */
+static inline picture_t *bridged_es_Peek( bridged_es_t *p_es, unsigned i )
+{
+    unsigned i_read = atomic_load_explicit( &p_es->i_read,
+                                            memory_order_relaxed );
+    unsigned i_write = atomic_load_explicit( &p_es->i_write,
+                                             memory_order_acquire );
+
+    if( i_write - i_read <= i )
+        return NULL;
+    return p_es->pp_queue[(i_read + i) % BRIDGE_QUEUE_SIZE];
+}
+
 typedef struct bridge_t
 {
     bridged_es_t **pp_es;
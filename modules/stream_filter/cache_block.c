@@ -54,6 +54,17 @@
 #   define STREAM_CACHE_SIZE  (4*12*1024*1024)
 #endif
 
+/* Lower bound of the adaptive cache size */
+#define STREAM_CACHE_MIN_SIZE (1024*128)
+
+/* The cache should hold enough data to cover that many upstream read
+ * latencies at the demuxer consumption rate */
+#define STREAM_CACHE_LATENCY_FACTOR 32
+
+/* A read that finds no data ahead and waits longer than this for the
+ * source is an underrun */
+#define STREAM_CACHE_UNDERRUN_DELAY (CLOCK_FREQ / 50)
+
 /* How many data we try to prebuffer
  * XXX it should be small to avoid useless latency but big enough for
  * efficient demux probing */
@@ -61,7 +72,10 @@
 
 /* Method: Simple, for pf_block.
  *  We get blocks and put them in the linked list.
- *  We release blocks once the total size is bigger than STREAM_CACHE_SIZE
+ *  We release blocks once the total size is bigger than i_cache_size.
+ *  i_cache_size starts at STREAM_CACHE_MIN_SIZE, doubles on each underrun
+ *  and follows the measured upstream latency and the demuxer consumption
+ *  rate, up to i_cache_max.
  */
 
 struct stream_sys_t
@@ -76,21 +90,93 @@ struct stream_sys_t
     block_t     *p_first;
     block_t    **pp_last;
 
+    uint64_t     i_cache_size;   /* Current cache size target */
+    uint64_t     i_cache_floor;  /* Lower bound, grown on underruns */
+    uint64_t     i_cache_max;    /* Cache size limit */
+
     struct
     {
         /* Stat about reading data */
         uint64_t i_read_count;
         uint64_t i_bytes;
         uint64_t i_read_time;
+
+        /* Smoothed upstream latency and its decaying peak */
+        mtime_t  i_latency;
+        mtime_t  i_latency_peak;
+
+        /* Demuxer consumption */
+        uint64_t i_consumed;     /* Bytes returned since i_consume_date */
+        mtime_t  i_consume_date;
+        uint64_t i_consumption;  /* Smoothed consumption rate (bytes/s) */
+
+        unsigned i_underruns;
     } stat;
 };
 
+static void AStreamUpdateCacheSize(stream_t *s, mtime_t i_latency)
+{
+    stream_sys_t *sys = s->p_sys;
+    const mtime_t now = mdate();
+
+    /* Exponential moving averages, 1/8 weight for the new sample */
+    if (sys->stat.i_latency == 0)
+        sys->stat.i_latency = i_latency;
+    else
+        sys->stat.i_latency += (i_latency - sys->stat.i_latency) / 8;
+
+    /* The peak decays slowly so that bursty sources keep a deep cache */
+    sys->stat.i_latency_peak -= sys->stat.i_latency_peak / 16;
+    if (i_latency > sys->stat.i_latency_peak)
+        sys->stat.i_latency_peak = i_latency;
+
+    const mtime_t i_elapsed = now - sys->stat.i_consume_date;
+    if (i_elapsed >= CLOCK_FREQ / 10)
+    {
+        uint64_t i_rate = sys->stat.i_consumed * CLOCK_FREQ / i_elapsed;
+
+        if (sys->stat.i_consumption == 0)
+            sys->stat.i_consumption = i_rate;
+        else
+            sys->stat.i_consumption = (7 * sys->stat.i_consumption + i_rate) / 8;
+        sys->stat.i_consumed = 0;
+        sys->stat.i_consume_date = now;
+    }
+
+    /* Keep the current size until the demuxer pace is known (probing
+     * seeks back to the start of the stream) */
+    if (sys->stat.i_consumption == 0)
+        return;
+
+    uint64_t i_target = sys->stat.i_consumption
+                      * sys->stat.i_latency_peak / CLOCK_FREQ
+                      * STREAM_CACHE_LATENCY_FACTOR;
+
+    sys->i_cache_size = VLC_CLIP(i_target, sys->i_cache_floor,
+                                 sys->i_cache_max);
+}
+
+static void AStreamUnderrun(stream_t *s, mtime_t i_latency)
+{
+    stream_sys_t *sys = s->p_sys;
+
+    sys->stat.i_underruns++;
+    if (sys->i_cache_floor >= sys->i_cache_max)
+        return;
+
+    sys->i_cache_floor = __MIN(2 * sys->i_cache_floor, sys->i_cache_max);
+    if (sys->i_cache_size < sys->i_cache_floor)
+        sys->i_cache_size = sys->i_cache_floor;
+    msg_Dbg(s, "underrun after %"PRId64" ms, cache size %"PRIu64" KiB",
+            i_latency / 1000, sys->i_cache_size >> 10);
+}
+
 static int AStreamRefillBlock(stream_t *s)
 {
     stream_sys_t *sys = s->p_sys;
 
     /* Release data */
-    while (sys->i_size >= STREAM_CACHE_SIZE &&
+    while (sys->i_size >= sys->i_cache_size &&
            sys->p_first != sys->p_current)
     {
         block_t *b = sys->p_first;
@@ -101,7 +187,7 @@ static int AStreamRefillBlock(stream_t *s)
 
         block_Release(b);
     }
-    if (sys->i_size >= STREAM_CACHE_SIZE &&
+    if (sys->i_size >= sys->i_cache_size &&
         sys->p_current == sys->p_first &&
         sys->p_current->p_next)    /* At least 2 packets */
     {
@@ -125,7 +211,12 @@ static int AStreamRefillBlock(stream_t *s)
             return VLC_EGENERIC;
     }
 
-    sys->stat.i_read_time += mdate() - start;
+    const mtime_t i_latency = mdate() - start;
+    sys->stat.i_read_time += i_latency;
+    /* The reader waits on the source when there is no data ahead */
+    if (sys->p_current == NULL && i_latency > STREAM_CACHE_UNDERRUN_DELAY)
+        AStreamUnderrun(s, i_latency);
+    AStreamUpdateCacheSize(s, i_latency);
     while (b)
     {
         /* Append the block */
@@ -292,7 +383,7 @@ static int AStreamSeekBlock(stream_t *s, uint64_t i_pos)
             int i_th = b_aseekfast ? 1 : 5;
 
             if (i_skip <= i_th * i_avg &&
-                i_skip < STREAM_CACHE_SIZE)
+                (uint64_t)i_skip < sys->i_cache_size)
                 b_seek = false;
             else
                 b_seek = true;
@@ -388,6 +479,7 @@ static ssize_t AStreamReadBlock(stream_t *s, void *buf, size_t len)
         return AStreamReadBlock( s, buf, len );
 
     sys->i_pos += i_copy;
+    sys->stat.i_consumed += i_copy;
     return i_copy;
 }
 
@@ -418,6 +510,26 @@ static int AStreamControl(stream_t *s, int i_query, va_list args)
         case STREAM_GET_PRIVATE_ID_STATE:
             return vlc_stream_vaControl(s->p_source, i_query, args);
 
+        case STREAM_GET_CACHE_STATS:
+        {
+            stream_sys_t *sys = s->p_sys;
+            stream_cache_stats_t *p_stats = va_arg(args, stream_cache_stats_t *);
+            uint64_t i_level = 0;
+
+            if (sys->p_current != NULL)
+                i_level = sys->i_start + sys->i_size - sys->i_pos;
+
+            p_stats->i_size = sys->i_cache_size;
+            p_stats->i_max_size = sys->i_cache_max;
+            p_stats->i_level = i_level;
+            p_stats->i_byterate = (CLOCK_FREQ * sys->stat.i_bytes) /
+                                  (sys->stat.i_read_time + 1);
+            p_stats->i_consumption = sys->stat.i_consumption;
+            p_stats->i_latency = sys->stat.i_latency;
+            p_stats->i_underruns = sys->stat.i_underruns;
+            break;
+        }
+
         case STREAM_SET_TITLE:
         case STREAM_SET_SEEKPOINT:
         {
@@ -450,6 +562,17 @@ static int Open(vlc_object_t *obj)
     sys->stat.i_bytes = 0;
     sys->stat.i_read_time = 0;
     sys->stat.i_read_count = 0;
+    sys->stat.i_latency = 0;
+    sys->stat.i_latency_peak = 0;
+    sys->stat.i_consumed = 0;
+    sys->stat.i_consume_date = mdate();
+    sys->stat.i_consumption = 0;
+    sys->stat.i_underruns = 0;
+
+    /* Start small, and let the underruns and measurements grow the cache */
+    sys->i_cache_max = var_InheritInteger(s, "cache-block-max-size") << 10;
+    sys->i_cache_floor = __MIN(STREAM_CACHE_MIN_SIZE, sys->i_cache_max);
+    sys->i_cache_size = sys->i_cache_floor;
 
     msg_Dbg(s, "Using block method for AStream*");
 
@@ -497,4 +620,9 @@ vlc_module_begin()
 
     set_description(N_("Block stream cache"))
     set_callbacks(Open, Close)
+
+    add_integer("cache-block-max-size", STREAM_CACHE_SIZE >> 10,
+                N_("Maximum cache size"),
+                N_("Upper bound of the adaptive block cache (KiB)"), true)
+        change_integer_range(4, 1 << 20)
 vlc_module_end()
@@ -0,0 +1,545 @@
+/*****************************************************************************
+ * cache_shared.c: process-wide byte range cache for network streams
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_stream.h>
+#include <vlc_interrupt.h>
+
+/*
+ * All the instances of this filter within the process share a single cache.
+ * Resources are identified by their URL, and by their size and validator
+ * (e.g. HTTP entity tag) to detect changes. Each resource is split into
+ * fixed-size chunks, which are stored in a global least-recently-used list
+ * bounded by the "cache-shared-size" option.
+ *
+ * The first instance to need a chunk fetches it through its own access,
+ * while other instances needing the same chunk wait for it to complete, or
+ * for their own interruption.
+ */
+
+#define CHUNK_SIZE (256 * 1024)
+
+struct shared_chunk
+{
+    struct shared_resource *res;
+    struct shared_chunk *lru_prev; /**< more recently used */
+    struct shared_chunk *lru_next; /**< less recently used */
+    uint64_t index;
+    size_t length;
+    unsigned refs;
+    vlc_cond_t wait; /**< signaled when the fetch completes */
+    bool pending; /**< being fetched */
+    bool failed; /**< fetch failed, no longer in the cache */
+    unsigned char data[];
+};
+
+struct shared_resource
+{
+    struct shared_resource *next;
+    char *url;
+    char *validator;
+    uint64_t size;
+    uint64_t chunk_count;
+    struct shared_chunk **chunks;
+    unsigned users; /**< instances reading the resource */
+    unsigned cached; /**< chunks in the cache */
+    bool listed; /**< can be found by new instances */
+};
+
+static struct
+{
+    vlc_mutex_t lock;
+    struct shared_resource *resources;
+    struct shared_chunk *lru_first;
+    struct shared_chunk *lru_last;
+    uint64_t size;
+} cache = { VLC_STATIC_MUTEX, NULL, NULL, NULL, 0 };
+
+struct stream_sys_t
+{
+    struct shared_resource *res;
+    uint64_t offset; /**< downstream read offset */
+    uint64_t source_offset; /**< upstream read offset */
+    uint64_t max_size;
+};
+
+/* All the following functions must be called with the cache lock held. */
+
+static void LRUUnlink(struct shared_chunk *chunk)
+{
+    if (chunk->lru_prev != NULL)
+        chunk->lru_prev->lru_next = chunk->lru_next;
+    else
+        cache.lru_first = chunk->lru_next;
+    if (chunk->lru_next != NULL)
+        chunk->lru_next->lru_prev = chunk->lru_prev;
+    else
+        cache.lru_last = chunk->lru_prev;
+}
+
+static void LRUPushFront(struct shared_chunk *chunk)
+{
+    chunk->lru_prev = NULL;
+    chunk->lru_next = cache.lru_first;
+    if (cache.lru_first != NULL)
+        cache.lru_first->lru_prev = chunk;
+    else
+        cache.lru_last = chunk;
+    cache.lru_first = chunk;
+}
+
+static void ChunkUnlink(struct shared_chunk *chunk)
+{
+    struct shared_resource *res = chunk->res;
+
+    LRUUnlink(chunk);
+    res->chunks[chunk->index] = NULL;
+    cache.size -= chunk->length;
+
+    assert(res->cached > 0);
+    res->cached--;
+}
+
+static void ChunkFree(struct shared_chunk *chunk)
+{
+    vlc_cond_destroy(&chunk->wait);
+    free(chunk);
+}
+
+static void ChunkRemove(struct shared_chunk *chunk)
+{
+    assert(chunk->refs == 0);
+    ChunkUnlink(chunk);
+    ChunkFree(chunk);
+}
+
+static void ResourceUnlist(struct shared_resource *res)
+{
+    assert(res->listed);
+
+    struct shared_resource **pp = &cache.resources;
+
+    while (*pp != res)
+    {
+        assert(*pp != NULL);
+        pp = &(*pp)->next;
+    }
+    *pp = res->next;
+    res->listed = false;
+}
+
+/**
+ * Destroys a resource if it is neither in use nor worth keeping.
+ */
+static void ResourceCheck(struct shared_resource *res)
+{
+    if (res->users > 0)
+        return;
+
+    if (res->listed)
+    {
+        if (res->cached > 0)
+            return; /* keep it for later readers */
+        ResourceUnlist(res);
+    }
+
+    for (uint64_t i = 0; i < res->chunk_count && res->cached > 0; i++)
+        if (res->chunks[i] != NULL)
+            ChunkRemove(res->chunks[i]);
+
+    free(res->chunks);
+    free(res->validator);
+    free(res->url);
+    free(res);
+}
+
+static void ChunkDestroy(struct shared_chunk *chunk)
+{
+    struct shared_resource *res = chunk->res;
+
+    ChunkRemove(chunk);
+    ResourceCheck(res);
+}
+
+static void CacheTrim(uint64_t max_size)
+{
+    struct shared_chunk *chunk = cache.lru_last;
+
+    /* Destroying a chunk only ever destroys a resource without any other
+     * chunk, so the previous chunk remains valid. */
+    while (cache.size > max_size && chunk != NULL)
+    {
+        struct shared_chunk *prev = chunk->lru_prev;
+
+        if (chunk->refs == 0)
+            ChunkDestroy(chunk);
+        chunk = prev;
+    }
+}
+
+static struct shared_resource *ResourceGet(const char *url,
+                                           const char *validator,
+                                           uint64_t size)
+{
+    struct shared_resource *res;
+
+    for (res = cache.resources; res != NULL; res = res->next)
+    {
+        if (strcmp(res->url, url))
+            continue;
+
+        if (res->size == size
+         && (res->validator == NULL) == (validator == NULL)
+         && (validator == NULL || !strcmp(res->validator, validator)))
+        {
+            res->users++;
+            return res;
+        }
+
+        /* The resource has changed: drop whatever is not in use. Current
+         * readers keep using their version until they are closed. */
+        ResourceUnlist(res);
+        for (uint64_t i = 0; i < res->chunk_count; i++)
+        {
+            struct shared_chunk *chunk = res->chunks[i];
+            if (chunk != NULL && chunk->refs == 0)
+                ChunkRemove(chunk);
+        }
+        ResourceCheck(res);
+        break;
+    }
+
+    res = malloc(sizeof (*res));
+    if (unlikely(res == NULL))
+        return NULL;
+
+    res->url = strdup(url);
+    res->validator = (validator != NULL) ? strdup(validator) : NULL;
+    res->size = size;
+    res->chunk_count = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    res->chunks = calloc(res->chunk_count, sizeof (*res->chunks));
+    res->users = 1;
+    res->cached = 0;
+
+    if (unlikely(res->url == NULL || res->chunks == NULL
+              || (validator != NULL && res->validator == NULL)))
+    {
+        free(res->chunks);
+        free(res->validator);
+        free(res->url);
+        free(res);
+        return NULL;
+    }
+
+    res->listed = true;
+    res->next = cache.resources;
+    cache.resources = res;
+    return res;
+}
+
+/* End of functions requiring the cache lock */
+
+struct chunk_waiter
+{
+    struct shared_chunk *chunk;
+    bool interrupted;
+};
+
+static void ChunkWaitInterrupted(void *data)
+{
+    struct chunk_waiter *waiter = data;
+
+    vlc_mutex_lock(&cache.lock);
+    waiter->interrupted = true;
+    vlc_cond_broadcast(&waiter->chunk->wait);
+    vlc_mutex_unlock(&cache.lock);
+}
+
+/**
+ * Waits for another instance to fetch a chunk, or for an interruption.
+ * Called with the lock held and a reference to the chunk, which is released
+ * if the chunk cannot be used.
+ * \return 0 if the chunk is ready, -1 otherwise
+ */
+static int ChunkWait(struct shared_chunk *chunk)
+{
+    struct chunk_waiter waiter = { chunk, false };
+
+    /* The interrupt callback takes the lock */
+    vlc_mutex_unlock(&cache.lock);
+    vlc_interrupt_register(ChunkWaitInterrupted, &waiter);
+    vlc_mutex_lock(&cache.lock);
+    while (chunk->pending && !waiter.interrupted)
+        vlc_cond_wait(&chunk->wait, &cache.lock);
+    vlc_mutex_unlock(&cache.lock);
+    vlc_interrupt_unregister();
+    vlc_mutex_lock(&cache.lock);
+
+    if (!chunk->pending && !chunk->failed)
+        return 0;
+
+    /* The fetching instance left a failed chunk to its last user */
+    chunk->refs--;
+    if (chunk->failed && chunk->refs == 0)
+        ChunkFree(chunk);
+    return -1;
+}
+
+/**
+ * Fetches one chunk from the upstream access. Called without the lock.
+ */
+static ssize_t FetchChunk(stream_t *s, uint64_t index, unsigned char *buf)
+{
+    stream_sys_t *sys = s->p_sys;
+    uint64_t offset = index * CHUNK_SIZE;
+    size_t length = CHUNK_SIZE;
+
+    if (offset + length > sys->res->size)
+        length = sys->res->size - offset;
+
+    if (sys->source_offset != offset)
+    {
+        if (vlc_stream_Seek(s->p_source, offset))
+            return -1;
+        sys->source_offset = offset;
+    }
+
+    ssize_t val = vlc_stream_Read(s->p_source, buf, length);
+    if (val > 0)
+        sys->source_offset += val;
+    if ((size_t)val != length)
+    {
+        msg_Err(s, "cannot fetch chunk %"PRIu64" (%zd of %zu bytes)",
+                index, val, length);
+        return -1;
+    }
+    return val;
+}
+
+static ssize_t Read(stream_t *s, void *buf, size_t len)
+{
+    stream_sys_t *sys = s->p_sys;
+    struct shared_resource *res = sys->res;
+
+    if (sys->offset >= res->size || len == 0)
+        return 0;
+
+    uint64_t index = sys->offset / CHUNK_SIZE;
+    struct shared_chunk *chunk;
+
+    vlc_mutex_lock(&cache.lock);
+    chunk = res->chunks[index];
+
+    if (chunk != NULL && chunk->pending)
+    {   /* Being fetched by another instance */
+        chunk->refs++;
+        if (ChunkWait(chunk))
+        {
+            vlc_mutex_unlock(&cache.lock);
+            return -1; /* not the end of the stream */
+        }
+        LRUUnlink(chunk);
+        LRUPushFront(chunk);
+    }
+    else if (chunk == NULL)
+    {   /* Not cached: fetch it ourselves */
+        chunk = malloc(sizeof (*chunk) + CHUNK_SIZE);
+        if (unlikely(chunk == NULL))
+        {
+            vlc_mutex_unlock(&cache.lock);
+            return -1;
+        }
+
+        chunk->res = res;
+        chunk->index = index;
+        chunk->length = 0;
+        chunk->refs = 1;
+        vlc_cond_init(&chunk->wait);
+        chunk->pending = true;
+        chunk->failed = false;
+        res->chunks[index] = chunk;
+        res->cached++;
+        LRUPushFront(chunk);
+        vlc_mutex_unlock(&cache.lock);
+
+        ssize_t val = FetchChunk(s, index, chunk->data);
+
+        vlc_mutex_lock(&cache.lock);
+        chunk->pending = false;
+        vlc_cond_broadcast(&chunk->wait);
+
+        if (val < 0)
+        {
+            chunk->refs--;
+            if (chunk->refs == 0)
+                ChunkDestroy(chunk);
+            else
+            {   /* the waiting instances free it */
+                chunk->failed = true;
+                ChunkUnlink(chunk);
+            }
+            vlc_mutex_unlock(&cache.lock);
+            return -1; /* not the end of the stream */
+        }
+
+        chunk->length = val;
+        cache.size += val;
+        CacheTrim(sys->max_size);
+    }
+    else
+    {
+        chunk->refs++;
+        LRUUnlink(chunk);
+        LRUPushFront(chunk);
+    }
+    vlc_mutex_unlock(&cache.lock);
+
+    /* The chunk cannot be evicted nor modified while referenced. */
+    size_t offset = sys->offset - index * CHUNK_SIZE;
+    size_t copy = chunk->length - offset;
+
+    if (copy > len)
+        copy = len;
+    memcpy(buf, chunk->data + offset, copy);
+    sys->offset += copy;
+
+    vlc_mutex_lock(&cache.lock);
+    chunk->refs--;
+    CacheTrim(sys->max_size);
+    vlc_mutex_unlock(&cache.lock);
+    return copy;
+}
+
+static int Seek(stream_t *s, uint64_t offset)
+{
+    stream_sys_t *sys = s->p_sys;
+
+    sys->offset = offset;
+    return VLC_SUCCESS;
+}
+
+static int Control(stream_t *s, int query, va_list args)
+{
+    switch (query)
+    {
+        case STREAM_CAN_SEEK:
+        case STREAM_CAN_FASTSEEK:
+        case STREAM_CAN_PAUSE:
+        case STREAM_CAN_CONTROL_PACE:
+        case STREAM_GET_SIZE:
+        case STREAM_GET_PTS_DELAY:
+        case STREAM_GET_META:
+        case STREAM_GET_CONTENT_TYPE:
+        case STREAM_GET_VALIDATOR:
+        case STREAM_SET_PAUSE_STATE:
+            return vlc_stream_vaControl(s->p_source, query, args);
+
+        default:
+            return VLC_EGENERIC;
+    }
+}
+
+static int Open(vlc_object_t *obj)
+{
+    stream_t *s = (stream_t *)obj;
+    uint64_t size;
+    bool can_seek;
+
+    if (s->psz_url == NULL || s->p_source->pf_readdir != NULL)
+        return VLC_EGENERIC;
+
+    /* Local files are in the page cache already */
+    if (!strncasecmp(s->psz_url, "file:", 5))
+        return VLC_EGENERIC;
+
+    /* Only fixed-size seekable resources can be shared */
+    vlc_stream_Control(s->p_source, STREAM_CAN_SEEK, &can_seek);
+    if (!can_seek || vlc_stream_GetSize(s->p_source, &size) || size == 0)
+        return VLC_EGENERIC;
+
+    char *validator;
+    if (vlc_stream_Control(s->p_source, STREAM_GET_VALIDATOR, &validator))
+        validator = NULL;
+
+    stream_sys_t *sys = malloc(sizeof (*sys));
+    if (unlikely(sys == NULL))
+    {
+        free(validator);
+        return VLC_ENOMEM;
+    }
+
+    sys->offset = 0;
+    sys->source_offset = 0;
+    sys->max_size = var_InheritInteger(s, "cache-shared-size") << 20;
+
+    vlc_mutex_lock(&cache.lock);
+    sys->res = ResourceGet(s->psz_url, validator, size);
+    vlc_mutex_unlock(&cache.lock);
+    free(validator);
+
+    if (sys->res == NULL)
+    {
+        free(sys);
+        return VLC_ENOMEM;
+    }
+
+    msg_Dbg(s, "sharing %"PRIu64" bytes resource %s", size, s->psz_url);
+    s->p_sys = sys;
+    s->pf_read = Read;
+    s->pf_seek = Seek;
+    s->pf_control = Control;
+    return VLC_SUCCESS;
+}
+
+static void Close(vlc_object_t *obj)
+{
+    stream_t *s = (stream_t *)obj;
+    stream_sys_t *sys = s->p_sys;
+
+    vlc_mutex_lock(&cache.lock);
+    assert(sys->res->users > 0);
+    sys->res->users--;
+    ResourceCheck(sys->res);
+    vlc_mutex_unlock(&cache.lock);
+    free(sys);
+}
+
+vlc_module_begin()
+    set_category(CAT_INPUT)
+    set_subcategory(SUBCAT_INPUT_STREAM_FILTER)
+    set_capability("stream_filter", 0)
+
+    set_description(N_("Shared stream cache"))
+    set_callbacks(Open, Close)
+
+    add_integer("cache-shared-size", 256, N_("Shared cache size"),
+                N_("Memory shared by all the inputs of the process to cache "
+                   "recently read network data (MiB)."), true)
+        change_integer_range(1, 1 << 16)
+vlc_module_end()
@@ -61,6 +61,26 @@ struct stream_sys_t
     char        *buffer;
     size_t       read_size;
     size_t       seek_threshold;
+
+    /* Adaptive buffer sizing */
+    bool         adaptive;
+    bool         full; /**< buffer was filled since the last underrun */
+    bool         grow; /**< reader ran dry after the buffer was full */
+    size_t       min_size;
+    size_t       max_size;
+    mtime_t      resize_date;
+
+    struct
+    {
+        uint64_t read_bytes;
+        mtime_t  read_time;
+        mtime_t  latency; /**< smoothed upstream read latency */
+        mtime_t  latency_peak;
+        uint64_t consumed; /**< bytes read since consume_date */
+        mtime_t  consume_date;
+        uint64_t consumption; /**< smoothed downstream read rate */
+        unsigned underruns;
+    } stats;
 };
 
 static ssize_t ThreadRead(stream_t *stream, void *buf, size_t length)
@@ -71,13 +91,134 @@ static ssize_t ThreadRead(stream_t *stream, void *buf, size_t length)
     vlc_mutex_unlock(&sys->lock);
     assert(length > 0);
 
+    mtime_t start = mdate();
     ssize_t val = vlc_stream_ReadPartial(stream->p_source, buf, length);
+    mtime_t latency = mdate() - start;
 
     vlc_mutex_lock(&sys->lock);
     vlc_restorecancel(canc);
+
+    if (val > 0)
+    {
+        sys->stats.read_bytes += val;
+        sys->stats.read_time += latency;
+        sys->stats.latency += (latency - sys->stats.latency) / 8;
+        /* The peak decays slowly, so that bursty sources keep a deep buffer */
+        sys->stats.latency_peak -= sys->stats.latency_peak / 64;
+        if (latency > sys->stats.latency_peak)
+            sys->stats.latency_peak = latency;
+    }
     return val;
 }
 
+/**
+ * Reallocates the circular buffer, preserving unread data and as much of the
+ * historical data as fits. Must be called with the lock held.
+ */
+static int ThreadResize(stream_t *stream, size_t size)
+{
+    stream_sys_t *sys = stream->p_sys;
+    uint64_t end = sys->buffer_offset + sys->buffer_length;
+    uint64_t start = sys->buffer_offset;
+
+    if (sys->stream_offset >= start && sys->stream_offset <= end)
+    {
+        if (end - sys->stream_offset > size)
+            return -1; /* would discard unread data */
+    }
+    if (end - start > size)
+        start = end - size;
+
+    char *buffer = malloc(size);
+    if (unlikely(buffer == NULL))
+        return -1;
+
+    for (uint64_t offset = start; offset < end;)
+    {
+        size_t from = offset % sys->buffer_size;
+        size_t to = offset % size;
+        size_t len = end - offset;
+
+        /* Do not step past the sharp edges of either circular buffer */
+        if (len > sys->buffer_size - from)
+            len = sys->buffer_size - from;
+        if (len > size - to)
+            len = size - to;
+
+        memcpy(buffer + to, sys->buffer + from, len);
+        offset += len;
+    }
+
+    msg_Dbg(stream, "resizing buffer from %zu to %zu bytes "
+            "(latency: %"PRId64" us, consumption: %"PRIu64" B/s)",
+            sys->buffer_size, size, sys->stats.latency_peak,
+            sys->stats.consumption);
+    free(sys->buffer);
+    sys->buffer = buffer;
+    sys->buffer_size = size;
+    sys->buffer_offset = start;
+    sys->buffer_length = end - start;
+    sys->resize_date = mdate();
+    return 0;
+}
+
+/* Buffer the downstream read rate for that many upstream read latencies */
+#define LATENCY_FACTOR 32
+/* Minimum delay between two buffer shrinks */
+#define SHRINK_DELAY (10 * CLOCK_FREQ)
+
+/**
+ * Grows the buffer after underruns, or shrinks it if the measured latency and
+ * consumption rate do not require that much read-ahead.
+ * Must be called with the lock held.
+ */
+static void ThreadAdapt(stream_t *stream)
+{
+    stream_sys_t *sys = stream->p_sys;
+    mtime_t now = mdate();
+    mtime_t elapsed = now - sys->stats.consume_date;
+
+    if (elapsed >= CLOCK_FREQ)
+    {
+        uint64_t rate = sys->stats.consumed * CLOCK_FREQ / elapsed;
+
+        if (sys->stats.consumption == 0)
+            sys->stats.consumption = rate;
+        else
+            sys->stats.consumption = (sys->stats.consumption * 7 + rate) / 8;
+        sys->stats.consumed = 0;
+        sys->stats.consume_date = now;
+    }
+
+    if (sys->grow)
+    {
+        sys->grow = false;
+        if (sys->buffer_size < sys->max_size)
+        {
+            size_t size = sys->buffer_size * 2;
+            if (size > sys->max_size)
+                size = sys->max_size;
+            ThreadResize(stream, size);
+        }
+        return;
+    }
+
+    if (sys->buffer_size <= sys->min_size
+     || now - sys->resize_date < SHRINK_DELAY)
+        return;
+
+    uint64_t need = sys->stats.consumption * sys->stats.latency_peak
+                  / CLOCK_FREQ * LATENCY_FACTOR;
+    if (need * 4 < sys->buffer_size)
+    {
+        size_t size = sys->buffer_size / 2;
+        if (size < sys->min_size)
+            size = sys->min_size;
+        if (ThreadResize(stream, size))
+            sys->resize_date = now; /* retry later */
+    }
+}
+
 static int ThreadSeek(stream_t *stream, uint64_t seek_offset)
 {
     stream_sys_t *sys = stream->p_sys;
@@ -143,6 +284,9 @@ static void *Thread(void *data)
             continue;
         }
 
+        if (sys->adaptive)
+            ThreadAdapt(stream);
+
         uint_fast64_t stream_offset = sys->stream_offset;
 
         if (stream_offset < sys->buffer_offset)
@@ -209,6 +353,7 @@ static void *Thread(void *data)
         {   /* Buffer is full */
             if (history == 0)
             {   /* Wait for data to be read */
+                sys->full = true;
                 vlc_cond_wait(&sys->wait_space, &sys->lock);
                 continue;
             }
@@ -291,7 +436,7 @@ static ssize_t Read(stream_t *stream, void *buf, size_t buflen)
 {
     stream_sys_t *sys = stream->p_sys;
     size_t copy, offset;
-    bool eof;
+    bool eof, underrun = false;
 
     if (buflen == 0)
         return buflen;
@@ -314,6 +459,19 @@ static ssize_t Read(stream_t *stream, void *buf, size_t buflen)
             return 0;
         }
 
+        if (!underrun
+         && sys->stream_offset == sys->buffer_offset + sys->buffer_length)
+        {   /* Caught up with the prefetch thread */
+            underrun = true;
+            sys->stats.underruns++;
+            if (sys->full)
+            {   /* Buffering more would have avoided this */
+                sys->full = false;
+                sys->grow = true;
+                vlc_cond_signal(&sys->wait_space);
+            }
+        }
+
         vlc_interrupt_forward_start(sys->interrupt, data);
         vlc_cond_wait(&sys->wait_data, &sys->lock);
         vlc_interrupt_forward_stop(data);
@@ -328,6 +486,7 @@ static ssize_t Read(stream_t *stream, void *buf, size_t buflen)
 
     memcpy(buf, sys->buffer + offset, copy);
     sys->stream_offset += copy;
+    sys->stats.consumed += copy;
     vlc_cond_signal(&sys->wait_space);
     vlc_mutex_unlock(&sys->lock);
     return copy;
@@ -379,6 +538,23 @@ static int Control(stream_t *stream, int query, va_list args)
             return VLC_SUCCESS;
         case STREAM_GET_SIGNAL:
             return VLC_EGENERIC;
+        case STREAM_GET_CACHE_STATS:
+        {
+            stream_cache_stats_t *stats = va_arg(args, stream_cache_stats_t *);
+            bool eof;
+
+            vlc_mutex_lock(&sys->lock);
+            stats->i_size = sys->buffer_size;
+            stats->i_max_size = sys->max_size;
+            stats->i_level = BufferLevel(stream, &eof);
+            stats->i_byterate = sys->stats.read_bytes * CLOCK_FREQ
+                              / (sys->stats.read_time + 1);
+            stats->i_consumption = sys->stats.consumption;
+            stats->i_latency = sys->stats.latency;
+            stats->i_underruns = sys->stats.underruns;
+            vlc_mutex_unlock(&sys->lock);
+            break;
+        }
         case STREAM_SET_PAUSE_STATE:
         {
             bool paused = va_arg(args, unsigned);
@@ -452,6 +628,9 @@ static int Open(vlc_object_t *obj)
     sys->buffer_size = var_InheritInteger(obj, "prefetch-buffer-size") << 10u;
     sys->read_size = var_InheritInteger(obj, "prefetch-read-size");
     sys->seek_threshold = var_InheritInteger(obj, "prefetch-seek-threshold");
+    sys->adaptive = var_InheritBool(obj, "prefetch-adaptive");
+    sys->full = false;
+    sys->grow = false;
 
     uint64_t size = stream_Size(stream->p_source);
     if (size > 0)
@@ -464,6 +643,18 @@ static int Open(vlc_object_t *obj)
     if (sys->buffer_size < sys->read_size)
         sys->buffer_size = sys->read_size;
 
+    /* The configured size is the limit. In adaptive mode, start from a small
+     * buffer, and grow it as underruns occur. */
+    sys->max_size = sys->buffer_size;
+    sys->min_size = sys->read_size * 4;
+    if (sys->min_size > sys->max_size)
+        sys->min_size = sys->max_size;
+    if (sys->adaptive && sys->buffer_size > sys->min_size * 16)
+        sys->buffer_size = sys->min_size * 16;
+
+    memset(&sys->stats, 0, sizeof (sys->stats));
+    sys->stats.consume_date = sys->resize_date = mdate();
+
     sys->buffer = malloc(sys->buffer_size);
     if (sys->buffer == NULL)
         goto error;
@@ -534,6 +725,10 @@ vlc_module_begin()
     add_integer("prefetch-buffer-size", 1 << 14, N_("Buffer size"),
                 N_("Prefetch buffer size (KiB)"), false)
         change_integer_range(4, 1 << 20)
+    add_bool("prefetch-adaptive", true, N_("Adaptive buffer size"),
+             N_("Size the prefetch buffer according to the measured source "
+                "latency and read rate, up to the configured buffer size."),
+             true)
     add_integer("prefetch-read-size", 1 << 14, N_("Read size"),
                 N_("Prefetch background read size (bytes)"), true)
         change_integer_range(1, 1 << 29)
@@ -358,20 +358,13 @@ static sout_stream_id_sys_t * Add( sout_stream_t *p_stream, const es_format_t *p
 
     //p_es->fmt = *p_fmt;
     p_es->psz_id = p_sys->psz_id;
-    p_es->p_picture = NULL;
-    p_es->pp_last = &p_es->p_picture;
+    bridged_es_Init( p_es );
     p_es->b_empty = false;
 
     vlc_global_unlock( VLC_MOSAIC_MUTEX );
 
-    if ( p_sys->i_height || p_sys->i_width )
-    {
-        p_sys->p_image = image_HandlerCreate( p_stream );
-    }
-    else
-    {
-        p_sys->p_image = NULL;
-    }
+    /* Also used to scale to the mosaic tile */
+    p_sys->p_image = image_HandlerCreate( p_stream );
 
     msg_Dbg( p_stream, "mosaic bridge id=%s pos=%d", p_es->psz_id, i );
 
@@ -444,12 +437,8 @@ static void Del( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
     p_es = p_sys->p_es;
 
     p_es->b_empty = true;
-    while ( p_es->p_picture )
-    {
-        picture_t *p_next = p_es->p_picture->p_next;
-        picture_Release( p_es->p_picture );
-        p_es->p_picture = p_next;
-    }
+    while ( bridged_es_Peek( p_es, 0 ) != NULL )
+        bridged_es_Pop( p_es );
 
     for ( i = 0; i < p_bridge->i_es_num; i++ )
     {
@@ -486,6 +475,9 @@ static int decoder_queue_video( decoder_t *p_dec, picture_t *p_pic )
     sout_stream_sys_t *p_sys = p_stream->p_sys;
     picture_t *p_new_pic;
     const video_format_t *p_fmt_in = &p_sys->p_decoder->fmt_out.video;
+    bridged_es_t *p_es = p_sys->p_es;
+    unsigned i_tile_width = atomic_load( &p_es->i_tile_width );
+    unsigned i_tile_height = atomic_load( &p_es->i_tile_height );
 
     if( p_sys->i_height || p_sys->i_width )
     {
@@ -534,6 +526,28 @@ static int decoder_queue_video( decoder_t *p_dec, picture_t *p_pic )
             return -1;
         }
     }
+    else if( i_tile_width && i_tile_height )
+    {
+        /* Convert to the tile here, rather than on the mosaic thread for
+         * all the bridges */
+        video_format_t fmt_out;
+
+        video_format_Init( &fmt_out, p_sys->i_chroma ?
+                                     (vlc_fourcc_t)p_sys->i_chroma :
+                                     atomic_load( &p_es->i_tile_chroma ) );
+        fmt_out.i_width = fmt_out.i_visible_width = i_tile_width;
+        fmt_out.i_height = fmt_out.i_visible_height = i_tile_height;
+        fmt_out.i_sar_num = fmt_out.i_sar_den = 1;
+
+        p_new_pic = image_Convert( p_sys->p_image,
+                                   p_pic, p_fmt_in, &fmt_out );
+        if( p_new_pic == NULL )
+        {
+            msg_Err( p_stream, "image conversion failed" );
+            picture_Release( p_pic );
+            return -1;
+        }
+    }
     else
     {
         /* TODO: chroma conversion if needed */
@@ -556,13 +570,13 @@ static int decoder_queue_video( decoder_t *p_dec, picture_t *p_pic )
     if( p_sys->p_vf2 )
         p_new_pic = filter_chain_VideoFilter( p_sys->p_vf2, p_new_pic );
 
+    if( p_new_pic == NULL )
+        return 0;
+
     /* push the picture in the mosaic-struct structure */
-    bridged_es_t *p_es = p_sys->p_es;
-    vlc_global_lock( VLC_MOSAIC_MUTEX );
-    *p_es->pp_last = p_new_pic;
     p_new_pic->p_next = NULL;
-    p_es->pp_last = &p_new_pic->p_next;
-    vlc_global_unlock( VLC_MOSAIC_MUTEX );
+    if( !bridged_es_Push( p_es, p_new_pic ) )
+        msg_Dbg( p_stream, "mosaic late, dropping oldest picture" );
     return 0;
 }
 
@@ -577,6 +591,11 @@ static int Send( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
         return VLC_SUCCESS;
     }
 
+    /* Decoders may work in place */
+    p_buffer = block_Unshare( p_buffer );
+    if( p_buffer == NULL )
+        return VLC_ENOMEM;
+
     int ret = p_sys->p_decoder->pf_decode( p_sys->p_decoder, p_buffer );
     return ret == VLCDEC_SUCCESS ? VLC_SUCCESS : VLC_EGENERIC;
 }
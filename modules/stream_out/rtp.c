@@ -137,6 +137,12 @@
     "Default caching value for outbound RTP streams. This " \
     "value should be set in milliseconds." )
 
+#define FANOUT_TEXT N_("Fan-out threads")
+#define FANOUT_LONGTEXT N_( \
+    "Number of threads sending the RTP packets to the receivers. " \
+    "With many unicast receivers (RTSP sessions), they are spread across " \
+    "these threads. With 0, packets are sent by the pacing thread." )
+
 #define PROTO_TEXT N_("Transport protocol")
 #define PROTO_LONGTEXT N_( \
     "This selects which transport protocol to use for RTP." )
@@ -227,6 +233,8 @@ vlc_module_begin ()
               RTCP_MUX_TEXT, RTCP_MUX_LONGTEXT, false )
     add_integer( SOUT_CFG_PREFIX "caching", DEFAULT_PTS_DELAY / 1000,
                  CACHING_TEXT, CACHING_LONGTEXT, true )
+    add_integer_with_range( SOUT_CFG_PREFIX "fanout-threads", 0, 0, 64,
+                            FANOUT_TEXT, FANOUT_LONGTEXT, true )
 
 #ifdef HAVE_SRTP
     add_string( SOUT_CFG_PREFIX "key", "",
@@ -263,7 +271,7 @@ vlc_module_end ()
 static const char *const ppsz_sout_options[] = {
     "dst", "name", "cat", "port", "port-audio", "port-video", "*sdp", "ttl",
     "mux", "sap", "description", "url", "email",
-    "proto", "rtcp-mux", "caching",
+    "proto", "rtcp-mux", "caching", "fanout-threads",
 #ifdef HAVE_SRTP
     "key", "salt",
 #endif
@@ -280,7 +288,6 @@ static int               MuxSend( sout_stream_t *, sout_stream_id_sys_t *,
                                   block_t* );
 
 static sout_access_out_t *GrabberCreate( sout_stream_t *p_sout );
-static void* ThreadSend( void * );
 static void *rtp_listen_thread( void * );
 
 static void SDPHandleUrl( sout_stream_t *, const char * );
@@ -336,18 +343,15 @@ struct sout_stream_sys_t
     sout_access_out_t *p_grab;
     block_t           *packet;
 
+    /* Packets pacing and sending, shared by all ES */
+    rtp_sender_t    *sender;
+
     /* */
     vlc_mutex_t      lock_es;
     int              i_es;
     sout_stream_id_sys_t **es;
 };
 
-typedef struct rtp_sink_t
-{
-    int rtp_fd;
-    rtcp_sender_t *rtcp;
-} rtp_sink_t;
-
 struct sout_stream_id_sys_t
 {
     sout_stream_t *p_stream;
@@ -373,17 +377,14 @@ struct sout_stream_id_sys_t
 #endif
 
     /* Packets sinks */
-    vlc_thread_t      thread;
-    vlc_mutex_t       lock_sink;
-    int               sinkc;
-    rtp_sink_t       *sinkv;
+    rtp_flow_t       *flow;
+    int               dst_fd; /* explicit outgoing dst=, if any */
     rtsp_stream_id_t *rtsp_id;
     struct {
         int          *fd;
         vlc_thread_t  thread;
     } listen;
 
-    block_fifo_t     *p_fifo;
     int64_t           i_caching;
 };
 
@@ -545,6 +546,20 @@ static int Open( vlc_object_t *p_this )
     vlc_mutex_init( &p_sys->lock_ts );
     vlc_mutex_init( &p_sys->lock_es );
 
+    p_sys->sender = rtp_sender_New( VLC_OBJECT(p_stream),
+                var_GetInteger( p_stream, SOUT_CFG_PREFIX "fanout-threads" ),
+                p_sys->p_vod_media != NULL );
+    if( p_sys->sender == NULL )
+    {
+        vlc_mutex_destroy( &p_sys->lock_sdp );
+        vlc_mutex_destroy( &p_sys->lock_ts );
+        vlc_mutex_destroy( &p_sys->lock_es );
+        free( p_sys->psz_vod_session );
+        free( p_sys->psz_destination );
+        free( p_sys );
+        return VLC_ENOMEM;
+    }
+
     psz = var_GetNonEmptyString( p_stream, SOUT_CFG_PREFIX "mux" );
     if( psz != NULL )
     {
@@ -555,6 +570,7 @@ static int Open( vlc_object_t *p_this )
         {
             msg_Err( p_stream, "unsupported muxer type for RTP (only TS/PS)" );
             free( psz );
+            rtp_sender_Delete( p_sys->sender );
             vlc_mutex_destroy( &p_sys->lock_sdp );
             vlc_mutex_destroy( &p_sys->lock_ts );
             vlc_mutex_destroy( &p_sys->lock_es );
@@ -572,6 +588,7 @@ static int Open( vlc_object_t *p_this )
         {
             msg_Err( p_stream, "cannot create muxer" );
             sout_AccessOutDelete( p_sys->p_grab );
+            rtp_sender_Delete( p_sys->sender );
             vlc_mutex_destroy( &p_sys->lock_sdp );
             vlc_mutex_destroy( &p_sys->lock_ts );
             vlc_mutex_destroy( &p_sys->lock_es );
@@ -664,6 +681,7 @@ static void Close( vlc_object_t * p_this )
     if( p_sys->rtsp != NULL )
         RtspUnsetup( p_sys->rtsp );
 
+    rtp_sender_Delete( p_sys->sender );
     vlc_mutex_destroy( &p_sys->lock_sdp );
     vlc_mutex_destroy( &p_sys->lock_ts );
     vlc_mutex_destroy( &p_sys->lock_es );
@@ -811,7 +829,7 @@ char *SDPGenerate( sout_stream_t *p_stream, const char *rtsp_url )
             getsockname( p_sys->es[0]->listen.fd[0],
                          (struct sockaddr *)&dst, &dstlen );
         else
-            getpeername( p_sys->es[0]->sinkv[0].rtp_fd,
+            getpeername( p_sys->es[0]->dst_fd,
                          (struct sockaddr *)&dst, &dstlen );
     }
     else
@@ -972,11 +990,9 @@ static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
 #ifdef HAVE_SRTP
     id->srtp = NULL;
 #endif
-    vlc_mutex_init( &id->lock_sink );
-    id->sinkc = 0;
-    id->sinkv = NULL;
+    id->flow = NULL;
+    id->dst_fd = -1;
     id->rtsp_id = NULL;
-    id->p_fifo = NULL;
     id->listen.fd = NULL;
 
     id->b_first_packet = true;
@@ -985,6 +1001,43 @@ static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
 
     vlc_rand_bytes (&id->i_sequence, sizeof (id->i_sequence));
     vlc_rand_bytes (id->ssrc, sizeof (id->ssrc));
+    id->rtp_fmt.fmtp = NULL; /* don't free() garbage on error */
+
+#ifdef HAVE_SRTP
+    char *key = var_GetNonEmptyString (p_stream, SOUT_CFG_PREFIX"key");
+    if (key)
+    {
+        vlc_gcrypt_init ();
+        id->srtp = srtp_create (SRTP_ENCR_AES_CM, SRTP_AUTH_HMAC_SHA1,
+                                RTP_SRTP_TAG_LEN, SRTP_PRF_AES_CM,
+                                SRTP_RCC_MODE1);
+        if (id->srtp == NULL)
+        {
+            free (key);
+            goto error;
+        }
+
+        char *salt = var_GetNonEmptyString (p_stream, SOUT_CFG_PREFIX"salt");
+        int val = srtp_setkeystring (id->srtp, key, salt ? salt : "");
+        free (salt);
+        free (key);
+        if (val)
+        {
+            msg_Err (p_stream, "bad SRTP key/salt combination (%s)",
+                     vlc_strerror_c(val));
+            goto error;
+        }
+    }
+
+    id->flow = rtp_flow_New( p_sys->sender, VLC_OBJECT(p_stream),
+                             id->i_caching, id->srtp );
+#else
+    id->flow = rtp_flow_New( p_sys->sender, VLC_OBJECT(p_stream),
+                             id->i_caching, NULL );
+#endif
+    /* The flow must exist before vod_init_id() attaches RTSP sinks */
+    if( unlikely(id->flow == NULL) )
+        goto error;
 
     bool format = false;
 
@@ -1011,7 +1064,6 @@ static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
 
     if (!format)
     {
-        id->rtp_fmt.fmtp = NULL; /* don't free() garbage on error */
         char *psz = var_GetNonEmptyString( p_stream, SOUT_CFG_PREFIX "mux" );
         if (p_fmt == NULL && psz == NULL)
             goto error;
@@ -1022,30 +1074,8 @@ static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
     }
 
 #ifdef HAVE_SRTP
-    char *key = var_GetNonEmptyString (p_stream, SOUT_CFG_PREFIX"key");
-    if (key)
-    {
-        vlc_gcrypt_init ();
-        id->srtp = srtp_create (SRTP_ENCR_AES_CM, SRTP_AUTH_HMAC_SHA1, 10,
-                                   SRTP_PRF_AES_CM, SRTP_RCC_MODE1);
-        if (id->srtp == NULL)
-        {
-            free (key);
-            goto error;
-        }
-
-        char *salt = var_GetNonEmptyString (p_stream, SOUT_CFG_PREFIX"salt");
-        int val = srtp_setkeystring (id->srtp, key, salt ? salt : "");
-        free (salt);
-        free (key);
-        if (val)
-        {
-            msg_Err (p_stream, "bad SRTP key/salt combination (%s)",
-                     vlc_strerror_c(val));
-            goto error;
-        }
+    if (id->srtp != NULL)
         id->i_sequence = 0; /* FIXME: awful hack for libvlc_srtp */
-    }
 #endif
 
     id->i_seq_sent_next = id->i_sequence;
@@ -1139,7 +1169,7 @@ static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
                             sizeof (int));
                 rtp_add_sink( id, fd, p_sys->rtcp_mux, NULL );
                 /* FIXME: test if this is multicast  */
-                mcast_fd = fd;
+                mcast_fd = id->dst_fd = fd;
             }
         }
     }
@@ -1167,8 +1197,8 @@ static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
     int cscov = -1;
     if( cscov != -1 )
         cscov += 8 /* UDP */ + 12 /* RTP */;
-    if( id->sinkc > 0 )
-        net_SetCSCov( id->sinkv[0].rtp_fd, cscov, -1 );
+    if( id->dst_fd != -1 )
+        net_SetCSCov( id->dst_fd, cscov, -1 );
 #endif
 
     vlc_mutex_lock( &p_sys->lock_ts );
@@ -1182,16 +1212,6 @@ static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
         id->rtsp_id = RtspAddId( p_sys->rtsp, id, GetDWBE( id->ssrc ),
                                  id->rtp_fmt.clock_rate, mcast_fd );
 
-    id->p_fifo = block_FifoNew();
-    if( unlikely(id->p_fifo == NULL) )
-        goto error;
-    if( vlc_clone( &id->thread, ThreadSend, id, VLC_THREAD_PRIORITY_HIGHEST ) )
-    {
-        block_FifoRelease( id->p_fifo );
-        id->p_fifo = NULL;
-        goto error;
-    }
-
     /* Update p_sys context */
     vlc_mutex_lock( &p_sys->lock_es );
     TAB_APPEND( p_sys->i_es, p_sys->es, id );
@@ -1225,13 +1245,6 @@ static void Del( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
     TAB_REMOVE( p_sys->i_es, p_sys->es, id );
     vlc_mutex_unlock( &p_sys->lock_es );
 
-    if( likely(id->p_fifo != NULL) )
-    {
-        vlc_cancel( id->thread );
-        vlc_join( id->thread, NULL );
-        block_FifoRelease( id->p_fifo );
-    }
-
     free( id->rtp_fmt.fmtp );
 
     if (p_sys->p_vod_media != NULL)
@@ -1244,17 +1257,14 @@ static void Del( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
         vlc_join( id->listen.thread, NULL );
         net_ListenClose( id->listen.fd );
     }
-    /* Delete remaining sinks (incoming connections or explicit
-     * outgoing dst=) */
-    while( id->sinkc > 0 )
-        rtp_del_sink( id, id->sinkv[0].rtp_fd );
+    /* Drops the packets not sent yet, and deletes remaining sinks */
+    if( id->flow != NULL )
+        rtp_flow_Delete( id->flow );
 #ifdef HAVE_SRTP
     if( id->srtp != NULL )
         srtp_destroy( id->srtp );
 #endif
 
-    vlc_mutex_destroy( &id->lock_sink );
-
     /* Update SDP (sap/file) */
     if( p_sys->b_export_sap ) SapSetup( p_stream );
     if( p_sys->psz_sdp_file != NULL ) FileSetup( p_stream );
@@ -1389,98 +1399,6 @@ static int  HttpCallback( httpd_file_sys_t *p_args,
     return VLC_SUCCESS;
 }
 
-/****************************************************************************
- * RTP send
- ****************************************************************************/
-static void* ThreadSend( void *data )
-{
-#ifdef _WIN32
-# define ENOBUFS      WSAENOBUFS
-# define EAGAIN       WSAEWOULDBLOCK
-# define EWOULDBLOCK  WSAEWOULDBLOCK
-#endif
-    sout_stream_id_sys_t *id = data;
-    unsigned i_caching = id->i_caching;
-
-    for (;;)
-    {
-        block_t *out = block_FifoGet( id->p_fifo );
-        block_cleanup_push (out);
-
-#ifdef HAVE_SRTP
-        if( id->srtp )
-        {   /* FIXME: this is awfully inefficient */
-            size_t len = out->i_buffer;
-            out = block_Realloc( out, 0, len + 10 );
-            out->i_buffer = len;
-
-            int canc = vlc_savecancel ();
-            int val = srtp_send( id->srtp, out->p_buffer, &len, len + 10 );
-            vlc_restorecancel (canc);
-            if( val )
-            {
-                msg_Dbg( id->p_stream, "SRTP sending error: %s",
-                         vlc_strerror_c(val) );
-                block_Release( out );
-                out = NULL;
-            }
-            else
-                out->i_buffer = len;
-        }
-        if (out)
-            mwait (out->i_dts + i_caching);
-        vlc_cleanup_pop ();
-        if (out == NULL)
-            continue;
-#else
-        mwait (out->i_dts + i_caching);
-        vlc_cleanup_pop ();
-#endif
-
-        ssize_t len = out->i_buffer;
-        int canc = vlc_savecancel ();
-
-        vlc_mutex_lock( &id->lock_sink );
-        unsigned deadc = 0; /* How many dead sockets? */
-        int deadv[id->sinkc ? id->sinkc : 1]; /* Dead sockets list */
-
-        for( int i = 0; i < id->sinkc; i++ )
-        {
-#ifdef HAVE_SRTP
-            if( !id->srtp ) /* FIXME: SRTCP support */
-#endif
-                SendRTCP( id->sinkv[i].rtcp, out );
-
-            if( send( id->sinkv[i].rtp_fd, out->p_buffer, len, 0 ) == -1
-             && net_errno != EAGAIN && net_errno != EWOULDBLOCK
-             && net_errno != ENOBUFS && net_errno != ENOMEM )
-            {
-                int type;
-                getsockopt( id->sinkv[i].rtp_fd, SOL_SOCKET, SO_TYPE,
-                            &type, &(socklen_t){ sizeof(type) });
-                if( type == SOCK_DGRAM )
-                    /* ICMP soft error: ignore and retry */
-                    send( id->sinkv[i].rtp_fd, out->p_buffer, len, 0 );
-                else
-                    /* Broken connection */
-                    deadv[deadc++] = id->sinkv[i].rtp_fd;
-            }
-        }
-        id->i_seq_sent_next = ntohs(((uint16_t *) out->p_buffer)[1]) + 1;
-        vlc_mutex_unlock( &id->lock_sink );
-        block_Release( out );
-
-        for( unsigned i = 0; i < deadc; i++ )
-        {
-            msg_Dbg( id->p_stream, "removing socket %d", deadv[i] );
-            rtp_del_sink( id, deadv[i] );
-        }
-        vlc_restorecancel (canc);
-    }
-    return NULL;
-}
-
-
 /* This thread dequeues incoming connections (DCCP streaming) */
 static void *rtp_listen_thread( void *data )
 {
@@ -1510,11 +1428,9 @@ int rtp_add_sink( sout_stream_id_sys_t *id, int fd, bool rtcp_mux, uint16_t *seq
     if( sink.rtcp == NULL )
         msg_Err( id->p_stream, "RTCP failed!" );
 
-    vlc_mutex_lock( &id->lock_sink );
-    TAB_APPEND(id->sinkc, id->sinkv, sink);
     if( seq != NULL )
         *seq = id->i_seq_sent_next;
-    vlc_mutex_unlock( &id->lock_sink );
+    rtp_flow_AddSink( id->flow, &sink, seq );
     return VLC_SUCCESS;
 }
 
@@ -1523,17 +1439,7 @@ void rtp_del_sink( sout_stream_id_sys_t *id, int fd )
     rtp_sink_t sink = { fd, NULL };
 
     /* NOTE: must be safe to use if fd is not included */
-    vlc_mutex_lock( &id->lock_sink );
-    for( int i = 0; i < id->sinkc; i++ )
-    {
-        if (id->sinkv[i].rtp_fd == fd)
-        {
-            sink = id->sinkv[i];
-            TAB_ERASE(id->sinkc, id->sinkv, i);
-            break;
-        }
-    }
-    vlc_mutex_unlock( &id->lock_sink );
+    rtp_flow_DelSink( id->flow, fd, &sink );
 
     CloseRTCP( sink.rtcp );
     net_Close( sink.rtp_fd );
@@ -1542,12 +1448,9 @@ void rtp_del_sink( sout_stream_id_sys_t *id, int fd )
 uint16_t rtp_get_seq( sout_stream_id_sys_t *id )
 {
     /* This will return values for the next packet. */
-    uint16_t seq;
-
-    vlc_mutex_lock( &id->lock_sink );
-    seq = id->i_seq_sent_next;
-    vlc_mutex_unlock( &id->lock_sink );
+    uint16_t seq = id->i_seq_sent_next;
 
+    rtp_flow_GetSeq( id->flow, &seq );
     return seq;
 }
 
@@ -1659,7 +1562,7 @@ uint16_t rtp_get_extended_sequence( sout_stream_id_sys_t *id )
 
 void rtp_packetize_send( sout_stream_id_sys_t *id, block_t *out )
 {
-    block_FifoPut( id->p_fifo, out );
+    rtp_flow_Send( id->flow, out );
 }
 
 /**
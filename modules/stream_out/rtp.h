@@ -69,6 +69,34 @@ rtcp_sender_t *OpenRTCP (vlc_object_t *obj, int rtp_fd, int proto,
 void CloseRTCP (rtcp_sender_t *rtcp);
 void SendRTCP (rtcp_sender_t *restrict rtcp, const block_t *rtp);
 
+/* Packet scheduling and fan-out */
+#define RTP_SRTP_TAG_LEN 10 /* SRTP authentication tag size */
+
+typedef struct rtp_sink_t
+{
+    int rtp_fd;
+    rtcp_sender_t *rtcp;
+} rtp_sink_t;
+
+typedef struct rtp_sender_t rtp_sender_t;
+typedef struct rtp_flow_t rtp_flow_t;
+struct srtp_session_t;
+
+/* All the VoD sessions share the same sender */
+rtp_sender_t *rtp_sender_New( vlc_object_t *obj, unsigned workers,
+                              bool b_vod );
+void rtp_sender_Delete( rtp_sender_t * );
+
+rtp_flow_t *rtp_flow_New( rtp_sender_t *, vlc_object_t *obj,
+                          mtime_t i_caching, struct srtp_session_t *srtp );
+void rtp_flow_Delete( rtp_flow_t * );
+void rtp_flow_Send( rtp_flow_t *, block_t *out );
+/* The sequence number of the next packet sent is left untouched until the
+ * flow sent its first packet */
+void rtp_flow_AddSink( rtp_flow_t *, const rtp_sink_t *, uint16_t *seq );
+bool rtp_flow_DelSink( rtp_flow_t *, int fd, rtp_sink_t * );
+void rtp_flow_GetSeq( rtp_flow_t *, uint16_t *seq );
+
 typedef int (*pf_rtp_packetizer_t)( sout_stream_id_sys_t *, block_t * );
 
 typedef struct rtp_format_t
@@ -0,0 +1,739 @@
+/*****************************************************************************
+ * rtpsend.c: RTP packet scheduling and fan-out
+ *****************************************************************************
+ * Copyright © 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_atomic.h>
+
+#include <vlc_network.h>
+#include <vlc_sout.h>
+#ifdef HAVE_SRTP
+# include <srtp.h>
+#endif
+#include "rtp.h"
+
+#ifdef HAVE_SYS_UIO_H
+# include <sys/uio.h>
+#endif
+#include <errno.h>
+#include <limits.h>
+#include <assert.h>
+
+#ifdef _WIN32
+# define ENOBUFS      WSAENOBUFS
+# define EAGAIN       WSAEWOULDBLOCK
+# define EWOULDBLOCK  WSAEWOULDBLOCK
+#endif
+#ifndef MSG_DONTWAIT
+# define MSG_DONTWAIT 0
+#endif
+
+/*
+ * NOTE on the sender design:
+ * - a single scheduler thread per stream output paces the packets of all
+ *   its flows (one per ES), always serving the earliest deadline first,
+ * - the packets of a flow that are due at the same time (typically all the
+ *   packets of one frame) are dequeued as one batch, and sent to each sink
+ *   with a single system call where sendmmsg() is available,
+ * - SRTP encryption is done once per packet by the scheduler, in place in
+ *   the tail room of the packet buffer,
+ * - without workers, the scheduler sends the batches itself; otherwise,
+ *   the sinks of each flow are spread over one shard per worker thread,
+ *   and every worker sends every batch to the sinks of its own shard,
+ * - the packets are sent without blocking, and dropped for the sinks that
+ *   cannot take them, so that a slow sink does not hold the others back,
+ * - the VoD sessions, each of which has a stream output of its own, share
+ *   a single sender.
+ */
+
+/** Maximum number of packets sent to a sink at once */
+#define RTP_BATCH_MAX 64
+
+typedef struct rtp_batch_t rtp_batch_t;
+
+typedef struct
+{
+    vlc_mutex_t  lock;
+    int          sinkc;
+    rtp_sink_t  *sinkv;
+    bool         b_sent;   /* false until the first packet is sent */
+    uint16_t     seq_next; /* sequence number of the next packet sent */
+} rtp_shard_t;
+
+struct rtp_flow_t
+{
+    rtp_sender_t   *sender;
+    vlc_object_t   *obj;
+    atomic_uint     refs; /* owner and batches in flight */
+    mtime_t         i_caching;
+#ifdef HAVE_SRTP
+    srtp_session_t *srtp;
+#endif
+    bool            b_rtcp;
+
+    /* Packets waiting for their deadline, protected by the sender lock */
+    block_t        *p_first;
+    block_t       **pp_last;
+
+    unsigned        shardc;
+    rtp_shard_t     shardv[];
+};
+
+struct rtp_batch_t
+{
+    rtp_flow_t  *flow;
+    atomic_uint  refs; /* one per worker */
+    unsigned     count;
+    block_t     *blockv[RTP_BATCH_MAX];
+    rtp_batch_t *nextv[]; /* one queue link per worker */
+};
+
+typedef struct
+{
+    rtp_sender_t *sender;
+    unsigned      index;
+    vlc_thread_t  thread;
+    vlc_mutex_t   lock;
+    vlc_cond_t    wait;
+    bool          b_quit;
+    rtp_batch_t  *p_first;
+    rtp_batch_t **pp_last;
+} rtp_worker_t;
+
+struct rtp_sender_t
+{
+    unsigned      refs; /* VoD sessions sharing the sender */
+    vlc_thread_t  thread;
+    vlc_mutex_t   lock;
+    vlc_cond_t    wait; /* new packet, or termination */
+    vlc_cond_t    idle; /* the scheduler released the busy flow */
+    bool          b_quit;
+    int           flowc;
+    rtp_flow_t  **flowv;
+    rtp_flow_t   *busy; /* flow whose batch is being prepared */
+
+    unsigned      workerc;
+    rtp_worker_t  workerv[];
+};
+
+static void FlowRelease( rtp_flow_t *flow )
+{
+    if( atomic_fetch_sub( &flow->refs, 1 ) != 1 )
+        return;
+
+    for( unsigned i = 0; i < flow->shardc; i++ )
+    {
+        assert( flow->shardv[i].sinkc == 0 );
+        vlc_mutex_destroy( &flow->shardv[i].lock );
+    }
+    free( flow );
+}
+
+static void BatchRelease( rtp_batch_t *batch )
+{
+    if( atomic_fetch_sub( &batch->refs, 1 ) != 1 )
+        return;
+
+    for( unsigned i = 0; i < batch->count; i++ )
+        block_Release( batch->blockv[i] );
+    FlowRelease( batch->flow );
+    free( batch );
+}
+
+/*****************************************************************************
+ * Sending
+ *****************************************************************************/
+
+/**
+ * Sends a batch of packets to one sink, dropping those it cannot take now.
+ * @return false if the connection is broken and the sink must be removed
+ */
+static bool SendPackets( int fd, const rtp_batch_t *batch, void *msgs )
+{
+    unsigned i = 0;
+
+    while( i < batch->count )
+    {
+        const block_t *out = batch->blockv[i];
+#ifdef HAVE_SENDMMSG
+        struct mmsghdr *msgv = msgs;
+        int val = sendmmsg( fd, msgv + i, batch->count - i, MSG_DONTWAIT );
+        if( val > 0 )
+        {
+            i += val;
+            /* Only a stream socket takes part of a packet: its framing
+             * cannot be recovered */
+            if( msgv[i - 1].msg_len < batch->blockv[i - 1]->i_buffer )
+                return false;
+            continue;
+        }
+#else
+        VLC_UNUSED(msgs);
+        ssize_t val = send( fd, out->p_buffer, out->i_buffer, MSG_DONTWAIT );
+        if( val != -1 )
+        {
+            if( (size_t)val < out->i_buffer )
+                return false; /* see above */
+            i++;
+            continue;
+        }
+#endif
+        if( net_errno != EAGAIN
+#if EWOULDBLOCK != EAGAIN
+         && net_errno != EWOULDBLOCK
+#endif
+         && net_errno != ENOBUFS && net_errno != ENOMEM )
+        {
+            int type;
+            getsockopt( fd, SOL_SOCKET, SO_TYPE,
+                        &type, &(socklen_t){ sizeof(type) });
+            if( type != SOCK_DGRAM )
+                return false; /* Broken connection */
+
+            /* ICMP soft error: ignore and retry */
+            send( fd, out->p_buffer, out->i_buffer, MSG_DONTWAIT );
+        }
+        i++; /* drop the packet */
+    }
+    return true;
+}
+
+/** Sends a batch to all the sinks of a shard */
+static void SendBatch( rtp_batch_t *batch, unsigned index )
+{
+    rtp_flow_t *flow = batch->flow;
+    rtp_shard_t *shard = &flow->shardv[index];
+
+#ifdef HAVE_SENDMMSG
+    /* Sockets are connected, so the same messages are good for all sinks */
+    struct iovec iov[RTP_BATCH_MAX];
+    struct mmsghdr msgv[RTP_BATCH_MAX];
+
+    for( unsigned i = 0; i < batch->count; i++ )
+    {
+        iov[i].iov_base = batch->blockv[i]->p_buffer;
+        iov[i].iov_len = batch->blockv[i]->i_buffer;
+        memset( &msgv[i], 0, sizeof(msgv[i]) );
+        msgv[i].msg_hdr.msg_iov = &iov[i];
+        msgv[i].msg_hdr.msg_iovlen = 1;
+    }
+#else
+    void *msgv = NULL;
+#endif
+
+    vlc_mutex_lock( &shard->lock );
+    for( int i = 0; i < shard->sinkc; i++ )
+    {
+        rtp_sink_t *sink = &shard->sinkv[i];
+
+        if( flow->b_rtcp )
+            for( unsigned j = 0; j < batch->count; j++ )
+                SendRTCP( sink->rtcp, batch->blockv[j] );
+
+        if( !SendPackets( sink->rtp_fd, batch, msgv ) )
+        {
+            msg_Dbg( flow->obj, "removing socket %d", sink->rtp_fd );
+            CloseRTCP( sink->rtcp );
+            net_Close( sink->rtp_fd );
+            TAB_ERASE( shard->sinkc, shard->sinkv, i );
+            i--;
+        }
+    }
+    const block_t *last = batch->blockv[batch->count - 1];
+    shard->seq_next = GetWBE( last->p_buffer + 2 ) + 1;
+    shard->b_sent = true;
+    vlc_mutex_unlock( &shard->lock );
+}
+
+static void *Work( void *data )
+{
+    rtp_worker_t *worker = data;
+    const unsigned index = worker->index;
+
+    vlc_mutex_lock( &worker->lock );
+    for( ;; )
+    {
+        while( worker->p_first == NULL && !worker->b_quit )
+            vlc_cond_wait( &worker->wait, &worker->lock );
+
+        rtp_batch_t *batch = worker->p_first;
+        if( batch == NULL )
+            break; /* quitting, and nothing left to send */
+
+        worker->p_first = batch->nextv[index];
+        if( worker->p_first == NULL )
+            worker->pp_last = &worker->p_first;
+        vlc_mutex_unlock( &worker->lock );
+
+        SendBatch( batch, index );
+        BatchRelease( batch );
+
+        vlc_mutex_lock( &worker->lock );
+    }
+    vlc_mutex_unlock( &worker->lock );
+    return NULL;
+}
+
+/*****************************************************************************
+ * Scheduling
+ *****************************************************************************/
+
+#ifdef HAVE_SRTP
+static block_t *Encrypt( rtp_flow_t *flow, block_t *out )
+{
+    size_t len = out->i_buffer;
+    size_t size = out->p_start + out->i_size - out->p_buffer;
+
+    /* The packetizers allocate their packets with block_Alloc(), so the
+     * authentication tag normally fits in the tail padding. */
+    if( unlikely(size < len + RTP_SRTP_TAG_LEN) )
+    {
+        out = block_Realloc( out, 0, len + RTP_SRTP_TAG_LEN );
+        if( unlikely(out == NULL) )
+            return NULL;
+        out->i_buffer = len;
+        size = len + RTP_SRTP_TAG_LEN;
+    }
+
+    int val = srtp_send( flow->srtp, out->p_buffer, &len, size );
+    if( val )
+    {
+        msg_Dbg( flow->obj, "SRTP sending error: %s", vlc_strerror_c(val) );
+        block_Release( out );
+        return NULL;
+    }
+    out->i_buffer = len;
+    return out;
+}
+#endif
+
+/** Finds the flow with the earliest deadline (sender must be locked) */
+static rtp_flow_t *NextFlow( rtp_sender_t *sender, mtime_t *deadline )
+{
+    rtp_flow_t *next = NULL;
+
+    for( int i = 0; i < sender->flowc; i++ )
+    {
+        rtp_flow_t *flow = sender->flowv[i];
+        if( flow->p_first == NULL )
+            continue;
+
+        mtime_t date = flow->p_first->i_dts + flow->i_caching;
+        if( next == NULL || date < *deadline )
+        {
+            next = flow;
+            *deadline = date;
+        }
+    }
+    return next;
+}
+
+static void Dispatch( rtp_sender_t *sender, rtp_batch_t *batch )
+{
+    if( sender->workerc == 0 )
+    {
+        SendBatch( batch, 0 );
+        BatchRelease( batch );
+        return;
+    }
+
+    atomic_init( &batch->refs, sender->workerc );
+    for( unsigned i = 0; i < sender->workerc; i++ )
+    {
+        rtp_worker_t *worker = &sender->workerv[i];
+
+        batch->nextv[i] = NULL;
+        vlc_mutex_lock( &worker->lock );
+        *worker->pp_last = batch;
+        worker->pp_last = &batch->nextv[i];
+        vlc_cond_signal( &worker->wait );
+        vlc_mutex_unlock( &worker->lock );
+    }
+}
+
+static void *Schedule( void *data )
+{
+    rtp_sender_t *sender = data;
+    const size_t batch_size = sizeof (rtp_batch_t)
+                            + sender->workerc * sizeof (rtp_batch_t *);
+
+    vlc_mutex_lock( &sender->lock );
+    while( !sender->b_quit )
+    {
+        mtime_t deadline = 0;
+        rtp_flow_t *flow = NextFlow( sender, &deadline );
+
+        if( flow == NULL )
+        {
+            vlc_cond_wait( &sender->wait, &sender->lock );
+            continue;
+        }
+
+        mtime_t now = mdate();
+        if( deadline > now )
+        {   /* An earlier packet may be queued in the mean time */
+            vlc_cond_timedwait( &sender->wait, &sender->lock, deadline );
+            continue;
+        }
+
+        rtp_batch_t *batch = malloc( batch_size );
+        unsigned count = 0;
+        block_t *chain = flow->p_first;
+        block_t **pp_end = &flow->p_first;
+
+        /* Take all the packets of the flow that are due */
+        while( *pp_end != NULL && count < RTP_BATCH_MAX
+            && (*pp_end)->i_dts + flow->i_caching <= now )
+        {
+            pp_end = &(*pp_end)->p_next;
+            count++;
+        }
+        flow->p_first = *pp_end;
+        if( flow->p_first == NULL )
+            flow->pp_last = &flow->p_first;
+        *pp_end = NULL;
+
+        if( unlikely(batch == NULL) )
+        {
+            vlc_mutex_unlock( &sender->lock );
+            block_ChainRelease( chain );
+            vlc_mutex_lock( &sender->lock );
+            continue;
+        }
+
+        atomic_fetch_add( &flow->refs, 1 );
+        batch->flow = flow;
+        atomic_init( &batch->refs, 1 );
+        batch->count = 0;
+        sender->busy = flow;
+        vlc_mutex_unlock( &sender->lock );
+
+        while( chain != NULL )
+        {
+            block_t *out = chain;
+            chain = out->p_next;
+            out->p_next = NULL;
+#ifdef HAVE_SRTP
+            if( flow->srtp != NULL )
+            {
+                out = Encrypt( flow, out );
+                if( out == NULL )
+                    continue;
+            }
+#endif
+            batch->blockv[batch->count++] = out;
+        }
+
+        if( likely(batch->count > 0) )
+            Dispatch( sender, batch );
+        else
+            BatchRelease( batch );
+
+        vlc_mutex_lock( &sender->lock );
+        sender->busy = NULL;
+        vlc_cond_broadcast( &sender->idle );
+    }
+    vlc_mutex_unlock( &sender->lock );
+    return NULL;
+}
+
+/*****************************************************************************
+ * Sender
+ *****************************************************************************/
+
+static void StopWorker( rtp_worker_t *worker )
+{
+    vlc_mutex_lock( &worker->lock );
+    worker->b_quit = true;
+    vlc_cond_signal( &worker->wait );
+    vlc_mutex_unlock( &worker->lock );
+
+    vlc_join( worker->thread, NULL );
+    assert( worker->p_first == NULL );
+    vlc_cond_destroy( &worker->wait );
+    vlc_mutex_destroy( &worker->lock );
+}
+
+static rtp_sender_t *SenderNew( vlc_object_t *obj, unsigned workers )
+{
+    rtp_sender_t *sender = malloc( sizeof (*sender)
+                                   + workers * sizeof (rtp_worker_t) );
+    if( unlikely(sender == NULL) )
+        return NULL;
+
+    sender->refs = 1;
+    vlc_mutex_init( &sender->lock );
+    vlc_cond_init( &sender->wait );
+    vlc_cond_init( &sender->idle );
+    sender->b_quit = false;
+    sender->flowc = 0;
+    sender->flowv = NULL;
+    sender->busy = NULL;
+    sender->workerc = 0;
+
+    /* Workers must run before the scheduler can dispatch to them */
+    for( unsigned i = 0; i < workers; i++ )
+    {
+        rtp_worker_t *worker = &sender->workerv[i];
+
+        worker->sender = sender;
+        worker->index = i;
+        vlc_mutex_init( &worker->lock );
+        vlc_cond_init( &worker->wait );
+        worker->b_quit = false;
+        worker->p_first = NULL;
+        worker->pp_last = &worker->p_first;
+
+        if( vlc_clone( &worker->thread, Work, worker,
+                       VLC_THREAD_PRIORITY_HIGHEST ) )
+        {
+            vlc_cond_destroy( &worker->wait );
+            vlc_mutex_destroy( &worker->lock );
+            msg_Warn( obj, "only %u of %u fan-out threads started",
+                      i, workers );
+            break;
+        }
+        sender->workerc++;
+    }
+
+    if( vlc_clone( &sender->thread, Schedule, sender,
+                   VLC_THREAD_PRIORITY_HIGHEST ) )
+    {
+        for( unsigned i = 0; i < sender->workerc; i++ )
+            StopWorker( &sender->workerv[i] );
+        vlc_cond_destroy( &sender->idle );
+        vlc_cond_destroy( &sender->wait );
+        vlc_mutex_destroy( &sender->lock );
+        free( sender );
+        return NULL;
+    }
+    return sender;
+}
+
+static void SenderDelete( rtp_sender_t *sender )
+{
+    vlc_mutex_lock( &sender->lock );
+    assert( sender->flowc == 0 );
+    sender->b_quit = true;
+    vlc_cond_signal( &sender->wait );
+    vlc_mutex_unlock( &sender->lock );
+    vlc_join( sender->thread, NULL );
+
+    /* Workers send the batches still queued before they quit */
+    for( unsigned i = 0; i < sender->workerc; i++ )
+        StopWorker( &sender->workerv[i] );
+
+    vlc_cond_destroy( &sender->idle );
+    vlc_cond_destroy( &sender->wait );
+    vlc_mutex_destroy( &sender->lock );
+    free( sender->flowv );
+    free( sender );
+}
+
+static vlc_mutex_t vod_lock = VLC_STATIC_MUTEX;
+static rtp_sender_t *vod_sender = NULL;
+
+rtp_sender_t *rtp_sender_New( vlc_object_t *obj, unsigned workers,
+                              bool b_vod )
+{
+    if( !b_vod )
+        return SenderNew( obj, workers );
+
+    /* The first session sets the number of workers */
+    vlc_mutex_lock( &vod_lock );
+    rtp_sender_t *sender = vod_sender;
+    if( sender != NULL )
+        sender->refs++;
+    else
+        vod_sender = sender = SenderNew( obj, workers );
+    vlc_mutex_unlock( &vod_lock );
+    return sender;
+}
+
+void rtp_sender_Delete( rtp_sender_t *sender )
+{
+    vlc_mutex_lock( &vod_lock );
+    bool b_last = --sender->refs == 0;
+    if( b_last && sender == vod_sender )
+        vod_sender = NULL;
+    vlc_mutex_unlock( &vod_lock );
+
+    if( b_last )
+        SenderDelete( sender );
+}
+
+/*****************************************************************************
+ * Flows
+ *****************************************************************************/
+
+rtp_flow_t *rtp_flow_New( rtp_sender_t *sender, vlc_object_t *obj,
+                          mtime_t i_caching, struct srtp_session_t *srtp )
+{
+    const unsigned shardc = sender->workerc ? sender->workerc : 1;
+    rtp_flow_t *flow = malloc( sizeof (*flow)
+                               + shardc * sizeof (rtp_shard_t) );
+    if( unlikely(flow == NULL) )
+        return NULL;
+
+    flow->sender = sender;
+    flow->obj = obj;
+    atomic_init( &flow->refs, 1 );
+    flow->i_caching = i_caching;
+#ifdef HAVE_SRTP
+    flow->srtp = srtp;
+#endif
+    flow->b_rtcp = srtp == NULL; /* FIXME: SRTCP support */
+    flow->p_first = NULL;
+    flow->pp_last = &flow->p_first;
+    flow->shardc = shardc;
+
+    for( unsigned i = 0; i < shardc; i++ )
+    {
+        rtp_shard_t *shard = &flow->shardv[i];
+
+        vlc_mutex_init( &shard->lock );
+        shard->sinkc = 0;
+        shard->sinkv = NULL;
+        shard->b_sent = false;
+    }
+
+    vlc_mutex_lock( &sender->lock );
+    TAB_APPEND( sender->flowc, sender->flowv, flow );
+    vlc_mutex_unlock( &sender->lock );
+    return flow;
+}
+
+void rtp_flow_Delete( rtp_flow_t *flow )
+{
+    rtp_sender_t *sender = flow->sender;
+
+    vlc_mutex_lock( &sender->lock );
+    TAB_REMOVE( sender->flowc, sender->flowv, flow );
+    while( sender->busy == flow )
+        vlc_cond_wait( &sender->idle, &sender->lock );
+    block_t *queue = flow->p_first;
+    flow->p_first = NULL;
+    vlc_mutex_unlock( &sender->lock );
+
+    block_ChainRelease( queue );
+
+    /* Delete remaining sinks (incoming connections or explicit
+     * outgoing dst=) */
+    for( unsigned i = 0; i < flow->shardc; i++ )
+    {
+        rtp_shard_t *shard = &flow->shardv[i];
+
+        vlc_mutex_lock( &shard->lock );
+        for( int j = 0; j < shard->sinkc; j++ )
+        {
+            CloseRTCP( shard->sinkv[j].rtcp );
+            net_Close( shard->sinkv[j].rtp_fd );
+        }
+        TAB_CLEAN( shard->sinkc, shard->sinkv );
+        vlc_mutex_unlock( &shard->lock );
+    }
+
+    /* Batches in flight keep the flow alive until they are sent */
+    FlowRelease( flow );
+}
+
+void rtp_flow_Send( rtp_flow_t *flow, block_t *out )
+{
+    rtp_sender_t *sender = flow->sender;
+
+    vlc_mutex_lock( &sender->lock );
+    bool b_head = flow->p_first == NULL;
+    *flow->pp_last = out;
+    flow->pp_last = &out->p_next;
+    /* Packets behind the head of a queue cannot change the next deadline */
+    if( b_head )
+        vlc_cond_signal( &sender->wait );
+    vlc_mutex_unlock( &sender->lock );
+}
+
+void rtp_flow_AddSink( rtp_flow_t *flow, const rtp_sink_t *sink,
+                       uint16_t *seq )
+{
+    /* Put the sink in the least loaded shard */
+    rtp_shard_t *shard = &flow->shardv[0];
+    int sinkc = INT_MAX;
+
+    for( unsigned i = 0; i < flow->shardc; i++ )
+    {
+        rtp_shard_t *other = &flow->shardv[i];
+
+        vlc_mutex_lock( &other->lock );
+        if( other->sinkc < sinkc )
+        {
+            shard = other;
+            sinkc = other->sinkc;
+        }
+        vlc_mutex_unlock( &other->lock );
+    }
+
+    vlc_mutex_lock( &shard->lock );
+    TAB_APPEND( shard->sinkc, shard->sinkv, *sink );
+    /* Each shard gets all the packets: if this one did not send any yet,
+     * the next one is the first packet of the flow */
+    if( seq != NULL && shard->b_sent )
+        *seq = shard->seq_next;
+    vlc_mutex_unlock( &shard->lock );
+}
+
+bool rtp_flow_DelSink( rtp_flow_t *flow, int fd, rtp_sink_t *sink )
+{
+    for( unsigned i = 0; i < flow->shardc; i++ )
+    {
+        rtp_shard_t *shard = &flow->shardv[i];
+
+        vlc_mutex_lock( &shard->lock );
+        for( int j = 0; j < shard->sinkc; j++ )
+        {
+            if( shard->sinkv[j].rtp_fd == fd )
+            {
+                *sink = shard->sinkv[j];
+                TAB_ERASE( shard->sinkc, shard->sinkv, j );
+                vlc_mutex_unlock( &shard->lock );
+                return true;
+            }
+        }
+        vlc_mutex_unlock( &shard->lock );
+    }
+    return false;
+}
+
+void rtp_flow_GetSeq( rtp_flow_t *flow, uint16_t *seq )
+{
+    /* All shards see the same packets: any of them will do */
+    rtp_shard_t *shard = &flow->shardv[0];
+
+    vlc_mutex_lock( &shard->lock );
+    if( shard->b_sent )
+        *seq = shard->seq_next;
+    vlc_mutex_unlock( &shard->lock );
+}
@@ -66,9 +66,14 @@ struct rtsp_stream_t
     char           *psz_path;
     unsigned        track_id;
 
+    /* Sessions, sorted by identifier */
     int             sessionc;
     rtsp_session_t **sessionv;
 
+    /* Sessions, least recently seen first, for timeouts */
+    rtsp_session_t *idle_first;
+    rtsp_session_t *idle_last;
+
     int             timeout;
     vlc_timer_t     timer;
 };
@@ -147,6 +152,7 @@ void RtspUnsetup( rtsp_stream_t *rtsp )
 
     while( rtsp->sessionc > 0 )
         RtspClientDel( rtsp, rtsp->sessionv[0] );
+    free( rtsp->sessionv );
 
     if (rtsp->timeout > 0)
         vlc_timer_destroy(rtsp->timer);
@@ -178,6 +184,7 @@ struct rtsp_session_t
     rtsp_stream_t *stream;
     uint64_t       id;
     mtime_t        last_seen; /* for timeouts */
+    rtsp_session_t *idle_prev, *idle_next; /* by last_seen */
 
     /* output (id-access) */
     int            trackc;
@@ -304,13 +311,8 @@ static void RtspUpdateTimer( rtsp_stream_t *rtsp )
         return;
 
     mtime_t timeout = 0;
-    for (int i = 0; i < rtsp->sessionc; i++)
-    {
-        if (timeout == 0 || rtsp->sessionv[i]->last_seen < timeout)
-            timeout = rtsp->sessionv[i]->last_seen;
-    }
-    if (timeout != 0)
-        timeout += rtsp->timeout * CLOCK_FREQ;
+    if (rtsp->idle_first != NULL)
+        timeout = rtsp->idle_first->last_seen + rtsp->timeout * CLOCK_FREQ;
     vlc_timer_schedule(rtsp->timer, true, timeout, 0);
 }
 
@@ -321,25 +323,72 @@ static void RtspTimeOut( void *data )
 
     vlc_mutex_lock(&rtsp->lock);
     mtime_t now = mdate();
-    for (int i = rtsp->sessionc - 1; i >= 0; i--)
+    rtsp_session_t *ses;
+
+    while ((ses = rtsp->idle_first) != NULL
+        && ses->last_seen + rtsp->timeout * CLOCK_FREQ < now)
     {
-        if (rtsp->sessionv[i]->last_seen + rtsp->timeout * CLOCK_FREQ < now)
+        if (rtsp->vod_media != NULL)
         {
-            if (rtsp->vod_media != NULL)
-            {
-                char psz_sesbuf[17];
-                snprintf( psz_sesbuf, sizeof( psz_sesbuf ), "%"PRIx64,
-                          rtsp->sessionv[i]->id );
-                vod_stop(rtsp->vod_media, psz_sesbuf);
-            }
-            RtspClientDel(rtsp, rtsp->sessionv[i]);
+            char psz_sesbuf[17];
+            snprintf( psz_sesbuf, sizeof( psz_sesbuf ), "%"PRIx64, ses->id );
+            vod_stop(rtsp->vod_media, psz_sesbuf);
         }
+        RtspClientDel(rtsp, ses);
     }
     RtspUpdateTimer(rtsp);
     vlc_mutex_unlock(&rtsp->lock);
 }
 
 
+/** rtsp must be locked
+ * \return the index of the session with that identifier if any, or else the
+ * index to insert it at */
+static int RtspClientFind( rtsp_stream_t *rtsp, uint64_t id, bool *found )
+{
+    int lo = 0, hi = rtsp->sessionc;
+
+    while( lo < hi )
+    {
+        int i = (lo + hi) / 2;
+
+        if( rtsp->sessionv[i]->id < id )
+            lo = i + 1;
+        else
+            hi = i;
+    }
+    *found = lo < rtsp->sessionc && rtsp->sessionv[lo]->id == id;
+    return lo;
+}
+
+
+/** rtsp must be locked */
+static void RtspIdleAppend( rtsp_stream_t *rtsp, rtsp_session_t *s )
+{
+    s->idle_next = NULL;
+    s->idle_prev = rtsp->idle_last;
+    if( rtsp->idle_last != NULL )
+        rtsp->idle_last->idle_next = s;
+    else
+        rtsp->idle_first = s;
+    rtsp->idle_last = s;
+}
+
+
+/** rtsp must be locked */
+static void RtspIdleRemove( rtsp_stream_t *rtsp, rtsp_session_t *s )
+{
+    if( s->idle_prev != NULL )
+        s->idle_prev->idle_next = s->idle_next;
+    else
+        rtsp->idle_first = s->idle_next;
+    if( s->idle_next != NULL )
+        s->idle_next->idle_prev = s->idle_prev;
+    else
+        rtsp->idle_last = s->idle_prev;
+}
+
+
 /** rtsp must be locked */
 static
 rtsp_session_t *RtspClientNew( rtsp_stream_t *rtsp )
@@ -348,12 +397,33 @@ rtsp_session_t *RtspClientNew( rtsp_stream_t *rtsp )
     if( s == NULL )
         return NULL;
 
+    rtsp_session_t **pv = realloc( rtsp->sessionv,
+                                   (rtsp->sessionc + 1) * sizeof( *pv ) );
+    if( pv == NULL )
+    {
+        free( s );
+        return NULL;
+    }
+    rtsp->sessionv = pv;
+
     s->stream = rtsp;
-    vlc_rand_bytes (&s->id, sizeof (s->id));
     s->trackc = 0;
     s->trackv = NULL;
+    s->last_seen = mdate();
+
+    bool found;
+    int i;
+    do
+    {
+        vlc_rand_bytes (&s->id, sizeof (s->id));
+        i = RtspClientFind( rtsp, s->id, &found );
+    }
+    while( found );
 
-    TAB_APPEND( rtsp->sessionc, rtsp->sessionv, s );
+    memmove( pv + i + 1, pv + i, (rtsp->sessionc - i) * sizeof( *pv ) );
+    pv[i] = s;
+    rtsp->sessionc++;
+    RtspIdleAppend( rtsp, s );
 
     return s;
 }
@@ -365,6 +435,7 @@ rtsp_session_t *RtspClientGet( rtsp_stream_t *rtsp, const char *name )
 {
     char *end;
     uint64_t id;
+    bool found;
     int i;
 
     if( name == NULL )
@@ -375,13 +446,8 @@ rtsp_session_t *RtspClientGet( rtsp_stream_t *rtsp, const char *name )
     if( errno || *end )
         return NULL;
 
-    /* FIXME: use a hash/dictionary */
-    for( i = 0; i < rtsp->sessionc; i++ )
-    {
-        if( rtsp->sessionv[i]->id == id )
-            return rtsp->sessionv[i];
-    }
-    return NULL;
+    i = RtspClientFind( rtsp, id, &found );
+    return found ? rtsp->sessionv[i] : NULL;
 }
 
 
@@ -389,8 +455,14 @@ rtsp_session_t *RtspClientGet( rtsp_stream_t *rtsp, const char *name )
 static
 void RtspClientDel( rtsp_stream_t *rtsp, rtsp_session_t *session )
 {
-    int i;
-    TAB_REMOVE( rtsp->sessionc, rtsp->sessionv, session );
+    bool found;
+    int i = RtspClientFind( rtsp, session->id, &found );
+
+    assert( found && rtsp->sessionv[i] == session );
+    rtsp->sessionc--;
+    memmove( rtsp->sessionv + i, rtsp->sessionv + i + 1,
+             (rtsp->sessionc - i) * sizeof( *rtsp->sessionv ) );
+    RtspIdleRemove( rtsp, session );
 
     for( i = 0; i < session->trackc; i++ )
         RtspTrackClose( &session->trackv[i] );
@@ -403,11 +475,15 @@ void RtspClientDel( rtsp_stream_t *rtsp, rtsp_session_t *session )
 /** rtsp must be locked */
 static void RtspClientAlive( rtsp_session_t *session )
 {
-    if (session->stream->timeout <= 0)
+    rtsp_stream_t *rtsp = session->stream;
+
+    if (rtsp->timeout <= 0)
         return;
 
     session->last_seen = mdate();
-    RtspUpdateTimer(session->stream);
+    RtspIdleRemove(rtsp, session);
+    RtspIdleAppend(rtsp, session);
+    RtspUpdateTimer(rtsp);
 }
 
 static int dup_socket(int oldfd)
@@ -37,6 +37,25 @@
  *
  * the video-data and audio-data pointers will be passed to lock/unlock function
  *
+ * Instead of the prerender and postrender callbacks, you can give deliver
+ * callbacks. They get the buffers of this module without any copy, along
+ * with a release function and a handle to pass to it once the application
+ * is done with the (read-only) data:
+ *
+ * void video_deliver( void *p_video_data, const uint8_t *p_pixel_buffer,
+ *                     int width, int height, int pixel_pitch, size_t size,
+ *                     mtime_t pts, void (*pf_release)( void * ),
+ *                     void *p_handle );
+ * void audio_deliver( void *p_audio_data, const uint8_t *p_pcm_buffer,
+ *                     unsigned int channels, unsigned int rate,
+ *                     unsigned int nb_samples, unsigned int bits_per_sample,
+ *                     size_t size, mtime_t pts, void (*pf_release)( void * ),
+ *                     void *p_handle );
+ *
+ * pf_release() can be called from any thread, even after the end of the
+ * stream. At most pool-size buffers of an elementary stream are held by the
+ * application: beyond that, the stream waits for one to be released.
+ *
  ******************************************************************************/
 
 /*****************************************************************************
@@ -74,6 +93,20 @@
 #define LT_AUDIO_POSTRENDER_CALLBACK N_( "Address of the audio postrender callback function. " \
                                         "This function will be called when the render is into the buffer." )
 
+#define T_VIDEO_DELIVER_CALLBACK N_( "Video deliver callback" )
+#define LT_VIDEO_DELIVER_CALLBACK N_( "Address of the video deliver callback function. " \
+                                      "This function will be handed the rendered buffers, without copy, " \
+                                      "instead of the prerender and postrender callbacks." )
+
+#define T_AUDIO_DELIVER_CALLBACK N_( "Audio deliver callback" )
+#define LT_AUDIO_DELIVER_CALLBACK N_( "Address of the audio deliver callback function. " \
+                                      "This function will be handed the rendered buffers, without copy, " \
+                                      "instead of the prerender and postrender callbacks." )
+
+#define T_POOL_SIZE N_( "Delivered buffers" )
+#define LT_POOL_SIZE N_( "Maximum number of delivered buffers held by the application, " \
+                         "per elementary stream. The stream waits for a release beyond." )
+
 #define T_VIDEO_DATA N_( "Video Callback data" )
 #define LT_VIDEO_DATA N_( "Data for the video callback function." )
 
@@ -107,6 +140,11 @@ vlc_module_begin ()
         change_volatile()
     add_string( SOUT_PREFIX_AUDIO "postrender-callback", "0", T_AUDIO_POSTRENDER_CALLBACK, LT_AUDIO_POSTRENDER_CALLBACK, true )
         change_volatile()
+    add_string( SOUT_PREFIX_VIDEO "deliver-callback", "0", T_VIDEO_DELIVER_CALLBACK, LT_VIDEO_DELIVER_CALLBACK, true )
+        change_volatile()
+    add_string( SOUT_PREFIX_AUDIO "deliver-callback", "0", T_AUDIO_DELIVER_CALLBACK, LT_AUDIO_DELIVER_CALLBACK, true )
+        change_volatile()
+    add_integer_with_range( SOUT_CFG_PREFIX "pool-size", 8, 1, 1000, T_POOL_SIZE, LT_POOL_SIZE, true )
     add_string( SOUT_PREFIX_VIDEO "data", "0", T_VIDEO_DATA, LT_VIDEO_DATA, true )
         change_volatile()
     add_string( SOUT_PREFIX_AUDIO "data", "0", T_AUDIO_DATA, LT_VIDEO_DATA, true )
@@ -122,7 +160,9 @@ vlc_module_end ()
  *****************************************************************************/
 static const char *const ppsz_sout_options[] = {
     "video-prerender-callback", "audio-prerender-callback",
-    "video-postrender-callback", "audio-postrender-callback", "video-data", "audio-data", "time-sync", NULL
+    "video-postrender-callback", "audio-postrender-callback",
+    "video-deliver-callback", "audio-deliver-callback", "pool-size",
+    "video-data", "audio-data", "time-sync", NULL
 };
 
 static sout_stream_id_sys_t *Add( sout_stream_t *, const es_format_t * );
@@ -139,10 +179,13 @@ static int SendVideo( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
 static int SendAudio( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
                       block_t *p_buffer );
 
+typedef struct smem_pool_t smem_pool_t;
+
 struct sout_stream_id_sys_t
 {
     es_format_t format;
     void *p_data;
+    smem_pool_t *p_pool; /* delivered buffers, NULL if copying */
 };
 
 struct sout_stream_sys_t
@@ -152,6 +195,8 @@ struct sout_stream_sys_t
     void ( *pf_audio_prerender_callback ) ( void* p_audio_data, uint8_t** pp_pcm_buffer, size_t size );
     void ( *pf_video_postrender_callback ) ( void* p_video_data, uint8_t* p_pixel_buffer, int width, int height, int pixel_pitch, size_t size, mtime_t pts );
     void ( *pf_audio_postrender_callback ) ( void* p_audio_data, uint8_t* p_pcm_buffer, unsigned int channels, unsigned int rate, unsigned int nb_samples, unsigned int bits_per_sample, size_t size, mtime_t pts );
+    void ( *pf_video_deliver_callback ) ( void* p_video_data, const uint8_t* p_pixel_buffer, int width, int height, int pixel_pitch, size_t size, mtime_t pts, void ( *pf_release ) ( void* ), void* p_handle );
+    void ( *pf_audio_deliver_callback ) ( void* p_audio_data, const uint8_t* p_pcm_buffer, unsigned int channels, unsigned int rate, unsigned int nb_samples, unsigned int bits_per_sample, size_t size, mtime_t pts, void ( *pf_release ) ( void* ), void* p_handle );
     bool time_sync;
 };
 
@@ -194,6 +239,105 @@ void AudioPostrenderDefaultCallback( void* p_audio_data, uint8_t* p_pcm_buffer,
     VLC_UNUSED( bits_per_sample ); VLC_UNUSED( size ); VLC_UNUSED( pts );
 }
 
+/*****************************************************************************
+ * Delivered buffers
+ *****************************************************************************/
+typedef struct
+{
+    smem_pool_t *p_pool;
+    block_t     *p_block; /* NULL if free */
+} smem_buffer_t;
+
+struct smem_pool_t
+{
+    vlc_mutex_t   lock;
+    vlc_cond_t    wait;
+    unsigned      i_free;
+    bool          b_orphan; /* the ES is gone: the last release deletes it */
+    unsigned      i_size;
+    smem_buffer_t bufferv[];
+};
+
+static smem_pool_t *PoolNew( unsigned i_size )
+{
+    smem_pool_t *p_pool = malloc( sizeof( *p_pool ) +
+                                  i_size * sizeof( p_pool->bufferv[0] ) );
+    if( !p_pool )
+        return NULL;
+
+    vlc_mutex_init( &p_pool->lock );
+    vlc_cond_init( &p_pool->wait );
+    p_pool->i_free = i_size;
+    p_pool->b_orphan = false;
+    p_pool->i_size = i_size;
+    for( unsigned i = 0; i < i_size; i++ )
+    {
+        p_pool->bufferv[i].p_pool = p_pool;
+        p_pool->bufferv[i].p_block = NULL;
+    }
+    return p_pool;
+}
+
+static void PoolDelete( smem_pool_t *p_pool )
+{
+    vlc_cond_destroy( &p_pool->wait );
+    vlc_mutex_destroy( &p_pool->lock );
+    free( p_pool );
+}
+
+/* Called by the application, from any thread */
+static void PoolRelease( void *p_handle )
+{
+    smem_buffer_t *p_buf = p_handle;
+    smem_pool_t *p_pool = p_buf->p_pool;
+    block_t *p_block;
+    bool b_delete;
+
+    vlc_mutex_lock( &p_pool->lock );
+    p_block = p_buf->p_block;
+    p_buf->p_block = NULL;
+    p_pool->i_free++;
+    b_delete = p_pool->b_orphan && p_pool->i_free == p_pool->i_size;
+    vlc_cond_signal( &p_pool->wait );
+    vlc_mutex_unlock( &p_pool->lock );
+
+    block_Release( p_block );
+    if( b_delete )
+        PoolDelete( p_pool );
+}
+
+/* Waits for the application to release a buffer if it holds them all */
+static smem_buffer_t *PoolGet( smem_pool_t *p_pool, block_t *p_block )
+{
+    smem_buffer_t *p_buf = p_pool->bufferv;
+
+    vlc_mutex_lock( &p_pool->lock );
+    mutex_cleanup_push( &p_pool->lock );
+    while( p_pool->i_free == 0 )
+        vlc_cond_wait( &p_pool->wait, &p_pool->lock );
+    vlc_cleanup_pop();
+
+    while( p_buf->p_block != NULL )
+        p_buf++;
+    p_buf->p_block = p_block;
+    p_pool->i_free--;
+    vlc_mutex_unlock( &p_pool->lock );
+    return p_buf;
+}
+
+static void PoolOrphan( smem_pool_t *p_pool )
+{
+    bool b_delete;
+
+    vlc_mutex_lock( &p_pool->lock );
+    p_pool->b_orphan = true;
+    b_delete = p_pool->i_free == p_pool->i_size;
+    vlc_mutex_unlock( &p_pool->lock );
+
+    if( b_delete )
+        PoolDelete( p_pool );
+}
+
 /*****************************************************************************
  * Open:
  *****************************************************************************/
@@ -237,6 +381,15 @@ static int Open( vlc_object_t *p_this )
     if (p_sys->pf_audio_postrender_callback == NULL)
         p_sys->pf_audio_postrender_callback = AudioPostrenderDefaultCallback;
 
+    /* No default: the buffers are copied without deliver callbacks */
+    psz_tmp = var_GetString( p_stream, SOUT_PREFIX_VIDEO "deliver-callback" );
+    p_sys->pf_video_deliver_callback = (void (*) (void*, const uint8_t*, int, int, int, size_t, mtime_t, void (*) (void*), void*))(intptr_t)atoll( psz_tmp );
+    free( psz_tmp );
+
+    psz_tmp = var_GetString( p_stream, SOUT_PREFIX_AUDIO "deliver-callback" );
+    p_sys->pf_audio_deliver_callback = (void (*) (void*, const uint8_t*, unsigned int, unsigned int, unsigned int, unsigned int, size_t, mtime_t, void (*) (void*), void*))(intptr_t)atoll( psz_tmp );
+    free( psz_tmp );
+
     /* Setting stream out module callbacks */
     p_stream->pf_add    = Add;
     p_stream->pf_del    = Del;
@@ -312,6 +465,16 @@ static sout_stream_id_sys_t *AddVideo( sout_stream_t *p_stream,
     id->p_data = (void *)( intptr_t )atoll( psz_tmp );
     free( psz_tmp );
 
+    if( p_stream->p_sys->pf_video_deliver_callback != NULL )
+    {
+        id->p_pool = PoolNew( var_GetInteger( p_stream, SOUT_CFG_PREFIX "pool-size" ) );
+        if( !id->p_pool )
+        {
+            free( id );
+            return NULL;
+        }
+    }
+
     es_format_Copy( &id->format, p_fmt );
     id->format.video.i_bits_per_pixel = i_bits_per_pixel;
     return id;
@@ -338,6 +501,16 @@ static sout_stream_id_sys_t *AddAudio( sout_stream_t *p_stream,
     id->p_data = (void *)( intptr_t )atoll( psz_tmp );
     free( psz_tmp );
 
+    if( p_stream->p_sys->pf_audio_deliver_callback != NULL )
+    {
+        id->p_pool = PoolNew( var_GetInteger( p_stream, SOUT_CFG_PREFIX "pool-size" ) );
+        if( !id->p_pool )
+        {
+            free( id );
+            return NULL;
+        }
+    }
+
     es_format_Copy( &id->format, p_fmt );
     id->format.audio.i_bitspersample = i_bits_per_sample;
     return id;
@@ -346,6 +519,9 @@ static sout_stream_id_sys_t *AddAudio( sout_stream_t *p_stream,
 static void Del( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
 {
     VLC_UNUSED( p_stream );
+    /* The application may still hold some of the delivered buffers */
+    if( id->p_pool )
+        PoolOrphan( id->p_pool );
     es_format_Clean( &id->format );
     free( id );
 }
@@ -367,6 +543,24 @@ static int SendVideo( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
     size_t i_size = p_buffer->i_buffer;
     uint8_t* p_pixels = NULL;
 
+    if( id->p_pool )
+    {
+        /* Hand the buffers over, the application releases them */
+        while( p_buffer )
+        {
+            block_t *p_next = p_buffer->p_next;
+            p_buffer->p_next = NULL;
+
+            smem_buffer_t *p_buf = PoolGet( id->p_pool, p_buffer );
+            p_sys->pf_video_deliver_callback( id->p_data, p_buffer->p_buffer,
+                                              id->format.video.i_width, id->format.video.i_height,
+                                              id->format.video.i_bits_per_pixel, p_buffer->i_buffer,
+                                              p_buffer->i_pts, PoolRelease, p_buf );
+            p_buffer = p_next;
+        }
+        return VLC_SUCCESS;
+    }
+
     /* Calling the prerender callback to get user buffer */
     p_sys->pf_video_prerender_callback( id->p_data, &p_pixels, i_size );
 
@@ -403,6 +597,25 @@ static int SendAudio( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
         return VLC_EGENERIC;
     }
 
+    if( id->p_pool )
+    {
+        /* Hand the buffers over, the application releases them */
+        while( p_buffer )
+        {
+            block_t *p_next = p_buffer->p_next;
+            p_buffer->p_next = NULL;
+
+            i_samples = p_buffer->i_buffer / ( ( id->format.audio.i_bitspersample / 8 ) * id->format.audio.i_channels );
+            smem_buffer_t *p_buf = PoolGet( id->p_pool, p_buffer );
+            p_sys->pf_audio_deliver_callback( id->p_data, p_buffer->p_buffer,
+                                              id->format.audio.i_channels, id->format.audio.i_rate, i_samples,
+                                              id->format.audio.i_bitspersample, p_buffer->i_buffer,
+                                              p_buffer->i_pts, PoolRelease, p_buf );
+            p_buffer = p_next;
+        }
+        return VLC_SUCCESS;
+    }
+
     i_samples = i_size / ( ( id->format.audio.i_bitspersample / 8 ) * id->format.audio.i_channels );
     /* Calling the prerender callback to get user buffer */
     p_sys->pf_audio_prerender_callback( id->p_data, &p_pcm_buffer, i_size );
@@ -0,0 +1,367 @@
+/*****************************************************************************
+ * splice.c: splicing stream output module
+ *****************************************************************************
+ * Copyright © 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_sout.h>
+#include <vlc_block.h>
+
+/*
+ * Like gather, splice keeps the outputs of the previous input (with
+ * --sout-keep) and reuses them for the elementary streams of the next input
+ * with the same codec parameters. It additionally splices the compressed
+ * streams without re-encoding them:
+ *  - the new input is output from its first video keyframe on, and the
+ *    blocks of its other streams dated before that keyframe are dropped;
+ *  - the pictures that follow the keyframe in decoding order but precede it
+ *    in presentation order are dropped too, since with an open GOP they
+ *    reference pictures of the previous input;
+ *  - its timestamps are shifted to follow the end of the previous input, so
+ *    that the dates, and thus the PCR of the muxer, remain continuous.
+ * A stream whose codec parameters differ cannot be spliced: it gets a new
+ * output, as with gather.
+ */
+
+/*****************************************************************************
+ * Module descriptor
+ *****************************************************************************/
+static int      Open    ( vlc_object_t * );
+static void     Close   ( vlc_object_t * );
+
+vlc_module_begin ()
+    set_description( N_("Splicing stream output") )
+    set_capability( "sout stream", 50 )
+    add_shortcut( "splice" )
+    set_callbacks( Open, Close )
+vlc_module_end ()
+
+/*****************************************************************************
+ * Exported prototypes
+ *****************************************************************************/
+static sout_stream_id_sys_t *Add ( sout_stream_t *, const es_format_t * );
+static void              Del ( sout_stream_t *, sout_stream_id_sys_t * );
+static int               Send( sout_stream_t *, sout_stream_id_sys_t *, block_t* );
+
+struct sout_stream_id_sys_t
+{
+    bool    b_used;
+    bool    b_spliced; /* past the splice point of the input in progress */
+
+    es_format_t fmt;
+    void          *id;
+};
+
+struct sout_stream_sys_t
+{
+    int              i_id;
+    sout_stream_id_sys_t **id;
+
+    /* Input in progress */
+    bool             b_splicing; /* waiting for its splice point */
+    mtime_t          i_splice;   /* input date of its splice point */
+    mtime_t          i_splice_pts; /* and presentation date */
+    mtime_t          i_offset;   /* from its dates to the output dates */
+
+    /* Output date following the last block sent */
+    mtime_t          i_next;
+};
+
+/*****************************************************************************
+ * Open:
+ *****************************************************************************/
+static int Open( vlc_object_t *p_this )
+{
+    sout_stream_t     *p_stream = (sout_stream_t*)p_this;
+    sout_stream_sys_t *p_sys;
+
+    if( !p_stream->p_next )
+        return VLC_EGENERIC;
+
+    p_stream->p_sys = p_sys = malloc( sizeof( sout_stream_sys_t ) );
+    if( p_sys == NULL )
+        return VLC_ENOMEM;
+
+    p_stream->pf_add    = Add;
+    p_stream->pf_del    = Del;
+    p_stream->pf_send   = Send;
+
+    TAB_INIT( p_sys->i_id, p_sys->id );
+    p_sys->b_splicing = false;
+    p_sys->i_splice   = VLC_TS_INVALID;
+    p_sys->i_splice_pts = VLC_TS_INVALID;
+    p_sys->i_offset   = 0;
+    p_sys->i_next     = VLC_TS_INVALID;
+
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * Close:
+ *****************************************************************************/
+static void Close( vlc_object_t * p_this )
+{
+    sout_stream_t     *p_stream = (sout_stream_t*)p_this;
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    for( int i = 0; i < p_sys->i_id; i++ )
+    {
+        sout_stream_id_sys_t *id = p_sys->id[i];
+
+        sout_StreamIdDel( p_stream->p_next, id->id );
+        es_format_Clean( &id->fmt );
+        free( id );
+    }
+    TAB_CLEAN( p_sys->i_id, p_sys->id );
+
+    free( p_sys );
+}
+
+/* Whether the blocks of p_fmt can follow those of id without the decoders
+ * downstream noticing */
+static bool CanSplice( const sout_stream_id_sys_t *id, const es_format_t *p_fmt )
+{
+    if( id->fmt.i_cat != p_fmt->i_cat || id->fmt.i_codec != p_fmt->i_codec )
+        return false;
+
+    if( id->fmt.i_extra != p_fmt->i_extra ||
+        ( p_fmt->i_extra > 0 &&
+          memcmp( id->fmt.p_extra, p_fmt->p_extra, p_fmt->i_extra ) ) )
+        return false;
+
+    if( id->fmt.i_cat == AUDIO_ES )
+    {
+        const audio_format_t *p_a = &id->fmt.audio;
+        if( p_a->i_rate != p_fmt->audio.i_rate ||
+            p_a->i_channels != p_fmt->audio.i_channels ||
+            p_a->i_blockalign != p_fmt->audio.i_blockalign )
+            return false;
+    }
+    else if( id->fmt.i_cat == VIDEO_ES )
+    {
+        const video_format_t *p_v = &id->fmt.video;
+        if( p_v->i_width != p_fmt->video.i_width ||
+            p_v->i_height != p_fmt->video.i_height ||
+            id->fmt.i_profile != p_fmt->i_profile ||
+            id->fmt.i_level != p_fmt->i_level )
+            return false;
+    }
+    return true;
+}
+
+/*****************************************************************************
+ * Add:
+ *****************************************************************************/
+static sout_stream_id_sys_t * Add( sout_stream_t *p_stream, const es_format_t *p_fmt )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+    sout_stream_id_sys_t  *id;
+    bool b_new_input = true;
+
+    for( int i = 0; i < p_sys->i_id; i++ )
+        if( p_sys->id[i]->b_used )
+            b_new_input = false;
+
+    /* The first stream of an input, after those of the previous one were
+     * all deleted, starts a new splice */
+    if( b_new_input && p_sys->i_next > VLC_TS_INVALID )
+    {
+        msg_Dbg( p_stream, "waiting for the splice point of the next input" );
+        p_sys->b_splicing = true;
+        p_sys->i_splice = VLC_TS_INVALID;
+        p_sys->i_splice_pts = VLC_TS_INVALID;
+    }
+
+    /* search a compatible output */
+    for( int i = 0; i < p_sys->i_id; i++ )
+    {
+        id = p_sys->id[i];
+        if( id->b_used || !CanSplice( id, p_fmt ) )
+            continue;
+
+        msg_Dbg( p_stream, "splicing to already opened output" );
+        id->b_used = true;
+        id->b_spliced = false;
+        return id;
+    }
+
+    /* destroy all outputs from the same category */
+    for( int i = 0; i < p_sys->i_id; )
+    {
+        id = p_sys->id[i];
+        if( !id->b_used && id->fmt.i_cat == p_fmt->i_cat )
+        {
+            TAB_REMOVE( p_sys->i_id, p_sys->id, id );
+            sout_StreamIdDel( p_stream->p_next, id->id );
+            es_format_Clean( &id->fmt );
+            free( id );
+            continue;
+        }
+        i++;
+    }
+
+    msg_Dbg( p_stream, "creating new output" );
+    id = malloc( sizeof( sout_stream_id_sys_t ) );
+    if( id == NULL )
+        return NULL;
+    es_format_Copy( &id->fmt, p_fmt );
+    id->b_used           = true;
+    id->b_spliced        = false;
+    id->id               = sout_StreamIdAdd( p_stream->p_next, &id->fmt );
+    if( id->id == NULL )
+    {
+        es_format_Clean( &id->fmt );
+        free( id );
+        return NULL;
+    }
+    TAB_APPEND( p_sys->i_id, p_sys->id, id );
+
+    return id;
+}
+
+/*****************************************************************************
+ * Del:
+ *****************************************************************************/
+static void Del( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
+{
+    VLC_UNUSED(p_stream);
+    id->b_used = false;
+}
+
+/* Finds the splice point of the input in progress: its first video keyframe,
+ * or its first block if it has no video */
+static bool SplicePoint( sout_stream_sys_t *p_sys, sout_stream_id_sys_t *id,
+                         const block_t *p_buffer )
+{
+    if( p_buffer->i_dts <= VLC_TS_INVALID )
+        return false;
+
+    if( id->fmt.i_cat == VIDEO_ES )
+        return ( p_buffer->i_flags & BLOCK_FLAG_TYPE_I ) != 0;
+
+    for( int i = 0; i < p_sys->i_id; i++ )
+        if( p_sys->id[i]->b_used && p_sys->id[i]->fmt.i_cat == VIDEO_ES )
+            return false;
+    return true;
+}
+
+/* Whether a block of the input in progress precedes its splice point, and
+ * must be dropped. Each stream is checked until it gets past that point, so
+ * that later discontinuities of the input do not drop anything. */
+static bool BeforeSplice( const sout_stream_sys_t *p_sys,
+                          sout_stream_id_sys_t *id, const block_t *p_buffer )
+{
+    if( id->b_spliced || p_sys->i_splice <= VLC_TS_INVALID )
+        return false;
+
+    if( id->fmt.i_cat == VIDEO_ES && p_buffer->i_pts > VLC_TS_INVALID &&
+        p_sys->i_splice_pts > VLC_TS_INVALID )
+    {
+        /* The leading pictures of the keyframe come right after it in
+         * decoding order, and before it in presentation order */
+        if( p_buffer->i_pts < p_sys->i_splice_pts )
+            return true;
+        if( p_buffer->i_pts > p_sys->i_splice_pts )
+            id->b_spliced = true;
+        return false;
+    }
+
+    if( p_buffer->i_dts <= VLC_TS_INVALID )
+        return false;
+    if( p_buffer->i_dts < p_sys->i_splice )
+        return true;
+    if( id->fmt.i_cat != VIDEO_ES || p_buffer->i_dts > p_sys->i_splice )
+        id->b_spliced = true;
+    return false;
+}
+
+/* Output duration of a block, that the next input will follow */
+static mtime_t BlockLength( const sout_stream_id_sys_t *id,
+                            const block_t *p_buffer )
+{
+    if( p_buffer->i_length > 0 )
+        return p_buffer->i_length;
+
+    const video_format_t *p_v = &id->fmt.video;
+    if( id->fmt.i_cat == VIDEO_ES && p_v->i_frame_rate && p_v->i_frame_rate_base )
+        return CLOCK_FREQ * p_v->i_frame_rate_base / p_v->i_frame_rate;
+    return 1;
+}
+
+/*****************************************************************************
+ * Send:
+ *****************************************************************************/
+static int Send( sout_stream_t *p_stream,
+                 sout_stream_id_sys_t *id, block_t *p_buffer )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+    int i_ret = VLC_SUCCESS;
+
+    for( block_t *p_next; p_buffer != NULL; p_buffer = p_next )
+    {
+        p_next = p_buffer->p_next;
+        p_buffer->p_next = NULL;
+
+        if( p_sys->b_splicing )
+        {
+            if( !SplicePoint( p_sys, id, p_buffer ) )
+            {
+                block_Release( p_buffer );
+                continue;
+            }
+
+            p_sys->b_splicing = false;
+            p_sys->i_splice = p_buffer->i_dts;
+            p_sys->i_splice_pts = p_buffer->i_pts;
+            p_sys->i_offset = p_sys->i_next - p_buffer->i_dts;
+            msg_Dbg( p_stream, "spliced at %"PRId64" (offset %"PRId64")",
+                     p_sys->i_next, p_sys->i_offset );
+        }
+
+        if( BeforeSplice( p_sys, id, p_buffer ) )
+        {
+            block_Release( p_buffer );
+            continue;
+        }
+
+        if( p_buffer->i_dts > VLC_TS_INVALID )
+            p_buffer->i_dts += p_sys->i_offset;
+        if( p_buffer->i_pts > VLC_TS_INVALID )
+            p_buffer->i_pts += p_sys->i_offset;
+
+        if( p_buffer->i_dts > VLC_TS_INVALID )
+        {
+            mtime_t i_end = p_buffer->i_dts + BlockLength( id, p_buffer );
+            if( i_end > p_sys->i_next )
+                p_sys->i_next = i_end;
+        }
+
+        if( sout_StreamIdSend( p_stream->p_next, id->id, p_buffer ) )
+            i_ret = VLC_EGENERIC;
+    }
+    return i_ret;
+}
@@ -226,11 +226,120 @@ void transcode_audio_close( sout_stream_id_sys_t *id )
         aout_FiltersDelete( (vlc_object_t *)NULL, id->p_af_chain );
 }
 
+static bool transcode_audio_needs_init( sout_stream_id_sys_t *id )
+{
+    return !id->p_encoder->p_module ||
+           id->p_decoder->fmt_out.audio.i_rate != id->fmt_audio.i_rate ||
+           id->p_decoder->fmt_out.audio.i_physical_channels !=
+               id->fmt_audio.i_physical_channels;
+}
+
+/* Opens the encoder if it failed to, and rebuilds the filters for the
+ * decoded format */
+static int transcode_audio_init( sout_stream_t *p_stream,
+                                 sout_stream_id_sys_t *id,
+                                 const block_t *p_audio_buf )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    if( unlikely( !id->p_encoder->p_module ) )
+    {
+        /* Complete destination format */
+        id->p_encoder->fmt_out.i_codec = p_sys->i_acodec;
+        id->p_encoder->fmt_out.audio.i_rate = p_sys->i_sample_rate > 0 ?
+            p_sys->i_sample_rate : id->p_decoder->fmt_out.audio.i_rate;
+        id->p_encoder->fmt_out.i_bitrate = p_sys->i_abitrate;
+        id->p_encoder->fmt_out.audio.i_bitspersample =
+            id->p_decoder->fmt_out.audio.i_bitspersample;
+        id->p_encoder->fmt_out.audio.i_channels = p_sys->i_channels > 0 ?
+            p_sys->i_channels : id->p_decoder->fmt_out.audio.i_channels;
+
+        id->p_encoder->fmt_in.audio.i_physical_channels =
+        id->p_encoder->fmt_out.audio.i_physical_channels =
+            pi_channels_maps[id->p_encoder->fmt_out.audio.i_channels];
+
+        if( transcode_audio_initialize_encoder( id, p_stream ) )
+        {
+            msg_Err( p_stream, "cannot create audio chain" );
+            return VLC_EGENERIC;
+        }
+        if( unlikely( transcode_audio_initialize_filters( p_stream, id, p_sys,
+                      &id->p_decoder->fmt_out.audio ) != VLC_SUCCESS ) )
+            return VLC_EGENERIC;
+        date_Init( &id->next_input_pts, id->p_decoder->fmt_out.audio.i_rate, 1 );
+        date_Set( &id->next_input_pts, p_audio_buf->i_pts );
+    }
+
+    /* Check if audio format has changed, and filters need reinit */
+    if( unlikely( ( id->p_decoder->fmt_out.audio.i_rate != id->fmt_audio.i_rate ) ||
+                  ( id->p_decoder->fmt_out.audio.i_physical_channels != id->fmt_audio.i_physical_channels ) ) )
+    {
+        msg_Info( p_stream, "Audio changed, trying to reinitialize filters" );
+        if( id->p_af_chain != NULL )
+            aout_FiltersDelete( (vlc_object_t *)NULL, id->p_af_chain );
+
+        /* decoders don't set audio.i_format, but audio filters use it */
+        id->p_decoder->fmt_out.audio.i_format = id->p_decoder->fmt_out.i_codec;
+        aout_FormatPrepare( &id->p_decoder->fmt_out.audio );
+
+        if( transcode_audio_initialize_filters( p_stream, id, p_sys,
+                      &id->p_decoder->fmt_out.audio ) != VLC_SUCCESS )
+            return VLC_EGENERIC;
+
+        /* Set next_input_pts to run with new samplerate */
+        date_Init( &id->next_input_pts, id->fmt_audio.i_rate, 1 );
+        date_Set( &id->next_input_pts, p_audio_buf->i_pts );
+    }
+    return VLC_SUCCESS;
+}
+
+static void transcode_audio_sync( sout_stream_t *p_stream,
+                                  sout_stream_id_sys_t *id,
+                                  block_t *p_audio_buf )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    if( p_sys->b_master_sync )
+    {
+        mtime_t i_pts = date_Get( &id->next_input_pts );
+        mtime_t i_drift = 0;
+
+        if( likely( p_audio_buf->i_pts != VLC_TS_INVALID ) )
+            i_drift = p_audio_buf->i_pts - i_pts;
+
+        if ( unlikely(i_drift > MASTER_SYNC_MAX_DRIFT
+             || i_drift < -MASTER_SYNC_MAX_DRIFT) )
+        {
+            msg_Dbg( p_stream,
+                "audio drift is too high (%"PRId64"), resetting master sync",
+                i_drift );
+            date_Set( &id->next_input_pts, p_audio_buf->i_pts );
+            i_pts = date_Get( &id->next_input_pts );
+            if( likely(p_audio_buf->i_pts != VLC_TS_INVALID ) )
+                i_drift = p_audio_buf->i_pts - i_pts;
+        }
+        atomic_store( &p_sys->i_master_drift, i_drift );
+        date_Increment( &id->next_input_pts, p_audio_buf->i_nb_samples );
+    }
+
+    p_audio_buf->i_dts = p_audio_buf->i_pts;
+}
+
+/* Run filter chain */
+static block_t *transcode_audio_filter( sout_stream_id_sys_t *id,
+                                        block_t *p_audio_buf )
+{
+    p_audio_buf = aout_FiltersPlay( id->p_af_chain, p_audio_buf,
+                                    INPUT_RATE_DEFAULT );
+    if( p_audio_buf )
+        p_audio_buf->i_dts = p_audio_buf->i_pts;
+    return p_audio_buf;
+}
+
 int transcode_audio_process( sout_stream_t *p_stream,
                                     sout_stream_id_sys_t *id,
                                     block_t *in, block_t **out )
 {
-    sout_stream_sys_t *p_sys = p_stream->p_sys;
     *out = NULL;
     bool b_error = false;
 
@@ -254,91 +363,18 @@ int transcode_audio_process( sout_stream_t *p_stream,
             continue;
         }
 
-        if( unlikely( !id->p_encoder->p_module ) )
-        {
-            /* Complete destination format */
-            id->p_encoder->fmt_out.i_codec = p_sys->i_acodec;
-            id->p_encoder->fmt_out.audio.i_rate = p_sys->i_sample_rate > 0 ?
-                p_sys->i_sample_rate : id->p_decoder->fmt_out.audio.i_rate;
-            id->p_encoder->fmt_out.i_bitrate = p_sys->i_abitrate;
-            id->p_encoder->fmt_out.audio.i_bitspersample =
-                id->p_decoder->fmt_out.audio.i_bitspersample;
-            id->p_encoder->fmt_out.audio.i_channels = p_sys->i_channels > 0 ?
-                p_sys->i_channels : id->p_decoder->fmt_out.audio.i_channels;
-
-            id->p_encoder->fmt_in.audio.i_physical_channels =
-            id->p_encoder->fmt_out.audio.i_physical_channels =
-                pi_channels_maps[id->p_encoder->fmt_out.audio.i_channels];
-
-            if( transcode_audio_initialize_encoder( id, p_stream ) )
-            {
-                msg_Err( p_stream, "cannot create audio chain" );
-                goto error;
-            }
-            if( unlikely( transcode_audio_initialize_filters( p_stream, id, p_sys,
-                          &id->p_decoder->fmt_out.audio ) != VLC_SUCCESS ) )
-                goto error;
-            date_Init( &id->next_input_pts, id->p_decoder->fmt_out.audio.i_rate, 1 );
-            date_Set( &id->next_input_pts, p_audio_buf->i_pts );
-        }
-
-        /* Check if audio format has changed, and filters need reinit */
-        if( unlikely( ( id->p_decoder->fmt_out.audio.i_rate != id->fmt_audio.i_rate ) ||
-                      ( id->p_decoder->fmt_out.audio.i_physical_channels != id->fmt_audio.i_physical_channels ) ) )
-        {
-            msg_Info( p_stream, "Audio changed, trying to reinitialize filters" );
-            if( id->p_af_chain != NULL )
-                aout_FiltersDelete( (vlc_object_t *)NULL, id->p_af_chain );
-
-            /* decoders don't set audio.i_format, but audio filters use it */
-            id->p_decoder->fmt_out.audio.i_format = id->p_decoder->fmt_out.i_codec;
-            aout_FormatPrepare( &id->p_decoder->fmt_out.audio );
-
-            if( transcode_audio_initialize_filters( p_stream, id, p_sys,
-                          &id->p_decoder->fmt_out.audio ) != VLC_SUCCESS )
-                goto error;
-
-            /* Set next_input_pts to run with new samplerate */
-            date_Init( &id->next_input_pts, id->fmt_audio.i_rate, 1 );
-            date_Set( &id->next_input_pts, p_audio_buf->i_pts );
-        }
-
-        if( p_sys->b_master_sync )
-        {
-            mtime_t i_pts = date_Get( &id->next_input_pts );
-            mtime_t i_drift = 0;
-
-            if( likely( p_audio_buf->i_pts != VLC_TS_INVALID ) )
-                i_drift = p_audio_buf->i_pts - i_pts;
-
-            if ( unlikely(i_drift > MASTER_SYNC_MAX_DRIFT
-                 || i_drift < -MASTER_SYNC_MAX_DRIFT) )
-            {
-                msg_Dbg( p_stream,
-                    "audio drift is too high (%"PRId64"), resetting master sync",
-                    i_drift );
-                date_Set( &id->next_input_pts, p_audio_buf->i_pts );
-                i_pts = date_Get( &id->next_input_pts );
-                if( likely(p_audio_buf->i_pts != VLC_TS_INVALID ) )
-                    i_drift = p_audio_buf->i_pts - i_pts;
-            }
-            p_sys->i_master_drift = i_drift;
-            date_Increment( &id->next_input_pts, p_audio_buf->i_nb_samples );
-        }
+        if( transcode_audio_init( p_stream, id, p_audio_buf ) != VLC_SUCCESS )
+            goto error;
 
-        p_audio_buf->i_dts = p_audio_buf->i_pts;
+        transcode_audio_sync( p_stream, id, p_audio_buf );
 
-        /* Run filter chain */
-        p_audio_buf = aout_FiltersPlay( id->p_af_chain, p_audio_buf,
-                                        INPUT_RATE_DEFAULT );
+        p_audio_buf = transcode_audio_filter( id, p_audio_buf );
         if( !p_audio_buf )
         {
             b_error = true;
             continue;
         }
 
-        p_audio_buf->i_dts = p_audio_buf->i_pts;
-
         block_t *p_block = id->p_encoder->pf_encode_audio( id->p_encoder, p_audio_buf );
 
         block_ChainAppend( out, p_block );
@@ -363,6 +399,100 @@ end:
     return b_error ? VLC_EGENERIC : VLC_SUCCESS;
 }
 
+/*
+ * Pipelined stages: decoder, filters (resampler included), encoder
+ */
+static void DecodeStage( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
+                         void *data )
+{
+    transcode_pipeline_t *p = id->p_pipeline;
+    block_t *in = data;
+
+    if( transcode_pipeline_Failed( p ) )
+    {
+        if( in != NULL )
+            block_Release( in );
+        return;
+    }
+
+    if( id->p_decoder->pf_decode( id->p_decoder, in ) != VLCDEC_SUCCESS )
+        return;
+
+    for( block_t *p_bufs = transcode_dequeue_all_audios( id ); p_bufs; )
+    {
+        block_t *p_audio_buf = p_bufs;
+        p_bufs = p_bufs->p_next;
+        p_audio_buf->p_next = NULL;
+
+        if( transcode_pipeline_Failed( p ) )
+        {
+            block_Release( p_audio_buf );
+            continue;
+        }
+
+        /* The chains of the next stages are only changed while idle */
+        if( transcode_audio_needs_init( id ) )
+        {
+            transcode_pipeline_Wait( p );
+            if( transcode_audio_init( p_stream, id, p_audio_buf ) )
+            {
+                block_Release( p_audio_buf );
+                transcode_pipeline_Fail( p );
+                continue;
+            }
+        }
+
+        transcode_audio_sync( p_stream, id, p_audio_buf );
+        transcode_pipeline_Emit( p, 0, p_audio_buf );
+    }
+}
+
+static void FilterStage( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
+                         void *data )
+{
+    VLC_UNUSED(p_stream);
+    if( data == NULL )
+        return;
+
+    block_t *p_audio_buf = transcode_audio_filter( id, data );
+    if( p_audio_buf )
+        transcode_pipeline_Emit( id->p_pipeline, 1, p_audio_buf );
+}
+
+static void EncodeStage( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
+                         void *data )
+{
+    VLC_UNUSED(p_stream);
+    block_t *p_out = NULL;
+
+    if( data != NULL )
+    {
+        p_out = id->p_encoder->pf_encode_audio( id->p_encoder, data );
+        block_Release( data );
+    }
+    else if( id->p_encoder->p_module )
+    {
+        block_t *p_block;
+        do {
+           p_block = id->p_encoder->pf_encode_audio( id->p_encoder, NULL );
+           block_ChainAppend( &p_out, p_block );
+        } while( p_block );
+    }
+
+    transcode_pipeline_Emit( id->p_pipeline, 2, p_out );
+}
+
+bool transcode_audio_pipeline( sout_stream_t *p_stream,
+                               sout_stream_id_sys_t *id )
+{
+    static const transcode_stage_cb stages[] = {
+        DecodeStage, FilterStage, EncodeStage,
+    };
+
+    return transcode_pipeline_New( p_stream, id, stages, ARRAY_SIZE(stages),
+                                   VLC_THREAD_PRIORITY_AUDIO ) != NULL;
+}
+
 bool transcode_audio_add( sout_stream_t *p_stream, const es_format_t *p_fmt,
             sout_stream_id_sys_t *id )
 {
@@ -0,0 +1,495 @@
+/*****************************************************************************
+ * chunk.c: transcoding stream output module (GOP-parallel video)
+ *****************************************************************************
+ * Copyright © 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#include "transcode.h"
+
+#include <vlc_block.h>
+#include <vlc_modules.h>
+
+/*
+ * The video is cut into chunks at the first keyframe after every
+ * gop-length, and each chunk is transcoded by a thread of its own through
+ * a private decoder -> filters -> encoder chain (see video.c). The encoded
+ * chunks are then sent on in order, as a single elementary stream.
+ *
+ * Each chunk only encodes the pictures dated from its first keyframe up to
+ * the keyframe starting the next chunk. Decoders may need the previous GOP
+ * to rebuild the leading pictures of an open GOP, so a chunk also decodes
+ * the next keyframe and the blocks dated before it that follow.
+ */
+
+struct transcode_chunk_t
+{
+    transcode_chunker_t  *p_owner;
+    sout_stream_id_sys_t *id;       /* private chain */
+    vlc_thread_t          thread;
+    vlc_cond_t            wait;
+
+    mtime_t               i_start;  /* first picture date to encode */
+    mtime_t               i_end;    /* first picture date not to encode */
+    mtime_t               i_first;  /* first input block date */
+    bool                  b_dts_shift; /* known once it output dates */
+    mtime_t               i_dts_shift; /* to the reordering delay of the
+                                          first chunk */
+
+    /* Protected by the chunker lock */
+    block_t              *p_in;
+    block_t             **pp_in_last;
+    bool                  b_eos;    /* no more input */
+    block_t              *p_out;
+    block_t             **pp_out_last;
+    bool                  b_done;   /* thread exited */
+
+    transcode_chunk_t    *p_next;
+};
+
+struct transcode_chunker_t
+{
+    sout_stream_t        *p_stream;
+    vlc_mutex_t           lock;
+    vlc_cond_t            wait;     /* a chunk is done */
+    unsigned              i_running;
+
+    transcode_chunk_t    *p_first;  /* oldest chunk, being output */
+    transcode_chunk_t   **pp_last;
+    transcode_chunk_t    *p_input;  /* chunk receiving the input */
+    transcode_chunk_t    *p_lead;   /* chunk finishing its last GOP */
+
+    es_format_t           fmt;      /* of the first encoded chunk */
+    bool                  b_delay;
+    mtime_t               i_delay;  /* reordering delay of the first chunk */
+    mtime_t               i_last_dts;
+};
+
+static void *ChunkThread( void *obj )
+{
+    transcode_chunk_t    *chunk = obj;
+    transcode_chunker_t  *p_chunker = chunk->p_owner;
+    sout_stream_t        *p_stream = p_chunker->p_stream;
+    sout_stream_id_sys_t *id = chunk->id;
+    bool b_error = false;
+    int canc = vlc_savecancel();
+
+    vlc_mutex_lock( &p_chunker->lock );
+    for( ;; )
+    {
+        while( chunk->p_in == NULL && !chunk->b_eos )
+            vlc_cond_wait( &chunk->wait, &p_chunker->lock );
+
+        block_t *p_in = chunk->p_in;
+        const bool b_eos = p_in == NULL;
+        if( p_in != NULL )
+        {
+            chunk->p_in = p_in->p_next;
+            if( chunk->p_in == NULL )
+                chunk->pp_in_last = &chunk->p_in;
+            p_in->p_next = NULL;
+        }
+        vlc_mutex_unlock( &p_chunker->lock );
+
+        block_t *p_out = NULL;
+        if( b_error )
+        {
+            if( p_in != NULL )
+                block_Release( p_in );
+        }
+        else if( b_eos || (p_in = block_Unshare( p_in )) != NULL )
+        {
+            transcode_video_process( p_stream, id, p_in, &p_out );
+            /* the chain is closed if the encoder could not be opened */
+            b_error = !id->b_transcode;
+        }
+
+        vlc_mutex_lock( &p_chunker->lock );
+        block_ChainLastAppend( &chunk->pp_out_last, p_out );
+
+        if( b_eos )
+            break;
+    }
+
+    chunk->b_done = true;
+    p_chunker->i_running--;
+    vlc_cond_signal( &p_chunker->wait );
+    vlc_mutex_unlock( &p_chunker->lock );
+
+    vlc_restorecancel( canc );
+    return NULL;
+}
+
+static void ChunkDelete( sout_stream_t *p_stream, transcode_chunk_t *chunk )
+{
+    vlc_join( chunk->thread, NULL );
+
+    if( chunk->id->b_transcode )
+        transcode_video_close( p_stream, chunk->id );
+    transcode_stream_id_delete( chunk->id );
+
+    block_ChainRelease( chunk->p_in );
+    block_ChainRelease( chunk->p_out );
+    vlc_cond_destroy( &chunk->wait );
+    free( chunk );
+}
+
+/* Must be called with the lock held */
+static void ChunkPut( transcode_chunk_t *chunk, block_t *p_block )
+{
+    block_ChainLastAppend( &chunk->pp_in_last, p_block );
+    vlc_cond_signal( &chunk->wait );
+}
+
+/* Must be called with the lock held */
+static void ChunkEnd( transcode_chunk_t *chunk )
+{
+    chunk->b_eos = true;
+    vlc_cond_signal( &chunk->wait );
+}
+
+static transcode_chunk_t *ChunkNew( sout_stream_t *p_stream,
+                                    sout_stream_id_sys_t *id,
+                                    mtime_t i_start, mtime_t i_first )
+{
+    sout_stream_sys_t   *p_sys = p_stream->p_sys;
+    transcode_chunker_t *p_chunker = id->p_chunker;
+
+    /* One more than requested, as the previous chunk usually still has to
+     * finish its last GOP */
+    vlc_mutex_lock( &p_chunker->lock );
+    while( p_chunker->i_running > (unsigned)p_sys->i_chunk_threads )
+        vlc_cond_wait( &p_chunker->wait, &p_chunker->lock );
+    vlc_mutex_unlock( &p_chunker->lock );
+
+    transcode_chunk_t *chunk = malloc( sizeof( *chunk ) );
+    if( unlikely(chunk == NULL) )
+        return NULL;
+
+    chunk->p_owner = p_chunker;
+    chunk->i_start = i_start;
+    chunk->i_end = INT64_MAX;
+    chunk->i_first = i_first;
+    chunk->b_dts_shift = false;
+    chunk->i_dts_shift = 0;
+    chunk->p_in = NULL;
+    chunk->pp_in_last = &chunk->p_in;
+    chunk->b_eos = false;
+    chunk->p_out = NULL;
+    chunk->pp_out_last = &chunk->p_out;
+    chunk->b_done = false;
+    chunk->p_next = NULL;
+    vlc_cond_init( &chunk->wait );
+
+    chunk->id = transcode_stream_id_new( p_stream, &id->p_decoder->fmt_in );
+    if( chunk->id == NULL )
+        goto error;
+    chunk->id->p_chunk = chunk;
+
+    if( !transcode_video_add( p_stream, &id->p_decoder->fmt_in, chunk->id ) )
+    {
+        transcode_stream_id_delete( chunk->id );
+        goto error;
+    }
+
+    vlc_mutex_lock( &p_chunker->lock );
+    if( vlc_clone( &chunk->thread, ChunkThread, chunk,
+                   p_sys->b_high_priority ? VLC_THREAD_PRIORITY_OUTPUT
+                                          : VLC_THREAD_PRIORITY_VIDEO ) )
+    {
+        vlc_mutex_unlock( &p_chunker->lock );
+        msg_Err( p_stream, "cannot spawn GOP chunk thread" );
+        transcode_video_close( p_stream, chunk->id );
+        transcode_stream_id_delete( chunk->id );
+        goto error;
+    }
+    p_chunker->i_running++;
+    *p_chunker->pp_last = chunk;
+    p_chunker->pp_last = &chunk->p_next;
+    vlc_mutex_unlock( &p_chunker->lock );
+    return chunk;
+
+error:
+    vlc_cond_destroy( &chunk->wait );
+    free( chunk );
+    return NULL;
+}
+
+/* Encoders restart their timeline at every chunk: the decoding dates of a
+ * chunk are shifted by a constant, so that its reordering delay (between the
+ * dates of its first block) is that of the first chunk, and the decoding
+ * dates keep evenly spaced across the boundaries.
+ * Must be called with the lock held. */
+static void ChunkShiftDts( transcode_chunker_t *p_chunker,
+                           transcode_chunk_t *chunk )
+{
+    for( block_t *p_block = chunk->p_out; p_block != NULL;
+         p_block = p_block->p_next )
+    {
+        if( p_block->i_dts <= VLC_TS_INVALID )
+            continue;
+
+        if( !chunk->b_dts_shift )
+        {
+            if( p_block->i_pts <= VLC_TS_INVALID )
+                continue;
+            mtime_t i_delay = p_block->i_pts - p_block->i_dts;
+            if( !p_chunker->b_delay )
+            {
+                p_chunker->b_delay = true;
+                p_chunker->i_delay = i_delay;
+            }
+            chunk->b_dts_shift = true;
+            chunk->i_dts_shift = i_delay - p_chunker->i_delay;
+        }
+        p_block->i_dts += chunk->i_dts_shift;
+    }
+}
+
+/* Takes the encoded blocks that can be sent in order, and the chunks that
+ * are done with them. With b_drain, waits for all the chunks to be done. */
+static block_t *ChunkerCollect( sout_stream_t *p_stream,
+                                transcode_chunker_t *p_chunker, bool b_drain )
+{
+    block_t *p_out = NULL, **pp_last = &p_out;
+
+    vlc_mutex_lock( &p_chunker->lock );
+    for( transcode_chunk_t *chunk; (chunk = p_chunker->p_first) != NULL; )
+    {
+        if( chunk->p_out != NULL )
+        {
+            /* The encoder of the chunk is open once it output something */
+            if( p_chunker->fmt.i_cat == UNKNOWN_ES )
+                es_format_Copy( &p_chunker->fmt,
+                                &chunk->id->p_encoder->fmt_out );
+
+            ChunkShiftDts( p_chunker, chunk );
+            block_ChainLastAppend( &pp_last, chunk->p_out );
+            chunk->p_out = NULL;
+            chunk->pp_out_last = &chunk->p_out;
+        }
+
+        if( !chunk->b_done )
+        {
+            if( !b_drain )
+                break;
+            vlc_cond_wait( &p_chunker->wait, &p_chunker->lock );
+            continue;
+        }
+
+        p_chunker->p_first = chunk->p_next;
+        if( p_chunker->p_first == NULL )
+            p_chunker->pp_last = &p_chunker->p_first;
+        vlc_mutex_unlock( &p_chunker->lock );
+
+        ChunkDelete( p_stream, chunk );
+        vlc_mutex_lock( &p_chunker->lock );
+    }
+    vlc_mutex_unlock( &p_chunker->lock );
+
+    /* Only an encoder changing its reordering delay within a chunk could
+     * still step the decoding dates back */
+    for( block_t *p_block = p_out; p_block != NULL; p_block = p_block->p_next )
+    {
+        if( p_block->i_dts <= VLC_TS_INVALID )
+            continue;
+        if( p_chunker->i_last_dts > VLC_TS_INVALID
+         && p_block->i_dts <= p_chunker->i_last_dts )
+        {
+            msg_Warn( p_stream, "GOP chunk decoding date going back by "
+                      "%"PRId64" us", p_chunker->i_last_dts - p_block->i_dts );
+            p_block->i_dts = p_chunker->i_last_dts + 1;
+        }
+        p_chunker->i_last_dts = p_block->i_dts;
+    }
+
+    return p_out;
+}
+
+bool transcode_chunk_wants( transcode_chunk_t *chunk, mtime_t i_date )
+{
+    transcode_chunker_t *p_chunker = chunk->p_owner;
+
+    vlc_mutex_lock( &p_chunker->lock );
+    bool b_wanted = i_date >= chunk->i_start && i_date < chunk->i_end;
+    vlc_mutex_unlock( &p_chunker->lock );
+    return b_wanted;
+}
+
+int transcode_chunk_process( sout_stream_t *p_stream,
+                             sout_stream_id_sys_t *id,
+                             block_t *in, block_t **out )
+{
+    sout_stream_sys_t   *p_sys = p_stream->p_sys;
+    transcode_chunker_t *p_chunker = id->p_chunker;
+    int i_ret = VLC_SUCCESS;
+
+    *out = NULL;
+
+    if( in == NULL )
+    {
+        vlc_mutex_lock( &p_chunker->lock );
+        if( p_chunker->p_lead )
+            ChunkEnd( p_chunker->p_lead );
+        if( p_chunker->p_input )
+            ChunkEnd( p_chunker->p_input );
+        p_chunker->p_lead = p_chunker->p_input = NULL;
+        vlc_mutex_unlock( &p_chunker->lock );
+    }
+    else
+    {
+        transcode_chunk_t *p_input = p_chunker->p_input;
+        mtime_t i_date = in->i_dts > VLC_TS_INVALID ? in->i_dts : in->i_pts;
+
+        if( p_input == NULL )
+        {
+            p_input = ChunkNew( p_stream, id, INT64_MIN, i_date );
+            p_chunker->p_input = p_input;
+        }
+        else if( (in->i_flags & BLOCK_FLAG_TYPE_I)
+              && in->i_pts > VLC_TS_INVALID
+              && i_date - p_input->i_first >= p_sys->i_chunk_length )
+        {
+            /* Without a new chunk, the current one goes on */
+            transcode_chunk_t *chunk = ChunkNew( p_stream, id, in->i_pts,
+                                                 i_date );
+            if( chunk != NULL )
+            {
+                block_t *p_ref = block_Reference( in );
+
+                vlc_mutex_lock( &p_chunker->lock );
+                if( p_chunker->p_lead )
+                    ChunkEnd( p_chunker->p_lead );
+                p_input->i_end = in->i_pts;
+                if( p_ref != NULL )
+                    ChunkPut( p_input, p_ref );
+                else
+                    ChunkEnd( p_input );
+                p_chunker->p_lead = p_ref != NULL ? p_input : NULL;
+                vlc_mutex_unlock( &p_chunker->lock );
+
+                p_chunker->p_input = p_input = chunk;
+            }
+        }
+        else if( p_chunker->p_lead )
+        {
+            /* Leading pictures of the new GOP */
+            transcode_chunk_t *p_lead = p_chunker->p_lead;
+            block_t *p_ref = NULL;
+
+            if( in->i_pts > VLC_TS_INVALID && in->i_pts < p_lead->i_end )
+                p_ref = block_Reference( in );
+
+            vlc_mutex_lock( &p_chunker->lock );
+            if( p_ref != NULL )
+                ChunkPut( p_lead, p_ref );
+            else
+            {
+                ChunkEnd( p_lead );
+                p_chunker->p_lead = NULL;
+            }
+            vlc_mutex_unlock( &p_chunker->lock );
+        }
+
+        if( p_input != NULL )
+        {
+            vlc_mutex_lock( &p_chunker->lock );
+            ChunkPut( p_input, in );
+            vlc_mutex_unlock( &p_chunker->lock );
+        }
+        else
+        {
+            block_Release( in );
+            i_ret = VLC_EGENERIC;
+        }
+    }
+
+    *out = ChunkerCollect( p_stream, p_chunker, in == NULL );
+    if( *out == NULL )
+        return i_ret;
+
+    if( id->id == NULL )
+    {
+        id->id = sout_StreamIdAdd( p_stream->p_next, &p_chunker->fmt );
+        if( id->id == NULL )
+        {
+            msg_Err( p_stream, "cannot add this stream" );
+            block_ChainRelease( *out );
+            *out = NULL;
+            return VLC_EGENERIC;
+        }
+    }
+    return i_ret;
+}
+
+bool transcode_chunk_add( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
+{
+    transcode_chunker_t *p_chunker = malloc( sizeof( *p_chunker ) );
+    if( unlikely(p_chunker == NULL) )
+    {
+        transcode_video_close( p_stream, id );
+        return false;
+    }
+
+    p_chunker->p_stream = p_stream;
+    vlc_mutex_init( &p_chunker->lock );
+    vlc_cond_init( &p_chunker->wait );
+    p_chunker->i_running = 0;
+    p_chunker->p_first = NULL;
+    p_chunker->pp_last = &p_chunker->p_first;
+    p_chunker->p_input = NULL;
+    p_chunker->p_lead = NULL;
+    es_format_Init( &p_chunker->fmt, UNKNOWN_ES, 0 );
+    p_chunker->b_delay = false;
+    p_chunker->i_delay = 0;
+    p_chunker->i_last_dts = VLC_TS_INVALID;
+
+    /* The chunks bring their own decoders */
+    module_unneed( id->p_decoder, id->p_decoder->p_module );
+    id->p_decoder->p_module = NULL;
+
+    id->p_chunker = p_chunker;
+    msg_Dbg( p_stream, "transcoding video by GOP chunks of %"PRId64" ms "
+             "on %d threads", p_stream->p_sys->i_chunk_length / 1000,
+             p_stream->p_sys->i_chunk_threads );
+    return true;
+}
+
+void transcode_chunk_close( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
+{
+    transcode_chunker_t *p_chunker = id->p_chunker;
+
+    /* Del() drained the chunks already */
+    vlc_mutex_lock( &p_chunker->lock );
+    if( p_chunker->p_lead )
+        ChunkEnd( p_chunker->p_lead );
+    if( p_chunker->p_input )
+        ChunkEnd( p_chunker->p_input );
+    p_chunker->p_lead = p_chunker->p_input = NULL;
+    vlc_mutex_unlock( &p_chunker->lock );
+
+    block_ChainRelease( ChunkerCollect( p_stream, p_chunker, true ) );
+
+    es_format_Clean( &p_chunker->fmt );
+    vlc_cond_destroy( &p_chunker->wait );
+    vlc_mutex_destroy( &p_chunker->lock );
+    free( p_chunker );
+    id->p_chunker = NULL;
+}
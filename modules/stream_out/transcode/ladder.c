@@ -0,0 +1,290 @@
+/*****************************************************************************
+ * ladder.c: transcoding stream output module (ABR ladder)
+ *****************************************************************************
+ * Copyright © 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#include "transcode.h"
+
+#include <vlc_arrays.h>
+#include <vlc_block.h>
+
+/*
+ * A video stream with renditions decodes once. Every decoded picture is
+ * handed, by reference, to each rendition before the stream filters and
+ * encodes it itself. A rendition has filters and an encoder of its own,
+ * and a decoder object that is never opened: it only holds the format of
+ * the pictures of the stream. All the renditions get keyframes at the same
+ * dates as the stream, so that players can switch between them there.
+ */
+
+typedef struct
+{
+    sout_stream_id_sys_t *id;      /**< filters and encoder */
+    sout_stream_t        *p_chain; /**< own output chain, or NULL */
+} transcode_rendition_t;
+
+struct transcode_ladder_t
+{
+    mtime_t               i_next_key;
+    int                   i_renditions;
+    transcode_rendition_t renditionv[];
+};
+
+/* Parses the rendition="WxH:kbps[:chain]" options */
+void transcode_ladder_config( sout_stream_t *p_stream,
+                              sout_stream_sys_t *p_sys )
+{
+    TAB_INIT( p_sys->i_renditions, p_sys->p_renditions );
+
+    for( config_chain_t *p_cfg = p_stream->p_cfg; p_cfg != NULL;
+         p_cfg = p_cfg->p_next )
+    {
+        if( strcmp( p_cfg->psz_name, "rendition" ) || !p_cfg->psz_value )
+            continue;
+
+        const char *psz = p_cfg->psz_value;
+        transcode_rendition_cfg_t cfg = { .psz_chain = NULL };
+        int i_end = 0;
+
+        if( sscanf( psz, "%ux%u:%d%n", &cfg.i_width, &cfg.i_height,
+                    &cfg.i_bitrate, &i_end ) != 3
+         || ( psz[i_end] != '\0' && psz[i_end] != ':' )
+         || cfg.i_bitrate <= 0 )
+        {
+            msg_Err( p_stream, "invalid rendition `%s' (WxH:kbps[:chain])",
+                     psz );
+            continue;
+        }
+        if( cfg.i_bitrate < 16000 ) cfg.i_bitrate *= 1000;
+
+        if( psz[i_end] == ':' && psz[i_end + 1] != '\0' )
+        {
+            cfg.psz_chain = strdup( &psz[i_end + 1] );
+            if( unlikely(cfg.psz_chain == NULL) )
+                continue;
+        }
+
+        msg_Dbg( p_stream, "rendition %ux%u %dkb/s to %s", cfg.i_width,
+                 cfg.i_height, cfg.i_bitrate / 1000,
+                 cfg.psz_chain ? cfg.psz_chain : "the next stream" );
+        TAB_APPEND( p_sys->i_renditions, p_sys->p_renditions, cfg );
+    }
+}
+
+void transcode_ladder_config_clean( sout_stream_sys_t *p_sys )
+{
+    for( int i = 0; i < p_sys->i_renditions; i++ )
+        free( p_sys->p_renditions[i].psz_chain );
+    TAB_CLEAN( p_sys->i_renditions, p_sys->p_renditions );
+}
+
+static sout_stream_t *RenditionOutput( sout_stream_t *p_stream,
+                                       const transcode_rendition_t *r )
+{
+    return r->p_chain ? r->p_chain : p_stream->p_next;
+}
+
+static void RenditionInit( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
+                           sout_stream_id_sys_t *rid,
+                           const transcode_rendition_cfg_t *cfg )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+    encoder_t *p_enc = rid->p_encoder;
+
+    rid->b_transcode = true;
+    rid->b_rendition = true;
+    rid->i_width  = cfg->i_width;
+    rid->i_height = cfg->i_height;
+
+    /* Same encoder as the stream, hence the same input chroma */
+    es_format_Init( &p_enc->fmt_in, VIDEO_ES, id->p_encoder->fmt_in.i_codec );
+    p_enc->fmt_in.video.i_chroma = p_enc->fmt_in.i_codec;
+
+    p_enc->fmt_out.i_codec = p_sys->i_vcodec;
+    p_enc->fmt_out.video.i_visible_width  = cfg->i_width & ~1;
+    p_enc->fmt_out.video.i_visible_height = cfg->i_height & ~1;
+    p_enc->fmt_out.i_bitrate = cfg->i_bitrate;
+    /* Next to the stream, the rendition needs an ES ID of its own */
+    if( cfg->psz_chain == NULL )
+        p_enc->fmt_out.i_id = -1;
+
+    if( p_sys->fps_num )
+    {
+        p_enc->fmt_in.video.i_frame_rate = p_enc->fmt_out.video.i_frame_rate = p_sys->fps_num;
+        p_enc->fmt_in.video.i_frame_rate_base = p_enc->fmt_out.video.i_frame_rate_base = (p_sys->fps_den ? p_sys->fps_den : 1);
+    }
+
+    p_enc->i_threads = p_sys->i_threads;
+    p_enc->p_cfg = p_sys->p_video_cfg;
+}
+
+bool transcode_ladder_add( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+    transcode_ladder_t *p_ladder =
+        malloc( sizeof( *p_ladder ) +
+                p_sys->i_renditions * sizeof( p_ladder->renditionv[0] ) );
+    if( unlikely(p_ladder == NULL) )
+        return false;
+
+    p_ladder->i_next_key = VLC_TS_INVALID;
+    p_ladder->i_renditions = 0;
+    id->p_ladder = p_ladder;
+
+    for( int i = 0; i < p_sys->i_renditions; i++ )
+    {
+        const transcode_rendition_cfg_t *cfg = &p_sys->p_renditions[i];
+        transcode_rendition_t *r = &p_ladder->renditionv[i];
+
+        r->p_chain = NULL;
+        if( cfg->psz_chain != NULL )
+        {
+            r->p_chain = sout_StreamChainNew( p_stream->p_sout,
+                                              cfg->psz_chain, NULL, NULL );
+            if( r->p_chain == NULL )
+            {
+                msg_Err( p_stream, "cannot create rendition chain `%s'",
+                         cfg->psz_chain );
+                goto error;
+            }
+        }
+
+        r->id = transcode_stream_id_new( p_stream, &id->p_decoder->fmt_in );
+        if( r->id == NULL )
+        {
+            if( r->p_chain != NULL )
+                sout_StreamChainDelete( r->p_chain, NULL );
+            goto error;
+        }
+
+        RenditionInit( p_stream, id, r->id, cfg );
+        p_ladder->i_renditions++;
+    }
+    return true;
+
+error:
+    transcode_ladder_close( p_stream, id );
+    return false;
+}
+
+void transcode_ladder_close( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
+{
+    transcode_ladder_t *p_ladder = id->p_ladder;
+
+    for( int i = 0; i < p_ladder->i_renditions; i++ )
+    {
+        transcode_rendition_t *r = &p_ladder->renditionv[i];
+        sout_stream_t *p_out_stream = RenditionOutput( p_stream, r );
+
+        if( r->id->id != NULL )
+        {
+            block_t *p_out = NULL;
+
+            if( r->id->b_transcode )
+                transcode_video_drain( r->id, &p_out );
+            if( p_out != NULL )
+                sout_StreamIdSend( p_out_stream, r->id->id, p_out );
+            sout_StreamIdDel( p_out_stream, r->id->id );
+        }
+
+        transcode_video_close( p_stream, r->id );
+        transcode_stream_id_delete( r->id );
+        if( r->p_chain != NULL )
+            sout_StreamChainDelete( r->p_chain, NULL );
+    }
+
+    free( p_ladder );
+    id->p_ladder = NULL;
+}
+
+static void LadderKeyframe( sout_stream_t *p_stream,
+                            transcode_ladder_t *p_ladder, picture_t *p_pic )
+{
+    const mtime_t i_keyint = p_stream->p_sys->i_ladder_keyint;
+
+    p_pic->b_keyframe = false;
+    if( p_pic->date <= VLC_TS_INVALID )
+        return;
+
+    /* Restart the keyframe grid on the first picture and on discontinuities */
+    if( p_ladder->i_next_key == VLC_TS_INVALID
+     || p_pic->date >= p_ladder->i_next_key
+     || p_pic->date < p_ladder->i_next_key - i_keyint )
+    {
+        p_pic->b_keyframe = true;
+        p_ladder->i_next_key = p_pic->date + i_keyint;
+    }
+}
+
+void transcode_ladder_process( sout_stream_t *p_stream,
+                               sout_stream_id_sys_t *id, picture_t *p_pic )
+{
+    transcode_ladder_t *p_ladder = id->p_ladder;
+
+    /* Flagged before any filter, which copy it to their output */
+    LadderKeyframe( p_stream, p_ladder, p_pic );
+
+    for( int i = 0; i < p_ladder->i_renditions; i++ )
+    {
+        transcode_rendition_t *r = &p_ladder->renditionv[i];
+        sout_stream_id_sys_t *rid = r->id;
+        sout_stream_t *p_out_stream = RenditionOutput( p_stream, r );
+        block_t *p_out = NULL;
+
+        if( !rid->b_transcode )
+            continue;
+
+        /* Reinitializes the rendition when the decoded format changes */
+        if( !video_format_IsSimilar( &rid->p_decoder->fmt_out.video,
+                                     &id->p_decoder->fmt_out.video ) )
+        {
+            es_format_Clean( &rid->p_decoder->fmt_out );
+            es_format_Copy( &rid->p_decoder->fmt_out, &id->p_decoder->fmt_out );
+        }
+
+        if( transcode_video_encode( p_stream, rid, picture_Hold( p_pic ),
+                                    &p_out ) != VLC_SUCCESS )
+        {
+            msg_Err( p_stream, "cannot encode the %ux%u rendition",
+                     rid->i_width, rid->i_height );
+            rid->b_transcode = false;
+            continue;
+        }
+
+        if( rid->id == NULL )
+        {
+            rid->id = sout_StreamIdAdd( p_out_stream,
+                                        &rid->p_encoder->fmt_out );
+            if( rid->id == NULL )
+            {
+                msg_Err( p_stream, "cannot add the %ux%u rendition",
+                         rid->i_width, rid->i_height );
+                block_ChainRelease( p_out );
+                rid->b_transcode = false;
+                continue;
+            }
+        }
+
+        if( p_out != NULL )
+            sout_StreamIdSend( p_out_stream, rid->id, p_out );
+    }
+}
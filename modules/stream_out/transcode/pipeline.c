@@ -0,0 +1,295 @@
+/*****************************************************************************
+ * pipeline.c: transcoding stream output module (pipelined stages)
+ *****************************************************************************
+ * Copyright © 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#include "transcode.h"
+
+#include <vlc_atomic.h>
+#include <vlc_block.h>
+
+/*
+ * Every stage of a stream (decoder, filters, encoder) runs on a thread of
+ * its own, and hands its output to the next stage through a bounded queue.
+ * A full queue blocks the stage feeding it, down to the stream output
+ * thread. The encoded blocks of the last stage are kept until the stream
+ * output thread collects them, so that it never blocks on its own output.
+ */
+
+/* Single producer, single consumer ring. The semaphores count the free and
+ * the used slots, and order the accesses to a slot: neither side locks. */
+typedef struct
+{
+    void      **pp_items;
+    unsigned    i_size;
+    unsigned    i_read;     /* consumer only */
+    unsigned    i_write;    /* producer only */
+    vlc_sem_t   room;
+    vlc_sem_t   ready;
+} transcode_queue_t;
+
+typedef struct
+{
+    transcode_pipeline_t *p_owner;
+    transcode_stage_cb    pf_run;
+    transcode_queue_t     queue;
+    vlc_thread_t          thread;
+} transcode_stage_t;
+
+struct transcode_pipeline_t
+{
+    sout_stream_t        *p_stream;
+    sout_stream_id_sys_t *id;
+
+    /* Items queued to or being processed by the stages after the first */
+    atomic_uint           i_pending;
+    atomic_bool           b_waiting;
+    vlc_sem_t             idle;
+
+    atomic_bool           b_failed;
+    bool                  b_drained;
+
+    vlc_mutex_t           lock;
+    block_t              *p_out;
+    block_t             **pp_out_last;
+
+    unsigned              i_stages;
+    unsigned              i_threads; /* stages spawned */
+    transcode_stage_t     stagev[];
+};
+
+static int QueueInit( transcode_queue_t *q, unsigned i_size )
+{
+    q->pp_items = malloc( i_size * sizeof( *q->pp_items ) );
+    if( unlikely(q->pp_items == NULL) )
+        return VLC_ENOMEM;
+    q->i_size = i_size;
+    q->i_read = q->i_write = 0;
+    vlc_sem_init( &q->room, i_size );
+    vlc_sem_init( &q->ready, 0 );
+    return VLC_SUCCESS;
+}
+
+static void QueueClean( transcode_queue_t *q )
+{
+    vlc_sem_destroy( &q->ready );
+    vlc_sem_destroy( &q->room );
+    free( q->pp_items );
+}
+
+static void QueuePush( transcode_queue_t *q, void *p_item )
+{
+    vlc_sem_wait( &q->room );
+    q->pp_items[q->i_write] = p_item;
+    q->i_write = (q->i_write + 1) % q->i_size;
+    vlc_sem_post( &q->ready );
+}
+
+static void *QueuePop( transcode_queue_t *q )
+{
+    vlc_sem_wait( &q->ready );
+    void *p_item = q->pp_items[q->i_read];
+    q->i_read = (q->i_read + 1) % q->i_size;
+    vlc_sem_post( &q->room );
+    return p_item;
+}
+
+static void *StageThread( void *data )
+{
+    transcode_stage_t    *stage = data;
+    transcode_pipeline_t *p = stage->p_owner;
+    const unsigned        i_stage = stage - p->stagev;
+    int canc = vlc_savecancel();
+
+    for( ;; )
+    {
+        /* NULL drains the stage, then the next ones */
+        void *p_item = QueuePop( &stage->queue );
+
+        stage->pf_run( p->p_stream, p->id, p_item );
+
+        if( p_item == NULL )
+        {
+            if( i_stage + 1 < p->i_stages )
+                QueuePush( &p->stagev[i_stage + 1].queue, NULL );
+            break;
+        }
+
+        if( i_stage > 0
+         && atomic_fetch_sub( &p->i_pending, 1 ) == 1
+         && atomic_load( &p->b_waiting ) )
+            vlc_sem_post( &p->idle );
+    }
+
+    vlc_restorecancel( canc );
+    return NULL;
+}
+
+transcode_pipeline_t *transcode_pipeline_New( sout_stream_t *p_stream,
+                                              sout_stream_id_sys_t *id,
+                                              const transcode_stage_cb *pf_stages,
+                                              unsigned i_stages, int i_priority )
+{
+    transcode_pipeline_t *p =
+        malloc( sizeof( *p ) + i_stages * sizeof( p->stagev[0] ) );
+    if( unlikely(p == NULL) )
+        return NULL;
+
+    for( unsigned i = 0; i < i_stages; i++ )
+    {
+        transcode_stage_t *stage = &p->stagev[i];
+
+        stage->p_owner = p;
+        stage->pf_run = pf_stages[i];
+        if( QueueInit( &stage->queue, p_stream->p_sys->pool_size ) )
+        {
+            while( i > 0 )
+                QueueClean( &p->stagev[--i].queue );
+            free( p );
+            return NULL;
+        }
+    }
+
+    p->p_stream = p_stream;
+    p->id = id;
+    atomic_init( &p->i_pending, 0 );
+    atomic_init( &p->b_waiting, false );
+    vlc_sem_init( &p->idle, 0 );
+    atomic_init( &p->b_failed, false );
+    p->b_drained = false;
+    vlc_mutex_init( &p->lock );
+    p->p_out = NULL;
+    p->pp_out_last = &p->p_out;
+    p->i_stages = i_stages;
+    p->i_threads = 0;
+
+    id->p_pipeline = p;
+
+    while( p->i_threads < i_stages )
+    {
+        transcode_stage_t *stage = &p->stagev[p->i_threads];
+
+        if( vlc_clone( &stage->thread, StageThread, stage, i_priority ) )
+        {
+            msg_Err( p_stream, "cannot spawn the transcoding stages" );
+            transcode_pipeline_Delete( p );
+            return NULL;
+        }
+        p->i_threads++;
+    }
+    return p;
+}
+
+static void Drain( transcode_pipeline_t *p )
+{
+    /* The last stage spawned stops there, as the next one has no input */
+    QueuePush( &p->stagev[0].queue, NULL );
+    for( unsigned i = 0; i < p->i_threads; i++ )
+        vlc_join( p->stagev[i].thread, NULL );
+    p->b_drained = true;
+}
+
+void transcode_pipeline_Delete( transcode_pipeline_t *p )
+{
+    if( !p->b_drained )
+        Drain( p );
+
+    for( unsigned i = 0; i < p->i_stages; i++ )
+        QueueClean( &p->stagev[i].queue );
+    block_ChainRelease( p->p_out );
+    vlc_mutex_destroy( &p->lock );
+    vlc_sem_destroy( &p->idle );
+    p->id->p_pipeline = NULL;
+    free( p );
+}
+
+void transcode_pipeline_Emit( transcode_pipeline_t *p, unsigned i_stage,
+                              void *p_item )
+{
+    if( i_stage + 1 < p->i_stages )
+    {
+        atomic_fetch_add( &p->i_pending, 1 );
+        QueuePush( &p->stagev[i_stage + 1].queue, p_item );
+    }
+    else if( p_item != NULL )
+    {
+        vlc_mutex_lock( &p->lock );
+        block_ChainLastAppend( &p->pp_out_last, p_item );
+        vlc_mutex_unlock( &p->lock );
+    }
+}
+
+void transcode_pipeline_Wait( transcode_pipeline_t *p )
+{
+    atomic_store( &p->b_waiting, true );
+    while( atomic_load( &p->i_pending ) != 0 )
+        vlc_sem_wait( &p->idle );
+    atomic_store( &p->b_waiting, false );
+}
+
+void transcode_pipeline_Fail( transcode_pipeline_t *p )
+{
+    atomic_store( &p->b_failed, true );
+}
+
+bool transcode_pipeline_Failed( transcode_pipeline_t *p )
+{
+    return atomic_load( &p->b_failed );
+}
+
+int transcode_pipeline_Send( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
+                             block_t *in, block_t **out )
+{
+    transcode_pipeline_t *p = id->p_pipeline;
+
+    if( in != NULL )
+    {
+        if( !p->b_drained )
+            QueuePush( &p->stagev[0].queue, in );
+        else
+            block_Release( in );
+    }
+    else if( !p->b_drained )
+        Drain( p );
+
+    vlc_mutex_lock( &p->lock );
+    *out = p->p_out;
+    p->p_out = NULL;
+    p->pp_out_last = &p->p_out;
+    vlc_mutex_unlock( &p->lock );
+
+    /* The stages cannot add the stream from their own threads: they
+     * opened the encoder before handing out anything it encoded */
+    if( *out != NULL && id->id == NULL )
+    {
+        id->id = sout_StreamIdAdd( p_stream->p_next, &id->p_encoder->fmt_out );
+        if( id->id == NULL )
+        {
+            msg_Err( p_stream, "cannot add this stream" );
+            block_ChainRelease( *out );
+            *out = NULL;
+            transcode_pipeline_Fail( p );
+        }
+    }
+
+    return transcode_pipeline_Failed( p ) ? VLC_EGENERIC : VLC_SUCCESS;
+}
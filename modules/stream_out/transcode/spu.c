@@ -164,10 +164,11 @@ int transcode_spu_process( sout_stream_t *p_stream,
             continue;
         }
 
-        if( p_sys->b_master_sync && p_sys->i_master_drift )
+        mtime_t i_drift = atomic_load( &p_sys->i_master_drift );
+        if( p_sys->b_master_sync && i_drift )
         {
-            p_subpic->i_start -= p_sys->i_master_drift;
-            if( p_subpic->i_stop ) p_subpic->i_stop -= p_sys->i_master_drift;
+            p_subpic->i_start -= i_drift;
+            if( p_subpic->i_stop ) p_subpic->i_stop -= i_drift;
         }
 
         if( p_sys->b_soverlay )
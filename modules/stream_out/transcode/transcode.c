@@ -123,6 +123,33 @@
 #define THREADS_TEXT N_("Number of threads")
 #define THREADS_LONGTEXT N_( \
     "Number of threads used for the transcoding." )
+#define CHUNK_THREADS_TEXT N_("GOP-parallel video pipelines")
+#define CHUNK_THREADS_LONGTEXT N_( \
+    "Split the video at keyframes into chunks and transcode this many " \
+    "chunks at once, each with its own decoder, filters and encoder. " \
+    "Meant for file to file transcoding, as it delays the output by " \
+    "several chunks. 0 disables it." )
+#define CHUNK_LENGTH_TEXT N_("GOP-parallel chunk length (ms)")
+#define CHUNK_LENGTH_LONGTEXT N_( \
+    "Minimum duration of a chunk; it ends at the first keyframe after it." )
+#define VPIPELINE_TEXT N_("Pipelined video")
+#define VPIPELINE_LONGTEXT N_( \
+    "Run the video decoder, filters and encoder on threads of their own, " \
+    "handing pictures over through queues of pool-size pictures." )
+#define RENDITION_TEXT N_("Rendition")
+#define RENDITION_LONGTEXT N_( \
+    "Extra rendition of the video, as WxH:kbps[:chain], encoded from the " \
+    "pictures decoded for the main one, to the given chain or next to " \
+    "the main video. Can be given several times." )
+#define LADDER_KEYINT_TEXT N_("Rendition keyframe interval (ms)")
+#define LADDER_KEYINT_LONGTEXT N_( \
+    "Keyframes are forced at the same dates in the main video and its " \
+    "renditions, at this interval. The encoder own keyframe interval " \
+    "should be longer." )
+#define APIPELINE_TEXT N_("Pipelined audio")
+#define APIPELINE_LONGTEXT N_( \
+    "Run the audio decoder, filters and encoder on threads of their own, " \
+    "handing buffers over through queues of pool-size buffers." )
 #define HP_TEXT N_("High priority")
 #define HP_LONGTEXT N_( \
     "Runs the optional encoder thread at the OUTPUT priority instead of " \
@@ -178,6 +205,10 @@ vlc_module_begin ()
                  MAXHEIGHT_LONGTEXT, true )
     add_module_list( SOUT_CFG_PREFIX "vfilter", "video filter",
                      NULL, VFILTER_TEXT, VFILTER_LONGTEXT, false )
+    add_string( SOUT_CFG_PREFIX "rendition", NULL, RENDITION_TEXT,
+                RENDITION_LONGTEXT, true )
+    add_integer_with_range( SOUT_CFG_PREFIX "ladder-keyint", 2000, 100, 60000,
+                            LADDER_KEYINT_TEXT, LADDER_KEYINT_LONGTEXT, true )
 
     set_section( N_("Audio"), NULL )
     add_module( SOUT_CFG_PREFIX "aenc", "encoder", NULL, AENC_TEXT,
@@ -213,6 +244,14 @@ vlc_module_begin ()
                  THREADS_LONGTEXT, true )
     add_integer( SOUT_CFG_PREFIX "pool-size", 10, POOL_TEXT, POOL_LONGTEXT, true )
         change_integer_range( 1, 1000 )
+    add_bool( SOUT_CFG_PREFIX "vpipeline", false, VPIPELINE_TEXT,
+              VPIPELINE_LONGTEXT, true )
+    add_bool( SOUT_CFG_PREFIX "apipeline", false, APIPELINE_TEXT,
+              APIPELINE_LONGTEXT, true )
+    add_integer_with_range( SOUT_CFG_PREFIX "gop-threads", 0, 0, 64,
+                            CHUNK_THREADS_TEXT, CHUNK_THREADS_LONGTEXT, true )
+    add_integer_with_range( SOUT_CFG_PREFIX "gop-length", 10000, 1000, 600000,
+                            CHUNK_LENGTH_TEXT, CHUNK_LENGTH_LONGTEXT, true )
     add_bool( SOUT_CFG_PREFIX "high-priority", false, HP_TEXT, HP_LONGTEXT,
               true )
 
@@ -224,7 +263,8 @@ static const char *const ppsz_sout_options[] = {
     "deinterlace-module", "threads", "aenc", "acodec", "ab", "alang",
     "afilter", "samplerate", "channels", "senc", "scodec", "soverlay",
     "sfilter", "high-priority", "maxwidth", "maxheight", "pool-size",
-    NULL
+    "gop-threads", "gop-length", "vpipeline", "apipeline", "rendition",
+    "ladder-keyint", NULL
 };
 
 /*****************************************************************************
@@ -249,7 +289,7 @@ static int Open( vlc_object_t *p_this )
         return VLC_EGENERIC;
     }
     p_sys = calloc( 1, sizeof( *p_sys ) );
-    p_sys->i_master_drift = 0;
+    atomic_init( &p_sys->i_master_drift, 0 );
 
     config_ChainParse( p_stream, SOUT_CFG_PREFIX, ppsz_sout_options,
                    p_stream->p_cfg );
@@ -309,6 +349,8 @@ static int Open( vlc_object_t *p_this )
         p_sys->psz_af = NULL;
     free( psz_string );
 
+    p_sys->b_audio_pipeline = var_GetBool( p_stream, SOUT_CFG_PREFIX "apipeline" );
+
     /* Video transcoding parameters */
     psz_string = var_GetString( p_stream, SOUT_CFG_PREFIX "venc" );
     p_sys->psz_venc = NULL;
@@ -348,6 +390,9 @@ static int Open( vlc_object_t *p_this )
 
     p_sys->i_maxheight = var_GetInteger( p_stream, SOUT_CFG_PREFIX "maxheight" );
 
+    transcode_ladder_config( p_stream, p_sys );
+    p_sys->i_ladder_keyint = var_GetInteger( p_stream, SOUT_CFG_PREFIX "ladder-keyint" ) * 1000;
+
     psz_string = var_GetString( p_stream, SOUT_CFG_PREFIX "vfilter" );
     if( psz_string && *psz_string )
         p_sys->psz_vf2 = strdup(psz_string );
@@ -368,6 +413,9 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_threads = var_GetInteger( p_stream, SOUT_CFG_PREFIX "threads" );
     p_sys->pool_size = var_GetInteger( p_stream, SOUT_CFG_PREFIX "pool-size" );
     p_sys->b_high_priority = var_GetBool( p_stream, SOUT_CFG_PREFIX "high-priority" );
+    p_sys->b_video_pipeline = var_GetBool( p_stream, SOUT_CFG_PREFIX "vpipeline" );
+    p_sys->i_chunk_threads = var_GetInteger( p_stream, SOUT_CFG_PREFIX "gop-threads" );
+    p_sys->i_chunk_length = var_GetInteger( p_stream, SOUT_CFG_PREFIX "gop-length" ) * 1000;
 
     if( p_sys->i_vcodec )
     {
@@ -419,6 +467,38 @@ static int Open( vlc_object_t *p_this )
     }
     free( psz_string );
 
+    if( p_sys->i_renditions > 0 )
+    {
+        /* Overlays are rendered once per date on a single blender */
+        if( p_sys->p_spu || p_sys->b_soverlay )
+        {
+            msg_Warn( p_stream, "video renditions disabled by overlays" );
+            transcode_ladder_config_clean( p_sys );
+        }
+        else
+        {
+            /* the renditions are encoded along the stream */
+            p_sys->i_chunk_threads = 0;
+            p_sys->b_video_pipeline = false;
+        }
+    }
+
+    if( p_sys->i_chunk_threads > 0 )
+    {
+        /* Overlays are rendered in presentation order on a single blender */
+        if( p_sys->p_spu || p_sys->b_soverlay )
+        {
+            msg_Warn( p_stream, "GOP-parallel video disabled by overlays" );
+            p_sys->i_chunk_threads = 0;
+        }
+        else
+        {
+            /* every chunk is its own encoder thread */
+            p_sys->i_threads = 0;
+            p_sys->b_video_pipeline = false;
+        }
+    }
+
     p_stream->pf_add    = Add;
     p_stream->pf_del    = Del;
     p_stream->pf_send   = Send;
@@ -442,6 +522,7 @@ static void Close( vlc_object_t * p_this )
     free( p_sys->psz_alang );
 
     free( p_sys->psz_vf2 );
+    transcode_ladder_config_clean( p_sys );
 
     config_ChainDestroy( p_sys->p_video_cfg );
     free( p_sys->psz_venc );
@@ -458,7 +539,7 @@ static void Close( vlc_object_t * p_this )
     free( p_sys );
 }
 
-static void DeleteSoutStreamID( sout_stream_id_sys_t *id )
+void transcode_stream_id_delete( sout_stream_id_sys_t *id )
 {
     if( id )
     {
@@ -481,8 +562,8 @@ static void DeleteSoutStreamID( sout_stream_id_sys_t *id )
     }
 }
 
-static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
-                                  const es_format_t *p_fmt )
+sout_stream_id_sys_t *transcode_stream_id_new( sout_stream_t *p_stream,
+                                               const es_format_t *p_fmt )
 {
     sout_stream_sys_t *p_sys = p_stream->p_sys;
     sout_stream_id_sys_t *id;
@@ -522,12 +603,54 @@ static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
     else if( p_fmt->psz_language )
         id->p_encoder->fmt_out.psz_language = strdup( p_fmt->psz_language );
 
+    return id;
+
+error:
+    transcode_stream_id_delete( id );
+    return NULL;
+}
+
+static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
+                                  const es_format_t *p_fmt )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+    sout_stream_id_sys_t *id;
+
+    id = transcode_stream_id_new( p_stream, p_fmt );
+    if( !id )
+        return NULL;
+
     bool success;
 
     if( p_fmt->i_cat == AUDIO_ES && p_sys->i_acodec )
+    {
         success = transcode_audio_add(p_stream, p_fmt, id);
+        if( success && p_sys->b_audio_pipeline
+         && !transcode_audio_pipeline(p_stream, id) )
+        {
+            transcode_audio_close( id );
+            sout_StreamIdDel( p_stream->p_next, id->id );
+            success = false;
+        }
+    }
     else if( p_fmt->i_cat == VIDEO_ES && p_sys->i_vcodec )
+    {
         success = transcode_video_add(p_stream, p_fmt, id);
+        if( success && p_sys->i_renditions > 0
+         && !transcode_ladder_add(p_stream, id) )
+        {
+            transcode_video_close( p_stream, id );
+            success = false;
+        }
+        else if( success && p_sys->i_chunk_threads > 0 )
+            success = transcode_chunk_add(p_stream, id);
+        else if( success && p_sys->b_video_pipeline
+              && !transcode_video_pipeline(p_stream, id) )
+        {
+            transcode_video_close( p_stream, id );
+            success = false;
+        }
+    }
     else if( ( p_fmt->i_cat == SPU_ES ) &&
              ( p_sys->i_scodec || p_sys->b_soverlay ) )
         success = transcode_spu_add(p_stream, p_fmt, id);
@@ -542,13 +665,12 @@ static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
     }
 
     if(!success)
-        goto error;
+    {
+        transcode_stream_id_delete( id );
+        return NULL;
+    }
 
     return id;
-
-error:
-    DeleteSoutStreamID( id );
-    return NULL;
 }
 
 static void Del( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
@@ -559,10 +681,18 @@ static void Del( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
         {
         case AUDIO_ES:
             Send( p_stream, id, NULL );
+            if( id->p_pipeline )
+                transcode_pipeline_Delete( id->p_pipeline );
             transcode_audio_close( id );
             break;
         case VIDEO_ES:
             Send( p_stream, id, NULL );
+            if( id->p_pipeline )
+                transcode_pipeline_Delete( id->p_pipeline );
+            if( id->p_chunker )
+                transcode_chunk_close( p_stream, id );
+            if( id->p_ladder )
+                transcode_ladder_close( p_stream, id );
             transcode_video_close( p_stream, id );
             break;
         case SPU_ES:
@@ -575,7 +705,7 @@ static void Del( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
 
     if( id->id ) sout_StreamIdDel( p_stream->p_next, id->id );
 
-    DeleteSoutStreamID( id );
+    transcode_stream_id_delete( id );
 }
 
 static int Send( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
@@ -592,10 +722,20 @@ static int Send( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
         return VLC_EGENERIC;
     }
 
+    /* Decoders may work in place; NULL drains the chain from Del() */
+    if( p_buffer != NULL )
+    {
+        p_buffer = block_Unshare( p_buffer );
+        if( p_buffer == NULL )
+            return VLC_ENOMEM;
+    }
+
     switch( id->p_decoder->fmt_in.i_cat )
     {
     case AUDIO_ES:
-        if( transcode_audio_process( p_stream, id, p_buffer, &p_out )
+        if( ( id->p_pipeline ?
+              transcode_pipeline_Send( p_stream, id, p_buffer, &p_out ) :
+              transcode_audio_process( p_stream, id, p_buffer, &p_out ) )
             != VLC_SUCCESS )
         {
             return VLC_EGENERIC;
@@ -603,7 +743,11 @@ static int Send( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
         break;
 
     case VIDEO_ES:
-        if( transcode_video_process( p_stream, id, p_buffer, &p_out )
+        if( ( id->p_pipeline ?
+              transcode_pipeline_Send( p_stream, id, p_buffer, &p_out ) :
+              id->p_chunker ?
+              transcode_chunk_process( p_stream, id, p_buffer, &p_out ) :
+              transcode_video_process( p_stream, id, p_buffer, &p_out ) )
             != VLC_SUCCESS )
         {
             return VLC_EGENERIC;
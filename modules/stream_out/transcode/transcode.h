@@ -8,12 +8,27 @@
 #include <vlc_filter.h>
 #include <vlc_es.h>
 #include <vlc_codec.h>
+#include <vlc_atomic.h>
 
 #include <vlc_picture_fifo.h>
 
 /*100ms is around the limit where people are noticing lipsync issues*/
 #define MASTER_SYNC_MAX_DRIFT 100000
 
+typedef struct transcode_chunk_t transcode_chunk_t;
+typedef struct transcode_chunker_t transcode_chunker_t;
+typedef struct transcode_pipeline_t transcode_pipeline_t;
+typedef struct transcode_ladder_t transcode_ladder_t;
+
+/* Extra rendition of the video, encoded from the same decoded pictures */
+typedef struct
+{
+    unsigned int    i_width;
+    unsigned int    i_height;
+    int             i_bitrate;
+    char            *psz_chain; /**< own output chain, NULL for the next one */
+} transcode_rendition_cfg_t;
+
 struct sout_stream_sys_t
 {
     sout_stream_id_sys_t *id_video;
@@ -36,6 +51,7 @@ struct sout_stream_sys_t
     int             i_abitrate;
 
     char            *psz_af;
+    bool            b_audio_pipeline;
 
     /* Video */
     vlc_fourcc_t    i_vcodec;   /* codec video (0 if not transcode) */
@@ -48,11 +64,18 @@ struct sout_stream_sys_t
     char            *psz_deinterlace;
     config_chain_t  *p_deinterlace_cfg;
     int             i_threads;
+    int             i_chunk_threads; /* GOP-parallel pipelines (0 if off) */
+    mtime_t         i_chunk_length;
     bool            b_high_priority;
     bool            b_hurry_up;
     unsigned int    fps_num,fps_den;
 
     char            *psz_vf2;
+    bool            b_video_pipeline;
+
+    transcode_rendition_cfg_t *p_renditions; /**< ABR ladder below this one */
+    int             i_renditions;
+    mtime_t         i_ladder_keyint; /**< aligned keyframes interval */
 
     /* SPU */
     vlc_fourcc_t    i_scodec;   /* codec spu (0 if not transcode) */
@@ -64,8 +87,9 @@ struct sout_stream_sys_t
 
     /* Sync */
     bool            b_master_sync;
-    /* i_master drift is how much audio buffer is ahead of calculated pts */
-    mtime_t         i_master_drift;
+    /* i_master drift is how much audio buffer is ahead of calculated pts,
+     * set by the audio thread when the audio stages are pipelined */
+    atomic_int_least64_t i_master_drift;
 };
 
 struct aout_filters;
@@ -107,6 +131,8 @@ struct sout_stream_id_sys_t
              filter_chain_t  *p_f_chain; /**< Video filters */
              filter_chain_t  *p_uf_chain; /**< User-specified video filters */
              video_format_t  fmt_input_video;
+             /* requested size, 0 to derive it from the source */
+             unsigned int    i_width, i_height;
          };
          struct
          {
@@ -119,12 +145,48 @@ struct sout_stream_id_sys_t
     /* Encoder */
     encoder_t       *p_encoder;
 
+    /* Stages on their own threads (see pipeline.c) */
+    transcode_pipeline_t *p_pipeline;
+
+    /* GOP-parallel video */
+    transcode_chunker_t *p_chunker; /**< splits and stitches this stream */
+    transcode_chunk_t   *p_chunk;   /**< chunk this private chain encodes */
+
+    /* ABR ladder */
+    transcode_ladder_t  *p_ladder;  /**< renditions fed by this stream */
+    bool                 b_rendition; /**< fed by another stream's decoder */
+
     /* Sync */
     date_t          next_input_pts; /**< Incoming calculated PTS */
     date_t          next_output_pts; /**< output calculated PTS */
 
 };
 
+sout_stream_id_sys_t *transcode_stream_id_new( sout_stream_t *,
+                                               const es_format_t * );
+void transcode_stream_id_delete( sout_stream_id_sys_t * );
+
+/* Pipelined stages */
+
+/* Processes an item, or drains the stage with NULL */
+typedef void (*transcode_stage_cb)( sout_stream_t *, sout_stream_id_sys_t *,
+                                    void * );
+
+transcode_pipeline_t *transcode_pipeline_New( sout_stream_t *,
+                                              sout_stream_id_sys_t *,
+                                              const transcode_stage_cb *,
+                                              unsigned, int );
+void transcode_pipeline_Delete( transcode_pipeline_t * );
+/* Hands an item to the stage after the given one, or a block chain to the
+ * output from the last stage */
+void transcode_pipeline_Emit( transcode_pipeline_t *, unsigned, void * );
+/* Waits for the stages after the first one to be idle */
+void transcode_pipeline_Wait( transcode_pipeline_t * );
+void transcode_pipeline_Fail( transcode_pipeline_t * );
+bool transcode_pipeline_Failed( transcode_pipeline_t * );
+int  transcode_pipeline_Send( sout_stream_t *, sout_stream_id_sys_t *,
+                              block_t *, block_t ** );
+
 /* SPU */
 
 void transcode_spu_close  ( sout_stream_t *, sout_stream_id_sys_t * );
@@ -139,6 +201,7 @@ int  transcode_audio_process( sout_stream_t *, sout_stream_id_sys_t *,
                                      block_t *, block_t ** );
 bool transcode_audio_add    ( sout_stream_t *, const es_format_t *,
                                 sout_stream_id_sys_t *);
+bool transcode_audio_pipeline( sout_stream_t *, sout_stream_id_sys_t * );
 
 /* VIDEO */
 
@@ -147,3 +210,24 @@ int  transcode_video_process( sout_stream_t *, sout_stream_id_sys_t *,
                                      block_t *, block_t ** );
 bool transcode_video_add    ( sout_stream_t *, const es_format_t *,
                                 sout_stream_id_sys_t *);
+bool transcode_video_pipeline( sout_stream_t *, sout_stream_id_sys_t * );
+int  transcode_video_encode ( sout_stream_t *, sout_stream_id_sys_t *,
+                              picture_t *, block_t ** );
+void transcode_video_drain  ( sout_stream_id_sys_t *, block_t ** );
+
+/* GOP-parallel VIDEO */
+
+bool transcode_chunk_add    ( sout_stream_t *, sout_stream_id_sys_t * );
+void transcode_chunk_close  ( sout_stream_t *, sout_stream_id_sys_t * );
+int  transcode_chunk_process( sout_stream_t *, sout_stream_id_sys_t *,
+                                     block_t *, block_t ** );
+bool transcode_chunk_wants  ( transcode_chunk_t *, mtime_t );
+
+/* ABR ladder */
+
+void transcode_ladder_config( sout_stream_t *, sout_stream_sys_t * );
+void transcode_ladder_config_clean( sout_stream_sys_t * );
+bool transcode_ladder_add    ( sout_stream_t *, sout_stream_id_sys_t * );
+void transcode_ladder_close  ( sout_stream_t *, sout_stream_id_sys_t * );
+void transcode_ladder_process( sout_stream_t *, sout_stream_id_sys_t *,
+                               picture_t * );
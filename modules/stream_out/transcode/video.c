@@ -97,6 +97,14 @@ static picture_t *transcode_video_filter_buffer_new( filter_t *p_filter )
     return picture_NewFromFormat( &p_filter->fmt_out.video );
 }
 
+/* EncoderThread is superseded by the stages of a pipelined stream, and is
+ * not used along a ladder, whose renditions share the pictures it encodes */
+static inline bool EncoderThreaded( const sout_stream_sys_t *p_sys )
+{
+    return p_sys->i_threads >= 1 && !p_sys->b_video_pipeline
+        && p_sys->i_renditions == 0;
+}
+
 static void* EncoderThread( void *obj )
 {
     sout_stream_sys_t *p_sys = (sout_stream_sys_t*)obj;
@@ -201,6 +209,10 @@ static int transcode_video_new( sout_stream_t *p_stream, sout_stream_id_sys_t *i
         return VLC_EGENERIC;
     }
 
+    /* The encoder of a GOP chunk was tested by the stream it belongs to */
+    if( id->p_chunk )
+        return VLC_SUCCESS;
+
     /*
      * Open encoder.
      * Because some info about the decoded input will only be available
@@ -265,7 +277,7 @@ static int transcode_video_new( sout_stream_t *p_stream, sout_stream_id_sys_t *i
     }
     id->p_encoder->p_module = NULL;
 
-    if( p_sys->i_threads <= 0 )
+    if( !EncoderThreaded( p_sys ) )
         return VLC_SUCCESS;
 
     int i_priority = p_sys->b_high_priority ? VLC_THREAD_PRIORITY_OUTPUT :
@@ -635,6 +647,12 @@ static int transcode_video_encoder_open( sout_stream_t *p_stream,
     id->p_encoder->fmt_out.i_codec =
         vlc_fourcc_GetCodec( VIDEO_ES, id->p_encoder->fmt_out.i_codec );
 
+    /* Chunks are stitched back into a single stream by the chunker,
+     * pipelined streams are added from the stream output thread, and
+     * renditions are added to their own chain by the ladder */
+    if( id->p_chunk || id->p_pipeline || id->b_rendition )
+        return VLC_SUCCESS;
+
     id->id = sout_StreamIdAdd( p_stream->p_next, &id->p_encoder->fmt_out );
     if( !id->id )
     {
@@ -648,7 +666,7 @@ static int transcode_video_encoder_open( sout_stream_t *p_stream,
 void transcode_video_close( sout_stream_t *p_stream,
                                    sout_stream_id_sys_t *id )
 {
-    if( p_stream->p_sys->i_threads >= 1 && !p_stream->p_sys->b_abort )
+    if( EncoderThreaded( p_stream->p_sys ) && !p_stream->p_sys->b_abort )
     {
         vlc_mutex_lock( &p_stream->p_sys->lock_out );
         p_stream->p_sys->b_abort = true;
@@ -661,7 +679,7 @@ void transcode_video_close( sout_stream_t *p_stream,
         block_ChainRelease( p_stream->p_sys->p_buffers );
     }
 
-    if( p_stream->p_sys->i_threads >= 1 )
+    if( EncoderThreaded( p_stream->p_sys ) )
     {
         vlc_mutex_destroy( &p_stream->p_sys->lock_out );
         vlc_cond_destroy( &p_stream->p_sys->cond );
@@ -688,6 +706,13 @@ static void OutputFrame( sout_stream_t *p_stream, picture_t *p_pic, sout_stream_
 {
     sout_stream_sys_t *p_sys = p_stream->p_sys;
 
+    /* Pictures outside a GOP chunk are encoded by its neighbours */
+    if( id->p_chunk && !transcode_chunk_wants( id->p_chunk, p_pic->date ) )
+    {
+        picture_Release( p_pic );
+        return;
+    }
+
     /*
      * Encoding
      */
@@ -730,7 +755,7 @@ static void OutputFrame( sout_stream_t *p_stream, picture_t *p_pic, sout_stream_
         }
     }
 
-    if( p_sys->i_threads == 0 )
+    if( !EncoderThreaded( p_sys ) )
     {
         block_t *p_block;
 
@@ -738,7 +763,7 @@ static void OutputFrame( sout_stream_t *p_stream, picture_t *p_pic, sout_stream_
         block_ChainAppend( out, p_block );
     }
 
-    if( p_sys->i_threads )
+    if( EncoderThreaded( p_sys ) )
     {
         vlc_sem_wait( &p_sys->picture_pool_has_room );
         vlc_mutex_lock( &p_sys->lock_out );
@@ -747,10 +772,109 @@ static void OutputFrame( sout_stream_t *p_stream, picture_t *p_pic, sout_stream_
         vlc_mutex_unlock( &p_sys->lock_out );
     }
 
-    if ( p_sys->i_threads == 0 )
+    if( !EncoderThreaded( p_sys ) )
         picture_Release( p_pic );
 }
 
+static bool transcode_video_needs_init( sout_stream_id_sys_t *id )
+{
+    return !id->p_encoder->p_module ||
+           !video_format_IsSimilar( &id->fmt_input_video,
+                                    &id->p_decoder->fmt_out.video );
+}
+
+/* (Re)builds the filters for the decoded format, and opens the encoder with
+ * the first picture */
+static int transcode_video_init( sout_stream_t *p_stream,
+                                 sout_stream_id_sys_t *id )
+{
+    if( unlikely (
+         id->p_encoder->p_module &&
+         !video_format_IsSimilar( &id->fmt_input_video, &id->p_decoder->fmt_out.video )
+        )
+      )
+    {
+        msg_Info( p_stream, "aspect-ratio changed, reiniting. %i -> %i : %i -> %i.",
+                    id->fmt_input_video.i_sar_num, id->p_decoder->fmt_out.video.i_sar_num,
+                    id->fmt_input_video.i_sar_den, id->p_decoder->fmt_out.video.i_sar_den
+                );
+        /* Close filters */
+        if( id->p_f_chain )
+            filter_chain_Delete( id->p_f_chain );
+        id->p_f_chain = NULL;
+        if( id->p_uf_chain )
+            filter_chain_Delete( id->p_uf_chain );
+        id->p_uf_chain = NULL;
+
+        /* Reinitialize filters */
+        id->p_encoder->fmt_out.video.i_visible_width  = id->i_width & ~1;
+        id->p_encoder->fmt_out.video.i_visible_height = id->i_height & ~1;
+        id->p_encoder->fmt_out.video.i_sar_num = id->p_encoder->fmt_out.video.i_sar_den = 0;
+
+        transcode_video_encoder_init( p_stream, id );
+        transcode_video_filter_init( p_stream, id );
+        conversion_video_filter_append( id );
+        memcpy( &id->fmt_input_video, &id->p_decoder->fmt_out.video, sizeof(video_format_t));
+    }
+
+
+    if( unlikely( !id->p_encoder->p_module ) )
+    {
+        if( id->p_f_chain )
+            filter_chain_Delete( id->p_f_chain );
+        if( id->p_uf_chain )
+            filter_chain_Delete( id->p_uf_chain );
+        id->p_f_chain = id->p_uf_chain = NULL;
+
+        transcode_video_encoder_init( p_stream, id );
+        transcode_video_filter_init( p_stream, id );
+        conversion_video_filter_append( id );
+        memcpy( &id->fmt_input_video, &id->p_decoder->fmt_out.video, sizeof(video_format_t));
+
+        if( transcode_video_encoder_open( p_stream, id ) != VLC_SUCCESS )
+            return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
+/* Run the filter and output chains; first with the picture,
+ * and then with NULL as many times as we need until they
+ * stop outputting frames.
+ */
+static void transcode_video_filter( sout_stream_t *p_stream,
+                                    sout_stream_id_sys_t *id, picture_t *p_pic,
+                                    void (*pf_output)( sout_stream_t *, picture_t *,
+                                                       sout_stream_id_sys_t *,
+                                                       block_t ** ),
+                                    block_t **out )
+{
+    for ( ;; ) {
+        picture_t *p_filtered_pic = p_pic;
+
+        /* Run filter chain */
+        if( id->p_f_chain )
+            p_filtered_pic = filter_chain_VideoFilter( id->p_f_chain, p_filtered_pic );
+        if( !p_filtered_pic )
+            break;
+
+        for ( ;; ) {
+            picture_t *p_user_filtered_pic = p_filtered_pic;
+
+            /* Run user specified filter chain */
+            if( id->p_uf_chain )
+                p_user_filtered_pic = filter_chain_VideoFilter( id->p_uf_chain, p_user_filtered_pic );
+            if( !p_user_filtered_pic )
+                break;
+
+            pf_output( p_stream, p_user_filtered_pic, id, out );
+
+            p_filtered_pic = NULL;
+        }
+
+        p_pic = NULL;
+    }
+}
+
 int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
                                     block_t *in, block_t **out )
 {
@@ -778,91 +902,23 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
             continue;
         }
 
-        if( unlikely (
-             id->p_encoder->p_module &&
-             !video_format_IsSimilar( &id->fmt_input_video, &id->p_decoder->fmt_out.video )
-            )
-          )
-        {
-            msg_Info( p_stream, "aspect-ratio changed, reiniting. %i -> %i : %i -> %i.",
-                        id->fmt_input_video.i_sar_num, id->p_decoder->fmt_out.video.i_sar_num,
-                        id->fmt_input_video.i_sar_den, id->p_decoder->fmt_out.video.i_sar_den
-                    );
-            /* Close filters */
-            if( id->p_f_chain )
-                filter_chain_Delete( id->p_f_chain );
-            id->p_f_chain = NULL;
-            if( id->p_uf_chain )
-                filter_chain_Delete( id->p_uf_chain );
-            id->p_uf_chain = NULL;
-
-            /* Reinitialize filters */
-            id->p_encoder->fmt_out.video.i_visible_width  = p_sys->i_width & ~1;
-            id->p_encoder->fmt_out.video.i_visible_height = p_sys->i_height & ~1;
-            id->p_encoder->fmt_out.video.i_sar_num = id->p_encoder->fmt_out.video.i_sar_den = 0;
-
-            transcode_video_encoder_init( p_stream, id );
-            transcode_video_filter_init( p_stream, id );
-            conversion_video_filter_append( id );
-            memcpy( &id->fmt_input_video, &id->p_decoder->fmt_out.video, sizeof(video_format_t));
-        }
-
-
-        if( unlikely( !id->p_encoder->p_module ) )
+        if( transcode_video_init( p_stream, id ) != VLC_SUCCESS )
         {
-            if( id->p_f_chain )
-                filter_chain_Delete( id->p_f_chain );
-            if( id->p_uf_chain )
-                filter_chain_Delete( id->p_uf_chain );
-            id->p_f_chain = id->p_uf_chain = NULL;
-
-            transcode_video_encoder_init( p_stream, id );
-            transcode_video_filter_init( p_stream, id );
-            conversion_video_filter_append( id );
-            memcpy( &id->fmt_input_video, &id->p_decoder->fmt_out.video, sizeof(video_format_t));
-
-            if( transcode_video_encoder_open( p_stream, id ) != VLC_SUCCESS )
-            {
-                picture_Release( p_pic );
-                transcode_video_close( p_stream, id );
-                id->b_transcode = false;
-                b_error = true;
-                continue;
-            }
+            picture_Release( p_pic );
+            transcode_video_close( p_stream, id );
+            id->b_transcode = false;
+            b_error = true;
+            continue;
         }
 
-        /* Run the filter and output chains; first with the picture,
-         * and then with NULL as many times as we need until they
-         * stop outputting frames.
-         */
-        for ( ;; ) {
-            picture_t *p_filtered_pic = p_pic;
-
-            /* Run filter chain */
-            if( id->p_f_chain )
-                p_filtered_pic = filter_chain_VideoFilter( id->p_f_chain, p_filtered_pic );
-            if( !p_filtered_pic )
-                break;
+        /* The renditions get the picture before the filters of this one */
+        if( id->p_ladder )
+            transcode_ladder_process( p_stream, id, p_pic );
 
-            for ( ;; ) {
-                picture_t *p_user_filtered_pic = p_filtered_pic;
-
-                /* Run user specified filter chain */
-                if( id->p_uf_chain )
-                    p_user_filtered_pic = filter_chain_VideoFilter( id->p_uf_chain, p_user_filtered_pic );
-                if( !p_user_filtered_pic )
-                    break;
-
-                OutputFrame( p_stream, p_user_filtered_pic, id, out );
-
-                p_filtered_pic = NULL;
-            }
-
-            p_pic = NULL;
-        }
+        transcode_video_filter( p_stream, id, p_pic, OutputFrame, out );
     } while( p_pics );
 
-    if( p_sys->i_threads >= 1 )
+    if( EncoderThreaded( p_sys ) )
     {
         /* Pick up any return data the encoder thread wants to output. */
         vlc_mutex_lock( &p_sys->lock_out );
@@ -874,17 +930,8 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
 end:
     if( unlikely( in == NULL ) )
     {
-        if( p_sys->i_threads == 0 )
-        {
-            if( id->p_encoder->p_module )
-            {
-                block_t *p_block;
-                do {
-                    p_block = id->p_encoder->pf_encode_video(id->p_encoder, NULL );
-                    block_ChainAppend( out, p_block );
-                } while( p_block );
-            }
-        }
+        if( !EncoderThreaded( p_sys ) )
+            transcode_video_drain( id, out );
         else
         {
             msg_Dbg( p_stream, "Flushing thread and waiting that");
@@ -906,6 +953,120 @@ end:
     return b_error ? VLC_EGENERIC : VLC_SUCCESS;
 }
 
+/* Encodes an already decoded picture */
+int transcode_video_encode( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
+                            picture_t *p_pic, block_t **out )
+{
+    if( transcode_video_init( p_stream, id ) != VLC_SUCCESS )
+    {
+        picture_Release( p_pic );
+        return VLC_EGENERIC;
+    }
+
+    transcode_video_filter( p_stream, id, p_pic, OutputFrame, out );
+    return VLC_SUCCESS;
+}
+
+/* Outputs the pictures delayed by the encoder */
+void transcode_video_drain( sout_stream_id_sys_t *id, block_t **out )
+{
+    if( id->p_encoder->p_module )
+    {
+        block_t *p_block;
+        do {
+            p_block = id->p_encoder->pf_encode_video( id->p_encoder, NULL );
+            block_ChainAppend( out, p_block );
+        } while( p_block );
+    }
+}
+
+/*
+ * Pipelined stages: decoder, filters, encoder
+ */
+static void DecodeStage( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
+                         void *data )
+{
+    transcode_pipeline_t *p = id->p_pipeline;
+    block_t *in = data;
+
+    if( transcode_pipeline_Failed( p ) )
+    {
+        if( in != NULL )
+            block_Release( in );
+        return;
+    }
+
+    if( id->p_decoder->pf_decode( id->p_decoder, in ) != VLCDEC_SUCCESS )
+        return;
+
+    for( picture_t *p_pics = transcode_dequeue_all_pics( id ); p_pics; )
+    {
+        picture_t *p_pic = p_pics;
+        p_pics = p_pics->p_next;
+        p_pic->p_next = NULL;
+
+        if( transcode_pipeline_Failed( p ) )
+        {
+            picture_Release( p_pic );
+            continue;
+        }
+
+        /* The chains of the next stages are only changed while idle */
+        if( transcode_video_needs_init( id ) )
+        {
+            transcode_pipeline_Wait( p );
+            if( transcode_video_init( p_stream, id ) != VLC_SUCCESS )
+            {
+                picture_Release( p_pic );
+                transcode_pipeline_Fail( p );
+                continue;
+            }
+        }
+
+        transcode_pipeline_Emit( p, 0, p_pic );
+    }
+}
+
+static void EmitFrame( sout_stream_t *p_stream, picture_t *p_pic,
+                       sout_stream_id_sys_t *id, block_t **out )
+{
+    VLC_UNUSED(p_stream); VLC_UNUSED(out);
+    transcode_pipeline_Emit( id->p_pipeline, 1, p_pic );
+}
+
+static void FilterStage( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
+                         void *data )
+{
+    if( data != NULL )
+        transcode_video_filter( p_stream, id, data, EmitFrame, NULL );
+}
+
+static void EncodeStage( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
+                         void *data )
+{
+    block_t *p_out = NULL;
+
+    if( data != NULL )
+        OutputFrame( p_stream, data, id, &p_out );
+    else
+        transcode_video_drain( id, &p_out );
+
+    transcode_pipeline_Emit( id->p_pipeline, 2, p_out );
+}
+
+bool transcode_video_pipeline( sout_stream_t *p_stream,
+                               sout_stream_id_sys_t *id )
+{
+    static const transcode_stage_cb stages[] = {
+        DecodeStage, FilterStage, EncodeStage,
+    };
+
+    return transcode_pipeline_New( p_stream, id, stages, ARRAY_SIZE(stages),
+                                   p_stream->p_sys->b_high_priority ?
+                                       VLC_THREAD_PRIORITY_OUTPUT :
+                                       VLC_THREAD_PRIORITY_VIDEO ) != NULL;
+}
+
 bool transcode_video_add( sout_stream_t *p_stream, const es_format_t *p_fmt,
                                 sout_stream_id_sys_t *id )
 {
@@ -920,8 +1081,10 @@ bool transcode_video_add( sout_stream_t *p_stream, const es_format_t *p_fmt,
 
     /* Complete destination format */
     id->p_encoder->fmt_out.i_codec = p_sys->i_vcodec;
-    id->p_encoder->fmt_out.video.i_visible_width  = p_sys->i_width & ~1;
-    id->p_encoder->fmt_out.video.i_visible_height = p_sys->i_height & ~1;
+    id->i_width  = p_sys->i_width;
+    id->i_height = p_sys->i_height;
+    id->p_encoder->fmt_out.video.i_visible_width  = id->i_width & ~1;
+    id->p_encoder->fmt_out.video.i_visible_height = id->i_height & ~1;
     id->p_encoder->fmt_out.i_bitrate = p_sys->i_vbitrate;
 
     /* Build decoder -> filter -> encoder chain */
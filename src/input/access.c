@@ -316,7 +316,12 @@ stream_t *stream_AccessNew(vlc_object_t *parent, input_thread_t *input,
     s->p_sys      = access;
 
     if (cachename != NULL)
+    {
+        /* The shared cache must be below the per-input caches */
+        if (var_InheritBool(s, "stream-shared-cache"))
+            s = stream_FilterChainNew(s, "cache_shared");
         s = stream_FilterChainNew(s, cachename);
+    }
     return stream_FilterAutoNew(s);
 }
 
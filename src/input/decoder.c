@@ -1520,6 +1520,7 @@ static void *DecoderThread( void *p_data )
     decoder_t *p_dec = (decoder_t *)p_data;
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
     bool paused = false;
+    mtime_t i_cpu = input_ThreadCpuTime();
 
     /* The decoder's main loop */
     vlc_fifo_Lock( p_owner->p_fifo );
@@ -1597,6 +1598,8 @@ static void *DecoderThread( void *p_data )
 
         int canc = vlc_savecancel();
         DecoderProcess( p_dec, p_block );
+        if( p_owner->p_input != NULL )
+            input_AddCpuTime( p_owner->p_input, &i_cpu );
 
         if( p_block == NULL )
         {   /* Draining: the decoder is drained and all decoded buffers are
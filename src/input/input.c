@@ -314,6 +314,8 @@ static input_thread_t *Create( vlc_object_t *p_parent, input_item_t *p_item,
     priv->is_stopped = false;
     priv->b_recording = false;
     priv->i_rate = INPUT_RATE_DEFAULT;
+    atomic_init( &priv->cpu_time, 0 );
+    priv->i_cpu_last = 0;
     memset( &priv->bookmark, 0, sizeof(priv->bookmark) );
     TAB_INIT( priv->i_bookmark, priv->pp_bookmark );
     TAB_INIT( priv->i_attachment, priv->attachment );
@@ -484,6 +486,7 @@ static void *Run( void *data )
     input_thread_t *p_input = &priv->input;
 
     vlc_interrupt_set(&priv->interrupt);
+    priv->i_cpu_last = input_ThreadCpuTime();
 
     if( !Init( p_input ) )
     {
@@ -500,6 +503,7 @@ static void *Run( void *data )
         End( p_input );
     }
 
+    input_AddCpuTime( p_input, &priv->i_cpu_last );
     input_SendEventDead( p_input );
     return NULL;
 }
@@ -666,6 +670,8 @@ static void MainLoopStatistics( input_thread_t *p_input )
 
     stats_ComputeInputStats( p_input, input_priv(p_input)->p_item->p_stats );
     input_SendEventStatistics( p_input );
+
+    input_AddCpuTime( p_input, &input_priv(p_input)->i_cpu_last );
 }
 
 /**
@@ -25,11 +25,13 @@
 #define LIBVLC_INPUT_INTERNAL_H 1
 
 #include <stddef.h>
+#include <time.h>
 
 #include <vlc_access.h>
 #include <vlc_demux.h>
 #include <vlc_input.h>
 #include <vlc_viewpoint.h>
+#include <vlc_atomic.h>
 #include <libvlc.h>
 #include "input_interface.h"
 #include "misc/interrupt.h"
@@ -173,6 +175,10 @@ typedef struct input_thread_private_t
     int i_control;
     input_control_t control[INPUT_CONTROL_FIFO_SIZE];
 
+    /* CPU time used by the input and decoder threads (in us) */
+    atomic_int_fast64_t cpu_time;
+    mtime_t i_cpu_last; /* of the input thread, at the last account */
+
     vlc_thread_t thread;
     vlc_interrupt_t interrupt;
 } input_thread_private_t;
@@ -182,6 +188,32 @@ static inline input_thread_private_t *input_priv(input_thread_t *input)
     return container_of(input, input_thread_private_t, input);
 }
 
+/* CPU time used by the calling thread so far, 0 if unknown */
+static inline mtime_t input_ThreadCpuTime( void )
+{
+#if defined(CLOCK_THREAD_CPUTIME_ID) && !defined(_WIN32)
+    struct timespec ts;
+
+    if( clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts ) == 0 )
+        return INT64_C(1000000) * ts.tv_sec + ts.tv_nsec / 1000;
+#endif
+    return 0;
+}
+
+/* Accounts the CPU time used by the calling thread since *pi_last */
+static inline void input_AddCpuTime( input_thread_t *p_input, mtime_t *pi_last )
+{
+    mtime_t i_now = input_ThreadCpuTime();
+
+    atomic_fetch_add( &input_priv(p_input)->cpu_time, i_now - *pi_last );
+    *pi_last = i_now;
+}
+
+static inline mtime_t input_GetCpuTime( input_thread_t *p_input )
+{
+    return atomic_load( &input_priv(p_input)->cpu_time );
+}
+
 /***************************************************************************
  * Internal control helpers
  ***************************************************************************/
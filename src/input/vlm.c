@@ -57,6 +57,8 @@
 
 static void* Manage( void * );
 static int vlm_MediaVodControl( void *, vod_media_t *, const char *, int, va_list );
+static void vlm_JobsStart( vlm_t * );
+static void vlm_JobsStop( vlm_t * );
 
 typedef struct preparse_data_t
 {
@@ -149,9 +151,11 @@ vlm_t *vlm_New ( vlc_object_t *p_this )
     vlc_cond_init_daytime( &p_vlm->wait_manage );
     p_vlm->users = 1;
     p_vlm->input_state_changed = false;
+    p_vlm->schedule_changed = false;
     p_vlm->i_id = 1;
     TAB_INIT( p_vlm->i_media, p_vlm->media );
     TAB_INIT( p_vlm->i_schedule, p_vlm->schedule );
+    TAB_INIT( p_vlm->i_timer, p_vlm->timer );
     p_vlm->p_vod = NULL;
     var_Create( p_vlm, "intf-event", VLC_VAR_ADDRESS );
 
@@ -164,6 +168,7 @@ vlm_t *vlm_New ( vlc_object_t *p_this )
         vlc_mutex_unlock( &vlm_mutex );
         return NULL;
     }
+    vlm_JobsStart( p_vlm );
 
     *pp_vlm = p_vlm; /* for future reference */
 
@@ -219,6 +224,7 @@ void vlm_Delete( vlm_t *p_vlm )
 
     vlm_ControlInternal( p_vlm, VLM_CLEAR_SCHEDULES );
     TAB_CLEAN( p_vlm->i_schedule, p_vlm->schedule );
+    TAB_CLEAN( p_vlm->i_timer, p_vlm->timer );
     vlc_mutex_unlock( &p_vlm->lock );
 
     vlc_cancel( p_vlm->thread );
@@ -233,6 +239,7 @@ void vlm_Delete( vlm_t *p_vlm )
     vlc_mutex_unlock( &vlm_mutex );
 
     vlc_join( p_vlm->thread, NULL );
+    vlm_JobsStop( p_vlm );
 
     vlc_cond_destroy( &p_vlm->wait_manage );
     vlc_mutex_destroy( &p_vlm->lock );
@@ -378,33 +385,35 @@ static int vlm_MediaVodControl( void *p_private, vod_media_t *p_vod_media,
 static void* Manage( void* p_object )
 {
     vlm_t *vlm = (vlm_t*)p_object;
-    time_t lastcheck, now, nextschedule = 0;
-
-    time(&lastcheck);
+    time_t now, nextschedule = 0;
 
     for( ;; )
     {
         char **ppsz_scheduled_commands = NULL;
         int    i_scheduled_commands = 0;
         bool scheduled_command = false;
+        bool input_state_changed;
 
         vlc_mutex_lock( &vlm->lock_manage );
         mutex_cleanup_push( &vlm->lock_manage );
-        while( !vlm->input_state_changed && !scheduled_command )
+        while( !vlm->input_state_changed && !vlm->schedule_changed &&
+               !scheduled_command )
         {
             if( nextschedule != 0 )
                 scheduled_command = vlc_cond_timedwait_daytime( &vlm->wait_manage, &vlm->lock_manage, nextschedule ) != 0;
             else
                 vlc_cond_wait( &vlm->wait_manage, &vlm->lock_manage );
         }
+        input_state_changed = vlm->input_state_changed;
         vlm->input_state_changed = false;
+        vlm->schedule_changed = false;
         vlc_cleanup_pop( );
         vlc_mutex_unlock( &vlm->lock_manage );
 
         int canc = vlc_savecancel ();
         /* destroy the inputs that wants to die, and launch the next input */
         vlc_mutex_lock( &vlm->lock );
-        for( int i = 0; i < vlm->i_media; i++ )
+        for( int i = 0; input_state_changed && i < vlm->i_media; i++ )
         {
             vlm_media_sys_t *p_media = vlm->media[i];
 
@@ -439,53 +448,22 @@ static void* Manage( void* p_object )
             }
         }
 
-        /* scheduling */
+        /* scheduling: only the schedules due are visited. A schedule that
+         * missed several of its dates executes once, and is re-armed on its
+         * first date after now. */
         time(&now);
-        nextschedule = 0;
 
-        for( int i = 0; i < vlm->i_schedule; i++ )
+        while( vlm->i_timer > 0 && vlm->timer[0]->next <= now )
         {
-            time_t real_date = vlm->schedule[i]->date;
+            vlm_schedule_sys_t *p_schedule = vlm->timer[0];
 
-            if( vlm->schedule[i]->b_enabled )
+            for( int j = 0; j < p_schedule->i_command; j++ )
             {
-                if( vlm->schedule[i]->date == 0 ) // now !
-                {
-                    vlm->schedule[i]->date = now;
-                    real_date = now;
-                }
-                else if( vlm->schedule[i]->period != 0 )
-                {
-                    int j = 0;
-                    while( ((vlm->schedule[i]->date + j *
-                             vlm->schedule[i]->period) <= lastcheck) &&
-                           ( vlm->schedule[i]->i_repeat > j ||
-                             vlm->schedule[i]->i_repeat < 0 ) )
-                    {
-                        j++;
-                    }
-
-                    real_date = vlm->schedule[i]->date + j *
-                        vlm->schedule[i]->period;
-                }
-
-                if( real_date <= now )
-                {
-                    if( real_date > lastcheck )
-                    {
-                        for( int j = 0; j < vlm->schedule[i]->i_command; j++ )
-                        {
-                            TAB_APPEND( i_scheduled_commands,
-                                        ppsz_scheduled_commands,
-                                        strdup(vlm->schedule[i]->command[j] ) );
-                        }
-                    }
-                }
-                else if( nextschedule == 0 || real_date < nextschedule )
-                {
-                    nextschedule = real_date;
-                }
+                TAB_APPEND( i_scheduled_commands,
+                            ppsz_scheduled_commands,
+                            strdup( p_schedule->command[j] ) );
             }
+            vlm_ScheduleArm( vlm, p_schedule, now + 1 );
         }
 
         while( i_scheduled_commands )
@@ -502,7 +480,7 @@ static void* Manage( void* p_object )
             free( psz_command );
         }
 
-        lastcheck = now;
+        nextschedule = vlm->i_timer > 0 ? vlm->timer[0]->next : 0;
         vlc_mutex_unlock( &vlm->lock );
         vlc_restorecancel (canc);
     }
@@ -876,22 +854,196 @@ static vlm_media_instance_sys_t *vlm_MediaInstanceNew( vlm_t *p_vlm, const char
     p_instance->p_parent = vlc_object_create( p_vlm, sizeof (vlc_object_t) );
     p_instance->p_input = NULL;
     p_instance->p_input_resource = input_resource_New( p_instance->p_parent );
+    p_instance->p_stopping = NULL;
+    p_instance->i_start = 0;
 
     return p_instance;
 }
+/*****************************************************************************
+ * Jobs: inputs are stopped by a pool of workers, as stopping one can take
+ * long (network timeouts, output flushing) and would otherwise hold the VLM
+ * lock, and with it all the other media, the schedules and the controls.
+ *****************************************************************************/
+struct vlm_job_t
+{
+    vlm_job_t *p_next;
+
+    input_thread_t *p_input;
+    input_resource_t *p_resource;
+    bool b_sout_keep;
+
+    /* instance to start the next input of, NULL once it is deleted */
+    vlm_media_sys_t *p_media;
+    vlm_media_instance_sys_t *p_instance;
+
+    /* parent of a deleted instance, released with its resource */
+    vlc_object_t *p_parent;
+};
+
+static int vlm_MediaInstanceLaunch( vlm_t *, vlm_media_sys_t *,
+                                    vlm_media_instance_sys_t * );
+
+static void *Worker( void *data )
+{
+    vlm_t *vlm = data;
+
+    vlc_mutex_lock( &vlm->lock_job );
+    for( ;; )
+    {
+        vlm_job_t *p_job = vlm->p_job_first;
+
+        if( p_job == NULL )
+        {
+            if( vlm->b_job_exit )
+                break;
+            vlc_cond_wait( &vlm->wait_job, &vlm->lock_job );
+            continue;
+        }
+        vlm->p_job_first = p_job->p_next;
+        if( vlm->p_job_first == NULL )
+            vlm->pp_job_last = &vlm->p_job_first;
+        vlc_mutex_unlock( &vlm->lock_job );
+
+        input_Stop( p_job->p_input );
+        input_Close( p_job->p_input );
+
+        /* The resource belongs either to the instance waiting for this job,
+         * or to the job once the instance is deleted */
+        if( !p_job->b_sout_keep )
+            input_resource_TerminateSout( p_job->p_resource );
+        input_resource_TerminateVout( p_job->p_resource );
+
+        vlc_mutex_lock( &vlm->lock );
+        vlm_media_instance_sys_t *p_instance = p_job->p_instance;
+        if( p_instance != NULL )
+        {
+            p_instance->p_stopping = NULL;
+            vlm_MediaInstanceLaunch( vlm, p_job->p_media, p_instance );
+        }
+        vlc_mutex_unlock( &vlm->lock );
+
+        if( p_instance == NULL )
+        {
+            input_resource_Terminate( p_job->p_resource );
+            input_resource_Release( p_job->p_resource );
+            vlc_object_release( p_job->p_parent );
+        }
+        free( p_job );
+
+        vlc_mutex_lock( &vlm->lock_job );
+    }
+    vlc_mutex_unlock( &vlm->lock_job );
+    return NULL;
+}
+
+static void vlm_JobsStart( vlm_t *vlm )
+{
+    unsigned i_worker = var_InheritInteger( vlm, "vlm-workers" );
+
+    vlc_mutex_init( &vlm->lock_job );
+    vlc_cond_init( &vlm->wait_job );
+    vlm->p_job_first = NULL;
+    vlm->pp_job_last = &vlm->p_job_first;
+    vlm->b_job_exit = false;
+    vlm->i_worker = 0;
+    vlm->worker = NULL;
+    if( i_worker == 0 )
+        return;
+    vlm->worker = malloc( i_worker * sizeof(vlc_thread_t) );
+    if( unlikely(vlm->worker == NULL) )
+        return;
+
+    while( vlm->i_worker < i_worker )
+    {
+        if( vlc_clone( &vlm->worker[vlm->i_worker], Worker, vlm,
+                       VLC_THREAD_PRIORITY_LOW ) )
+            break;
+        vlm->i_worker++;
+    }
+    msg_Dbg( vlm, "using %u workers", vlm->i_worker );
+}
+
+/* Waits for the queued jobs */
+static void vlm_JobsStop( vlm_t *vlm )
+{
+    vlc_mutex_lock( &vlm->lock_job );
+    vlm->b_job_exit = true;
+    vlc_cond_broadcast( &vlm->wait_job );
+    vlc_mutex_unlock( &vlm->lock_job );
+
+    for( unsigned i = 0; i < vlm->i_worker; i++ )
+        vlc_join( vlm->worker[i], NULL );
+    free( vlm->worker );
+    assert( vlm->p_job_first == NULL );
+
+    vlc_cond_destroy( &vlm->wait_job );
+    vlc_mutex_destroy( &vlm->lock_job );
+}
+
+/* Hands the input of an instance over to a worker, if there are any. The
+ * inputs of VoD media are not: the VoD server releases what their outputs
+ * use as soon as the media or the session is gone. */
+static vlm_job_t *vlm_MediaInstanceStopAsync( vlm_t *p_vlm,
+                                              vlm_media_sys_t *p_media,
+                                              vlm_media_instance_sys_t *p_instance )
+{
+    input_thread_t *p_input = p_instance->p_input;
+
+    if( p_vlm->i_worker == 0 || p_media->cfg.b_vod )
+        return NULL;
+
+    vlm_job_t *p_job = malloc( sizeof(*p_job) );
+    if( unlikely(p_job == NULL) )
+        return NULL;
+
+    var_DelCallback( p_input, "intf-event", InputEvent, p_media );
+    p_instance->p_input = NULL;
+
+    p_job->p_next = NULL;
+    p_job->p_input = p_input;
+    p_job->p_resource = p_instance->p_input_resource;
+    p_job->b_sout_keep = p_instance->b_sout_keep;
+    p_job->p_media = p_media;
+    p_job->p_instance = p_instance;
+    p_job->p_parent = NULL;
+
+    vlc_mutex_lock( &p_vlm->lock_job );
+    *p_vlm->pp_job_last = p_job;
+    p_vlm->pp_job_last = &p_job->p_next;
+    vlc_cond_signal( &p_vlm->wait_job );
+    vlc_mutex_unlock( &p_vlm->lock_job );
+
+    vlm_SendEventMediaInstanceStopped( p_vlm, p_media->cfg.id,
+                                       p_media->cfg.psz_name );
+    return p_job;
+}
+
 static void vlm_MediaInstanceDelete( vlm_t *p_vlm, int64_t id, vlm_media_instance_sys_t *p_instance, vlm_media_sys_t *p_media )
 {
     input_thread_t *p_input = p_instance->p_input;
-    if( p_input )
+    vlm_job_t *p_job = p_instance->p_stopping;
+
+    if( p_input && p_job == NULL )
+        p_job = vlm_MediaInstanceStopAsync( p_vlm, p_media, p_instance );
+
+    if( p_job != NULL )
+    {   /* The worker releases the resources after the input */
+        p_job->p_instance = NULL;
+        p_job->p_parent = p_instance->p_parent;
+    }
+    else
     {
-        input_Stop( p_input );
-        input_Close( p_input );
+        if( p_input )
+        {
+            input_Stop( p_input );
+            input_Close( p_input );
 
-        vlm_SendEventMediaInstanceStopped( p_vlm, id, p_media->cfg.psz_name );
+            vlm_SendEventMediaInstanceStopped( p_vlm, id, p_media->cfg.psz_name );
+        }
+        input_resource_Terminate( p_instance->p_input_resource );
+        input_resource_Release( p_instance->p_input_resource );
+        vlc_object_release( p_instance->p_parent );
     }
-    input_resource_Terminate( p_instance->p_input_resource );
-    input_resource_Release( p_instance->p_input_resource );
-    vlc_object_release( p_instance->p_parent );
 
     TAB_REMOVE( p_media->i_instance, p_media->instance, p_instance );
     input_item_Release( p_instance->p_item );
@@ -899,12 +1051,60 @@ static void vlm_MediaInstanceDelete( vlm_t *p_vlm, int64_t id, vlm_media_instanc
     free( p_instance );
 }
 
+/* Starts the input of the current index of an instance */
+static int vlm_MediaInstanceLaunch( vlm_t *p_vlm, vlm_media_sys_t *p_media,
+                                    vlm_media_instance_sys_t *p_instance )
+{
+    int64_t id = p_media->cfg.id;
+    char *psz_log;
+
+    if( strstr( p_media->cfg.ppsz_input[p_instance->i_index], "://" ) == NULL )
+    {
+        char *psz_uri = vlc_path2uri(
+                          p_media->cfg.ppsz_input[p_instance->i_index], NULL );
+        input_item_SetURI( p_instance->p_item, psz_uri ) ;
+        free( psz_uri );
+    }
+    else
+        input_item_SetURI( p_instance->p_item, p_media->cfg.ppsz_input[p_instance->i_index] ) ;
+
+    if( asprintf( &psz_log, _("Media: %s"), p_media->cfg.psz_name ) != -1 )
+    {
+        p_instance->p_input = input_Create( p_instance->p_parent,
+                                            p_instance->p_item, psz_log,
+                                            p_instance->p_input_resource );
+        if( p_instance->p_input )
+        {
+            var_AddCallback( p_instance->p_input, "intf-event", InputEvent, p_media );
+
+            if( input_Start( p_instance->p_input ) != VLC_SUCCESS )
+            {
+                var_DelCallback( p_instance->p_input, "intf-event", InputEvent, p_media );
+                input_Close( p_instance->p_input );
+                p_instance->p_input = NULL;
+            }
+        }
+
+        if( !p_instance->p_input )
+        {
+            vlm_MediaInstanceDelete( p_vlm, id, p_instance, p_media );
+        }
+        else
+        {
+            p_instance->i_start = mdate();
+            vlm_SendEventMediaInstanceStarted( p_vlm, id, p_media->cfg.psz_name );
+        }
+        free( psz_log );
+    }
+
+    return VLC_SUCCESS;
+}
+
 
 static int vlm_ControlMediaInstanceStart( vlm_t *p_vlm, int64_t id, const char *psz_id, int i_input_index, const char *psz_vod_output )
 {
     vlm_media_sys_t *p_media = vlm_ControlMediaGetById( p_vlm, id );
     vlm_media_instance_sys_t *p_instance;
-    char *psz_log;
 
     if( !p_media || !p_media->cfg.b_enabled || p_media->cfg.i_input <= 0 )
         return VLC_EGENERIC;
@@ -960,6 +1160,13 @@ static int vlm_ControlMediaInstanceStart( vlm_t *p_vlm, int64_t id, const char *
         TAB_APPEND( p_media->i_instance, p_media->instance, p_instance );
     }
 
+    /* The previous input is still stopping: the new one starts after it */
+    if( p_instance->p_stopping != NULL )
+    {
+        p_instance->i_index = i_input_index;
+        return VLC_SUCCESS;
+    }
+
     /* Stop old instance */
     input_thread_t *p_input = p_instance->p_input;
     if( p_input )
@@ -972,6 +1179,14 @@ static int vlm_ControlMediaInstanceStart( vlm_t *p_vlm, int64_t id, const char *
             return VLC_SUCCESS;
         }
 
+        p_instance->p_stopping =
+            vlm_MediaInstanceStopAsync( p_vlm, p_media, p_instance );
+        if( p_instance->p_stopping != NULL )
+        {
+            p_instance->i_index = i_input_index;
+            return VLC_SUCCESS;
+        }
+
         input_Stop( p_input );
         input_Close( p_input );
 
@@ -984,45 +1199,7 @@ static int vlm_ControlMediaInstanceStart( vlm_t *p_vlm, int64_t id, const char *
 
     /* Start new one */
     p_instance->i_index = i_input_index;
-    if( strstr( p_media->cfg.ppsz_input[p_instance->i_index], "://" ) == NULL )
-    {
-        char *psz_uri = vlc_path2uri(
-                          p_media->cfg.ppsz_input[p_instance->i_index], NULL );
-        input_item_SetURI( p_instance->p_item, psz_uri ) ;
-        free( psz_uri );
-    }
-    else
-        input_item_SetURI( p_instance->p_item, p_media->cfg.ppsz_input[p_instance->i_index] ) ;
-
-    if( asprintf( &psz_log, _("Media: %s"), p_media->cfg.psz_name ) != -1 )
-    {
-        p_instance->p_input = input_Create( p_instance->p_parent,
-                                            p_instance->p_item, psz_log,
-                                            p_instance->p_input_resource );
-        if( p_instance->p_input )
-        {
-            var_AddCallback( p_instance->p_input, "intf-event", InputEvent, p_media );
-
-            if( input_Start( p_instance->p_input ) != VLC_SUCCESS )
-            {
-                var_DelCallback( p_instance->p_input, "intf-event", InputEvent, p_media );
-                input_Close( p_instance->p_input );
-                p_instance->p_input = NULL;
-            }
-        }
-
-        if( !p_instance->p_input )
-        {
-            vlm_MediaInstanceDelete( p_vlm, id, p_instance, p_media );
-        }
-        else
-        {
-            vlm_SendEventMediaInstanceStarted( p_vlm, id, p_media->cfg.psz_name );
-        }
-        free( psz_log );
-    }
-
-    return VLC_SUCCESS;
+    return vlm_MediaInstanceLaunch( p_vlm, p_media, p_instance );
 }
 
 static int vlm_ControlMediaInstanceStop( vlm_t *p_vlm, int64_t id, const char *psz_id )
@@ -28,6 +28,8 @@
 #include "input_interface.h"
 
 /* Private */
+typedef struct vlm_job_t vlm_job_t;
+
 typedef struct
 {
     /* instance name */
@@ -43,6 +45,12 @@ typedef struct
     input_thread_t    *p_input;
     input_resource_t *p_input_resource;
 
+    /* previous input being stopped by a worker, the input of i_index
+     * starts after it */
+    vlm_job_t *p_stopping;
+    /* start date of the input, for its CPU load */
+    mtime_t i_start;
+
 } vlm_media_instance_sys_t;
 
 
@@ -78,6 +86,10 @@ typedef struct
     /* number of times you have to repeat
        i_repeat < 0 : endless repeat     */
     int i_repeat;
+
+    /* next date of execution, and index in the timer heap (-1 if none) */
+    time_t next;
+    int i_timer;
 } vlm_schedule_sys_t;
 
 
@@ -93,6 +105,7 @@ struct vlm_t
 
     /* tell vlm thread there is work to do */
     bool         input_state_changed;
+    bool         schedule_changed;
     /* */
     int64_t        i_id;
 
@@ -106,10 +119,24 @@ struct vlm_t
     /* Schedule list */
     int            i_schedule;
     vlm_schedule_sys_t **schedule;
+
+    /* Armed schedules, as a binary heap on their next execution date */
+    int            i_timer;
+    vlm_schedule_sys_t **timer;
+
+    /* Workers stopping the inputs, and starting the next ones */
+    vlc_mutex_t    lock_job;
+    vlc_cond_t     wait_job;
+    vlm_job_t      *p_job_first;
+    vlm_job_t      **pp_job_last;
+    bool           b_job_exit;
+    unsigned       i_worker;
+    vlc_thread_t   *worker;
 };
 
 int vlm_ControlInternal( vlm_t *p_vlm, int i_query, ... );
 int ExecuteCommand( vlm_t *, const char *, vlm_message_t ** );
 void vlm_ScheduleDelete( vlm_t *vlm, vlm_schedule_sys_t *sched );
+void vlm_ScheduleArm( vlm_t *vlm, vlm_schedule_sys_t *sched, time_t now );
 
 #endif
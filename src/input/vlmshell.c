@@ -568,6 +568,16 @@ static int ExecuteLoad( vlm_t *p_vlm, const char *psz_path, vlm_message_t **pp_s
     return VLC_SUCCESS;
 }
 
+static void ScheduleChanged( vlm_t *p_vlm, vlm_schedule_sys_t *p_schedule )
+{
+    vlm_ScheduleArm( p_vlm, p_schedule, time( NULL ) );
+
+    vlc_mutex_lock( &p_vlm->lock_manage );
+    p_vlm->schedule_changed = true;
+    vlc_cond_signal( &p_vlm->wait_manage );
+    vlc_mutex_unlock( &p_vlm->lock_manage );
+}
+
 static int ExecuteScheduleProperty( vlm_t *p_vlm, vlm_schedule_sys_t *p_schedule, bool b_new,
                                     const int i_property, char *ppsz_property[], vlm_message_t **pp_status )
 {
@@ -627,6 +637,8 @@ static int ExecuteScheduleProperty( vlm_t *p_vlm, vlm_schedule_sys_t *p_schedule
             {
                 if( b_new )
                     vlm_ScheduleDelete( p_vlm, p_schedule );
+                else
+                    ScheduleChanged( p_vlm, p_schedule );
                 return ExecuteSyntaxError( psz_cmd, pp_status );
             }
 
@@ -636,15 +648,11 @@ static int ExecuteScheduleProperty( vlm_t *p_vlm, vlm_schedule_sys_t *p_schedule
         }
     }
     *pp_status = vlm_MessageSimpleNew( psz_cmd );
-
-    vlc_mutex_lock( &p_vlm->lock_manage );
-    p_vlm->input_state_changed = true;
-    vlc_cond_signal( &p_vlm->wait_manage );
-    vlc_mutex_unlock( &p_vlm->lock_manage );
-
+    ScheduleChanged( p_vlm, p_schedule );
     return VLC_SUCCESS;
 
 error:
+    ScheduleChanged( p_vlm, p_schedule );
     *pp_status = vlm_MessageNew( psz_cmd, "Error while setting the property '%s' to the schedule",
                                  ppsz_property[i] );
     return VLC_EGENERIC;
@@ -971,6 +979,121 @@ vlm_media_sys_t *vlm_MediaSearch( vlm_t *vlm, const char *psz_name )
 /*****************************************************************************
  * Schedule handling
  *****************************************************************************/
+
+/* The armed schedules are kept in a binary heap, the next one to execute at
+ * the top, so that the vlm thread does not scan all of them on each wakeup */
+static void TimerSet( vlm_t *vlm, int i, vlm_schedule_sys_t *sched )
+{
+    vlm->timer[i] = sched;
+    sched->i_timer = i;
+}
+
+static void TimerUp( vlm_t *vlm, int i )
+{
+    vlm_schedule_sys_t *sched = vlm->timer[i];
+
+    while( i > 0 )
+    {
+        int i_parent = (i - 1) / 2;
+
+        if( vlm->timer[i_parent]->next <= sched->next )
+            break;
+        TimerSet( vlm, i, vlm->timer[i_parent] );
+        i = i_parent;
+    }
+    TimerSet( vlm, i, sched );
+}
+
+static void TimerDown( vlm_t *vlm, int i )
+{
+    vlm_schedule_sys_t *sched = vlm->timer[i];
+
+    for( ;; )
+    {
+        int i_child = 2 * i + 1;
+
+        if( i_child >= vlm->i_timer )
+            break;
+        if( i_child + 1 < vlm->i_timer &&
+            vlm->timer[i_child + 1]->next < vlm->timer[i_child]->next )
+            i_child++;
+        if( sched->next <= vlm->timer[i_child]->next )
+            break;
+        TimerSet( vlm, i, vlm->timer[i_child] );
+        i = i_child;
+    }
+    TimerSet( vlm, i, sched );
+}
+
+static void TimerRemove( vlm_t *vlm, vlm_schedule_sys_t *sched )
+{
+    int i = sched->i_timer;
+    vlm_schedule_sys_t *p_last = vlm->timer[--vlm->i_timer];
+
+    sched->i_timer = -1;
+    if( p_last == sched )
+        return;
+
+    TimerSet( vlm, i, p_last );
+    TimerUp( vlm, i );
+    TimerDown( vlm, p_last->i_timer );
+}
+
+/* Returns the first date of execution of the schedule not before now,
+ * or 0 if there is none left */
+static time_t vlm_ScheduleNextDate( const vlm_schedule_sys_t *sched,
+                                    time_t now )
+{
+    if( sched->date >= now )
+        return sched->date;
+    if( sched->period == 0 )
+        return 0;
+
+    time_t j = (now - sched->date + sched->period - 1) / sched->period;
+    if( sched->i_repeat >= 0 && j > sched->i_repeat )
+        return 0;
+    return sched->date + j * sched->period;
+}
+
+/* (Re)computes the next execution of the schedule, after its setup changed
+ * or it was just executed, and moves it accordingly in the timer heap */
+void vlm_ScheduleArm( vlm_t *vlm, vlm_schedule_sys_t *sched, time_t now )
+{
+    time_t next = 0;
+
+    if( sched->b_enabled )
+    {
+        if( sched->date == 0 ) // now !
+            sched->date = now;
+        next = vlm_ScheduleNextDate( sched, now );
+    }
+
+    if( next == 0 )
+    {
+        if( sched->i_timer >= 0 )
+            TimerRemove( vlm, sched );
+        sched->next = 0;
+        return;
+    }
+
+    sched->next = next;
+    if( sched->i_timer < 0 )
+    {
+        vlm_schedule_sys_t **pp_timer =
+            realloc( vlm->timer, (vlm->i_timer + 1) * sizeof( *pp_timer ) );
+        if( unlikely(pp_timer == NULL) )
+        {
+            sched->next = 0;
+            return;
+        }
+        vlm->timer = pp_timer;
+        sched->i_timer = vlm->i_timer++;
+        vlm->timer[sched->i_timer] = sched;
+    }
+    TimerUp( vlm, sched->i_timer );
+    TimerDown( vlm, sched->i_timer );
+}
+
 static vlm_schedule_sys_t *vlm_ScheduleNew( vlm_t *vlm, const char *psz_name )
 {
     if( !psz_name )
@@ -987,6 +1110,8 @@ static vlm_schedule_sys_t *vlm_ScheduleNew( vlm_t *vlm, const char *psz_name )
     p_sched->date = 0;
     p_sched->period = 0;
     p_sched->i_repeat = -1;
+    p_sched->next = 0;
+    p_sched->i_timer = -1;
 
     TAB_APPEND( vlm->i_schedule, vlm->schedule, p_sched );
 
@@ -999,6 +1124,8 @@ void vlm_ScheduleDelete( vlm_t *vlm, vlm_schedule_sys_t *sched )
     int i;
     if( sched == NULL ) return;
 
+    if( sched->i_timer >= 0 )
+        TimerRemove( vlm, sched );
     TAB_REMOVE( vlm->i_schedule, vlm->schedule, sched );
 
     if( vlm->i_schedule == 0 ) free( vlm->schedule );
@@ -1355,6 +1482,33 @@ static vlm_message_t *vlm_ShowMedia( vlm_media_sys_t *p_media )
             APPEND_INPUT_INFO( "title", "%"PRId64, Integer );
             APPEND_INPUT_INFO( "chapter", "%"PRId64, Integer );
             APPEND_INPUT_INFO( "can-seek", "%d", Bool );
+
+            /* What the instance costs: its input and output traffic */
+            input_item_t *p_item = input_GetItem( p_instance->p_input );
+            input_stats_t *p_stats = p_item->p_stats;
+            if( p_stats != NULL )
+            {
+                vlc_mutex_lock( &p_stats->lock );
+                vlm_MessageAdd( p_msg_instance, vlm_MessageNew( "read-bytes",
+                                "%"PRId64, p_stats->i_read_bytes ) );
+                vlm_MessageAdd( p_msg_instance, vlm_MessageNew( "input-kbps",
+                                "%.0f", p_stats->f_input_bitrate * 8000.f ) );
+                vlm_MessageAdd( p_msg_instance, vlm_MessageNew( "sent-bytes",
+                                "%"PRId64, p_stats->i_sent_bytes ) );
+                vlm_MessageAdd( p_msg_instance, vlm_MessageNew( "send-kbps",
+                                "%.0f", p_stats->f_send_bitrate * 8000.f ) );
+                vlm_MessageAdd( p_msg_instance, vlm_MessageNew( "demux-corrupted",
+                                "%"PRId64, p_stats->i_demux_corrupted ) );
+                vlc_mutex_unlock( &p_stats->lock );
+            }
+
+            /* and its CPU time (ms), in the input and decoder threads */
+            mtime_t i_cpu = input_GetCpuTime( p_instance->p_input );
+            mtime_t i_run = mdate() - p_instance->i_start;
+            vlm_MessageAdd( p_msg_instance, vlm_MessageNew( "cpu-time",
+                            "%"PRId64, i_cpu / 1000 ) );
+            vlm_MessageAdd( p_msg_instance, vlm_MessageNew( "cpu-load",
+                            "%.1f", i_run > 0 ? 100. * i_cpu / i_run : 0. ) );
         }
 #undef APPEND_INPUT_INFO
         vlm_MessageAdd( p_msg_instance, vlm_MessageNew( "playlistindex",
@@ -1495,21 +1649,9 @@ static vlm_message_t *vlm_Show( vlm_t *vlm, vlm_media_sys_t *media,
                             vlm_MessageNew( "enabled", s->b_enabled ?
                                             "yes" : "no" ) );
 
-            /* calculate next date */
+            /* next date after now, even if the schedule is disabled */
             time(&now);
-            next_date = s->date;
-
-            if( s->period != 0 )
-            {
-                int j = 0;
-                while( ((s->date + j * s->period) <= now) &&
-                       ( s->i_repeat > j || s->i_repeat < 0 ) )
-                {
-                    j++;
-                }
-
-                next_date = s->date + j * s->period;
-            }
+            next_date = vlm_ScheduleNextDate( s, now + 1 );
 
             if( next_date > now )
             {
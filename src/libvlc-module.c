@@ -645,6 +645,11 @@ static const char *const ppsz_prefres[] = {
 #define INPUT_FAST_SEEK_LONGTEXT N_( \
     "Favor speed over precision while seeking" )
 
+#define SEEK_INDEX_CACHE_TEXT N_("Cache seek indexes")
+#define SEEK_INDEX_CACHE_LONGTEXT N_( \
+    "Store the seek points that demuxers build for files without a " \
+    "usable index, and reuse them when the same file is opened again." )
+
 #define INPUT_RATE_TEXT N_("Playback speed")
 #define INPUT_RATE_LONGTEXT N_( \
     "This defines the playback speed (nominal speed is 1.0)." )
@@ -994,6 +999,11 @@ static const char *const ppsz_prefres[] = {
 #define STREAM_FILTER_LONGTEXT N_( \
     "Stream filters are used to modify the stream that is being read. " )
 
+#define STREAM_SHARED_CACHE_TEXT N_("Share network stream cache")
+#define STREAM_SHARED_CACHE_LONGTEXT N_( \
+    "Serve seekable network resources through a cache shared by all the " \
+    "inputs of the process, so that the same data is only fetched once." )
+
 #define DEMUX_FILTER_TEXT N_("Demux filter module")
 #define DEMUX_FILTER_LONGTEXT N_( \
     "Demux filters are used to modify/control the stream that is being read. " )
@@ -1032,6 +1042,12 @@ static const char *const ppsz_prefres[] = {
 #define VLM_CONF_LONGTEXT N_( \
     "Read a VLM configuration file as soon as VLM is started." )
 
+#define VLM_WORKERS_TEXT N_("VLM workers")
+#define VLM_WORKERS_LONGTEXT N_( \
+    "Number of threads stopping the inputs of the VLM media and starting " \
+    "the next ones, so that an input slow to stop does not hold up the " \
+    "others. With 0, the inputs are stopped by the VLM thread." )
+
 #define PLUGINS_CACHE_TEXT N_("Use a plugins cache")
 #define PLUGINS_CACHE_LONGTEXT N_( \
     "Use a plugins cache which will greatly improve the startup time of VLC.")
@@ -1727,6 +1743,8 @@ vlc_module_begin ()
     add_bool( "input-fast-seek", false,
               INPUT_FAST_SEEK_TEXT, INPUT_FAST_SEEK_LONGTEXT, false )
         change_safe ()
+    add_bool( "seek-index-cache", false,
+              SEEK_INDEX_CACHE_TEXT, SEEK_INDEX_CACHE_LONGTEXT, true )
     add_float( "rate", 1.,
                INPUT_RATE_TEXT, INPUT_RATE_LONGTEXT, false )
 
@@ -1898,6 +1916,8 @@ vlc_module_begin ()
     set_subcategory( SUBCAT_INPUT_STREAM_FILTER )
     add_module_list( "stream-filter", "stream_filter", NULL,
                      STREAM_FILTER_TEXT, STREAM_FILTER_LONGTEXT, false )
+    add_bool( "stream-shared-cache", false, STREAM_SHARED_CACHE_TEXT,
+              STREAM_SHARED_CACHE_LONGTEXT, true )
 
     add_string( "demux-filter", NULL, DEMUX_FILTER_TEXT, DEMUX_FILTER_LONGTEXT, true )
 
@@ -1925,6 +1945,9 @@ vlc_module_begin ()
     set_section( N_("VLM"), NULL )
     add_loadfile( "vlm-conf", NULL, VLM_CONF_TEXT,
                     VLM_CONF_LONGTEXT, true )
+    add_integer( "vlm-workers", 4, VLM_WORKERS_TEXT,
+                 VLM_WORKERS_LONGTEXT, true )
+        change_integer_range( 0, 64 )
 
 
 
@@ -33,6 +33,7 @@
 
 #include <vlc_common.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 #include <vlc_fs.h>
 
 #ifndef NDEBUG
@@ -99,6 +100,8 @@ static void block_generic_Release (block_t *block)
     free (block);
 }
 
+static bool block_IsAliased (const block_t *block);
+
 static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 {
     out->p_next    = in->p_next;
@@ -175,7 +178,7 @@ block_t *block_TryRealloc (block_t *p_block, ssize_t i_prebody, size_t i_body)
 
     if( p_block->i_buffer == 0 )
     {   /* Corner case: nothing to preserve */
-        if( requested <= p_block->i_size )
+        if( requested <= p_block->i_size && !block_IsAliased( p_block ) )
         {   /* Enough room: recycle buffer */
             size_t extra = p_block->i_size - requested;
 
@@ -197,10 +200,13 @@ block_t *block_TryRealloc (block_t *p_block, ssize_t i_prebody, size_t i_body)
     uint8_t *p_start = p_block->p_start;
     uint8_t *p_end = p_start + p_block->i_size;
 
-    /* Second, reallocate the buffer if we lack space. */
+    /* Second, reallocate the buffer if we lack space, or if the space
+     * around the payload may be in use by other references. */
     assert( i_prebody >= 0 );
     if( (size_t)(p_block->p_buffer - p_start) < (size_t)i_prebody
-     || (size_t)(p_end - p_block->p_buffer) < i_body )
+     || (size_t)(p_end - p_block->p_buffer) < i_body
+     || ( ( i_prebody > 0 || i_body > p_block->i_buffer )
+         && block_IsAliased( p_block ) ) )
     {
         block_t *p_rea = block_Alloc( requested );
         if( p_rea == NULL )
@@ -337,6 +343,182 @@ block_t *block_shm_Alloc (void *addr, size_t length)
 }
 #endif
 
+typedef struct
+{
+    atomic_uint refs;
+    atomic_bool aliased; /* references may overlap */
+    block_t    *source;
+} block_payload_t;
+
+typedef struct
+{
+    block_t          self;
+    block_payload_t *payload;
+} block_shared_t;
+
+static void block_shared_Release (block_t *block)
+{
+    block_payload_t *payload = ((block_shared_t *)block)->payload;
+
+    block_Invalidate (block);
+    free (block);
+
+    if (atomic_fetch_sub_explicit (&payload->refs, 1,
+                                   memory_order_acq_rel) == 1)
+    {
+        block_Release (payload->source);
+        free (payload);
+    }
+}
+
+static block_t *block_shared_New (block_payload_t *payload,
+                                  uint8_t *buf, size_t length)
+{
+    block_shared_t *shared = malloc (sizeof (*shared));
+    if (unlikely(shared == NULL))
+        return NULL;
+
+    /* Each reference can only (re)use its own part of the payload */
+    block_Init (&shared->self, buf, length);
+    shared->self.pf_release = block_shared_Release;
+    shared->payload = payload;
+    return &shared->self;
+}
+
+block_t *block_Share (block_t *block)
+{
+    block_Check (block);
+
+    if (block->pf_release == block_shared_Release)
+        return block;
+
+    block_payload_t *payload = malloc (sizeof (*payload));
+    if (unlikely(payload == NULL))
+        return NULL;
+
+    block_t *shared = block_shared_New (payload, block->p_buffer,
+                                        block->i_buffer);
+    if (unlikely(shared == NULL))
+    {
+        free (payload);
+        return NULL;
+    }
+
+    atomic_init (&payload->refs, 1);
+    atomic_init (&payload->aliased, false);
+    payload->source = block;
+    BlockMetaCopy (shared, block);
+    block->p_next = NULL;
+    return shared;
+}
+
+block_t *block_Slice (block_t *block, ssize_t offset, size_t length)
+{
+    block_Check (block);
+
+    if (block->pf_release != block_shared_Release)
+        return NULL;
+
+    /* The slice must lie within the buffer of the reference */
+    size_t headroom = block->p_buffer - block->p_start;
+    if (offset < 0 ? (size_t)-offset > headroom
+                   : (size_t)offset > block->i_size - headroom)
+        return NULL;
+
+    size_t start = headroom + offset;
+    if (length > block->i_size - start)
+        return NULL;
+
+    block_payload_t *payload = ((block_shared_t *)block)->payload;
+    block_t *slice = block_shared_New (payload, block->p_start + start,
+                                       length);
+    if (unlikely(slice == NULL))
+        return NULL;
+
+    atomic_fetch_add_explicit (&payload->refs, 1, memory_order_relaxed);
+    return slice;
+}
+
+block_t *block_Reference (block_t *block)
+{
+    block_Check (block);
+
+    if (block->pf_release != block_shared_Release)
+        return NULL;
+
+    block_payload_t *payload = ((block_shared_t *)block)->payload;
+    block_t *ref = block_shared_New (payload, block->p_buffer,
+                                     block->i_buffer);
+    if (unlikely(ref == NULL))
+        return NULL;
+
+    atomic_store_explicit (&payload->aliased, true, memory_order_relaxed);
+    atomic_fetch_add_explicit (&payload->refs, 1, memory_order_relaxed);
+    BlockMetaCopy (ref, block);
+    ref->p_next = NULL;
+    return ref;
+}
+
+static bool block_IsAliased (const block_t *block)
+{
+    if (block->pf_release != block_shared_Release)
+        return false;
+
+    block_payload_t *payload = ((const block_shared_t *)block)->payload;
+    return atomic_load_explicit (&payload->aliased, memory_order_relaxed)
+        && atomic_load_explicit (&payload->refs, memory_order_acquire) > 1;
+}
+
+block_t *block_Unshare (block_t *block)
+{
+    block_Check (block);
+
+    if (!block_IsAliased (block))
+        return block;
+
+    block_t *copy = block_Alloc (block->i_buffer);
+    if (unlikely(copy == NULL))
+    {
+        block_Release (block);
+        return NULL;
+    }
+
+    memcpy (copy->p_buffer, block->p_buffer, block->i_buffer);
+    BlockMetaCopy (copy, block);
+    block_Release (block);
+    return copy;
+}
+
+block_t *block_ChainJoin (block_t *list)
+{
+    block_Check (list);
+
+    if (list->pf_release != block_shared_Release)
+        return NULL;
+
+    const block_payload_t *payload = ((block_shared_t *)list)->payload;
+    const uint8_t *end = list->p_buffer + list->i_buffer;
+    mtime_t length = list->i_length;
+
+    for (const block_t *b = list->p_next; b != NULL; b = b->p_next)
+    {
+        if (b->pf_release != block_shared_Release
+         || ((const block_shared_t *)b)->payload != payload
+         || b->p_buffer != end)
+            return NULL;
+        end += b->i_buffer;
+        length += b->i_length;
+    }
+
+    block_ChainRelease (list->p_next);
+    list->p_next = NULL;
+    list->i_buffer = end - list->p_buffer;
+    if (list->i_size < (size_t)(end - list->p_start))
+        list->i_size = end - list->p_start;
+    list->i_length = length;
+    return list;
+}
+
 
 #ifdef _WIN32
 # include <io.h>
@@ -401,9 +583,19 @@ block_t *block_File(int fd, bool write)
         void *addr = mmap(NULL, length, prot, flags, fd, 0);
 
         if (addr != MAP_FAILED)
+        {
+#ifdef HAVE_POSIX_MADVISE
+            /* The whole file is about to be read, most likely in order */
+            posix_madvise (addr, length, POSIX_MADV_SEQUENTIAL);
+            posix_madvise (addr, length, POSIX_MADV_WILLNEED);
+#endif
             return block_mmap_Alloc (addr, length);
+        }
     }
 #endif
+#ifdef HAVE_POSIX_FADVISE
+    posix_fadvise (fd, 0, length, POSIX_FADV_SEQUENTIAL);
+#endif
 
     /* If mmap() is not implemented by the OS _or_ the filesystem... */
     block_t *block = block_Alloc (length);
@@ -62,6 +62,7 @@ static const struct
     { ".m2a",   "audio/mpeg" },
     { ".m1v",   "video/mpeg" },
     { ".m2v",   "video/mpeg" },
+    { ".m4s",   "video/iso.segment" },
     { ".mp2",   "audio/mpeg" },
     { ".mp3",   "audio/mpeg" },
     { ".mpa",   "audio/mpeg" },
@@ -70,6 +71,7 @@ static const struct
     { ".mpe",   "video/mpeg" },
     { ".mov",   "video/quicktime" },
     { ".moov",  "video/quicktime" },
+    { ".mp4",   "video/mp4" },
     { ".oga",   "audio/ogg" },
     { ".ogg",   "application/ogg" },
     { ".ogm",   "application/ogg" },
@@ -77,6 +79,7 @@ static const struct
     { ".ogx",   "application/ogg" },
     { ".opus",  "audio/ogg; codecs=opus" },
     { ".spx",   "audio/ogg" },
+    { ".ts",    "video/MP2T" },
     { ".wav",   "audio/wav" },
     { ".wma",   "audio/x-ms-wma" },
     { ".wmv",   "video/x-ms-wmv" },
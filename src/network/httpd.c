@@ -40,14 +40,19 @@
 #include <vlc_url.h>
 #include <vlc_mime.h>
 #include <vlc_block.h>
+#include <vlc_fs.h>
 #include "../libvlc.h"
 
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
+#include <sys/stat.h>
 #ifdef HAVE_SYS_UIO_H
 # include <sys/uio.h>
 #endif
+#ifdef HAVE_SYS_SENDFILE_H
+# include <sys/sendfile.h>
+#endif
 
 #ifdef HAVE_POLL
 # include <poll.h>
@@ -66,6 +71,9 @@
 #define HTTPD_CL_BUFSIZE 10000
 #endif
 
+/* Maximum amount of file data sent to a client in one go */
+#define HTTPD_FILE_CHUNK (1 << 20)
+
 static void httpd_ClientDestroy(httpd_client_t *cl);
 static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data);
 
@@ -154,6 +162,7 @@ struct httpd_client_t
 
     mtime_t i_activity_date;
     mtime_t i_activity_timeout;
+    mtime_t i_deadline; /* of a deferred answer, or 0 */
 
     /* buffer for reading header */
     int     i_buffer_size;
@@ -171,6 +180,11 @@ struct httpd_client_t
     httpd_message_t query;  /* client -> httpd */
     httpd_message_t answer; /* httpd -> client */
 
+    /* File descriptor body, sent after the answer header */
+    int      i_body_fd;
+    bool     b_body_zerocopy;
+    uint64_t i_body_fd_offset;
+    uint64_t i_body_fd_remaining;
 };
 
 
@@ -301,6 +315,7 @@ struct httpd_file_t
 {
     httpd_url_t *url;
     httpd_file_callback_t pf_fill;
+    httpd_file_fd_callback_t pf_open;
     httpd_file_sys_t      *p_sys;
     char mime[1];
 };
@@ -356,11 +371,157 @@ httpd_FileCallBack(httpd_callback_sys_t *p_sys, httpd_client_t *cl,
     return VLC_SUCCESS;
 }
 
-httpd_file_t *httpd_FileNew(httpd_host_t *host,
-                             const char *psz_url, const char *psz_mime,
-                             const char *psz_user, const char *psz_password,
-                             httpd_file_callback_t pf_fill,
-                             httpd_file_sys_t *p_sys)
+/* Parses the digits of a byte position, without sign nor white space */
+static bool httpd_ParsePos(const char **str, uint64_t *pos)
+{
+    const char *s = *str;
+    char *end;
+
+    if (*s < '0' || *s > '9')
+        return false;
+
+    errno = 0;
+    unsigned long long val = strtoull(s, &end, 10);
+    if (errno == ERANGE)
+        return false;
+
+    *pos = val;
+    *str = end;
+    return true;
+}
+
+/**
+ * Parses a single byte range (IETF RFC7233 §2.1).
+ * \retval 0 range is satisfiable
+ * \retval -1 range is not satisfiable
+ * \retval 1 range is not supported (and should be ignored)
+ */
+static int httpd_ParseRange(const char *range, uint64_t size,
+                            uint64_t *restrict start, uint64_t *restrict end)
+{
+    uint64_t first, last;
+
+    if (strncasecmp(range, "bytes=", 6))
+        return 1;
+    range += 6;
+    if (strchr(range, ',') != NULL)
+        return 1; /* multiple ranges */
+
+    if (*range == '-') {
+        /* suffix range: last bytes of the file */
+        range++;
+        if (!httpd_ParsePos(&range, &last) || *range != '\0')
+            return 1;
+        if (last == 0 || size == 0)
+            return -1;
+        *start = (last < size) ? size - last : 0;
+        *end = size - 1;
+        return 0;
+    }
+
+    if (!httpd_ParsePos(&range, &first) || *(range++) != '-')
+        return 1;
+    if (*range == '\0')
+        last = UINT64_MAX;
+    else if (!httpd_ParsePos(&range, &last) || *range != '\0' || last < first)
+        return 1;
+
+    if (first >= size)
+        return -1;
+    *start = first;
+    *end = (last < size) ? last : size - 1;
+    return 0;
+}
+
+static int
+httpd_FileFdCallBack(httpd_callback_sys_t *p_sys, httpd_client_t *cl,
+                     httpd_message_t *answer, const httpd_message_t *query)
+{
+    httpd_file_t *file = (httpd_file_t*)p_sys;
+    const char *psz_connection;
+    struct stat st;
+
+    if (!answer || !query )
+        return VLC_SUCCESS;
+
+    answer->i_proto  = HTTPD_PROTO_HTTP;
+    answer->i_version= 1;
+    answer->i_type   = HTTPD_MSG_ANSWER;
+
+    int max_age = -1;
+    int fd = file->pf_open(file->p_sys, file, query->psz_args, &max_age);
+    if (fd != -1 && (fstat(fd, &st) || !S_ISREG(st.st_mode))) {
+        vlc_close(fd);
+        fd = -1;
+    }
+
+    /* We respect client request */
+    psz_connection = httpd_MsgGet(&cl->query, "Connection");
+    if (psz_connection)
+        httpd_MsgAdd(answer, "Connection", "%s", psz_connection);
+
+    if (fd == -1) {
+        char *p;
+
+        answer->i_status = 404;
+        answer->i_body = httpd_HtmlError(&p, 404, query->psz_url);
+        answer->p_body = (uint8_t *)p;
+        httpd_MsgAdd(answer, "Content-Type", "%s", "text/html");
+        httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
+        return VLC_SUCCESS;
+    }
+
+    uint64_t size = st.st_size, start = 0, length = size;
+    const char *range = httpd_MsgGet(query, "Range");
+
+    answer->i_status = 200;
+    httpd_MsgAdd(answer, "Content-type",  "%s", file->mime);
+    if (max_age >= 0)
+        httpd_MsgAdd(answer, "Cache-Control", "public, max-age=%d", max_age);
+    else
+        httpd_MsgAdd(answer, "Cache-Control", "%s", "no-cache");
+    httpd_MsgAdd(answer, "Accept-Ranges", "%s", "bytes");
+
+    if (range != NULL) {
+        uint64_t end;
+
+        switch (httpd_ParseRange(range, size, &start, &end)) {
+            case 0:
+                answer->i_status = 206;
+                length = end - start + 1;
+                httpd_MsgAdd(answer, "Content-Range",
+                             "bytes %"PRIu64"-%"PRIu64"/%"PRIu64,
+                             start, end, size);
+                break;
+            case -1:
+                answer->i_status = 416;
+                length = 0;
+                httpd_MsgAdd(answer, "Content-Range", "bytes */%"PRIu64,
+                             size);
+                break;
+        }
+    }
+    httpd_MsgAdd(answer, "Content-Length", "%"PRIu64, length);
+
+    if (query->i_type == HTTPD_MSG_HEAD || length == 0) {
+        vlc_close(fd);
+        return VLC_SUCCESS;
+    }
+
+    /* The body is sent by httpd_ClientSend() once the header is out */
+    cl->i_body_fd = fd;
+    cl->b_body_zerocopy = cl->sock->p == NULL; /* not through TLS */
+    cl->i_body_fd_offset = start;
+    cl->i_body_fd_remaining = length;
+    return VLC_SUCCESS;
+}
+
+static httpd_file_t *httpd_FileCreate(httpd_host_t *host,
+                                      const char *psz_url, const char *psz_mime,
+                                      const char *psz_user,
+                                      const char *psz_password,
+                                      httpd_callback_t cb,
+                                      httpd_file_sys_t *p_sys)
 {
     const char *mime = psz_mime;
     if (mime == NULL || mime[0] == '\0')
@@ -377,17 +538,43 @@ httpd_file_t *httpd_FileNew(httpd_host_t *host,
         return NULL;
     }
 
-    file->pf_fill = pf_fill;
+    file->pf_fill = NULL;
+    file->pf_open = NULL;
     file->p_sys   = p_sys;
     memcpy(file->mime, mime, mimelen + 1);
 
-    httpd_UrlCatch(file->url, HTTPD_MSG_HEAD, httpd_FileCallBack,
-                    (httpd_callback_sys_t*)file);
-    httpd_UrlCatch(file->url, HTTPD_MSG_GET,  httpd_FileCallBack,
-                    (httpd_callback_sys_t*)file);
-    httpd_UrlCatch(file->url, HTTPD_MSG_POST, httpd_FileCallBack,
-                    (httpd_callback_sys_t*)file);
+    httpd_UrlCatch(file->url, HTTPD_MSG_HEAD, cb, (httpd_callback_sys_t*)file);
+    httpd_UrlCatch(file->url, HTTPD_MSG_GET,  cb, (httpd_callback_sys_t*)file);
+    httpd_UrlCatch(file->url, HTTPD_MSG_POST, cb, (httpd_callback_sys_t*)file);
+
+    return file;
+}
+
+httpd_file_t *httpd_FileNew(httpd_host_t *host,
+                             const char *psz_url, const char *psz_mime,
+                             const char *psz_user, const char *psz_password,
+                             httpd_file_callback_t pf_fill,
+                             httpd_file_sys_t *p_sys)
+{
+    httpd_file_t *file = httpd_FileCreate(host, psz_url, psz_mime, psz_user,
+                                          psz_password, httpd_FileCallBack,
+                                          p_sys);
+    if (file != NULL)
+        file->pf_fill = pf_fill;
+    return file;
+}
 
+httpd_file_t *httpd_FileNewFd(httpd_host_t *host,
+                              const char *psz_url, const char *psz_mime,
+                              const char *psz_user, const char *psz_password,
+                              httpd_file_fd_callback_t pf_open,
+                              httpd_file_sys_t *p_sys)
+{
+    httpd_file_t *file = httpd_FileCreate(host, psz_url, psz_mime, psz_user,
+                                          psz_password, httpd_FileFdCallBack,
+                                          p_sys);
+    if (file != NULL)
+        file->pf_open = pf_open;
     return file;
 }
 
@@ -1196,11 +1383,13 @@ static void httpd_ClientInit(httpd_client_t *cl, mtime_t now)
     cl->i_state = HTTPD_CLIENT_RECEIVING;
     cl->i_activity_date = now;
     cl->i_activity_timeout = INT64_C(10000000);
+    cl->i_deadline = 0;
     cl->i_buffer_size = HTTPD_CL_BUFSIZE;
     cl->i_buffer = 0;
     cl->p_buffer = xmalloc(cl->i_buffer_size);
     cl->i_keyframe_wait_to_pass = -1;
     cl->b_stream_mode = false;
+    cl->i_body_fd = -1;
 
     httpd_MsgInit(&cl->query);
     httpd_MsgInit(&cl->answer);
@@ -1216,8 +1405,16 @@ char* httpd_ServerIP(const httpd_client_t *cl, char *ip, int *port)
     return net_GetSockAddress(vlc_tls_GetFD(cl->sock), ip, port) ? NULL : ip;
 }
 
+void httpd_ClientSetDeadline(httpd_client_t *cl, mtime_t deadline)
+{
+    if (cl->i_deadline == 0)
+        cl->i_deadline = deadline;
+}
+
 static void httpd_ClientDestroy(httpd_client_t *cl)
 {
+    if (cl->i_body_fd != -1)
+        vlc_close(cl->i_body_fd);
     vlc_tls_Close(cl->sock);
     httpd_MsgClean(&cl->answer);
     httpd_MsgClean(&cl->query);
@@ -1560,10 +1757,76 @@ static void httpd_ClientRecv(httpd_client_t *cl)
         cl->i_activity_timeout = 0;
 }
 
+/**
+ * Sends the next part of a file descriptor body, either directly from the
+ * kernel, or by loading it into the client buffer.
+ */
+static void httpd_ClientSendFile(httpd_client_t *cl)
+{
+    if (cl->i_body_fd_remaining == 0) {
+        vlc_close(cl->i_body_fd);
+        cl->i_body_fd = -1;
+        cl->i_state = HTTPD_CLIENT_SEND_DONE;
+        return;
+    }
+
+    size_t i_len = HTTPD_FILE_CHUNK;
+    if (i_len > cl->i_body_fd_remaining)
+        i_len = cl->i_body_fd_remaining;
+
+#ifdef HAVE_SYS_SENDFILE_H
+    if (cl->b_body_zerocopy) {
+        off_t offset = cl->i_body_fd_offset;
+        ssize_t val = sendfile(vlc_tls_GetFD(cl->sock), cl->i_body_fd,
+                               &offset, i_len);
+        if (val > 0) {
+            cl->i_body_fd_offset += val;
+            cl->i_body_fd_remaining -= val;
+            return;
+        }
+        if (val < 0 && errno == EAGAIN)
+            return;
+        if (val == 0 || (errno != EINVAL && errno != ENOSYS)) {
+            cl->i_state = HTTPD_CLIENT_DEAD;
+            return;
+        }
+        /* Not supported for this file: fall back to copying */
+        cl->b_body_zerocopy = false;
+    }
+#endif
+
+    if (i_len > HTTPD_CL_BUFSIZE)
+        i_len = HTTPD_CL_BUFSIZE;
+
+    free(cl->p_buffer);
+    cl->p_buffer = xmalloc(i_len);
+
+    ssize_t val = pread(cl->i_body_fd, cl->p_buffer, i_len,
+                        cl->i_body_fd_offset);
+    if (val <= 0) {
+        cl->i_buffer = cl->i_buffer_size = 0;
+        cl->i_state = HTTPD_CLIENT_DEAD;
+        return;
+    }
+
+    cl->i_body_fd_offset += val;
+    cl->i_body_fd_remaining -= val;
+    cl->i_buffer = 0;
+    cl->i_buffer_size = val;
+}
+
 static void httpd_ClientSend(httpd_client_t *cl)
 {
     int i_len;
 
+    if (cl->i_body_fd != -1 && cl->i_buffer >= cl->i_buffer_size) {
+        /* The header or the previous file chunk was sent */
+        httpd_ClientSendFile(cl);
+        if (cl->i_state != HTTPD_CLIENT_SENDING
+         || cl->i_buffer >= cl->i_buffer_size)
+            return;
+    }
+
     if (cl->i_buffer < 0) {
         /* We need to create the header */
         int i_size = 0;
@@ -1601,6 +1864,9 @@ static void httpd_ClientSend(httpd_client_t *cl)
         cl->i_buffer += i_len;
 
         if (cl->i_buffer >= cl->i_buffer_size) {
+            if (cl->i_body_fd != -1)
+                return; /* file body follows */
+
             if (cl->answer.i_body == 0  && cl->answer.i_body_offset > 0) {
                 /* catch more body data */
                 int     i_msg = cl->query.i_type;
@@ -1819,6 +2085,7 @@ static void httpdLoop(httpd_host_t *host)
                     default: {
                         int i_msg = query->i_type;
                         bool b_auth_failed = false;
+                        bool b_deferred = false;
 
                         /* Search the url and trigger callbacks */
                         for (int i = 0; i < host->i_url; i++) {
@@ -1840,6 +2107,14 @@ static void httpdLoop(httpd_host_t *host)
                             if (url->catch[i_msg].cb(url->catch[i_msg].p_sys, cl, answer, query))
                                 continue;
 
+                            if (answer->i_type == HTTPD_MSG_NONE
+                             && query->i_proto == HTTPD_PROTO_HTTP) {
+                                /* no answer yet (e.g. blocking playlist
+                                 * reload): ask again on the next loop */
+                                b_deferred = true;
+                                break;
+                            }
+
                             if (answer->i_proto == HTTPD_PROTO_NONE)
                                 cl->i_buffer = cl->i_buffer_size; /* Raw answer from a CGI */
                             else
@@ -1851,6 +2126,17 @@ static void httpdLoop(httpd_host_t *host)
                                 cl->url = url;
                         }
 
+                        if (b_deferred) {
+                            if (cl->i_deadline == 0 || now < cl->i_deadline) {
+                                /* keep the client until the deadline */
+                                if (cl->i_deadline != 0)
+                                    cl->i_activity_date = now;
+                                break;
+                            }
+                            /* not answered in time */
+                        }
+                        cl->i_deadline = 0;
+
                         if (answer) {
                             answer->i_proto  = query->i_proto;
                             answer->i_type   = HTTPD_MSG_ANSWER;
@@ -1860,7 +2146,9 @@ static void httpdLoop(httpd_host_t *host)
                                 httpd_MsgAdd(answer, "WWW-Authenticate",
                                         "Basic realm=\"VLC stream\"");
                                 answer->i_status = 401;
-                            } else
+                            } else if (b_deferred)
+                                answer->i_status = 503;
+                            else
                                 answer->i_status = 404; /* no url registered */
 
                             char *p;
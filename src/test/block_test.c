@@ -86,11 +86,117 @@ static void test_block (void)
     //assert (block == NULL);
 }
 
+static void test_block_Slice (void)
+{
+    block_t *block = block_Alloc (sizeof (text));
+    assert (block != NULL);
+    memcpy (block->p_buffer, text, sizeof (text));
+    block->i_pts = 42;
+
+    block_t *shared = block_Share (block);
+    assert (shared != NULL && shared != block);
+    assert (block_Share (shared) == shared);
+    assert (shared->i_pts == 42);
+    assert (shared->p_buffer == block->p_buffer);
+    assert (block_Slice (block, 0, 1) == NULL);
+    assert (block_Slice (shared, 1, sizeof (text)) == NULL);
+
+    /* Slices outlive the reference they were created from */
+    block_t *a = block_Slice (shared, 0, 5);
+    block_t *b = block_Slice (shared, 5, 3);
+    block_t *c = block_Slice (shared, 8, sizeof (text) - 8);
+    assert (a != NULL && b != NULL && c != NULL);
+    assert (a->i_pts == VLC_TS_INVALID);
+
+    /* Consumed data remains reachable from the headroom */
+    shared->p_buffer += 5;
+    shared->i_buffer -= 5;
+    block_t *d = block_Slice (shared, -5, 5);
+    assert (d != NULL && !memcmp (d->p_buffer, text, 5));
+    block_Release (d);
+    assert (block_Slice (shared, -6, 1) == NULL);
+    block_Release (shared);
+
+    assert (!memcmp (b->p_buffer, text + 5, 3));
+    a->i_length = b->i_length = c->i_length = 1;
+
+    /* Non adjacent slices cannot be joined */
+    a->p_next = c;
+    assert (block_ChainJoin (a) == NULL);
+    assert (a->p_next == c);
+
+    a->p_next = b;
+    b->p_next = c;
+    block_t *gathered = block_ChainGather (a);
+    assert (gathered == a);
+    assert (gathered->p_next == NULL);
+    assert (gathered->i_buffer == sizeof (text));
+    assert (gathered->i_length == 3);
+    assert (!memcmp (gathered->p_buffer, text, sizeof (text)));
+
+    /* Slices are independent blocks */
+    gathered = block_Realloc (gathered, 100, gathered->i_buffer);
+    assert (gathered != NULL);
+    assert (!memcmp (gathered->p_buffer + 100, text, sizeof (text)));
+    block_Release (gathered);
+}
+
+static void test_block_Reference (void)
+{
+    block_t *block = block_Alloc (sizeof (text));
+    assert (block != NULL);
+    memcpy (block->p_buffer, text, sizeof (text));
+    block->i_pts = 42;
+
+    assert (block_Reference (block) == NULL);
+    block = block_Share (block);
+    assert (block != NULL);
+
+    /* Slices alone do not prevent in place writes */
+    block_t *slice = block_Slice (block, 0, 5);
+    assert (slice != NULL);
+    assert (block_Unshare (slice) == slice);
+
+    block_t *ref = block_Reference (block);
+    assert (ref != NULL && ref != block);
+    assert (ref->i_pts == 42 && ref->p_buffer == block->p_buffer);
+    assert (ref->p_next == NULL);
+
+    /* Metadata are independent, the payload is copied on demand */
+    ref->i_pts = 43;
+    assert (block->i_pts == 42);
+    block_t *copy = block_Unshare (ref);
+    assert (copy != NULL && copy->p_buffer != block->p_buffer);
+    assert (copy->i_pts == 43);
+    assert (!memcmp (copy->p_buffer, text, sizeof (text)));
+    copy->p_buffer[0] = 'X';
+    assert (block->p_buffer[0] == text[0]);
+    block_Release (copy);
+    block_Release (slice);
+
+    /* Growing an aliased payload in place would overwrite the others */
+    ref = block_Reference (block);
+    assert (ref != NULL);
+    ref->p_buffer += 5;
+    ref->i_buffer -= 5;
+    ref = block_Realloc (ref, 5, ref->i_buffer);
+    assert (ref != NULL && ref->p_buffer != block->p_buffer);
+    memset (ref->p_buffer, 'X', 5);
+    assert (!memcmp (block->p_buffer, text, sizeof (text)));
+    block_Release (ref);
+
+    /* The last reference is writable */
+    assert (block_Unshare (block) == block);
+    block_Release (block);
+}
+
 int main (void)
 {
     test_block_File(false);
     test_block_File(true);
     test_block ();
+    test_block_Slice ();
+    test_block_Reference ();
     return 0;
 }
 
@@ -0,0 +1,155 @@
+/*****************************************************************************
+ * file_range.c: test moving a range of a file up in chunks
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <vlc_common.h>
+
+/* Copies at most half of each request, and fails on chosen calls */
+static unsigned i_calls, i_fail_call, i_fail_call2;
+
+static ssize_t test_copy_file_range( int fd_in, loff_t *pi_in, int fd_out,
+                                     loff_t *pi_out, size_t i_len,
+                                     unsigned i_flags )
+{
+    uint8_t buf[4096];
+
+    assert( i_flags == 0 );
+    i_calls++;
+    if( i_calls == i_fail_call || i_calls == i_fail_call2 )
+    {
+        errno = EIO;
+        return -1;
+    }
+
+    if( i_len > 1 )
+        i_len /= 2;
+    if( i_len > sizeof(buf) )
+        i_len = sizeof(buf);
+
+    ssize_t val = pread( fd_in, buf, i_len, *pi_in );
+    if( val <= 0 )
+        return val;
+    val = pwrite( fd_out, buf, val, *pi_out );
+    if( val > 0 )
+    {
+        *pi_in += val;
+        *pi_out += val;
+    }
+    return val;
+}
+
+#define copy_file_range test_copy_file_range
+#include "../modules/access_output/file_range.h"
+
+#define FILE_SIZE  100000
+#define OFFSET     1000
+#define SHIFT      4096
+#define CHUNK      3000
+
+static uint8_t orig[FILE_SIZE];
+
+static int create_file( void )
+{
+    char psz_path[] = "/tmp/vlc-test-file-range-XXXXXX";
+    int fd = mkstemp( psz_path );
+
+    assert( fd != -1 );
+    unlink( psz_path );
+    for( size_t i = 0; i < FILE_SIZE; i++ )
+        orig[i] = rand();
+    assert( pwrite( fd, orig, FILE_SIZE, 0 ) == FILE_SIZE );
+    return fd;
+}
+
+static void check_intact( int fd )
+{
+    static uint8_t buf[FILE_SIZE + SHIFT];
+
+    assert( lseek( fd, 0, SEEK_END ) == FILE_SIZE );
+    assert( pread( fd, buf, FILE_SIZE, 0 ) == FILE_SIZE );
+    assert( !memcmp( buf, orig, FILE_SIZE ) );
+}
+
+static void test_success( void )
+{
+    static uint8_t buf[FILE_SIZE + SHIFT];
+    int fd = create_file();
+
+    i_calls = 0;
+    i_fail_call = i_fail_call2 = 0;
+    assert( file_ShiftRange( fd, OFFSET, FILE_SIZE, SHIFT, CHUNK ) == 0 );
+    assert( lseek( fd, 0, SEEK_END ) == FILE_SIZE + SHIFT );
+    assert( pread( fd, buf, FILE_SIZE + SHIFT, 0 ) == FILE_SIZE + SHIFT );
+    assert( !memcmp( buf, orig, OFFSET ) );
+    assert( !memcmp( buf + OFFSET + SHIFT, orig + OFFSET,
+                     FILE_SIZE - OFFSET ) );
+    close( fd );
+}
+
+static void test_failure( unsigned i_call )
+{
+    int fd = create_file();
+
+    i_calls = 0;
+    i_fail_call = i_call;
+    i_fail_call2 = 0;
+    assert( file_ShiftRange( fd, OFFSET, FILE_SIZE, SHIFT, CHUNK ) == -1 );
+    assert( errno == EIO );
+    check_intact( fd );
+    close( fd );
+}
+
+static void test_undo_failure( unsigned i_call )
+{
+    int fd = create_file();
+
+    i_calls = 0;
+    i_fail_call = i_call;
+    i_fail_call2 = i_call + 1;
+    assert( file_ShiftRange( fd, OFFSET, FILE_SIZE, SHIFT, CHUNK ) == -2 );
+    close( fd );
+}
+
+int main( void )
+{
+    test_success();
+
+    /* First chunk, and chunks in the middle, including in the middle of a
+     * partial chunk copy */
+    test_failure( 1 );
+    test_failure( 2 );
+    for( unsigned i = 5; i < 200; i += 7 )
+        test_failure( i );
+
+    test_undo_failure( 40 );
+    return 0;
+}
@@ -0,0 +1,275 @@
+/*****************************************************************************
+ * csa.c: DVB-CSA scrambling tests
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include <vlc_common.h>
+
+#define TS_NO_CSA_CK_MSG
+#include "../modules/mux/mpeg/csa.c"
+
+/* Output of the scalar implementation, before the bitsliced one */
+static const uint8_t scrambled_odd[188] = {
+    0x47, 0x01, 0x00, 0xd0, 0xc8, 0x54, 0x77, 0x18, 0x1e, 0x1c, 0x20, 0xf3,
+    0x01, 0x59, 0xd6, 0x00, 0x4a, 0x8d, 0x96, 0x1e, 0x8e, 0x38, 0x58, 0xcb,
+    0x68, 0xb1, 0x67, 0xb9, 0xe5, 0x53, 0x50, 0xd7, 0x51, 0x96, 0x58, 0x9e,
+    0x4b, 0xdd, 0x65, 0x5a, 0xac, 0x08, 0x3d, 0x9d, 0x52, 0x38, 0x8e, 0x7f,
+    0x46, 0x55, 0xfe, 0x37, 0xc4, 0xb3, 0xc5, 0x03, 0x34, 0x93, 0xe5, 0xf5,
+    0x71, 0x39, 0xac, 0x2d, 0x0d, 0x5b, 0xf0, 0x54, 0x55, 0x31, 0xe9, 0x49,
+    0x06, 0xdd, 0x37, 0xfc, 0xe3, 0x61, 0xe9, 0xb8, 0x25, 0xd5, 0xa5, 0x79,
+    0x5c, 0xfe, 0x43, 0xa8, 0x90, 0x3e, 0x9b, 0xde, 0x79, 0x43, 0xa8, 0xfe,
+    0x3a, 0x1a, 0xd6, 0xfd, 0xdf, 0x57, 0xf0, 0x4a, 0x02, 0xb7, 0xff, 0x46,
+    0xf0, 0xcf, 0xde, 0xd0, 0x57, 0xce, 0x43, 0xc1, 0x31, 0x6a, 0x9d, 0xb7,
+    0x98, 0x0e, 0x57, 0x97, 0x83, 0xbd, 0x57, 0xf9, 0x7f, 0xf4, 0xe2, 0x6a,
+    0x35, 0x84, 0xa6, 0xa8, 0x11, 0xc3, 0xc4, 0x62, 0x35, 0xbc, 0x9d, 0xc6,
+    0x47, 0x96, 0x3b, 0xa2, 0x00, 0xd8, 0x00, 0x3a, 0x26, 0x11, 0xe6, 0xff,
+    0xfc, 0xdb, 0xfb, 0xce, 0x22, 0x1d, 0x0f, 0x62, 0x6b, 0xf2, 0x1e, 0x3e,
+    0xd7, 0xbb, 0x83, 0xa5, 0x99, 0xf7, 0xc4, 0x73, 0x46, 0x08, 0x22, 0x7c,
+    0x0d, 0xe9, 0x4c, 0x6d, 0x3c, 0xef, 0xc0, 0x2a,
+};
+static const uint8_t scrambled_even_af[188] = {
+    0x47, 0x01, 0x00, 0xb0, 0x1a, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x1b, 0xee, 0x65, 0xd8, 0xbc,
+    0xf8, 0x17, 0x02, 0x68, 0x3f, 0xec, 0xcb, 0x7e, 0xa5, 0x33, 0x49, 0xb3,
+    0xc2, 0xdd, 0x04, 0xe6, 0x5b, 0x33, 0x35, 0xae, 0xe5, 0x20, 0x70, 0x1d,
+    0xf5, 0xfe, 0x54, 0xd2, 0xb9, 0x63, 0x56, 0xf3, 0xf7, 0x4c, 0xa9, 0x83,
+    0xa4, 0xc8, 0x88, 0x87, 0xe7, 0x0d, 0x09, 0xf1, 0xc2, 0x4b, 0xc4, 0x05,
+    0xc6, 0x13, 0x6b, 0x65, 0x60, 0x20, 0x57, 0x2e, 0xdc, 0x00, 0xd9, 0x64,
+    0x71, 0xde, 0x2b, 0x48, 0x4e, 0x09, 0x35, 0x19, 0x77, 0x79, 0xe9, 0xaf,
+    0x4b, 0x5a, 0x62, 0x8b, 0x5d, 0xaa, 0x3c, 0x2a, 0xa0, 0x0c, 0xa1, 0x89,
+    0xf8, 0xd8, 0x24, 0xe7, 0xbc, 0x67, 0x80, 0x31, 0x8b, 0x33, 0xd4, 0xb5,
+    0x61, 0x39, 0xb2, 0xa4, 0xf5, 0x5b, 0x66, 0x28, 0x32, 0x5d, 0x4b, 0x65,
+    0x34, 0x98, 0xde, 0xe3, 0x70, 0x13, 0xea, 0xaa, 0xa2, 0x2c, 0xdc, 0xf6,
+    0x3b, 0x2c, 0x26, 0xce, 0xbd, 0xe2, 0xd6, 0xc4, 0x42, 0x24, 0xd2, 0x1d,
+    0x5f, 0xe0, 0x97, 0xaa, 0x31, 0xaf, 0x1d, 0x9b, 0x63, 0xff, 0x78, 0xbf,
+    0x14, 0x2a, 0x4f, 0x93, 0x57, 0x01, 0x89, 0x61,
+};
+static const uint8_t scrambled_odd_100[188] = {
+    0x47, 0x01, 0x00, 0xd0, 0xf5, 0x4c, 0x58, 0xe6, 0x02, 0x98, 0x5a, 0x88,
+    0x31, 0xe0, 0xfb, 0xac, 0x9f, 0xe3, 0x3b, 0x95, 0x88, 0x7f, 0x88, 0xb0,
+    0xec, 0x88, 0x8f, 0x5d, 0xaf, 0x57, 0xa5, 0xbc, 0x52, 0x03, 0x91, 0x1d,
+    0x25, 0x6d, 0x89, 0xae, 0x49, 0x5c, 0xaa, 0x48, 0xad, 0x09, 0x49, 0x0e,
+    0x3f, 0xbf, 0xf9, 0x40, 0xc9, 0xff, 0xb0, 0xc1, 0x0b, 0x99, 0xcf, 0xda,
+    0x7e, 0x72, 0x37, 0xcb, 0xf1, 0xfc, 0xd3, 0x9d, 0x9a, 0x93, 0x0b, 0xed,
+    0xe0, 0x04, 0x5f, 0xf8, 0xd9, 0x0d, 0x54, 0xf6, 0x44, 0xf6, 0x6c, 0x23,
+    0x96, 0xb2, 0x16, 0x5d, 0x89, 0xf7, 0xad, 0x70, 0x14, 0x0d, 0xd3, 0xe1,
+    0x0d, 0x6c, 0xb0, 0x1f, 0xbf, 0xc6, 0xcd, 0xd4, 0xdb, 0xe2, 0xe9, 0xf0,
+    0xf7, 0xfe, 0x05, 0x0c, 0x13, 0x1a, 0x21, 0x28, 0x2f, 0x36, 0x3d, 0x44,
+    0x4b, 0x52, 0x59, 0x60, 0x67, 0x6e, 0x75, 0x7c, 0x83, 0x8a, 0x91, 0x98,
+    0x9f, 0xa6, 0xad, 0xb4, 0xbb, 0xc2, 0xc9, 0xd0, 0xd7, 0xde, 0xe5, 0xec,
+    0xf3, 0xfa, 0x01, 0x08, 0x0f, 0x16, 0x1d, 0x24, 0x2b, 0x32, 0x39, 0x40,
+    0x47, 0x4e, 0x55, 0x5c, 0x63, 0x6a, 0x71, 0x78, 0x7f, 0x86, 0x8d, 0x94,
+    0x9b, 0xa2, 0xa9, 0xb0, 0xb7, 0xbe, 0xc5, 0xcc, 0xd3, 0xda, 0xe1, 0xe8,
+    0xef, 0xf6, 0xfd, 0x04, 0x0b, 0x12, 0x19, 0x20,
+};
+
+static void packet_init( uint8_t *p, int i_af )
+{
+    int i = 4;
+
+    p[0] = 0x47; p[1] = 0x01; p[2] = 0x00; p[3] = i_af ? 0x30 : 0x10;
+    if( i_af )
+    {
+        p[4] = i_af - 1;
+        for( i = 5; i < 4 + i_af; i++ )
+            p[i] = 0xff;
+    }
+    for( ; i < 188; i++ )
+        p[i] = (i * 7 + 3) & 0xff;
+}
+
+static void packet_random( uint8_t *p )
+{
+    int i_af = rand() % 4 ? 0 : rand() % 184;
+
+    packet_init( p, i_af );
+    for( int i = 4 + i_af; i < 188; i++ )
+        p[i] = rand();
+}
+
+static void test_known( csa_t *c )
+{
+    const struct
+    {
+        const uint8_t *p_ref;
+        bool b_odd;
+        int  i_af;
+        int  i_pkt_size;
+    } tests[] = {
+        { scrambled_odd,     true,  0,  188 },
+        { scrambled_even_af, false, 27, 188 },
+        { scrambled_odd_100, true,  0,  100 },
+    };
+
+    for( size_t i = 0; i < ARRAY_SIZE(tests); i++ )
+    {
+        uint8_t pkt[188], clear[188];
+        uint8_t *pp_pkts[8];
+        uint8_t batch[8][188];
+
+        csa_UseKey( NULL, c, tests[i].b_odd );
+
+        packet_init( clear, tests[i].i_af );
+        memcpy( pkt, clear, 188 );
+        csa_Encrypt( c, pkt, tests[i].i_pkt_size );
+        assert( !memcmp( pkt, tests[i].p_ref, 188 ) );
+        csa_Decrypt( c, pkt, tests[i].i_pkt_size );
+        assert( !memcmp( pkt, clear, 188 ) );
+
+        for( size_t j = 0; j < ARRAY_SIZE(batch); j++ )
+        {
+            memcpy( batch[j], clear, 188 );
+            pp_pkts[j] = batch[j];
+        }
+        csa_EncryptBatch( c, pp_pkts, ARRAY_SIZE(batch), tests[i].i_pkt_size );
+        for( size_t j = 0; j < ARRAY_SIZE(batch); j++ )
+            assert( !memcmp( batch[j], tests[i].p_ref, 188 ) );
+        csa_DecryptBatch( c, pp_pkts, ARRAY_SIZE(batch), tests[i].i_pkt_size );
+        for( size_t j = 0; j < ARRAY_SIZE(batch); j++ )
+            assert( !memcmp( batch[j], clear, 188 ) );
+    }
+}
+
+static void test_batch( csa_t *c, size_t i_pkts, int i_pkt_size )
+{
+    uint8_t (*clear)[188] = malloc( i_pkts * 188 );
+    uint8_t (*ref)[188] = malloc( i_pkts * 188 );
+    uint8_t (*batch)[188] = malloc( i_pkts * 188 );
+    uint8_t **pp_pkts = malloc( i_pkts * sizeof(*pp_pkts) );
+    assert( clear && ref && batch && pp_pkts );
+
+    for( size_t i = 0; i < i_pkts; i++ )
+    {
+        packet_random( clear[i] );
+        pp_pkts[i] = batch[i];
+    }
+
+    /* scramble */
+    memcpy( ref, clear, i_pkts * 188 );
+    memcpy( batch, clear, i_pkts * 188 );
+    csa_UseKey( NULL, c, rand() % 2 );
+    for( size_t i = 0; i < i_pkts; i++ )
+        csa_Encrypt( c, ref[i], i_pkt_size );
+    csa_EncryptBatch( c, pp_pkts, i_pkts, i_pkt_size );
+    assert( !memcmp( ref, batch, i_pkts * 188 ) );
+
+    /* descramble a mix of odd and even keys */
+    for( size_t i = 0; i < i_pkts; i++ )
+    {
+        memcpy( ref[i], clear[i], 188 );
+        csa_UseKey( NULL, c, rand() % 2 );
+        csa_Encrypt( c, ref[i], i_pkt_size );
+        memcpy( batch[i], ref[i], 188 );
+        csa_Decrypt( c, ref[i], i_pkt_size );
+    }
+    csa_DecryptBatch( c, pp_pkts, i_pkts, i_pkt_size );
+    assert( !memcmp( ref, batch, i_pkts * 188 ) );
+    if( i_pkt_size == 188 )
+        assert( !memcmp( clear, batch, i_pkts * 188 ) );
+
+    free( pp_pkts );
+    free( batch );
+    free( ref );
+    free( clear );
+}
+
+typedef size_t (*stream_xor_t)( const uint8_t ck[8], const csa_lane_t *,
+                                size_t );
+
+static void test_stream( const char *psz_name, stream_xor_t pf_xor,
+                         size_t i_width )
+{
+    uint8_t data[2][300][188];
+    csa_lane_t lanes[2][300];
+    uint8_t ck[8];
+
+    printf( "testing %zu lanes %s stream cypher\n", i_width, psz_name );
+
+    for( size_t i = 0; i < 8; i++ )
+        ck[i] = rand();
+
+    for( size_t i = 0; i < 300; i++ )
+    {
+        int i_hdr = rand() % 4 ? 4 : 4 + rand() % 190;
+        if( i_hdr > 180 )
+            i_hdr = 180;
+
+        for( size_t j = 0; j < 188; j++ )
+            data[0][i][j] = data[1][i][j] = rand();
+        for( size_t k = 0; k < 2; k++ )
+        {
+            lanes[k][i].p_sb = &data[k][i][i_hdr];
+            lanes[k][i].p_data = &data[k][i][i_hdr + 8];
+            lanes[k][i].i_data = 188 - i_hdr - 8;
+        }
+    }
+
+    for( size_t i = 0; i < 300; i++ )
+        csa_StreamXor( ck, &lanes[0][i] );
+    for( size_t i = 0; i < 300; )
+        i += pf_xor( ck, &lanes[1][i], 300 - i );
+    assert( !memcmp( data[0], data[1], sizeof(data[0]) ) );
+
+    /* partial batches */
+    for( size_t i = 1; i < i_width; i += i_width / 4 + 1 )
+    {
+        memcpy( data[1], data[0], sizeof(data[0]) );
+        for( size_t j = 0; j < i; j++ )
+            csa_StreamXor( ck, &lanes[0][j] );
+        assert( pf_xor( ck, lanes[1], i ) == i );
+        assert( !memcmp( data[0], data[1], sizeof(data[0]) ) );
+    }
+}
+
+int main( void )
+{
+    csa_t *c = csa_New();
+    assert( c != NULL );
+
+    assert( csa_SetCW( NULL, c, (char *)"0x0123456789abcdef", true ) == VLC_SUCCESS );
+    assert( csa_SetCW( NULL, c, (char *)"0xfedcba9876543210", false ) == VLC_SUCCESS );
+    test_known( c );
+
+    test_stream( "scalar", csa_bs_StreamXor_64, 64 );
+#if defined(CAN_COMPILE_SSE2) || defined(HAVE_SSE2_INTRINSICS)
+    if( vlc_CPU_SSE2() )
+        test_stream( "SSE2", csa_bs_StreamXor_sse2, 128 );
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+    if( vlc_CPU_AVX2() )
+        test_stream( "AVX2", csa_bs_StreamXor_avx2, 256 );
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    test_stream( "NEON", csa_bs_StreamXor_neon, 128 );
+#endif
+
+    const size_t sizes[] = { 1, 3, 4, 17, 64, 65, 128, 129, 200, 256, 257, 600 };
+    for( size_t i = 0; i < ARRAY_SIZE(sizes); i++ )
+    {
+        test_batch( c, sizes[i], 188 );
+        test_batch( c, sizes[i], 12 + rand() % 177 );
+    }
+
+    csa_Delete( c );
+    return 0;
+}
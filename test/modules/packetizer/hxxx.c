@@ -208,9 +208,86 @@ static void test_annexb()
     test_iterators( NULL, 0, p_res, rgi_res );
 }
 
+/* the helpers only return sequences followed by at least one byte */
+static const uint8_t * ref_find( const uint8_t *p, const uint8_t *end, uint8_t c )
+{
+    for( ; end - p >= 4; p++ )
+        if( p[0] == 0 && p[1] == 0 && p[2] == c )
+            return p;
+    return NULL;
+}
+
+static size_t ref_ep3b_to_rbsp( const uint8_t *p_src, size_t i_src, uint8_t *p_dst )
+{
+    size_t j = 0;
+    for( size_t i = 0; i < i_src; i++ )
+    {
+        if( i + 3 < i_src &&
+            p_src[i] == 0 && p_src[i+1] == 0 && p_src[i+2] == 3 )
+        {
+            p_dst[j++] = 0;
+            p_dst[j++] = 0;
+            i += 2;
+            continue;
+        }
+        p_dst[j++] = p_src[i];
+    }
+    return j;
+}
+
+static void test_startcode_scan( void )
+{
+    printf("\nTEST startcode / emulation prevention scanning\n");
+
+    /* zero rich random data, at every alignment, so that all the SIMD
+     * block boundaries and scalar tails get hit */
+    uint8_t buf[32 + 512 + 32];
+    uint8_t ref[sizeof(buf)];
+    srand( 0 );
+    for( unsigned i_run = 0; i_run < 2000; i_run++ )
+    {
+        for( size_t i = 0; i < sizeof(buf); i++ )
+        {
+            const int r = rand() % 8;
+            buf[i] = r < 4 ? 0x00 : r == 4 ? 0x01 : r == 5 ? 0x03 : rand();
+        }
+
+        const size_t i_offset = i_run % 32;
+        const size_t i_size = rand() % 512;
+        const uint8_t *p = &buf[i_offset];
+        const uint8_t *end = &p[i_size];
+
+        for( const uint8_t *q = p; ; q += 3 )
+        {
+            const uint8_t *r = ref_find( q, end, 0x01 );
+            assert( startcode_FindAnnexB( q, end ) == r );
+            if( !r )
+                break;
+            q = r;
+        }
+        for( const uint8_t *q = p; ; q += 3 )
+        {
+            const uint8_t *r = ref_find( q, end, 0x03 );
+            assert( startcode_FindEP3B( q, end ) == r );
+            if( !r )
+                break;
+            q = r;
+        }
+
+        size_t i_ref = ref_ep3b_to_rbsp( p, i_size, ref );
+        size_t i_rbsp;
+        uint8_t *p_rbsp = hxxx_ep3b_to_rbsp( p, i_size, &i_rbsp );
+        assert( p_rbsp );
+        assert( i_rbsp == i_ref );
+        assert( !memcmp( p_rbsp, ref, i_ref ) );
+        free( p_rbsp );
+    }
+}
+
 int main( void )
 {
     test_annexb();
+    test_startcode_scan();
 
     return 0;
 }